@@ -91,6 +91,19 @@ TDS_INT tds_convert(const TDSCONTEXT *context, int srctype, const void *src, TDS
 
 size_t tds_strftime(char *buf, size_t maxsize, const char *format, const TDSDATEREC * timeptr, int prec);
 
+/* dateplan.c */
+typedef struct tds_date_plan TDSDATEPLAN;
+TDSDATEPLAN *tds_date_plan_compile(const char *format);
+void tds_date_plan_free(TDSDATEPLAN *plan);
+size_t tds_date_plan_format(const TDSDATEPLAN *plan, char *buf, size_t maxsize, const TDSDATEREC *dr, int prec);
+size_t tds_locale_strftime(TDSLOCALE *locale, char *buf, size_t maxsize, const char *format,
+			   const TDSDATEREC *dr, int prec);
+
+/* float.c */
+#define TDS_FLOAT_STRING_MAX 32
+size_t tds_double_to_string(double value, char *buf);
+size_t tds_real_to_string(float value, char *buf);
+
 #ifdef __cplusplus
 #if 0
 {
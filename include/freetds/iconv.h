@@ -87,11 +87,28 @@ typedef struct tds_errno_message_flags {
 	unsigned int einval:1;
 } TDS_ERRNO_MESSAGE_FLAGS;
 
+/** built-in converter, same semantic of iconv(3) */
+typedef size_t (*TDS_FAST_ICONV)(const char **inbuf, size_t *inbytesleft, char **outbuf, size_t *outbytesleft);
+
+/** how ASCII characters can be converted without iconv */
+typedef enum
+{
+	TDS_ASCII_NONE = 0,	/**< ASCII characters must be converted by iconv */
+	TDS_ASCII_COPY,		/**< copy bytes */
+	TDS_ASCII_WIDEN,	/**< bytes to UTF-16LE */
+	TDS_ASCII_NARROW,	/**< UTF-16LE to bytes */
+	TDS_ASCII_COPY2,	/**< copy UTF-16LE code units */
+} TDS_ASCII_MODE;
+
 typedef struct tdsiconvdir
 {
 	TDS_ENCODING charset;
 
 	iconv_t cd;
+	/** used in place of cd if not NULL, see tds_fast_iconv_get() */
+	TDS_FAST_ICONV fast;
+	/** ASCII runs are converted by tds_iconv() without using cd */
+	TDS_ASCII_MODE ascii;
 } TDSICONVDIR;
 
 struct tdsiconvinfo
@@ -126,6 +143,11 @@ const char *tds_canonical_collate_name(int canonical_charset);
 TDSICONV *tds_iconv_get(TDSCONNECTION * conn, const char *client_charset, const char *server_charset);
 TDSICONV *tds_iconv_get_info(TDSCONNECTION * conn, int canonic_client, int canonic_server);
 
+/* utfconv.c */
+TDS_FAST_ICONV tds_fast_iconv_get(int from_canonic, int to_canonic);
+TDS_ASCII_MODE tds_ascii_mode(int from_canonic, int to_canonic);
+size_t tds_ascii_convert(TDS_ASCII_MODE mode, const char **inbuf, size_t *inbytesleft, char **outbuf, size_t *outbytesleft);
+
 #ifdef __cplusplus
 }
 #endif
@@ -152,6 +152,14 @@ typedef TDS_UINT8 TDS_BIGDATETIME;
 #define TDS_SP_PREPEXECRPC     14
 #define TDS_SP_UNPREPARE       15
 
+/* feature extensions, see TDS_CONTROL_FEATUREEXTACK_TOKEN */
+#define TDS_FEATURE_UTF8_SUPPORT 0x0a
+#define TDS_FEATURE_TERMINATOR   0xff
+
+/* RPC option flags */
+#define TDS_RPC_WITH_RECOMPILE  0x01
+#define TDS_RPC_NO_METADATA     0x02
+
 /**
  * Flags returned in TDS_DONE token
  */
@@ -96,6 +96,11 @@ typedef struct tds_compiletime_settings
 	bool mars;		/* MARS enabled */
 	bool sspi;		/* SSPI enabled */
 	bool kerberos;		/* Kerberos enabled */
+	bool tcp_cork;		/* TCP_CORK used to coalesce packets */
+	bool busy_poll;		/* SO_BUSY_POLL can be set */
+	bool tcp_quickack;	/* TCP_QUICKACK can be set */
+	bool keepalive_timing;	/* keepalive idle time and interval can be set */
+	bool ktls;		/* TLS records can be handled by the kernel */
 } TDS_COMPILETIME_SETTINGS;
 
 /**
@@ -181,6 +186,8 @@ typedef int TDSRET;
 #define TDS_SUCCESS          ((TDSRET)0)
 #define TDS_FAIL             ((TDSRET)-1)
 #define TDS_CANCELLED        ((TDSRET)-2)
+/** returned in non-blocking mode if data is not available yet, callers not handling it see a failure */
+#define TDS_WOULD_BLOCK      ((TDSRET)-3)
 #define TDS_FAILED(rc) ((rc)<0)
 #define TDS_SUCCEED(rc) ((rc)>=0)
 #define TDS_PROPAGATE(rc) \
@@ -362,6 +369,8 @@ extern const char *const tds_type_names[256];
 
 #define is_blob_type(x)       ((x)==SYBTEXT || (x)==SYBIMAGE || (x)==SYBNTEXT)
 #define is_blob_col(x)        ((x)->column_varint_size > 2)
+/** data of current row for a column, see TDSCOLUMN::column_borrowed */
+#define tds_column_data(col)  ((col)->column_borrowed ? (col)->column_borrowed : (col)->column_data)
 /* large type means it has a two byte size field */
 /* define is_large_type(x) (x>128) */
 #define is_numeric_type(x)    ((x)==SYBNUMERIC || (x)==SYBDECIMAL)
@@ -390,6 +399,10 @@ is_tds_type_valid(int type)
 #define TDS_DEF_BLKSZ		512
 #define TDS_DEF_CHARSET		"iso_1"
 #define TDS_DEF_LANG		"us_english"
+/* milliseconds between connection attempts to different addresses, 0 tries all at once */
+#define TDS_DEF_CONNECT_ATTEMPT_DELAY	0
+/* seconds discovered instance ports and versions are kept */
+#define TDS_DEF_DISCOVERY_CACHE_TTL	3600
 #if TDS50
 #define TDS_DEFAULT_VERSION	0x500
 #define TDS_DEF_PORT		4000
@@ -420,6 +433,13 @@ is_tds_type_valid(int type)
 #define TDS_STR_TIMEOUT  "timeout"
 #define TDS_STR_QUERY_TIMEOUT  "query timeout"
 #define TDS_STR_CONNTIMEOUT "connect timeout"
+#define TDS_STR_CONNECT_ATTEMPT_DELAY "connect attempt delay"
+/* file to cache instance ports and detected TDS versions */
+#define TDS_STR_DISCOVERY_CACHE "discovery cache"
+#define TDS_STR_DISCOVERY_CACHE_TTL "discovery cache ttl"
+/* seconds to cache host name resolutions in the process */
+#define TDS_STR_DNS_CACHE_TTL "dns cache ttl"
+#define TDS_STR_DNS_NEGATIVE_CACHE_TTL "dns negative cache ttl"
 #define TDS_STR_HOSTNAME "hostname"
 #define TDS_STR_HOST     "host"
 #define TDS_STR_PORT     "port"
@@ -473,6 +493,24 @@ is_tds_type_valid(int type)
 #define TDS_STR_ENABLE_TLS_V1 "enable tls v1"
 /* enable old TLS v1.1 */
 #define TDS_STR_ENABLE_TLS_V1_1 "enable tls v1.1"
+/* number of unused packets to keep for each size */
+#define TDS_STR_PACKET_POOL_SIZE "packet pool size"
+/* use io_uring for network I/O if available */
+#define TDS_STR_USE_IO_URING "use io_uring"
+/* let the kernel encrypt and decrypt TLS records if possible */
+#define TDS_STR_USE_KTLS "use kernel tls"
+/* do not receive result metadata again executing prepared statements */
+#define TDS_STR_RPC_NO_METADATA "rpc no metadata"
+/* bytes to read from the network in advance */
+#define TDS_STR_READ_AHEAD "read ahead size"
+/* socket tuning */
+#define TDS_STR_SOCKET_RCVBUF "socket receive buffer"
+#define TDS_STR_SOCKET_SNDBUF "socket send buffer"
+#define TDS_STR_SOCKET_BUSY_POLL "socket busy poll"
+#define TDS_STR_TCP_CORK "tcp cork"
+#define TDS_STR_TCP_QUICKACK "tcp quickack"
+#define TDS_STR_KEEPALIVE_IDLE "keepalive idle"
+#define TDS_STR_KEEPALIVE_INTERVAL "keepalive interval"
 
 
 /* TODO do a better check for alignment than this */
@@ -504,9 +542,18 @@ typedef struct tds_login
 	int port;			/**< port of database service */
 	TDS_USMALLINT tds_version;	/**< TDS version */
 	int block_size;
+	int packet_pool_size;		/**< high-water mark of packet pool, -1 if not specified */
+	int read_ahead_size;		/**< size of network read-ahead buffer, -1 if not specified */
+	int socket_rcvbuf;		/**< SO_RCVBUF, -1 if not specified */
+	int socket_sndbuf;		/**< SO_SNDBUF, -1 if not specified */
+	int socket_busy_poll;		/**< SO_BUSY_POLL in microseconds, -1 if not specified */
+	int keepalive_idle;		/**< seconds before first keepalive probe, -1 if not specified */
+	int keepalive_interval;		/**< seconds between keepalive probes, -1 if not specified */
 	DSTR language;			/* e.g. us-english */
 	DSTR server_charset;		/**< charset of server e.g. iso_1 */
 	TDS_INT connect_timeout;
+	int connect_attempt_delay;	/**< milliseconds between connection attempts, -1 if not specified */
+	int discovery_cache_ttl;	/**< seconds entries in discovery cache are valid, -1 if not specified */
 	DSTR client_host_name;
 	DSTR server_host_name;
 	DSTR server_realm_name;		/**< server realm name (in freetds.conf) */
@@ -514,6 +561,7 @@ typedef struct tds_login
 	DSTR db_filename;		/**< database filename to attach (MSSQL) */
 	DSTR cafile;			/**< certificate authorities file */
 	DSTR crlfile;			/**< certificate revocation file */
+	DSTR discovery_cache;		/**< file to cache discovered ports and versions */
 	DSTR certificate_host_name;	/**< certificate hostname to check, if empty use server_host_name */
 	DSTR openssl_ciphers;
 	DSTR gnutls_ciphers;		/**< gnutls ciphers to use */
@@ -558,6 +606,12 @@ typedef struct tds_login
 	unsigned int enable_tls_v1_1:1;
 	unsigned int enable_tls_v1_1_specified:1;
 	unsigned int server_is_valid:1;
+	unsigned int use_io_uring:1;
+	unsigned int use_ktls:1;
+	unsigned int rpc_no_metadata:1;
+	unsigned int tcp_cork:1;
+	unsigned int tcp_quickack:1;
+	unsigned int tcp_quickack_specified:1;
 } TDSLOGIN;
 
 typedef struct tds_headers
@@ -575,6 +629,8 @@ typedef struct tds_locale
 	char *datetime_fmt;
 	char *date_fmt;
 	char *time_fmt;
+	/** formats compiled by tds_locale_strftime() */
+	struct tds_date_plan_cache *date_plans;
 } TDSLOCALE;
 
 /** 
@@ -709,6 +765,11 @@ struct tds_column
 
 	unsigned char *column_data;
 	void (*column_data_free)(struct tds_column *column);
+	/**
+	 * Data of current row still inside the received packet, used instead
+	 * of column_data if not NULL. See TDSRESULTINFO::borrow_data.
+	 */
+	unsigned char *column_borrowed;
 	unsigned char column_nullable:1;
 	unsigned char column_writeable:1;
 	unsigned char column_identity:1;
@@ -776,6 +837,16 @@ typedef struct tds_result_info
 	bool rows_exist;
 	/* TODO remove ?? used only in dblib */
 	bool more_results;
+	/**
+	 * Allow data of rows to be left inside the received packets.
+	 * Data must be accessed with tds_column_data() and is valid
+	 * till the next call to tds_process_tokens().
+	 */
+	bool borrow_data;
+	/** how to decode rows, built at first row, see tds_get_row_data() */
+	struct tds_row_plan *row_plan;
+	/** arena the result was allocated from, NULL if allocated from the heap */
+	struct tds_arena *arena;
 } TDSRESULTINFO;
 
 /** values for tds->state */
@@ -1002,6 +1073,15 @@ typedef struct tds_dynamic
 	TDSPARAMINFO *params;
 	/** saved query, we need to know original query if prepare is impossible */
 	char *query;
+	/**
+	 * metadata of the result returned by last execution.
+	 * If present server is asked to not send them again (mssql 2005+)
+	 */
+	TDSRESULTINFO *meta;
+	/** number of result sets returned by current execution */
+	unsigned num_results;
+	/** query returns more than a result set, metadata are always requested */
+	bool multiple_results;
 } TDSDYNAMIC;
 
 typedef enum {
@@ -1030,6 +1110,10 @@ struct tds_context
 	int (*err_handler) (const TDSCONTEXT *, TDSSOCKET *, TDSMESSAGE *);
 	int (*int_handler) (void *);
 	bool money_use_2_digits;
+	/** unused packets, shared by all connections of this context */
+	struct tds_packet_pool *packet_pool;
+	/** TLS sessions to resume, shared by all connections of this context */
+	struct tds_tls_session_cache *tls_sessions;
 };
 
 enum TDS_ICONV_ENTRY
@@ -1077,6 +1161,49 @@ typedef struct tds_packet
 #define tds_packet_get_data_start(pkt) 0
 #endif
 
+/** Number of size classes in a packet pool */
+#define TDS_PACKET_POOL_CLASSES 8
+
+/** Default number of packets kept for each size class */
+#define TDS_DEF_PACKET_POOL_SIZE 8
+
+/** Maximum number of packets of a message gathered before writing them */
+#define TDS_MAX_SEND_BATCH 8
+
+/** Default size of network read-ahead buffer */
+#define TDS_DEF_READ_AHEAD_SIZE 32768
+
+typedef struct tds_packet_pool_stats
+{
+	/** requests satisfied with a cached packet */
+	unsigned long hits;
+	/** requests which required a new allocation */
+	unsigned long misses;
+	/** packets freed as their size class was full */
+	unsigned long discards;
+	/** packets currently cached */
+	unsigned cached;
+} TDSPACKETPOOLSTATS;
+
+/**
+ * Cache of unused packets.
+ * Packets are kept in size classes, class n contains packets with
+ * capacity from 1024 << (n-1) up to 1024 << n (first and last classes
+ * are open ended).
+ * The pool is reference counted, the context and every connection
+ * created from it hold a reference.
+ */
+typedef struct tds_packet_pool
+{
+	tds_mutex mtx;
+	unsigned ref_count;
+	/** high-water mark, maximum number of packets kept for each class */
+	unsigned max_packets;
+	unsigned num_packets[TDS_PACKET_POOL_CLASSES];
+	TDSPACKET *packets[TDS_PACKET_POOL_CLASSES];
+	TDSPACKETPOOLSTATS stats;
+} TDSPACKETPOOL;
+
 typedef struct tds_poll_wakeup
 {
 	TDS_SYS_SOCKET s_signal, s_signaled;
@@ -1112,6 +1239,8 @@ struct tds_connection
 	TDSICONV **char_convs;
 
 	TDS_UCHAR collation[5];
+	/** incremented when server charset or collation change, invalidates cached metadata */
+	unsigned int charset_changes;
 	TDS_UCHAR tds72_transaction[8];
 
 	TDS_CAPABILITIES capabilities;
@@ -1119,8 +1248,28 @@ struct tds_connection
 	unsigned int tds71rev1:1;
 	unsigned int pending_close:1;	/**< true is connection has pending closing (cursors or dynamic) */
 	unsigned int encrypt_single_packet:1;
+	/** true if tokens can be decoded before the whole packet has been received */
+	unsigned int partial_packets:1;
+	/** true if cached metadata are used executing prepared statements, see TDSDYNAMIC::meta */
+	unsigned int rpc_no_metadata:1;
+	/** do not cork the socket while sending multi-packet messages */
+	unsigned int no_cork:1;
+	/** acknowledge received data immediately, reset after every read */
+	unsigned int quickack:1;
+
+	/**
+	 * Data read from the socket but not consumed yet.
+	 * Allows to receive multiple packets with a single system call.
+	 */
+	struct
+	{
+		unsigned char *buf;
+		unsigned pos, len, size;
+	} read_ahead;
 #if ENABLE_ODBC_MARS
 	unsigned int mars:1;
+	/** true if network I/O is driven by the application, see tds_set_nonblocking() */
+	unsigned int nonblocking:1;
 
 	TDSSOCKET *in_net_tds;
 	TDSPACKET *packets;
@@ -1135,8 +1284,8 @@ struct tds_connection
 #endif
 	tds_mutex list_mtx;
 
-	unsigned num_cached_packets;
-	TDSPACKET *packet_cache;
+	/** pool to get packets from, usually shared with the context */
+	TDSPACKETPOOL *packet_pool;
 
 	int spid;
 	int client_spid;
@@ -1155,6 +1304,14 @@ struct tds_connection
 	uint8_t unicharsize;
 
 	void *tls_session;
+	/** key of TLS session in context cache */
+	char *tls_session_key;
+	/** last TLS handshake resumed a previous session */
+	unsigned int tls_resumed:1;
+	/** kernel encrypts data sent, see tds_ssl_ktls_start() */
+	unsigned int ktls_tx:1;
+	/** kernel decrypts data received */
+	unsigned int ktls_rx:1;
 #if defined(HAVE_GNUTLS)
 	void *tls_credentials;
 #elif defined(HAVE_OPENSSL)
@@ -1164,6 +1321,8 @@ struct tds_connection
 #endif
 	TDSAUTHENTICATION *authentication;
 	char *server;
+	/** io_uring state if used for network I/O, see uring.h */
+	struct tds_uring *uring;
 };
 
 /**
@@ -1202,6 +1361,8 @@ struct tds_socket
 	unsigned in_pos;		/**< current position in in_buf */
 	unsigned out_pos;		/**< current position in out_buf */
 	unsigned in_len;		/**< input buffer length */
+	unsigned in_partial;		/**< bytes of current input packet still to receive */
+	unsigned in_packets;		/**< packets received, to check data did not span packets */
 	unsigned char in_flag;		/**< input buffer type */
 	unsigned char out_flag;		/**< output buffer type */
 
@@ -1234,11 +1395,22 @@ struct tds_socket
 	TDS_UINT send_seq;
 	TDS_UINT recv_wnd;
 	TDS_UINT send_wnd;
+	/**
+	 * Number of packets in conn->packets terminating a response.
+	 * This field should be protected by conn->list_mtx
+	 */
+	unsigned recv_eom;
 #endif
 	/* packet we received */
 	TDSPACKET *recv_packet;
+	/** received packets still referenced by borrowed column data */
+	TDSPACKET *borrowed_packets;
 	/** packet we are preparing to send */
 	TDSPACKET *send_packet;
+	/** packets of current message ready but not sent yet, linked by next */
+	TDSPACKET *send_queue;
+	/** number of packets in send_queue */
+	unsigned send_queued;
 
 	/**
 	 * Current query information. 
@@ -1250,10 +1422,23 @@ struct tds_socket
 	TDS_UINT num_comp_info;
 	TDSCOMPUTEINFO **comp_info;
 	TDSPARAMINFO *param_info;
+	/** memory for res_info and comp_info, see tds_alloc_socket_results() */
+	struct tds_arena *arena;
+	/** last result metadata and its wire form, reused if received again */
+	struct
+	{
+		TDSRESULTINFO *info;
+		unsigned char *wire;
+		unsigned int len;
+		/** TDSCONNECTION::charset_changes when cached */
+		unsigned int charset_changes;
+	} meta_cache;
 	TDSCURSOR *cur_cursor;		/**< cursor in use */
 	bool bulk_query;		/**< true is query sent was a bulk query so we need to switch state to QUERYING */
 	bool has_status; 		/**< true is ret_status is valid */
 	bool in_row;			/**< true if we are getting rows */
+	bool borrow_data;		/**< true if reading a row which data can be borrowed */
+	bool packet_borrowed;		/**< true if recv_packet is referenced by borrowed data */
 	volatile 
 	unsigned char in_cancel; 	/**< indicate we are waiting a cancel reply; discard tokens till acknowledge; 
 	1 mean we have to send cancel packet, 2 already sent. */
@@ -1307,6 +1492,28 @@ void tds_fix_login(TDSLOGIN* login);
 TDS_USMALLINT * tds_config_verstr(const char *tdsver, TDSLOGIN* login);
 struct addrinfo *tds_lookup_host(const char *servername);
 TDSRET tds_lookup_host_set(const char *servername, struct addrinfo **addr);
+
+/* dnscache.c */
+typedef struct tds_dns_cache_stats
+{
+	/** lookups satisfied by the cache */
+	unsigned long hits;
+	/** lookups satisfied by a cached resolution failure */
+	unsigned long negative_hits;
+	/** lookups which required a resolution */
+	unsigned long misses;
+	/** resolutions started in background to refresh an entry */
+	unsigned long refreshes;
+	/** names currently cached */
+	unsigned entries;
+} TDSDNSCACHESTATS;
+
+struct addrinfo *tds_dns_cache_lookup(const char *host);
+void tds_dns_cache_config(int ttl, int negative_ttl);
+void tds_dns_cache_flush(void);
+void tds_dns_cache_get_stats(TDSDNSCACHESTATS *stats);
+struct addrinfo *tds_addrinfo_dup(const struct addrinfo *addr);
+void tds_addrinfo_free(struct addrinfo *addr);
 const char *tds_addrinfo2str(struct addrinfo *addr, char *name, int namemax);
 
 TDSRET tds_set_interfaces_file_loc(const char *interfloc);
@@ -1339,6 +1546,7 @@ TDSICONV *tds_iconv_from_collate(TDSCONNECTION * conn, const TDS_UCHAR collate[5
 void tds_free_socket(TDSSOCKET * tds);
 void tds_free_all_results(TDSSOCKET * tds);
 void tds_free_results(TDSRESULTINFO * res_info);
+void tds_free_meta_cache(TDSSOCKET * tds);
 void tds_free_param_results(TDSPARAMINFO * param_info);
 void tds_free_param_result(TDSPARAMINFO * param_info);
 void tds_free_msg(TDSMESSAGE * message);
@@ -1346,12 +1554,14 @@ void tds_cursor_deallocated(TDSCONNECTION *conn, TDSCURSOR *cursor);
 void tds_release_cursor(TDSCURSOR **pcursor);
 void tds_free_bcp_column_data(BCPCOLDATA * coldata);
 TDSRESULTINFO *tds_alloc_results(TDS_USMALLINT num_cols);
+TDSRESULTINFO *tds_alloc_socket_results(TDSSOCKET * tds, TDS_USMALLINT num_cols);
 TDSCOMPUTEINFO **tds_alloc_compute_results(TDSSOCKET * tds, TDS_USMALLINT num_cols, TDS_USMALLINT by_cols);
 TDSCONTEXT *tds_alloc_context(void * parent);
 void tds_free_context(TDSCONTEXT * locale);
 TDSPARAMINFO *tds_alloc_param_result(TDSPARAMINFO * old_param);
 void tds_free_input_params(TDSDYNAMIC * dyn);
 void tds_release_dynamic(TDSDYNAMIC ** dyn);
+void tds_dynamic_free_meta(TDSDYNAMIC * dyn);
 inline static void
 tds_release_cur_dyn(TDSSOCKET * tds)
 {
@@ -1379,9 +1589,29 @@ void * tds_realloc(void **pp, size_t new_size);
 #define TDS_RESIZE(p, n_elem) \
 	tds_realloc((void **) &(p), sizeof(*(p)) * (size_t) (n_elem))
 
+
+/** Counters of a socket arena, see tds_get_arena_stats() */
+typedef struct tds_arena_stats
+{
+	/** blocks allocated from the arena */
+	unsigned long allocs;
+	/** blocks allocated from the heap as the arena was full */
+	unsigned long fallbacks;
+	/** times the arena was emptied to be reused */
+	unsigned long resets;
+	/** memory chunks allocated from the heap by the arena */
+	unsigned long chunks;
+	/** bytes currently reserved by the arena */
+	size_t reserved;
+} TDSARENASTATS;
+
+void tds_get_arena_stats(TDSSOCKET * tds, TDSARENASTATS * stats);
+
 TDSPACKET *tds_alloc_packet(void *buf, unsigned len);
 TDSPACKET *tds_realloc_packet(TDSPACKET *packet, unsigned len);
 void tds_free_packets(TDSPACKET *packet);
+TDSPACKETPOOL *tds_alloc_packet_pool(void);
+void tds_release_packet_pool(TDSPACKETPOOL *pool);
 TDSBCPINFO *tds_alloc_bcpinfo(void);
 void tds_free_bcpinfo(TDSBCPINFO *bcpinfo);
 void tds_deinit_bcpinfo(TDSBCPINFO *bcpinfo);
@@ -1465,10 +1695,53 @@ int tds5_send_optioncmd(TDSSOCKET * tds, TDS_OPTION_CMD tds_command, TDS_OPTION
 			TDS_INT * tds_argsize);
 TDSRET tds_process_tokens(TDSSOCKET * tds, /*@out@*/ TDS_INT * result_type, /*@out@*/ int *done_flags, unsigned flag);
 
+/* rowbatch.c */
+/** Values of a column for all rows of a TDSROWBATCH */
+typedef struct tds_batch_column
+{
+	/**
+	 * Column values.
+	 * For fixed layout value of row n is at values + n * stride,
+	 * for variable layout (strings, binaries and blobs) at values + offsets[n].
+	 */
+	unsigned char *values;
+	/** length in bytes of each value, 0 for NULLs */
+	TDS_INT *lengths;
+	/** start of each value inside values, NULL for fixed layout */
+	TDS_UINT *offsets;
+	/** NULL bitmap, row n is NULL if bit n % 8 of nulls[n / 8] is set */
+	unsigned char *nulls;
+	/** distance between values, 0 for variable layout */
+	TDS_UINT stride;
+	/** bytes used in values, variable layout only */
+	TDS_UINT values_len;
+	/** bytes allocated for values, variable layout only */
+	TDS_UINT values_alloc;
+	/** TDSCOLUMN::column_data of the result, restored after fetching */
+	unsigned char *row_data;
+} TDSBATCHCOLUMN;
+
+/** Rows of a result set stored by column, see tds_fetch_row_batch() */
+typedef struct tds_row_batch
+{
+	/** result rows are fetched from, should outlive the batch */
+	TDSRESULTINFO *info;
+	TDS_UINT max_rows;
+	/** rows fetched by last tds_fetch_row_batch() */
+	TDS_UINT num_rows;
+	TDS_USMALLINT num_cols;
+	TDSBATCHCOLUMN *columns;
+} TDSROWBATCH;
+
+TDSROWBATCH *tds_alloc_row_batch(TDSRESULTINFO * info, TDS_UINT max_rows);
+void tds_free_row_batch(TDSROWBATCH * batch);
+TDSRET tds_fetch_row_batch(TDSSOCKET * tds, TDSROWBATCH * batch, /*@out@*/ TDS_INT * result_type);
+
 
 /* data.c */
 void tds_set_param_type(TDSCONNECTION * conn, TDSCOLUMN * curcol, TDS_SERVER_TYPE type);
 void tds_set_column_type(TDSCONNECTION * conn, TDSCOLUMN * curcol, TDS_SERVER_TYPE type);
+TDSRET tds_get_row_data(TDSSOCKET * tds, TDSRESULTINFO * info, const unsigned char *nulls);
 #ifdef WORDS_BIGENDIAN
 void tds_swap_datatype(int coltype, void *b);
 #endif
@@ -1479,6 +1752,10 @@ TDSRET tds_datecrack(TDS_INT datetype, const void *di, TDSDATEREC * dr);
 TDS_SERVER_TYPE tds_get_conversion_type(TDS_SERVER_TYPE srctype, int colsize);
 extern const char tds_hex_digits[];
 
+/* dateplan.c */
+struct tds_date_plan_cache *tds_alloc_date_plans(void);
+void tds_free_date_plans(struct tds_date_plan_cache *cache);
+
 
 /* write.c */
 int tds_init_write_buf(TDSSOCKET * tds);
@@ -1558,15 +1835,23 @@ extern int tds_debug_flags;
 extern int tds_append_mode;
 
 
+/* discovery.c */
+int tds_discovery_cache_get(const TDSLOGIN *login, const char *key);
+void tds_discovery_cache_set(const TDSLOGIN *login, const char *key, int value);
+
+
 /* net.c */
-TDSERRNO tds_open_socket(TDSSOCKET * tds, struct addrinfo *ipaddr, unsigned int port, int timeout, int *p_oserr);
+TDSERRNO tds_open_socket(TDSSOCKET * tds, const TDSLOGIN * login, struct addrinfo *ipaddr, unsigned int port, int timeout, int *p_oserr);
 void tds_close_socket(TDSSOCKET * tds);
 int tds7_get_instance_ports(FILE *output, struct addrinfo *addr);
 int tds7_get_instance_port(struct addrinfo *addr, const char *instance);
 char *tds_prwsaerror(int erc);
 void tds_prwsaerror_free(char *s);
 ptrdiff_t tds_connection_read(TDSSOCKET * tds, unsigned char *buf, size_t buflen);
+bool tds_set_read_ahead(TDSCONNECTION *conn, unsigned size);
 ptrdiff_t tds_connection_write(TDSSOCKET *tds, const unsigned char *buf, size_t buflen, int final);
+ptrdiff_t tds_connection_write_packets(TDSSOCKET *tds, TDSPACKET *const *packets, unsigned num_packets, unsigned skip,
+				       int final);
 void tds_connection_coalesce(TDSSOCKET *tds);
 void tds_connection_flush(TDSSOCKET *tds);
 #define TDSSELREAD  POLLIN
@@ -1588,13 +1873,27 @@ tds_wakeup_get_fd(const TDSPOLLWAKEUP *wakeup)
 
 /* packet.c */
 int tds_read_packet(TDSSOCKET * tds);
+int tds_read_partial_packet(TDSSOCKET * tds);
 TDSRET tds_write_packet(TDSSOCKET * tds, unsigned char final);
+void tds_set_packet_pool_size(TDSPACKETPOOL *pool, unsigned max_packets);
+bool tds_connection_set_packet_pool_size(TDSCONNECTION *conn, unsigned max_packets);
+void tds_get_packet_pool_stats(TDSPACKETPOOL *pool, TDSPACKETPOOLSTATS *stats);
+void tds_release_borrowed_packets(TDSSOCKET *tds);
 #if ENABLE_ODBC_MARS
 int tds_append_cancel(TDSSOCKET *tds);
 TDSRET tds_append_syn(TDSSOCKET *tds);
 TDSRET tds_append_fin(TDSSOCKET *tds);
+TDSRET tds_set_nonblocking(TDSSOCKET *tds, bool nonblocking);
+TDS_SYS_SOCKET tds_get_poll_events(TDSSOCKET *tds, short *events);
+TDSRET tds_process_events(TDSSOCKET *tds, short revents);
+bool tds_response_received(TDSSOCKET *tds);
 #else
 int tds_put_cancel(TDSSOCKET * tds);
+/* non-blocking mode needs the packet queues of builds with MARS support */
+#define tds_set_nonblocking(tds, nonblocking) tds_nonblocking_mode_requires_mars_support
+#define tds_get_poll_events(tds, events) tds_nonblocking_mode_requires_mars_support
+#define tds_process_events(tds, revents) tds_nonblocking_mode_requires_mars_support
+#define tds_response_received(tds) tds_nonblocking_mode_requires_mars_support
 #endif
 
 typedef struct tds_freeze {
@@ -1648,6 +1947,9 @@ TDSRET tds_vstrbuild(char *buffer, int buflen, int *resultlen, const char *text,
 char *tds_money_to_string(const TDS_MONEY * money, char *s, bool use_2_digits);
 TDS_INT tds_numeric_to_string(const TDS_NUMERIC * numeric, char *s);
 TDS_INT tds_numeric_change_prec_scale(TDS_NUMERIC * numeric, unsigned char new_prec, unsigned char new_scale);
+TDS_INT tds_numeric_cmp(const TDS_NUMERIC * a, const TDS_NUMERIC * b, int *result);
+bool tds_numeric_set_digits(TDS_NUMERIC * numeric, const char *integer, size_t digits,
+			    const char *decimals, size_t num_decimals);
 
 
 /* getmac.c */
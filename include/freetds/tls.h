@@ -39,6 +39,18 @@
 #  include <openssl/err.h>
 #endif
 
+/*
+ * Kernel TLS needs the record keys computed during the handshake.
+ * GnuTLS exports them, with OpenSSL they are derived again from the
+ * session secrets which requires TLS 1.3 support.
+ */
+#if defined(__linux__) && defined(HAVE_LINUX_TLS_H) \
+    && ((defined(HAVE_GNUTLS) && GNUTLS_VERSION_NUMBER >= 0x030605) \
+	|| (!defined(HAVE_GNUTLS) && defined(HAVE_OPENSSL) && OPENSSL_VERSION_NUMBER >= 0x10101000L \
+	    && !defined(LIBRESSL_VERSION_NUMBER)))
+#define TDS_HAVE_KTLS 1
+#endif
+
 #include <freetds/pushvis.h>
 
 #if defined(HAVE_GNUTLS) || defined(HAVE_OPENSSL)
@@ -49,6 +61,8 @@
 TDSRET tds_ssl_init(TDSSOCKET *tds, bool full);
 void tds_ssl_deinit(TDSCONNECTION *conn);
 size_t tds_ssl_get_cb(TDSCONNECTION * conn, void *cb, size_t cblen);
+struct tds_tls_session_cache *tds_tls_session_cache_alloc(void);
+void tds_tls_session_cache_free(struct tds_tls_session_cache *cache);
 
 #  ifdef HAVE_GNUTLS
 /*
@@ -116,6 +130,17 @@ tds_ssl_deinit(TDSCONNECTION *conn TDS_UNUSED)
 {
 }
 
+static inline struct tds_tls_session_cache *
+tds_tls_session_cache_alloc(void)
+{
+	return NULL;
+}
+
+static inline void
+tds_tls_session_cache_free(struct tds_tls_session_cache *cache TDS_UNUSED)
+{
+}
+
 static inline int
 tds_ssl_pending(TDSCONNECTION *conn TDS_UNUSED)
 {
@@ -141,6 +166,17 @@ tds_ssl_get_cb(TDSCONNECTION *conn TDS_UNUSED, void *cb TDS_UNUSED, size_t cblen
 }
 #endif
 
+#ifdef TDS_HAVE_KTLS
+TDSRET tds_ssl_ktls_start(TDSSOCKET *tds);
+ptrdiff_t tds_ktls_recv(TDSCONNECTION *conn, unsigned char *buf, size_t buflen);
+#else
+static inline TDSRET
+tds_ssl_ktls_start(TDSSOCKET *tds TDS_UNUSED)
+{
+	return TDS_SUCCESS;
+}
+#endif
+
 #include <freetds/popvis.h>
 
 #endif /* _tdsguard_hpUeh3TzYOzN1FtT39tMHz_ */
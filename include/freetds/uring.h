@@ -0,0 +1,66 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _tdsguard_HkkX860tYmwaR70i6cejZE_
+#define _tdsguard_HkkX860tYmwaR70i6cejZE_
+
+#ifndef _tdsguard_hfOrWb5znoUCWdBPoNQvqN_
+#error tds.h must be included before uring.h
+#endif
+
+/*
+ * io_uring is used only by the blocking network code, MARS uses
+ * non-blocking sockets driven by tds_connection_network().
+ */
+#if ENABLE_IO_URING && defined(HAVE_LINUX_IO_URING_H) && !ENABLE_ODBC_MARS
+#define TDS_HAVE_IO_URING 1
+#endif
+
+#include <freetds/pushvis.h>
+
+#ifdef TDS_HAVE_IO_URING
+
+struct iovec;
+
+bool tds_uring_init(TDSCONNECTION *conn);
+void tds_uring_free(TDSCONNECTION *conn);
+int tds_uring_poll(TDSCONNECTION *conn, unsigned tds_sel, int timeout_ms, bool *wakeup);
+ptrdiff_t tds_uring_recv(TDSSOCKET *tds, unsigned char *buf, size_t buflen);
+bool tds_uring_post_send(TDSCONNECTION *conn, const struct iovec *iov, int iovcnt);
+ptrdiff_t tds_uring_send_result(TDSSOCKET *tds);
+
+#else
+/*
+ * Definitions if io_uring is not enabled
+ */
+static inline bool
+tds_uring_init(TDSCONNECTION *conn TDS_UNUSED)
+{
+	return false;
+}
+
+static inline void
+tds_uring_free(TDSCONNECTION *conn TDS_UNUSED)
+{
+}
+#endif
+
+#include <freetds/popvis.h>
+
+#endif /* _tdsguard_HkkX860tYmwaR70i6cejZE_ */
@@ -499,6 +499,11 @@ populate_login(TDSLOGIN * login, int argc, char **argv)
 			       "%35s: %s\n"
 			       "%35s: %s\n"
 			       "%35s: %s\n"
+			       "%35s: %s\n"
+			       "%35s: %s\n"
+			       "%35s: %s\n"
+			       "%35s: %s\n"
+			       "%35s: %s\n"
 			       "%35s: %s\n",
 			       "Compile-time settings (established with the \"configure\" script)",
 			       "Version", settings->freetds_version,
@@ -515,7 +520,12 @@ populate_login(TDSLOGIN * login, int argc, char **argv)
 			       "Kerberos", yes_no(settings->kerberos),
 			       "OpenSSL", yes_no(settings->openssl),
 			       "GnuTLS", yes_no(settings->gnutls),
-			       "MARS", yes_no(settings->mars));
+			       "MARS", yes_no(settings->mars),
+			       "TCP_CORK", yes_no(settings->tcp_cork),
+			       "SO_BUSY_POLL", yes_no(settings->busy_poll),
+			       "TCP_QUICKACK", yes_no(settings->tcp_quickack),
+			       "Keepalive timing", yes_no(settings->keepalive_timing),
+			       "Kernel TLS", yes_no(settings->ktls));
 			tds_free_login(login);
 			exit(0);
 			break;
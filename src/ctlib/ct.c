@@ -1788,6 +1788,10 @@ ct_fetch(CS_COMMAND * cmd, CS_INT type, CS_INT offset, CS_INT option, CS_INT * p
 	||  (cmd->curr_result_type == CS_STATUS_RESULT && marker != TDS_RETURNSTATUS_TOKEN) )
 		return CS_END_DATA;
 
+	/* bound data are converted before reading next row, no need to copy them */
+	if (cmd->curr_result_type == CS_ROW_RESULT && tds->current_results)
+		tds->current_results->borrow_data = true;
+
 	/* Array Binding Code changes start here */
 
 	for (temp_count = 0; temp_count < cmd->bind_count; temp_count++) {
@@ -1986,7 +1990,7 @@ _ct_bind_data(CS_CONTEXT *ctx, TDSRESULTINFO * resinfo, TDSRESULTINFO *bindinfo,
 			continue;
 		}
 
-		src = curcol->column_data;
+		src = tds_column_data(curcol);
 		if (is_blob_col(curcol))
 			src = (unsigned char *) ((TDSBLOB *) src)->textvalue;
 
@@ -3034,7 +3038,7 @@ ct_get_data(CS_COMMAND * cmd, CS_INT item, CS_VOID * buffer, CS_INT buflen, CS_I
 		/* get at the source data and length */
 		curcol = resinfo->columns[item - 1];
 
-		src = curcol->column_data;
+		src = tds_column_data(curcol);
 		if (is_blob_col(curcol)) {
 			blob = (TDSBLOB *) src;
 			src = (unsigned char *) blob->textvalue;
@@ -3083,7 +3087,7 @@ ct_get_data(CS_COMMAND * cmd, CS_INT item, CS_VOID * buffer, CS_INT buflen, CS_I
 	} else {
 		/* get at the source data */
 		curcol = resinfo->columns[item - 1];
-		src = curcol->column_data;
+		src = tds_column_data(curcol);
 		if (is_blob_col(curcol))
 			src = (unsigned char *) ((TDSBLOB *) src)->textvalue;
 
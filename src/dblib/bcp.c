@@ -766,8 +766,8 @@ _bcp_convert_out(DBPROCESS * dbproc, TDSCOLUMN *curcol, BCP_HOSTCOLINFO *hostcol
 		TDSDATEREC when;
 
 		tds_datecrack(srctype, src, &when);
-		buflen = (int)tds_strftime((TDS_CHAR *)(*p_data), 256,
-					 bcpdatefmt, &when, 3);
+		buflen = (int)tds_locale_strftime(tds_get_ctx(dbproc->tds_socket)->locale,
+						  (TDS_CHAR *)(*p_data), 256, bcpdatefmt, &when, 3);
 	} else if (srclen == 0 && is_variable_type(curcol->column_type)
 		   && is_ascii_type(hostcol->datatype)) {
 		/*
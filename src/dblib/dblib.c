@@ -1647,6 +1647,7 @@ prretcode(int retcode)
 	case TDS_FAIL:			return "TDS_FAIL";
 	case TDS_NO_MORE_RESULTS:	return "TDS_NO_MORE_RESULTS";
 	case TDS_CANCELLED:		return "TDS_CANCELLED";
+	case TDS_WOULD_BLOCK:		return "TDS_WOULD_BLOCK";
 	default: break;
 	}
 	return "??";
@@ -3503,7 +3504,8 @@ dbspr1row(DBPROCESS * dbproc, char *buffer, DBINT buf_len)
 			srctype = tds_get_conversion_type(colinfo->column_type, colinfo->column_size);
 			if (is_datetime_type(srctype)) {
 				tds_datecrack(srctype, dbdata(dbproc, col + 1), &when);
-				len = (int)tds_strftime(buffer, buf_len, STD_DATETIME_FMT, &when, 3);
+				len = (int)tds_locale_strftime(g_dblib_ctx.tds_ctx->locale, buffer, buf_len,
+							     STD_DATETIME_FMT, &when, 3);
 			} else {
 				len = dbconvert(dbproc, srctype, dbdata(dbproc, col + 1), dbdatlen(dbproc, col + 1), 
 						desttype, (BYTE *) buffer, buf_len);
@@ -3609,7 +3611,8 @@ dbprrow(DBPROCESS * dbproc)
 					srctype = tds_get_conversion_type(colinfo->column_type, colinfo->column_size);
 					if (is_datetime_type(srctype)) {
 						tds_datecrack(srctype, dbdata(dbproc, col + 1), &when);
-						len = (int)tds_strftime(dest, sizeof(dest), STD_DATETIME_FMT, &when, 3);
+						len = (int)tds_locale_strftime(g_dblib_ctx.tds_ctx->locale, dest, sizeof(dest),
+									     STD_DATETIME_FMT, &when, 3);
 					} else {
 						len = dbconvert(dbproc, srctype, dbdata(dbproc, col + 1), dbdatlen(dbproc, col + 1),
 								desttype, (BYTE *) dest, sizeof(dest));
@@ -3742,7 +3745,8 @@ dbprrow(DBPROCESS * dbproc)
 
 				if (is_datetime_type(srctype)) {
 					tds_datecrack(srctype, dbadata(dbproc, computeid, col), &when);
-					len = (int)tds_strftime(dest, sizeof(dest), STD_DATETIME_FMT, &when, 3);
+					len = (int)tds_locale_strftime(g_dblib_ctx.tds_ctx->locale, dest, sizeof(dest),
+								     STD_DATETIME_FMT, &when, 3);
 				} else {
 					len = dbconvert(dbproc, srctype, dbadata(dbproc, computeid, col), -1, desttype,
 							(BYTE *) dest, sizeof(dest));
@@ -403,7 +403,7 @@ odbc_tds2sql(TDS_STMT * stmt, TDSCOLUMN *curcol, int srctype, TDS_CHAR * src, TD
 		if (!fmt) goto normal_conversion;
 
 		tds_datecrack(srctype, src, &when);
-		tds_strftime(buf, sizeof(buf), fmt, &when, prec);
+		tds_locale_strftime(context->locale, buf, sizeof(buf), fmt, &when, prec);
 
 		if (srctype == SYBMSDATETIMEOFFSET) {
 			char sign = '+';
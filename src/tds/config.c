@@ -62,6 +62,10 @@
 #include <netinet/in.h>
 #endif /* HAVE_NETINET_IN_H */
 
+#if HAVE_NETINET_TCP_H
+#include <netinet/tcp.h>
+#endif /* HAVE_NETINET_TCP_H */
+
 #if HAVE_ARPA_INET_H
 #include <arpa/inet.h>
 #endif /* HAVE_ARPA_INET_H */
@@ -72,6 +76,7 @@
 
 #include <freetds/tds.h>
 #include <freetds/configs.h>
+#include <freetds/tls.h>
 #include <freetds/utils/string.h>
 #include <freetds/utils.h>
 #include <freetds/replacements.h>
@@ -82,6 +87,7 @@ static void tds_config_env_tdsver(TDSLOGIN * login);
 static void tds_config_env_tdsport(TDSLOGIN * login);
 static bool tds_config_env_tdshost(TDSLOGIN * login);
 static bool tds_read_conf_sections(FILE * in, const char *server, TDSLOGIN * login);
+static bool tds_parse_conf_global(const char *option, const char *value, void *param);
 static bool tds_read_interfaces(const char *server, TDSLOGIN * login);
 static bool parse_server_name_for_port(TDSLOGIN * connection, TDSLOGIN * login, bool update_server);
 static int tds_lookup_port(const char *portname);
@@ -225,9 +231,21 @@ tds_read_config_info(TDSSOCKET * tds, TDSLOGIN * login, TDSLOCALE * locale)
 		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "major_version", TDS_MAJOR(connection));
 		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "minor_version", TDS_MINOR(connection));
 		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "block_size", connection->block_size);
+		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "packet_pool_size", connection->packet_pool_size);
+		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "read_ahead_size", connection->read_ahead_size);
+		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "socket_rcvbuf", connection->socket_rcvbuf);
+		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "socket_sndbuf", connection->socket_sndbuf);
+		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "socket_busy_poll", connection->socket_busy_poll);
+		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "tcp_cork", connection->tcp_cork);
+		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "tcp_quickack", connection->tcp_quickack);
+		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "keepalive_idle", connection->keepalive_idle);
+		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "keepalive_interval", connection->keepalive_interval);
 		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %s\n", "language", tds_dstr_cstr(&connection->language));
 		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %s\n", "server_charset", tds_dstr_cstr(&connection->server_charset));
 		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "connect_timeout", connection->connect_timeout);
+		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "connect_attempt_delay", connection->connect_attempt_delay);
+		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %s\n", "discovery_cache", tds_dstr_cstr(&connection->discovery_cache));
+		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "discovery_cache_ttl", connection->discovery_cache_ttl);
 		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %s\n", "client_host_name", tds_dstr_cstr(&connection->client_host_name));
 		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %s\n", "client_charset", tds_dstr_cstr(&connection->client_charset));
 		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "use_utf16", connection->use_utf16);
@@ -253,6 +271,9 @@ tds_read_config_info(TDSSOCKET * tds, TDSLOGIN * login, TDSLOCALE * locale)
 		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "check_ssl_hostname", connection->check_ssl_hostname);
 		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %s\n", "db_filename", tds_dstr_cstr(&connection->db_filename));
 		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "readonly_intent", connection->readonly_intent);
+		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "use_io_uring", connection->use_io_uring);
+		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "use_ktls", connection->use_ktls);
+		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %d\n", "rpc_no_metadata", connection->rpc_no_metadata);
 #ifdef HAVE_OPENSSL
 		tdsdump_log(TDS_DBG_INFO1, "\t%20s = %s\n", "openssl_ciphers", tds_dstr_cstr(&connection->openssl_ciphers));
 #endif
@@ -392,7 +413,7 @@ tds_read_conf_sections(FILE * in, const char *server, TDSLOGIN * login)
 
 	bool found;
 
-	tds_read_conf_section(in, "global", tds_parse_conf_section, login);
+	tds_read_conf_section(in, "global", tds_parse_conf_global, login);
 
 	if (!server[0])
 		return false;
@@ -596,6 +617,29 @@ tds_read_conf_section(FILE * in, const char *section, TDSCONFPARSE tds_conf_pars
 #undef option
 }
 
+/* Parse [global] section, it can contain also settings for the whole process */
+static bool
+tds_parse_conf_global(const char *option, const char *value, void *param)
+{
+	int val;
+
+	if (!strcmp(option, TDS_STR_DNS_CACHE_TTL)) {
+		tdsdump_log(TDS_DBG_INFO1, "\t%s = '%s'\n", option, value);
+		val = atoi(value);
+		if (val >= 0)
+			tds_dns_cache_config(val, -1);
+		return true;
+	}
+	if (!strcmp(option, TDS_STR_DNS_NEGATIVE_CACHE_TTL)) {
+		tdsdump_log(TDS_DBG_INFO1, "\t%s = '%s'\n", option, value);
+		val = atoi(value);
+		if (val >= 0)
+			tds_dns_cache_config(-1, val);
+		return true;
+	}
+	return tds_parse_conf_section(option, value, param);
+}
+
 /* Also used to scan ODBC.INI entries */
 bool
 tds_parse_conf_section(const char *option, const char *value, void *param)
@@ -615,6 +659,39 @@ tds_parse_conf_section(const char *option, const char *value, void *param)
 		int val = atoi(value);
 		if (val >= 512 && val < 65536)
 			login->block_size = val;
+	} else if (!strcmp(option, TDS_STR_PACKET_POOL_SIZE)) {
+		int val = atoi(value);
+		if (val >= 0)
+			login->packet_pool_size = val;
+	} else if (!strcmp(option, TDS_STR_READ_AHEAD)) {
+		int val = atoi(value);
+		if (val >= 0 && val <= 4 * 1024 * 1024)
+			login->read_ahead_size = val;
+	} else if (!strcmp(option, TDS_STR_SOCKET_RCVBUF)) {
+		int val = atoi(value);
+		if (val > 0)
+			login->socket_rcvbuf = val;
+	} else if (!strcmp(option, TDS_STR_SOCKET_SNDBUF)) {
+		int val = atoi(value);
+		if (val > 0)
+			login->socket_sndbuf = val;
+	} else if (!strcmp(option, TDS_STR_SOCKET_BUSY_POLL)) {
+		int val = atoi(value);
+		if (val >= 0)
+			login->socket_busy_poll = val;
+	} else if (!strcmp(option, TDS_STR_TCP_CORK)) {
+		parse_boolean(option, value, login->tcp_cork);
+	} else if (!strcmp(option, TDS_STR_TCP_QUICKACK)) {
+		parse_boolean(option, value, login->tcp_quickack);
+		login->tcp_quickack_specified = 1;
+	} else if (!strcmp(option, TDS_STR_KEEPALIVE_IDLE)) {
+		int val = atoi(value);
+		if (val > 0)
+			login->keepalive_idle = val;
+	} else if (!strcmp(option, TDS_STR_KEEPALIVE_INTERVAL)) {
+		int val = atoi(value);
+		if (val > 0)
+			login->keepalive_interval = val;
 	} else if (!strcmp(option, TDS_STR_SWAPDT)) {
 		/* this option is deprecated, just check value for compatibility */
 		tds_config_boolean(option, value, login);
@@ -642,6 +719,19 @@ tds_parse_conf_section(const char *option, const char *value, void *param)
 	} else if (!strcmp(option, TDS_STR_CONNTIMEOUT)) {
 		if (atoi(value) > 0)
 			login->connect_timeout = atoi(value);
+	} else if (!strcmp(option, TDS_STR_CONNECT_ATTEMPT_DELAY)) {
+		int val = atoi(value);
+		if (val >= 0)
+			login->connect_attempt_delay = val;
+	} else if (!strcmp(option, TDS_STR_DISCOVERY_CACHE)) {
+		s = tds_dstr_copy(&login->discovery_cache, value);
+	} else if (!strcmp(option, TDS_STR_DNS_CACHE_TTL) || !strcmp(option, TDS_STR_DNS_NEGATIVE_CACHE_TTL)) {
+		/* a server section must not change the cache of the whole process */
+		tdsdump_log(TDS_DBG_WARN, "'%s' is allowed only in [global] section ... ignoring.\n", option);
+	} else if (!strcmp(option, TDS_STR_DISCOVERY_CACHE_TTL)) {
+		int val = atoi(value);
+		if (val >= 0)
+			login->discovery_cache_ttl = val;
 	} else if (!strcmp(option, TDS_STR_HOST)) {
 		char tmp[128];
 		struct addrinfo *addrs;
@@ -718,6 +808,12 @@ tds_parse_conf_section(const char *option, const char *value, void *param)
 	} else if (!strcmp(option, TDS_STR_ENABLE_TLS_V1_1)) {
 		parse_boolean(option, value, login->enable_tls_v1_1);
 		login->enable_tls_v1_1_specified = 1;
+	} else if (!strcmp(option, TDS_STR_USE_IO_URING)) {
+		parse_boolean(option, value, login->use_io_uring);
+	} else if (!strcmp(option, TDS_STR_USE_KTLS)) {
+		parse_boolean(option, value, login->use_ktls);
+	} else if (!strcmp(option, TDS_STR_RPC_NO_METADATA)) {
+		parse_boolean(option, value, login->rpc_no_metadata);
 	} else {
 		tdsdump_log(TDS_DBG_INFO1, "UNRECOGNIZED option '%s' ... ignoring.\n", option);
 	}
@@ -794,6 +890,27 @@ tds_config_login(TDSLOGIN * connection, TDSLOGIN * login)
 	if (login->block_size)
 		connection->block_size = login->block_size;
 
+	if (login->packet_pool_size >= 0)
+		connection->packet_pool_size = login->packet_pool_size;
+	if (login->read_ahead_size >= 0)
+		connection->read_ahead_size = login->read_ahead_size;
+	if (login->socket_rcvbuf >= 0)
+		connection->socket_rcvbuf = login->socket_rcvbuf;
+	if (login->socket_sndbuf >= 0)
+		connection->socket_sndbuf = login->socket_sndbuf;
+	if (login->socket_busy_poll >= 0)
+		connection->socket_busy_poll = login->socket_busy_poll;
+	if (!login->tcp_cork)
+		connection->tcp_cork = login->tcp_cork;
+	if (login->tcp_quickack_specified) {
+		connection->tcp_quickack_specified = login->tcp_quickack_specified;
+		connection->tcp_quickack = login->tcp_quickack;
+	}
+	if (login->keepalive_idle >= 0)
+		connection->keepalive_idle = login->keepalive_idle;
+	if (login->keepalive_interval >= 0)
+		connection->keepalive_interval = login->keepalive_interval;
+
 	if (login->gssapi_use_delegation)
 		connection->gssapi_use_delegation = login->gssapi_use_delegation;
 
@@ -805,6 +922,10 @@ tds_config_login(TDSLOGIN * connection, TDSLOGIN * login)
 
 	if (login->connect_timeout)
 		connection->connect_timeout = login->connect_timeout;
+	if (login->connect_attempt_delay >= 0)
+		connection->connect_attempt_delay = login->connect_attempt_delay;
+	if (login->discovery_cache_ttl >= 0)
+		connection->discovery_cache_ttl = login->discovery_cache_ttl;
 
 	if (login->query_timeout)
 		connection->query_timeout = login->query_timeout;
@@ -815,6 +936,9 @@ tds_config_login(TDSLOGIN * connection, TDSLOGIN * login)
 	if (res && !tds_dstr_isempty(&login->db_filename))
 		res = tds_dstr_dup(&connection->db_filename, &login->db_filename);
 
+	if (res && !tds_dstr_isempty(&login->discovery_cache))
+		res = tds_dstr_dup(&connection->discovery_cache, &login->discovery_cache);
+
 	if (res && !tds_dstr_isempty(&login->openssl_ciphers))
 		res = tds_dstr_dup(&connection->openssl_ciphers, &login->openssl_ciphers);
 
@@ -830,6 +954,15 @@ tds_config_login(TDSLOGIN * connection, TDSLOGIN * login)
 	if (login->readonly_intent)
 		connection->readonly_intent = login->readonly_intent;
 
+	if (login->use_io_uring)
+		connection->use_io_uring = login->use_io_uring;
+
+	if (login->use_ktls)
+		connection->use_ktls = login->use_ktls;
+
+	if (login->rpc_no_metadata)
+		connection->rpc_no_metadata = login->rpc_no_metadata;
+
 	connection->use_new_password = login->use_new_password;
 
 	if (login->use_ntlmv2_specified) {
@@ -1063,15 +1196,21 @@ tds_lookup_host(const char *servername)	/* (I) name of the server
 	return addr;
 }
 
+/**
+ * Resolve a server name, using the process cache if enabled.
+ * @param servername name to resolve
+ * @param addr where to store addresses, previous list is freed on success.
+ *        The list must be freed with tds_addrinfo_free().
+ */
 TDSRET
 tds_lookup_host_set(const char *servername, struct addrinfo **addr)
 {
 	struct addrinfo *newaddr;
 	assert(servername != NULL && addr != NULL);
 
-	if ((newaddr = tds_lookup_host(servername)) != NULL) {
+	if ((newaddr = tds_dns_cache_lookup(servername)) != NULL) {
 		if (*addr != NULL)
-			freeaddrinfo(*addr);
+			tds_addrinfo_free(*addr);
 		*addr = newaddr;
 		return TDS_SUCCESS;
 	}
@@ -1467,6 +1606,31 @@ tds_get_compiletime_settings(void)
 			, true
 #		else
 			, false
+#		endif
+#		if defined(TCP_CORK)
+			, true
+#		else
+			, false
+#		endif
+#		if defined(SO_BUSY_POLL)
+			, true
+#		else
+			, false
+#		endif
+#		if defined(TCP_QUICKACK)
+			, true
+#		else
+			, false
+#		endif
+#		if defined(_WIN32) || (defined(TCP_KEEPIDLE) && defined(TCP_KEEPINTVL))
+			, true
+#		else
+			, false
+#		endif
+#		ifdef TDS_HAVE_KTLS
+			, true
+#		else
+			, false
 #		endif
 	};
 
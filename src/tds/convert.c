@@ -1339,8 +1339,8 @@ tds_convert_datetimeall(const TDSCONTEXT * tds_ctx, int srctype, const TDS_DATET
 			datetime_fmt = tds_ctx->locale->date_fmt;
 		if (srctype == SYBMSTIME && tds_ctx->locale->time_fmt)
 			datetime_fmt = tds_ctx->locale->time_fmt;
-		tds_strftime(whole_date_string, sizeof(whole_date_string), datetime_fmt, &when,
-		             dta->time_prec);
+		tds_locale_strftime(tds_ctx->locale, whole_date_string, sizeof(whole_date_string),
+				    datetime_fmt, &when, dta->time_prec);
 
 		return string_to_result(desttype, whole_date_string, cr);
 	case SYBDATETIME:
@@ -1405,7 +1405,8 @@ tds_convert_datetime(const TDSCONTEXT * tds_ctx, const TDS_DATETIME * dt, int de
 	case TDS_CONVERT_CHAR:
 	case CASE_ALL_CHAR:
 		tds_datecrack(SYBDATETIME, dt, &when);
-		tds_strftime(whole_date_string, sizeof(whole_date_string), tds_ctx->locale->datetime_fmt, &when, 3);
+		tds_locale_strftime(tds_ctx->locale, whole_date_string, sizeof(whole_date_string),
+				    tds_ctx->locale->datetime_fmt, &when, 3);
 
 		return string_to_result(desttype, whole_date_string, cr);
 	case SYBDATETIME:
@@ -1580,7 +1581,7 @@ tds_convert_real(const TDS_REAL* src, int desttype, CONV_RESULT * cr)
 	switch (desttype) {
 	case TDS_CONVERT_CHAR:
 	case CASE_ALL_CHAR:
-		sprintf(tmp_str, "%.9g", the_value);
+		tds_real_to_string(the_value, tmp_str);
 		return string_to_result(desttype, tmp_str, cr);
 		break;
 	case SYBSINT1:
@@ -1689,13 +1690,13 @@ static TDS_INT
 tds_convert_flt8(const TDS_FLOAT* src, int desttype, CONV_RESULT * cr)
 {
 	TDS_FLOAT the_value;
-	char tmp_str[25];
+	char tmp_str[TDS_FLOAT_STRING_MAX];
 
 	memcpy(&the_value, src, 8);
 	switch (desttype) {
 	case TDS_CONVERT_CHAR:
 	case CASE_ALL_CHAR:
-		sprintf(tmp_str, "%.17g", the_value);
+		tds_double_to_string(the_value, tmp_str);
 		return string_to_result(desttype, tmp_str, cr);
 		break;
 	case SYBSINT1:
@@ -2410,14 +2411,17 @@ string_to_numeric(const char *instr, const char *pend, CONV_RESULT * cr)
 	if (cr->n.precision - cr->n.scale < digits)
 		return TDS_CONVERT_OVERFLOW;
 
+	if (decimals > cr->n.scale)
+		decimals = cr->n.scale;
+	if (tds_numeric_set_digits(&cr->n, instr, digits, instr + digits + 1, decimals))
+		return sizeof(TDS_NUMERIC);
+
 	/* copy digits before the dot */
 	memcpy(ptr, instr, digits);
 	ptr += digits;
 	instr += digits + 1;
 
 	/* copy digits after the dot */
-	if (decimals > cr->n.scale)
-		decimals = cr->n.scale;
 	memcpy(ptr, instr, decimals);
 
 	/* fill up decimal digits */
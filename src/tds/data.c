@@ -206,6 +206,10 @@
 
 #define USE_ICONV_IN (tds->conn->use_iconv_in)
 
+/* data of the column are not copied as is, client and server encodings differ */
+#define NEED_ICONV_IN(col) \
+	(USE_ICONV_IN && (col)->char_conv && !((col)->char_conv->flags & TDS_ENCODING_MEMCPY))
+
 static const TDSCOLUMNFUNCS *tds_get_column_funcs(TDSCONNECTION *conn, int type);
 static void tds_swap_numeric(TDS_NUMERIC *num);
 
@@ -472,7 +476,7 @@ tds_get_char_dynamic(TDSSOCKET *tds, TDSCOLUMN *curcol, void **pp, size_t alloca
 	 */
 	TDS_PROPAGATE(tds_dynamic_stream_init(&w, pp, allocated));
 
-	if (USE_ICONV_IN && curcol->char_conv)
+	if (NEED_ICONV_IN(curcol))
 		res = tds_convert_stream(tds, curcol->char_conv, to_client, r_stream, &w.stream);
 	else
 		res = tds_copy_stream(r_stream, &w.stream);
@@ -693,6 +697,69 @@ error_memory:
 	return TDS_FAIL;
 }
 
+/* Check if data can be left in the current input packet, see TDSRESULTINFO::borrow_data */
+static inline bool
+tds_borrow_enabled(TDSSOCKET * tds)
+{
+#if ENABLE_ODBC_MARS
+	/* a packet partially received is still owned by the connection */
+	if (tds->in_partial)
+		return false;
+#endif
+	return tds->borrow_data;
+}
+
+/*
+ * Check if data of a column at given address are properly aligned
+ * to be accessed in place.  Fixed size types are aligned to the largest
+ * power of 2 dividing their size, up to TDS_ALIGN_SIZE.
+ */
+static inline bool
+tds_borrow_aligned(const TDSCOLUMN * curcol, const unsigned char *p)
+{
+	unsigned align;
+
+	if (is_ascii_type(curcol->column_type) || is_binary_type(curcol->column_type))
+		return true;
+	if (is_unicode_type(curcol->column_type))
+		align = 2;
+	else
+		align = TDS_MIN((unsigned) curcol->column_size & (0u - (unsigned) curcol->column_size),
+				(unsigned) TDS_ALIGN_SIZE);
+	return align == 0 || ((uintptr_t) p % align) == 0;
+}
+
+/*
+ * Check if column data can be used directly from the received packet.
+ * Data must be entirely received, aligned and not need any transformation.
+ */
+static bool
+tds_can_borrow(TDSSOCKET * tds, TDSCOLUMN * curcol, int colsize)
+{
+#ifdef WORDS_BIGENDIAN
+	return false;
+#else
+	if (!tds_borrow_enabled(tds) || tds->in_len - tds->in_pos < (unsigned) colsize)
+		return false;
+
+	if (!tds_borrow_aligned(curcol, tds->in_buf + tds->in_pos))
+		return false;
+
+	switch (curcol->column_type) {
+	/* these can be padded */
+	case SYBLONGBINARY:
+	case SYBCHAR:
+	case XSYBCHAR:
+	case SYBBINARY:
+	case XSYBBINARY:
+		return colsize >= curcol->column_size;
+	default:
+		break;
+	}
+	return true;
+#endif
+}
+
 /**
  * Read a data from wire
  * \param tds state information for the socket and the TDS protocol
@@ -805,7 +872,7 @@ tds_generic_get(TDSSOCKET * tds, TDSCOLUMN * curcol)
 
 	/* non-numeric and non-blob */
 
-	if (USE_ICONV_IN && curcol->char_conv) {
+	if (NEED_ICONV_IN(curcol)) {
 		TDS_PROPAGATE(tds_get_char_data(tds, (char *) dest, colsize, curcol));
 	} else {
 		/*
@@ -817,6 +884,14 @@ tds_generic_get(TDSSOCKET * tds, TDSCOLUMN * curcol)
 			discard_len = colsize - curcol->column_size;
 			colsize = curcol->column_size;
 		}
+		if (tds_can_borrow(tds, curcol, colsize) && !discard_len) {
+			/* leave data in the packet, see TDSRESULTINFO::borrow_data */
+			curcol->column_borrowed = tds->in_buf + tds->in_pos;
+			curcol->column_cur_size = colsize;
+			tds->in_pos += colsize;
+			tds->packet_borrowed = true;
+			return TDS_SUCCESS;
+		}
 		if (!tds_get_n(tds, dest, colsize))
 			return TDS_FAIL;
 		if (discard_len > 0)
@@ -1718,6 +1793,258 @@ tds_get_column_funcs(TDSCONNECTION *conn, int type)
 	}
 	return &tds_generic_funcs;
 }
+
+/*
+ * Row decoding.
+ * Columns of a result are classified once and consecutive columns of
+ * the same kind are decoded together, avoiding a call through
+ * TDSCOLUMNFUNCS::get_data for every column of every row.
+ */
+enum {
+	/** fixed size columns, NULL only if marked in a NBC row bitmap */
+	TDS_ROW_STEP_FIXED,
+	/** 1 byte length prefix, 0 means NULL, no conversion */
+	TDS_ROW_STEP_BYTELEN,
+	/** 2 bytes length prefix, -1 means NULL, no conversion */
+	TDS_ROW_STEP_SHORTLEN,
+	/** anything else, use TDSCOLUMNFUNCS::get_data */
+	TDS_ROW_STEP_GENERIC,
+};
+
+typedef struct tds_row_step
+{
+	unsigned char kind;
+	TDS_USMALLINT first_col;
+	TDS_USMALLINT num_cols;
+	/** bytes on the wire for TDS_ROW_STEP_FIXED */
+	TDS_UINT size;
+} TDS_ROW_STEP;
+
+struct tds_row_plan
+{
+	unsigned int num_steps;
+	TDS_ROW_STEP steps[1];
+};
+
+static unsigned char
+tds_row_step_kind(const TDSCOLUMN *col)
+{
+#ifdef WORDS_BIGENDIAN
+	/* data need to be swapped */
+	return TDS_ROW_STEP_GENERIC;
+#else
+	if (col->funcs != &tds_generic_funcs || is_blob_col(col))
+		return TDS_ROW_STEP_GENERIC;
+	/* same encoding (like UTF-8 on both sides) can be copied */
+	if (col->char_conv && !(col->char_conv->flags & TDS_ENCODING_MEMCPY))
+		return TDS_ROW_STEP_GENERIC;
+
+	switch (col->column_type) {
+	/* these can be padded */
+	case SYBLONGBINARY:
+	case SYBCHAR:
+	case XSYBCHAR:
+	case SYBBINARY:
+	case XSYBBINARY:
+		return TDS_ROW_STEP_GENERIC;
+	default:
+		break;
+	}
+
+	switch (col->column_varint_size) {
+	case 0:
+		if (col->column_size > 0 && tds_get_size_by_type(col->column_type) == col->column_size)
+			return TDS_ROW_STEP_FIXED;
+		break;
+	case 1:
+		return TDS_ROW_STEP_BYTELEN;
+	case 2:
+		return TDS_ROW_STEP_SHORTLEN;
+	}
+	return TDS_ROW_STEP_GENERIC;
+#endif
+}
+
+static struct tds_row_plan *
+tds_build_row_plan(TDSRESULTINFO *info)
+{
+	struct tds_row_plan *plan;
+	TDS_ROW_STEP *step = NULL;
+	unsigned int i;
+
+	plan = (struct tds_row_plan *) malloc(sizeof(*plan) + sizeof(plan->steps[0]) * TDS_MAX(info->num_cols, 1));
+	if (!plan)
+		return NULL;
+
+	plan->num_steps = 0;
+	for (i = 0; i < info->num_cols; ++i) {
+		TDSCOLUMN *col = info->columns[i];
+		unsigned char kind = tds_row_step_kind(col);
+
+		if (!step || step->kind != kind) {
+			step = &plan->steps[plan->num_steps++];
+			step->kind = kind;
+			step->first_col = i;
+			step->num_cols = 0;
+			step->size = 0;
+		}
+		++step->num_cols;
+		if (kind == TDS_ROW_STEP_FIXED)
+			step->size += col->column_size;
+	}
+
+	tdsdump_log(TDS_DBG_INFO1, "row plan: %u columns in %u steps\n", info->num_cols, plan->num_steps);
+	return plan;
+}
+
+/** Read data of a column with a length prefix not requiring any transformation */
+static TDSRET
+tds_get_varlen_data(TDSSOCKET *tds, TDSCOLUMN *col, int colsize)
+{
+	int discard_len = 0;
+
+	if (IS_TDSDEAD(tds))
+		return TDS_FAIL;
+
+	if (colsize > col->column_size) {
+		discard_len = colsize - col->column_size;
+		colsize = col->column_size;
+	}
+	if (!discard_len && tds_can_borrow(tds, col, colsize)) {
+		col->column_borrowed = tds->in_buf + tds->in_pos;
+		col->column_cur_size = colsize;
+		tds->in_pos += colsize;
+		tds->packet_borrowed = true;
+		return TDS_SUCCESS;
+	}
+	if (!tds_get_n(tds, col->column_data, colsize))
+		return TDS_FAIL;
+	if (discard_len > 0)
+		tds_get_n(tds, NULL, discard_len);
+	col->column_cur_size = colsize;
+	return TDS_SUCCESS;
+}
+
+static bool
+tds_row_nulls_in(const unsigned char *nulls, unsigned int first, unsigned int num)
+{
+	for (; num; --num, ++first)
+		if (nulls[first / 8] & (1 << (first % 8)))
+			return true;
+	return false;
+}
+
+/**
+ * Read a row from wire.
+ * Decoding plan of the result is built at first row and reused.
+ * \tds
+ * \param info   result the row belongs to
+ * \param nulls  bitmap of NULL columns for NBC rows, NULL otherwise
+ * \return TDS_SUCCESS or TDS_FAIL
+ */
+TDSRET
+tds_get_row_data(TDSSOCKET * tds, TDSRESULTINFO * info, const unsigned char *nulls)
+{
+	const TDS_ROW_STEP *step, *end;
+	TDS_ROW_STEP generic;
+	unsigned int i, last;
+
+	CHECK_TDS_EXTRA(tds);
+
+	if (!info->row_plan)
+		info->row_plan = tds_build_row_plan(info);
+
+	if (info->row_plan) {
+		step = info->row_plan->steps;
+		end = step + info->row_plan->num_steps;
+	} else {
+		/* no memory for the plan, decode column by column */
+		generic.kind = TDS_ROW_STEP_GENERIC;
+		generic.first_col = 0;
+		generic.num_cols = info->num_cols;
+		generic.size = 0;
+		step = &generic;
+		end = step + 1;
+	}
+	for (; step != end; ++step) {
+		i = step->first_col;
+		last = i + step->num_cols;
+
+		switch (step->kind) {
+		case TDS_ROW_STEP_FIXED:
+			/* whole run inside the packet, take it at once */
+			if (tds->in_len - tds->in_pos >= step->size
+			    && (!nulls || !tds_row_nulls_in(nulls, i, step->num_cols))) {
+				const unsigned char *src = tds->in_buf + tds->in_pos;
+				const bool borrow = tds_borrow_enabled(tds);
+				bool borrowed = false;
+
+				for (; i < last; ++i) {
+					TDSCOLUMN *col = info->columns[i];
+
+					if (borrow && tds_borrow_aligned(col, src)) {
+						col->column_borrowed = (unsigned char *) src;
+						borrowed = true;
+					} else {
+						col->column_borrowed = NULL;
+						memcpy(col->column_data, src, col->column_size);
+					}
+					col->column_cur_size = col->column_size;
+					src += col->column_size;
+				}
+				tds->in_pos += step->size;
+				tds->packet_borrowed |= borrowed;
+				continue;
+			}
+			break;
+		case TDS_ROW_STEP_BYTELEN:
+			for (; i < last; ++i) {
+				TDSCOLUMN *col = info->columns[i];
+				int colsize;
+
+				col->column_borrowed = NULL;
+				if (nulls && (nulls[i / 8] & (1 << (i % 8))))
+					colsize = 0;
+				else
+					colsize = tds_get_byte(tds);
+				if (colsize == 0)
+					col->column_cur_size = -1;
+				else
+					TDS_PROPAGATE(tds_get_varlen_data(tds, col, colsize));
+			}
+			continue;
+		case TDS_ROW_STEP_SHORTLEN:
+			for (; i < last; ++i) {
+				TDSCOLUMN *col = info->columns[i];
+				int colsize;
+
+				col->column_borrowed = NULL;
+				if (nulls && (nulls[i / 8] & (1 << (i % 8))))
+					colsize = -1;
+				else
+					colsize = tds_get_smallint(tds);
+				if (colsize < 0)
+					col->column_cur_size = -1;
+				else
+					TDS_PROPAGATE(tds_get_varlen_data(tds, col, colsize));
+			}
+			continue;
+		}
+
+		/* generic decoding */
+		for (; i < last; ++i) {
+			TDSCOLUMN *col = info->columns[i];
+
+			tdsdump_log(TDS_DBG_INFO1, "tds_get_row_data(): reading column %d\n", i);
+			col->column_borrowed = NULL;
+			if (nulls && (nulls[i / 8] & (1 << (i % 8))))
+				col->column_cur_size = -1;
+			else
+				TDS_PROPAGATE(col->funcs->get_data(tds, col));
+		}
+	}
+	return TDS_SUCCESS;
+}
 #include "tds_types.h"
 
 #ifdef WORDS_BIGENDIAN
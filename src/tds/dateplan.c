@@ -0,0 +1,665 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * \file
+ * \brief Compiled datetime formats
+ *
+ * tds_strftime() parses the format string, allocates a copy of it and
+ * calls strftime(3) for every value.  Formats used to convert many
+ * values are instead compiled once into a list of operations writing
+ * fixed-width fields directly.  Values or formats the compiled form
+ * cannot reproduce exactly are passed to tds_strftime().
+ */
+
+#include <config.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <assert.h>
+
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif /* HAVE_STDLIB_H */
+
+#if HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+
+#ifdef HAVE_LANGINFO_H
+#include <langinfo.h>
+#endif /* HAVE_LANGINFO_H */
+
+#include <freetds/tds.h>
+#include <freetds/convert.h>
+
+#if defined(HAVE_LANGINFO_H) && defined(HAVE_NL_LANGINFO)
+#define USE_LANGINFO 1
+#endif
+
+/** maximum number of operations in a compiled format */
+#define TDS_DATE_PLAN_MAX_OPS 32
+/** maximum number of formats compiled for a locale */
+#define TDS_DATE_PLAN_CACHE_SIZE 8
+/** maximum number of replaced plans waiting for readers to leave */
+#define TDS_DATE_PLAN_MAX_RETIRED 32
+
+/*
+ * Every operation writes a field followed by len bytes from literals + pos.
+ */
+typedef enum
+{
+	TDS_DP_LITERAL,		/* no field, only literal */
+	TDS_DP_YEAR,		/* %Y */
+	TDS_DP_YEAR2,		/* %y */
+	TDS_DP_MONTH,		/* %m */
+	TDS_DP_DAY,		/* %d */
+	TDS_DP_DAY_SPACE,	/* %e */
+	TDS_DP_HOUR,		/* %H */
+	TDS_DP_HOUR12,		/* %I */
+	TDS_DP_HOUR12_SPACE,	/* %l */
+	TDS_DP_MINUTE,		/* %M */
+	TDS_DP_SECOND,		/* %S */
+	TDS_DP_FRACTION,	/* %z, prec is precision, 0 to use the one passed */
+	TDS_DP_FRACTION_NODOT,	/* %z after a dot, dot is removed if precision is 0 */
+	TDS_DP_MONTH_ABBR,	/* %b */
+	TDS_DP_MONTH_NAME,	/* %B */
+	TDS_DP_WEEKDAY_ABBR,	/* %a */
+	TDS_DP_WEEKDAY_NAME,	/* %A */
+	TDS_DP_AMPM,		/* %p */
+} TDS_DATE_OP;
+
+typedef struct tds_date_op
+{
+	unsigned char type;
+	unsigned char prec;
+	unsigned char len;
+	unsigned short pos;
+} TDSDATEOP;
+
+struct tds_date_plan
+{
+	/** original format, used for lookups and by tds_strftime() */
+	char *format;
+	/** format not supported, always use tds_strftime() */
+	bool use_strftime;
+	/** format contains %Y, printed as 4 digits only for years 1000-9999 */
+	bool has_year;
+	unsigned num_ops;
+	TDSDATEOP ops[TDS_DATE_PLAN_MAX_OPS];
+	char *literals;
+	/** next plan replaced in the cache but not freed yet */
+	struct tds_date_plan *next_retired;
+};
+
+/*
+ * Plans are published in slots read without any lock.  Adding or replacing
+ * a plan is done holding mtx; a replaced plan is kept in the retired list
+ * until no reader can be using it.  The list is freed by the last reader
+ * leaving; if readers never drop to zero the list is bounded and formats
+ * not cached fall back to tds_strftime().
+ */
+struct tds_date_plan_cache
+{
+	tds_mutex mtx;
+	/** threads currently looking up or using plans */
+	int readers;
+	/** next slot considered for replacement */
+	unsigned hand;
+	TDSDATEPLAN *plans[TDS_DATE_PLAN_CACHE_SIZE];
+	/** plan in the same slot was used since the hand passed it */
+	unsigned char used[TDS_DATE_PLAN_CACHE_SIZE];
+	TDSDATEPLAN *retired;
+	unsigned num_retired;
+};
+
+#if defined(__GNUC__) && defined(__ATOMIC_SEQ_CST)
+#define TDS_DATE_PLAN_ATOMIC 1
+#define DP_LOAD(v) __atomic_load_n(&(v), __ATOMIC_SEQ_CST)
+#define DP_STORE(v, x) __atomic_store_n(&(v), (x), __ATOMIC_SEQ_CST)
+#define DP_LOAD_RELAXED(v) __atomic_load_n(&(v), __ATOMIC_RELAXED)
+#define DP_STORE_RELAXED(v, x) __atomic_store_n(&(v), (x), __ATOMIC_RELAXED)
+#else
+/* no atomic operations, readers take the lock */
+#define DP_LOAD(v) (v)
+#define DP_STORE(v, x) ((v) = (x))
+#define DP_LOAD_RELAXED(v) (v)
+#define DP_STORE_RELAXED(v, x) ((v) = (x))
+#endif
+
+#ifdef USE_LANGINFO
+static const nl_item month_abbr[12] = {
+	ABMON_1, ABMON_2, ABMON_3, ABMON_4, ABMON_5, ABMON_6,
+	ABMON_7, ABMON_8, ABMON_9, ABMON_10, ABMON_11, ABMON_12
+};
+static const nl_item month_names[12] = {
+	MON_1, MON_2, MON_3, MON_4, MON_5, MON_6,
+	MON_7, MON_8, MON_9, MON_10, MON_11, MON_12
+};
+static const nl_item weekday_abbr[7] = {
+	ABDAY_1, ABDAY_2, ABDAY_3, ABDAY_4, ABDAY_5, ABDAY_6, ABDAY_7
+};
+static const nl_item weekday_names[7] = {
+	DAY_1, DAY_2, DAY_3, DAY_4, DAY_5, DAY_6, DAY_7
+};
+#endif
+
+static bool
+tds_date_plan_add(TDSDATEPLAN *plan, TDS_DATE_OP type, unsigned prec)
+{
+	TDSDATEOP *op;
+
+	if (plan->num_ops >= TDS_DATE_PLAN_MAX_OPS)
+		return false;
+	op = &plan->ops[plan->num_ops++];
+	op->type = type;
+	op->prec = prec;
+	op->len = 0;
+	op->pos = 0;
+	return true;
+}
+
+/* append a literal character to last operation */
+static bool
+tds_date_plan_literal(TDSDATEPLAN *plan, char **p_lit, char c)
+{
+	TDSDATEOP *op = plan->num_ops ? &plan->ops[plan->num_ops - 1] : NULL;
+
+	if (!op || op->len >= 255) {
+		if (!tds_date_plan_add(plan, TDS_DP_LITERAL, 0))
+			return false;
+		op = &plan->ops[plan->num_ops - 1];
+	}
+	if (!op->len)
+		op->pos = (unsigned short) (*p_lit - plan->literals);
+	*(*p_lit)++ = c;
+	++op->len;
+	return true;
+}
+
+/**
+ * Compile a format for tds_date_plan_format().
+ * Format syntax is the one of tds_strftime().
+ * @return compiled format or NULL if out of memory
+ */
+TDSDATEPLAN *
+tds_date_plan_compile(const char *format)
+{
+	TDSDATEPLAN *plan;
+	const char *p;
+	char *lit;
+	bool z_found = false;
+	bool ok = true;
+
+	assert(format);
+
+	plan = tds_new0(TDSDATEPLAN, 1);
+	if (!plan)
+		return NULL;
+	plan->format = strdup(format);
+	plan->literals = tds_new(char, strlen(format) + 1);
+	if (!plan->format || !plan->literals) {
+		tds_date_plan_free(plan);
+		return NULL;
+	}
+	if (strlen(format) >= 0xffff) {
+		plan->use_strftime = true;
+		return plan;
+	}
+
+	lit = plan->literals;
+	for (p = format; *p && ok; ++p) {
+		TDS_DATE_OP type;
+
+		if (*p != '%') {
+			ok = tds_date_plan_literal(plan, &lit, *p);
+			continue;
+		}
+		switch (*++p) {
+		case 0:
+			/* a final % is printed as is */
+			ok = tds_date_plan_literal(plan, &lit, '%');
+			--p;
+			continue;
+		case '%':
+			ok = tds_date_plan_literal(plan, &lit, '%');
+			continue;
+		case 'Y':
+			plan->has_year = true;
+			type = TDS_DP_YEAR;
+			break;
+		case 'y':
+			type = TDS_DP_YEAR2;
+			break;
+		case 'm':
+			type = TDS_DP_MONTH;
+			break;
+		case 'd':
+			type = TDS_DP_DAY;
+			break;
+		case 'e':
+			type = TDS_DP_DAY_SPACE;
+			break;
+		case 'H':
+			type = TDS_DP_HOUR;
+			break;
+		case 'I':
+			type = TDS_DP_HOUR12;
+			break;
+		case 'l':
+			type = TDS_DP_HOUR12_SPACE;
+			break;
+		case 'M':
+			type = TDS_DP_MINUTE;
+			break;
+		case 'S':
+			type = TDS_DP_SECOND;
+			break;
+#ifdef USE_LANGINFO
+		case 'b':
+		case 'h':
+			type = TDS_DP_MONTH_ABBR;
+			break;
+		case 'B':
+			type = TDS_DP_MONTH_NAME;
+			break;
+		case 'a':
+			type = TDS_DP_WEEKDAY_ABBR;
+			break;
+		case 'A':
+			type = TDS_DP_WEEKDAY_NAME;
+			break;
+		case 'p':
+			type = TDS_DP_AMPM;
+			break;
+#endif
+		case '1':
+		case '2':
+		case '3':
+		case '4':
+		case '5':
+		case '6':
+		case '7':
+			/* %Nz, fraction with fixed precision */
+			if (p[1] != 'z' || z_found) {
+				ok = false;
+				continue;
+			}
+			z_found = true;
+			ok = tds_date_plan_add(plan, TDS_DP_FRACTION, *p - '0');
+			++p;
+			continue;
+		case 'z':
+			/* tds_strftime() replaces only first %z */
+			if (z_found) {
+				ok = false;
+				continue;
+			}
+			z_found = true;
+			type = TDS_DP_FRACTION;
+			if (lit > plan->literals && lit[-1] == '.' && p - format >= 2 && p[-2] == '.')
+				type = TDS_DP_FRACTION_NODOT;
+			break;
+		default:
+			/* other conversions are left to strftime(3) */
+			ok = false;
+			continue;
+		}
+		ok = tds_date_plan_add(plan, type, 0);
+	}
+
+	if (!ok) {
+		plan->num_ops = 0;
+		plan->use_strftime = true;
+	}
+	return plan;
+}
+
+void
+tds_date_plan_free(TDSDATEPLAN *plan)
+{
+	if (!plan)
+		return;
+	free(plan->format);
+	free(plan->literals);
+	free(plan);
+}
+
+/* write a number as 2 digits, first one replaced by a blank if zero */
+static inline void
+two_digits(char *out, unsigned num, char pad)
+{
+	out[0] = num < 10 ? pad : (char) ('0' + num / 10u);
+	out[1] = (char) ('0' + num % 10u);
+}
+
+/**
+ * Format a date using a compiled format.
+ * Result is the same of tds_strftime() with the format passed to
+ * tds_date_plan_compile().
+ * @param buf     output buffer
+ * @param maxsize size of buffer in bytes (space include terminator)
+ * @param dr      date to convert
+ * @param prec    second fraction precision (0-7).
+ * @return length of string returned, 0 for error
+ */
+size_t
+tds_date_plan_format(const TDSDATEPLAN *plan, char *buf, size_t maxsize, const TDSDATEREC *dr, int prec)
+{
+	char *out = buf;
+	const char *const end = buf + maxsize;
+	const TDSDATEOP *op, *op_end;
+	const char *s;
+	static const unsigned pow10[8] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+	unsigned num, n;
+	int i;
+
+	assert(plan && buf && dr);
+
+	/* values tds_strftime() formats in a different way */
+	if (plan->use_strftime || dr->month < 0 || dr->month > 11 || dr->weekday < 0 || dr->weekday > 6
+	    || dr->day < 0 || dr->day > 99 || dr->hour < 0 || dr->hour > 99
+	    || dr->minute < 0 || dr->minute > 99 || dr->second < 0 || dr->second > 99
+	    || (plan->has_year && (dr->year < 1000 || dr->year > 9999)) || dr->year < 0)
+		return tds_strftime(buf, maxsize, plan->format, dr, prec);
+
+	if (prec < 0 || prec > 7)
+		prec = 3;
+
+/* check space for n characters and the terminator */
+#define NEED(n) do { if ((size_t) (end - out) <= (size_t) (n)) return 0; } while(0)
+#define TWO_DIGITS(num, pad) do { NEED(2); two_digits(out, num, pad); out += 2; } while(0)
+
+	for (op = plan->ops, op_end = op + plan->num_ops; op != op_end; ++op) {
+		switch (op->type) {
+		case TDS_DP_LITERAL:
+			break;
+		case TDS_DP_YEAR:
+			NEED(4);
+			num = dr->year;
+			two_digits(out, num / 100u, '0');
+			two_digits(out + 2, num % 100u, '0');
+			out += 4;
+			break;
+		case TDS_DP_YEAR2:
+			TWO_DIGITS(dr->year % 100u, '0');
+			break;
+		case TDS_DP_MONTH:
+			TWO_DIGITS(dr->month + 1u, '0');
+			break;
+		case TDS_DP_DAY:
+			TWO_DIGITS(dr->day, '0');
+			break;
+		case TDS_DP_DAY_SPACE:
+			/* like tds_strftime() clamp to valid days */
+			TWO_DIGITS(dr->day < 1 ? 1 : (dr->day > 31 ? 31 : dr->day), ' ');
+			break;
+		case TDS_DP_HOUR:
+			TWO_DIGITS(dr->hour, '0');
+			break;
+		case TDS_DP_HOUR12:
+			TWO_DIGITS((dr->hour + 11u) % 12u + 1u, '0');
+			break;
+		case TDS_DP_HOUR12_SPACE:
+			TWO_DIGITS((dr->hour + 11u) % 12u + 1u, ' ');
+			break;
+		case TDS_DP_MINUTE:
+			TWO_DIGITS(dr->minute, '0');
+			break;
+		case TDS_DP_SECOND:
+			TWO_DIGITS(dr->second, '0');
+			break;
+		case TDS_DP_FRACTION:
+		case TDS_DP_FRACTION_NODOT:
+			i = op->prec ? op->prec : prec;
+			if (!i) {
+				if (op->type == TDS_DP_FRACTION_NODOT)
+					--out;
+				break;
+			}
+			NEED(i);
+			/* first i digits of a 7 digits number */
+			num = ((unsigned) dr->decimicrosecond & 0x7fffffffu) % 10000000u / pow10[7 - i];
+			for (n = i; n-- > 0; num /= 10u)
+				out[n] = (char) ('0' + num % 10u);
+			out += i;
+			break;
+#ifdef USE_LANGINFO
+		case TDS_DP_MONTH_ABBR:
+			s = nl_langinfo(month_abbr[dr->month]);
+			goto copy_string;
+		case TDS_DP_MONTH_NAME:
+			s = nl_langinfo(month_names[dr->month]);
+			goto copy_string;
+		case TDS_DP_WEEKDAY_ABBR:
+			s = nl_langinfo(weekday_abbr[dr->weekday]);
+			goto copy_string;
+		case TDS_DP_WEEKDAY_NAME:
+			s = nl_langinfo(weekday_names[dr->weekday]);
+			goto copy_string;
+		case TDS_DP_AMPM:
+			s = nl_langinfo(dr->hour > 11 ? PM_STR : AM_STR);
+		copy_string:
+			num = (unsigned) strlen(s);
+			NEED(num);
+			memcpy(out, s, num);
+			out += num;
+			break;
+#endif
+		}
+
+		/* literal following the field, usually a separator */
+		if (op->len) {
+			NEED(op->len);
+			s = plan->literals + op->pos;
+			if (op->len == 1) {
+				*out++ = *s;
+			} else {
+				memcpy(out, s, op->len);
+				out += op->len;
+			}
+		}
+	}
+#undef TWO_DIGITS
+#undef NEED
+	*out = 0;
+	return out - buf;
+}
+
+struct tds_date_plan_cache *
+tds_alloc_date_plans(void)
+{
+	struct tds_date_plan_cache *cache;
+
+	cache = tds_new0(struct tds_date_plan_cache, 1);
+	if (!cache)
+		return NULL;
+	if (tds_mutex_init(&cache->mtx)) {
+		free(cache);
+		return NULL;
+	}
+	return cache;
+}
+
+static void
+tds_date_plan_free_retired(struct tds_date_plan_cache *cache)
+{
+	TDSDATEPLAN *plan;
+
+	while ((plan = cache->retired) != NULL) {
+		DP_STORE(cache->retired, plan->next_retired);
+		tds_date_plan_free(plan);
+	}
+	cache->num_retired = 0;
+}
+
+void
+tds_free_date_plans(struct tds_date_plan_cache *cache)
+{
+	unsigned n;
+
+	if (!cache)
+		return;
+	for (n = 0; n < TDS_DATE_PLAN_CACHE_SIZE; ++n)
+		tds_date_plan_free(cache->plans[n]);
+	tds_date_plan_free_retired(cache);
+	tds_mutex_free(&cache->mtx);
+	free(cache);
+}
+
+static inline void
+tds_date_plan_enter(struct tds_date_plan_cache *cache)
+{
+#ifdef TDS_DATE_PLAN_ATOMIC
+	__atomic_add_fetch(&cache->readers, 1, __ATOMIC_SEQ_CST);
+#else
+	tds_mutex_lock(&cache->mtx);
+#endif
+}
+
+static inline void
+tds_date_plan_leave(struct tds_date_plan_cache *cache)
+{
+#ifdef TDS_DATE_PLAN_ATOMIC
+	if (__atomic_sub_fetch(&cache->readers, 1, __ATOMIC_SEQ_CST) != 0 || !DP_LOAD(cache->retired))
+		return;
+
+	/* last reader, check again with the lock as new readers could have entered */
+	tds_mutex_lock(&cache->mtx);
+	if (DP_LOAD(cache->readers) == 0)
+		tds_date_plan_free_retired(cache);
+	tds_mutex_unlock(&cache->mtx);
+#else
+	tds_mutex_unlock(&cache->mtx);
+#endif
+}
+
+static const TDSDATEPLAN *
+tds_find_date_plan(struct tds_date_plan_cache *cache, const char *format)
+{
+	unsigned n;
+
+	for (n = 0; n < TDS_DATE_PLAN_CACHE_SIZE; ++n) {
+		const TDSDATEPLAN *plan = DP_LOAD(cache->plans[n]);
+
+		if (plan && strcmp(plan->format, format) == 0) {
+			/* avoid writing shared memory if already set */
+			if (!DP_LOAD_RELAXED(cache->used[n]))
+				DP_STORE_RELAXED(cache->used[n], 1);
+			return plan;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Compile and add a format, replacing a plan not used recently if the
+ * cache is full (clock algorithm).  Must be called between
+ * tds_date_plan_enter() and tds_date_plan_leave().
+ * Returns NULL if the format cannot be compiled or too many replaced
+ * plans are still waiting to be freed.
+ */
+static const TDSDATEPLAN *
+tds_add_date_plan(struct tds_date_plan_cache *cache, const char *format)
+{
+	TDSDATEPLAN *plan, *old;
+	unsigned n;
+
+#ifdef TDS_DATE_PLAN_ATOMIC
+	const TDSDATEPLAN *found;
+
+	tds_mutex_lock(&cache->mtx);
+	/* another thread could have added it */
+	found = tds_find_date_plan(cache, format);
+	if (found) {
+		tds_mutex_unlock(&cache->mtx);
+		return found;
+	}
+#endif
+
+	/* readers are still using replaced plans */
+	if (cache->num_retired >= TDS_DATE_PLAN_MAX_RETIRED) {
+#ifdef TDS_DATE_PLAN_ATOMIC
+		tds_mutex_unlock(&cache->mtx);
+#endif
+		return NULL;
+	}
+
+	plan = tds_date_plan_compile(format);
+	if (plan) {
+		for (;;) {
+			n = cache->hand;
+			cache->hand = (n + 1) % TDS_DATE_PLAN_CACHE_SIZE;
+			if (!cache->plans[n] || !DP_LOAD_RELAXED(cache->used[n]))
+				break;
+			DP_STORE_RELAXED(cache->used[n], 0);
+		}
+		old = cache->plans[n];
+		DP_STORE_RELAXED(cache->used[n], 1);
+		DP_STORE(cache->plans[n], plan);
+		if (old) {
+			old->next_retired = cache->retired;
+			DP_STORE(cache->retired, old);
+			++cache->num_retired;
+		}
+		/*
+		 * Readers entering from now on cannot see retired plans, if we are
+		 * the only reader nobody is using them.
+		 */
+		if (DP_LOAD(cache->readers) <= 1)
+			tds_date_plan_free_retired(cache);
+	}
+
+#ifdef TDS_DATE_PLAN_ATOMIC
+	tds_mutex_unlock(&cache->mtx);
+#endif
+	return plan;
+}
+
+/**
+ * Format a date like tds_strftime() using a format compiled once for
+ * the locale.
+ * @param locale  locale caching compiled formats, can be NULL
+ * @return length of string returned, 0 for error
+ */
+size_t
+tds_locale_strftime(TDSLOCALE *locale, char *buf, size_t maxsize, const char *format, const TDSDATEREC *dr, int prec)
+{
+	struct tds_date_plan_cache *cache;
+	const TDSDATEPLAN *plan;
+	size_t len;
+
+	assert(format);
+
+	if (!locale || !(cache = locale->date_plans))
+		return tds_strftime(buf, maxsize, format, dr, prec);
+
+	/* plans found cannot be freed till we leave */
+	tds_date_plan_enter(cache);
+	plan = tds_find_date_plan(cache, format);
+	if (!plan)
+		plan = tds_add_date_plan(cache, format);
+	if (plan)
+		len = tds_date_plan_format(plan, buf, maxsize, dr, prec);
+	else
+		len = tds_strftime(buf, maxsize, format, dr, prec);
+	tds_date_plan_leave(cache);
+	return len;
+}
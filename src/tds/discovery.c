@@ -0,0 +1,261 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * \file
+ * \brief Cache of server discovery results
+ *
+ * Instance ports obtained from the SQL Server Browser and protocol versions
+ * found by TDS version auto-detection are saved in a text file shared by all
+ * processes, see "discovery cache" in freetds.conf.
+ * Each line contains expiration time, value and key separated by spaces.
+ * The file is rewritten to a temporary file, created exclusively with a
+ * random name in the same directory, and renamed so readers never see
+ * a partial file.
+ * Writers of the same process are serialized; writers of different processes
+ * can lose an update, this only causes a new probe.
+ * As entries decide where and how to connect, on Unix the file is used only
+ * if owned by the current user and not accessible by other users.
+ */
+
+#include <config.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif /* HAVE_STDLIB_H */
+
+#if HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#if HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif /* HAVE_SYS_STAT_H */
+
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif /* HAVE_FCNTL_H */
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include <freetds/time.h>
+#include <freetds/tds.h>
+#include <freetds/thread.h>
+#include <freetds/replacements.h>
+
+/** serialize writers of the same process */
+static tds_mutex discovery_mutex = TDS_MUTEX_INITIALIZER;
+
+/** Parse a line of the cache file, returns key or NULL if invalid */
+static const char *
+tds_discovery_parse(char *line, time_t *expires, int *value)
+{
+	long exp;
+	int pos = 0;
+	char *end;
+
+	if (sscanf(line, "%ld %d %n", &exp, value, &pos) < 2 || !pos)
+		return NULL;
+	*expires = (time_t) exp;
+	end = strchr(line + pos, '\n');
+	if (end)
+		*end = 0;
+	return line + pos;
+}
+
+/**
+ * Open the cache file for reading.
+ * @param path cache file name
+ * @return file opened or NULL if missing or not private to current user
+ */
+static FILE *
+tds_discovery_open(const char *path)
+{
+#ifdef _WIN32
+	return fopen(path, "r");
+#else
+	struct stat st;
+	FILE *f;
+	/* do not wait on a FIFO */
+	int fd = open(path, O_RDONLY | O_NONBLOCK);
+
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & 077) != 0) {
+		tdsdump_log(TDS_DBG_WARN, "discovery cache: %s ignored, not a file private to current user\n", path);
+		close(fd);
+		return NULL;
+	}
+	f = fdopen(fd, "r");
+	if (!f)
+		close(fd);
+	return f;
+#endif
+}
+
+/**
+ * Create the temporary file for a new cache.
+ * @param tmp_path template ending with "XXXXXX", replaced with the name used
+ * @return file opened for writing or NULL on error
+ */
+static FILE *
+tds_discovery_create_tmp(char *tmp_path)
+{
+	FILE *out;
+	int fd;
+
+#ifdef _WIN32
+	if (_mktemp_s(tmp_path, strlen(tmp_path) + 1) != 0)
+		return NULL;
+	fd = _open(tmp_path, _O_WRONLY | _O_CREAT | _O_EXCL | _O_TEXT, _S_IREAD | _S_IWRITE);
+	if (fd < 0)
+		return NULL;
+	out = _fdopen(fd, "w");
+	if (!out)
+		_close(fd);
+#else
+	/* mkstemp creates a file private to current user */
+	fd = mkstemp(tmp_path);
+	if (fd < 0)
+		return NULL;
+	out = fdopen(fd, "w");
+	if (!out)
+		close(fd);
+#endif
+	if (!out)
+		remove(tmp_path);
+	return out;
+}
+
+/**
+ * Get a value from the discovery cache.
+ * @param login login with cache settings
+ * @param key key of the value
+ * @return value or 0 if not present or expired
+ */
+int
+tds_discovery_cache_get(const TDSLOGIN *login, const char *key)
+{
+	FILE *f;
+	char line[512];
+	time_t now, expires;
+	int value, found = 0;
+	const char *k;
+
+	if (tds_dstr_isempty(&login->discovery_cache))
+		return 0;
+
+	f = tds_discovery_open(tds_dstr_cstr(&login->discovery_cache));
+	if (!f)
+		return 0;
+
+	now = time(NULL);
+	while (fgets(line, sizeof(line), f)) {
+		k = tds_discovery_parse(line, &expires, &value);
+		if (k && expires > now && strcmp(k, key) == 0) {
+			found = value;
+			break;
+		}
+	}
+	fclose(f);
+
+	tdsdump_log(TDS_DBG_INFO1, "discovery cache: %s = %d\n", key, found);
+	return found;
+}
+
+/**
+ * Store a value in the discovery cache.
+ * Expired entries are removed at the same time.
+ * @param login login with cache settings
+ * @param key key of the value
+ * @param value value to store, 0 to remove the entry
+ */
+void
+tds_discovery_cache_set(const TDSLOGIN *login, const char *key, int value)
+{
+	FILE *in, *out;
+	char line[512], *tmp_path;
+	const char *path, *k;
+	time_t now, expires;
+	int old_value;
+	size_t len;
+
+	if (tds_dstr_isempty(&login->discovery_cache))
+		return;
+
+	tdsdump_log(TDS_DBG_INFO1, "discovery cache: setting %s = %d\n", key, value);
+
+	path = tds_dstr_cstr(&login->discovery_cache);
+	len = strlen(path) + 8;
+	tmp_path = tds_new(char, len);
+	if (!tmp_path)
+		return;
+	snprintf(tmp_path, len, "%s.XXXXXX", path);
+
+	tds_mutex_lock(&discovery_mutex);
+
+	in = tds_discovery_open(path);
+	out = tds_discovery_create_tmp(tmp_path);
+	if (!out) {
+		if (in)
+			fclose(in);
+		tds_mutex_unlock(&discovery_mutex);
+		free(tmp_path);
+		return;
+	}
+
+	now = time(NULL);
+	if (in) {
+		while (fgets(line, sizeof(line), in)) {
+			k = tds_discovery_parse(line, &expires, &old_value);
+			if (!k || expires <= now || strcmp(k, key) == 0)
+				continue;
+			fprintf(out, "%ld %d %s\n", (long) expires, old_value, k);
+		}
+		fclose(in);
+	}
+
+	if (value)
+		fprintf(out, "%ld %d %s\n",
+			(long) (now + (login->discovery_cache_ttl >= 0 ? login->discovery_cache_ttl : TDS_DEF_DISCOVERY_CACHE_TTL)),
+			value, key);
+
+	if (fclose(out) != 0) {
+		remove(tmp_path);
+	} else {
+#ifdef _WIN32
+		/* rename does not replace existing files */
+		remove(path);
+#endif
+		if (rename(tmp_path, path) != 0)
+			remove(tmp_path);
+	}
+	tds_mutex_unlock(&discovery_mutex);
+	free(tmp_path);
+}
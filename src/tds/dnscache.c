@@ -0,0 +1,330 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * \file
+ * \brief Process wide cache of host name resolutions
+ *
+ * Results of tds_lookup_host_set() are kept for "dns cache ttl" seconds,
+ * failures for "dns negative cache ttl" seconds.
+ * When an entry is used during the last quarter of its life the caller
+ * resolves the name again so busy entries do not expire; meanwhile other
+ * callers keep using the cached addresses.
+ * Address lists returned are always allocated by tds_addrinfo_dup() and
+ * must be freed with tds_addrinfo_free().
+ */
+
+#include <config.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif /* HAVE_STDLIB_H */
+
+#if HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+
+#if HAVE_NETDB_H
+#include <netdb.h>
+#endif /* HAVE_NETDB_H */
+
+#if HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif /* HAVE_SYS_SOCKET_H */
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif
+
+#include <freetds/time.h>
+#include <freetds/tds.h>
+#include <freetds/thread.h>
+#include <freetds/replacements.h>
+
+/** maximum number of host names cached */
+#define TDS_DNS_CACHE_MAX 256
+
+typedef struct tds_dns_entry
+{
+	struct tds_dns_entry *next;
+	/** resolved addresses, NULL if resolution failed */
+	struct addrinfo *addrs;
+	time_t expires;
+	bool refreshing;
+	char host[1];
+} TDSDNSENTRY;
+
+static tds_mutex dns_mtx = TDS_MUTEX_INITIALIZER;
+static TDSDNSENTRY *dns_entries = NULL;
+static int dns_ttl = 0;
+static int dns_negative_ttl = 0;
+static TDSDNSCACHESTATS dns_stats;
+
+/* clock and resolver, replaced by unit tests */
+static time_t (*dns_time)(time_t *) = time;
+static struct addrinfo *(*dns_lookup)(const char *) = tds_lookup_host;
+
+/**
+ * Free a list of addresses returned by tds_addrinfo_dup()
+ */
+void
+tds_addrinfo_free(struct addrinfo *addr)
+{
+	while (addr) {
+		struct addrinfo *next = addr->ai_next;
+
+		free(addr);
+		addr = next;
+	}
+}
+
+/**
+ * Copy a list of addresses.
+ * Every element is allocated in a single block with its address.
+ * @return copy or NULL on error or empty list
+ */
+struct addrinfo *
+tds_addrinfo_dup(const struct addrinfo *addr)
+{
+	struct addrinfo *head = NULL, **tail = &head, *curr;
+
+	for (; addr; addr = addr->ai_next) {
+		curr = (struct addrinfo *) calloc(1, sizeof(*curr) + addr->ai_addrlen);
+		if (!curr) {
+			tds_addrinfo_free(head);
+			return NULL;
+		}
+		curr->ai_flags = addr->ai_flags;
+		curr->ai_family = addr->ai_family;
+		curr->ai_socktype = addr->ai_socktype;
+		curr->ai_protocol = addr->ai_protocol;
+		curr->ai_addrlen = addr->ai_addrlen;
+		curr->ai_addr = (struct sockaddr *) (curr + 1);
+		memcpy(curr->ai_addr, addr->ai_addr, addr->ai_addrlen);
+		*tail = curr;
+		tail = &curr->ai_next;
+	}
+	return head;
+}
+
+static struct addrinfo *
+tds_dns_resolve(const char *host)
+{
+	struct addrinfo *resolved, *addrs;
+
+	resolved = dns_lookup(host);
+	if (!resolved)
+		return NULL;
+	addrs = tds_addrinfo_dup(resolved);
+	freeaddrinfo(resolved);
+	return addrs;
+}
+
+/** Find an entry, moving it at the beginning of the list. Lock must be held */
+static TDSDNSENTRY *
+tds_dns_find(const char *host)
+{
+	TDSDNSENTRY **prev, *entry;
+
+	for (prev = &dns_entries; (entry = *prev) != NULL; prev = &entry->next) {
+		if (strcasecmp(entry->host, host) != 0)
+			continue;
+		*prev = entry->next;
+		entry->next = dns_entries;
+		dns_entries = entry;
+		return entry;
+	}
+	return NULL;
+}
+
+/**
+ * Remove expired entries and entries exceeding cache size.
+ * Lock must be held.
+ * @param now current time, 0 to remove all entries
+ */
+static void
+tds_dns_purge(time_t now)
+{
+	TDSDNSENTRY **prev, *entry;
+	unsigned num = 0;
+
+	for (prev = &dns_entries; (entry = *prev) != NULL; ) {
+		if (now && entry->expires > now && num < TDS_DNS_CACHE_MAX) {
+			++num;
+			prev = &entry->next;
+			continue;
+		}
+		*prev = entry->next;
+		tds_addrinfo_free(entry->addrs);
+		free(entry);
+	}
+}
+
+/**
+ * Save resolution result in the cache.
+ * @param addrs addresses, NULL if resolution failed; not owned by the cache
+ */
+static void
+tds_dns_store(const char *host, const struct addrinfo *addrs)
+{
+	TDSDNSENTRY *entry;
+	time_t now = dns_time(NULL);
+	int ttl;
+
+	tds_mutex_lock(&dns_mtx);
+	ttl = addrs ? dns_ttl : dns_negative_ttl;
+	entry = tds_dns_find(host);
+	if (ttl <= 0) {
+		if (entry)
+			entry->expires = now;
+	} else {
+		if (!entry) {
+			size_t len = strlen(host);
+
+			entry = (TDSDNSENTRY *) calloc(1, sizeof(*entry) + len);
+			if (entry) {
+				memcpy(entry->host, host, len + 1);
+				entry->next = dns_entries;
+				dns_entries = entry;
+			}
+		}
+		if (entry) {
+			tds_addrinfo_free(entry->addrs);
+			entry->addrs = tds_addrinfo_dup(addrs);
+			entry->expires = (addrs && !entry->addrs) ? now : now + ttl;
+			entry->refreshing = false;
+		}
+	}
+	tds_dns_purge(now);
+	tds_mutex_unlock(&dns_mtx);
+}
+
+/**
+ * Resolve a host name using the cache.
+ * @return list of addresses to free with tds_addrinfo_free() or NULL on failure
+ */
+struct addrinfo *
+tds_dns_cache_lookup(const char *host)
+{
+	TDSDNSENTRY *entry;
+	struct addrinfo *addrs = NULL, *refreshed;
+	time_t now = dns_time(NULL);
+	bool use_cache, refresh = false;
+
+	tds_mutex_lock(&dns_mtx);
+	use_cache = dns_ttl > 0 || dns_negative_ttl > 0;
+	entry = use_cache ? tds_dns_find(host) : NULL;
+	if (entry && entry->expires > now) {
+		if (!entry->addrs) {
+			++dns_stats.negative_hits;
+			tds_mutex_unlock(&dns_mtx);
+			return NULL;
+		}
+		addrs = tds_addrinfo_dup(entry->addrs);
+		++dns_stats.hits;
+		/* only a caller refreshes the entry, others use cached addresses */
+		if (addrs && !entry->refreshing && entry->expires - now <= dns_ttl / 4) {
+			entry->refreshing = true;
+			++dns_stats.refreshes;
+			refresh = true;
+		}
+	} else if (use_cache) {
+		++dns_stats.misses;
+	}
+	tds_mutex_unlock(&dns_mtx);
+
+	if (refresh) {
+		refreshed = tds_dns_resolve(host);
+		if (refreshed) {
+			tds_dns_store(host, refreshed);
+			tds_addrinfo_free(addrs);
+			return refreshed;
+		}
+
+		/* keep old addresses till the entry expires */
+		tds_mutex_lock(&dns_mtx);
+		entry = tds_dns_find(host);
+		if (entry)
+			entry->refreshing = false;
+		tds_mutex_unlock(&dns_mtx);
+	}
+	if (addrs)
+		return addrs;
+
+	addrs = tds_dns_resolve(host);
+	if (use_cache)
+		tds_dns_store(host, addrs);
+	return addrs;
+}
+
+/**
+ * Set cache durations, applied to the whole process.
+ * @param ttl seconds to keep resolved names, 0 disables, < 0 keeps current value
+ * @param negative_ttl seconds to keep failed resolutions, 0 disables, < 0 keeps current value
+ */
+void
+tds_dns_cache_config(int ttl, int negative_ttl)
+{
+	TDSDNSENTRY *entry;
+
+	tds_mutex_lock(&dns_mtx);
+	if (ttl >= 0)
+		dns_ttl = ttl;
+	if (negative_ttl >= 0)
+		dns_negative_ttl = negative_ttl;
+
+	/* drop entries of disabled kinds */
+	for (entry = dns_entries; entry; entry = entry->next)
+		if ((entry->addrs ? dns_ttl : dns_negative_ttl) <= 0)
+			entry->expires = 0;
+	tds_dns_purge(dns_time(NULL));
+	tds_mutex_unlock(&dns_mtx);
+}
+
+/**
+ * Remove all entries from the cache and reset statistics.
+ */
+void
+tds_dns_cache_flush(void)
+{
+	tds_mutex_lock(&dns_mtx);
+	tds_dns_purge(0);
+	memset(&dns_stats, 0, sizeof(dns_stats));
+	tds_mutex_unlock(&dns_mtx);
+}
+
+/**
+ * Retrieve cache statistics.
+ */
+void
+tds_dns_cache_get_stats(TDSDNSCACHESTATS *stats)
+{
+	TDSDNSENTRY *entry;
+
+	tds_mutex_lock(&dns_mtx);
+	*stats = dns_stats;
+	stats->entries = 0;
+	for (entry = dns_entries; entry; entry = entry->next)
+		++stats->entries;
+	tds_mutex_unlock(&dns_mtx);
+}
@@ -0,0 +1,529 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * \file
+ * \brief Shortest round-trip formatting of FLOAT and REAL values
+ *
+ * Implements the Ryu algorithm (Ulf Adams, "Ryu: fast float-to-string
+ * conversion", PLDI 2018) which computes the shortest decimal number
+ * that reads back as the same binary value, using only integer
+ * arithmetic.  Output layout is the one of printf "%g" with 17 (FLOAT)
+ * or 9 (REAL) digits of precision, minus the superfluous digits.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <float.h>
+
+#if HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+
+#include <freetds/tds.h>
+#include <freetds/convert.h>
+
+/* algorithm requires IEEE 754 binary formats */
+#undef USE_RYU
+#if FLT_RADIX == 2 && DBL_MANT_DIG == 53 && DBL_MAX_EXP == 1024 && FLT_MANT_DIG == 24 && FLT_MAX_EXP == 128
+#define USE_RYU 1
+#endif
+
+#ifdef USE_RYU
+
+#include "float_tables.h"
+
+#define DOUBLE_MANTISSA_BITS 52
+#define DOUBLE_EXPONENT_BITS 11
+#define DOUBLE_BIAS 1023
+
+#define FLOAT_MANTISSA_BITS 23
+#define FLOAT_EXPONENT_BITS 8
+#define FLOAT_BIAS 127
+
+static const char digit_pairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/* floor(log10(2^e)) */
+static inline int32_t
+log10_pow2(int32_t e)
+{
+	return (int32_t) (((uint32_t) e * 78913u) >> 18);
+}
+
+/* floor(log10(5^e)) */
+static inline int32_t
+log10_pow5(int32_t e)
+{
+	return (int32_t) (((uint32_t) e * 732923u) >> 20);
+}
+
+/* bits needed to represent 5^e, 1 for e == 0 */
+static inline int32_t
+pow5_bits(int32_t e)
+{
+	return (int32_t) ((((uint32_t) e) * 1217359u) >> 19) + 1;
+}
+
+static inline unsigned
+pow5_factor(uint64_t value)
+{
+	unsigned count = 0;
+
+	while (value % 5u == 0) {
+		value /= 5u;
+		++count;
+	}
+	return count;
+}
+
+static inline bool
+multiple_of_pow5(uint64_t value, uint32_t p)
+{
+	return pow5_factor(value) >= p;
+}
+
+static inline bool
+multiple_of_pow2(uint64_t value, uint32_t p)
+{
+	return (value & ((((uint64_t) 1) << p) - 1)) == 0;
+}
+
+/**
+ * Compute (m * mul) >> j where mul is a 128 bit number.
+ * j is always between 64 and 128 here.
+ */
+static inline uint64_t
+mul_shift_64(uint64_t m, const uint64_t *mul, int32_t j)
+{
+#if defined(__GNUC__) && SIZEOF___INT128 > 0
+	const unsigned __int128 b0 = ((unsigned __int128) m) * mul[0];
+	const unsigned __int128 b2 = ((unsigned __int128) m) * mul[1];
+
+	return (uint64_t) (((b0 >> 64) + b2) >> (j - 64));
+#else
+	/* 64x64 -> 128 multiplications done with 32 bit parts */
+	const uint64_t m_lo = (uint32_t) m, m_hi = m >> 32;
+	uint64_t lo, hi, high0, mid, t;
+	int32_t dist;
+
+	/* high part of m * mul[0] */
+	t = m_lo * (uint32_t) mul[0];
+	mid = m_hi * (uint32_t) mul[0] + (t >> 32);
+	t = m_lo * (mul[0] >> 32) + (uint32_t) mid;
+	high0 = m_hi * (mul[0] >> 32) + (mid >> 32) + (t >> 32);
+
+	/* m * mul[1] */
+	t = m_lo * (uint32_t) mul[1];
+	lo = (uint32_t) t;
+	mid = m_hi * (uint32_t) mul[1] + (t >> 32);
+	t = m_lo * (mul[1] >> 32) + (uint32_t) mid;
+	lo |= t << 32;
+	hi = m_hi * (mul[1] >> 32) + (mid >> 32) + (t >> 32);
+
+	lo += high0;
+	if (lo < high0)
+		++hi;
+	dist = j - 64;
+	if (dist == 0)
+		return lo;
+	return (hi << (64 - dist)) | (lo >> dist);
+#endif
+}
+
+static inline uint32_t
+mul_shift_32(uint32_t m, uint64_t factor, int32_t shift)
+{
+	const uint64_t bits0 = ((uint64_t) m) * (uint32_t) factor;
+	const uint64_t bits1 = ((uint64_t) m) * (uint32_t) (factor >> 32);
+
+	return (uint32_t) (((bits0 >> 32) + bits1) >> (shift - 32));
+}
+
+/**
+ * Write the number output * 10^exponent in "%g" layout.
+ * \param olength     number of decimal digits of output
+ * \param precision   precision of "%g" used to choose between fixed and exponential notation
+ * \return number of characters written
+ */
+static size_t
+format_decimal(char *buf, bool sign, uint64_t output, int olength, int32_t exponent, int precision)
+{
+	char digits[24];
+	char *end = digits + sizeof(digits), *p = end;
+	char *out = buf;
+	int32_t sci_exp = exponent + olength - 1;
+
+	while (output >= 100u) {
+		const char *pair = &digit_pairs[(output % 100u) * 2];
+
+		output /= 100u;
+		*--p = pair[1];
+		*--p = pair[0];
+	}
+	if (output >= 10u) {
+		*--p = digit_pairs[output * 2 + 1];
+		*--p = digit_pairs[output * 2];
+	} else {
+		*--p = (char) ('0' + output);
+	}
+
+	if (sign)
+		*out++ = '-';
+
+	if (sci_exp < -4 || sci_exp >= precision) {
+		/* d[.ddd]e[+-]XX */
+		*out++ = *p++;
+		if (p != end) {
+			*out++ = '.';
+			memcpy(out, p, end - p);
+			out += end - p;
+		}
+		*out++ = 'e';
+		if (sci_exp < 0) {
+			*out++ = '-';
+			sci_exp = -sci_exp;
+		} else {
+			*out++ = '+';
+		}
+		if (sci_exp >= 100) {
+			*out++ = (char) ('0' + sci_exp / 100);
+			sci_exp %= 100;
+		}
+		*out++ = digit_pairs[sci_exp * 2];
+		*out++ = digit_pairs[sci_exp * 2 + 1];
+	} else if (sci_exp < 0) {
+		/* 0.000ddd */
+		*out++ = '0';
+		*out++ = '.';
+		memset(out, '0', -sci_exp - 1);
+		out += -sci_exp - 1;
+		memcpy(out, p, olength);
+		out += olength;
+	} else if (exponent >= 0) {
+		/* ddd000 */
+		memcpy(out, p, olength);
+		out += olength;
+		memset(out, '0', exponent);
+		out += exponent;
+	} else {
+		/* ddd.ddd */
+		memcpy(out, p, sci_exp + 1);
+		out += sci_exp + 1;
+		*out++ = '.';
+		memcpy(out, p + sci_exp + 1, olength - sci_exp - 1);
+		out += olength - sci_exp - 1;
+	}
+	*out = 0;
+	return out - buf;
+}
+
+static inline int
+decimal_length(uint64_t v)
+{
+	int len = 1;
+
+	for (; v >= 10000u; v /= 10000u)
+		len += 4;
+	for (; v >= 10u; v /= 10u)
+		++len;
+	return len;
+}
+
+/**
+ * Format a FLOAT value using the minimum number of digits needed to
+ * read it back unchanged.
+ * \param buf  output buffer, at least TDS_FLOAT_STRING_MAX bytes
+ * \return length of formatted string
+ */
+size_t
+tds_double_to_string(double value, char *buf)
+{
+	uint64_t bits, ieee_mantissa, m2, mv, vr, vp, vm, output;
+	uint32_t ieee_exponent, mm_shift;
+	int32_t e2, e10, removed = 0;
+	bool sign, accept_bounds;
+	bool vm_is_trailing_zeros = false, vr_is_trailing_zeros = false;
+	uint8_t last_removed_digit = 0;
+
+	memcpy(&bits, &value, sizeof(bits));
+	sign = (bits >> (DOUBLE_MANTISSA_BITS + DOUBLE_EXPONENT_BITS)) != 0;
+	ieee_mantissa = bits & ((((uint64_t) 1) << DOUBLE_MANTISSA_BITS) - 1);
+	ieee_exponent = (uint32_t) ((bits >> DOUBLE_MANTISSA_BITS) & ((1u << DOUBLE_EXPONENT_BITS) - 1));
+
+	if (ieee_exponent == ((1u << DOUBLE_EXPONENT_BITS) - 1u))
+		return sprintf(buf, "%g", value);
+	if (ieee_exponent == 0 && ieee_mantissa == 0)
+		return format_decimal(buf, sign, 0, 1, 0, 17);
+
+	if (ieee_exponent == 0) {
+		e2 = 1 - DOUBLE_BIAS - DOUBLE_MANTISSA_BITS - 2;
+		m2 = ieee_mantissa;
+	} else {
+		e2 = (int32_t) ieee_exponent - DOUBLE_BIAS - DOUBLE_MANTISSA_BITS - 2;
+		m2 = (((uint64_t) 1) << DOUBLE_MANTISSA_BITS) | ieee_mantissa;
+	}
+	accept_bounds = (m2 & 1) == 0;
+
+	/* interval of valid representations is (mm, mp) scaled by 4 */
+	mv = 4 * m2;
+	mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+
+	/* convert to a decimal power base */
+	if (e2 >= 0) {
+		const uint32_t q = (uint32_t) log10_pow2(e2) - (e2 > 3);
+		const int32_t k = DOUBLE_POW5_INV_BITCOUNT + pow5_bits((int32_t) q) - 1;
+		const int32_t i = -e2 + (int32_t) q + k;
+
+		e10 = (int32_t) q;
+		vr = mul_shift_64(4 * m2, double_pow5_inv_split[q], i);
+		vp = mul_shift_64(4 * m2 + 2, double_pow5_inv_split[q], i);
+		vm = mul_shift_64(4 * m2 - 1 - mm_shift, double_pow5_inv_split[q], i);
+		if (q <= 21) {
+			/* only one of mp, mv and mm can be a multiple of 5, if any */
+			if (mv % 5u == 0)
+				vr_is_trailing_zeros = multiple_of_pow5(mv, q);
+			else if (accept_bounds)
+				vm_is_trailing_zeros = multiple_of_pow5(mv - 1 - mm_shift, q);
+			else
+				vp -= multiple_of_pow5(mv + 2, q);
+		}
+	} else {
+		const uint32_t q = (uint32_t) log10_pow5(-e2) - (-e2 > 1);
+		const int32_t i = -e2 - (int32_t) q;
+		const int32_t k = pow5_bits(i) - DOUBLE_POW5_BITCOUNT;
+		const int32_t j = (int32_t) q - k;
+
+		e10 = (int32_t) q + e2;
+		vr = mul_shift_64(4 * m2, double_pow5_split[i], j);
+		vp = mul_shift_64(4 * m2 + 2, double_pow5_split[i], j);
+		vm = mul_shift_64(4 * m2 - 1 - mm_shift, double_pow5_split[i], j);
+		if (q <= 1) {
+			/* mv has at least q trailing 0 bits, so vr is exact */
+			vr_is_trailing_zeros = true;
+			if (accept_bounds)
+				vm_is_trailing_zeros = mm_shift == 1;
+			else
+				--vp;
+		} else if (q < 63) {
+			vr_is_trailing_zeros = multiple_of_pow2(mv, q);
+		}
+	}
+
+	/* find the shortest representation in the interval */
+	if (vm_is_trailing_zeros || vr_is_trailing_zeros) {
+		/* general case, rare */
+		while (vp / 10u > vm / 10u) {
+			vm_is_trailing_zeros &= vm % 10u == 0;
+			vr_is_trailing_zeros &= last_removed_digit == 0;
+			last_removed_digit = (uint8_t) (vr % 10u);
+			vr /= 10u;
+			vp /= 10u;
+			vm /= 10u;
+			++removed;
+		}
+		if (vm_is_trailing_zeros) {
+			while (vm % 10u == 0) {
+				vr_is_trailing_zeros &= last_removed_digit == 0;
+				last_removed_digit = (uint8_t) (vr % 10u);
+				vr /= 10u;
+				vp /= 10u;
+				vm /= 10u;
+				++removed;
+			}
+		}
+		/* round to even if exact number is .....50..0 */
+		if (vr_is_trailing_zeros && last_removed_digit == 5 && vr % 2u == 0)
+			last_removed_digit = 4;
+		output = vr + ((vr == vm && (!accept_bounds || !vm_is_trailing_zeros)) || last_removed_digit >= 5);
+	} else {
+		bool round_up = false;
+
+		/* remove two digits at a time while possible */
+		if (vp / 100u > vm / 100u) {
+			round_up = vr % 100u >= 50u;
+			vr /= 100u;
+			vp /= 100u;
+			vm /= 100u;
+			removed += 2;
+		}
+		while (vp / 10u > vm / 10u) {
+			round_up = vr % 10u >= 5u;
+			vr /= 10u;
+			vp /= 10u;
+			vm /= 10u;
+			++removed;
+		}
+		output = vr + (vr == vm || round_up);
+	}
+
+	return format_decimal(buf, sign, output, decimal_length(output), e10 + removed, 17);
+}
+
+/**
+ * Format a REAL value using the minimum number of digits needed to
+ * read it back unchanged.
+ * \param buf  output buffer, at least TDS_FLOAT_STRING_MAX bytes
+ * \return length of formatted string
+ */
+size_t
+tds_real_to_string(float value, char *buf)
+{
+	uint32_t bits, ieee_mantissa, ieee_exponent, m2, mv, mp, mm, mm_shift, vr, vp, vm, output;
+	int32_t e2, e10, removed = 0;
+	bool sign, accept_bounds;
+	bool vm_is_trailing_zeros = false, vr_is_trailing_zeros = false;
+	uint8_t last_removed_digit = 0;
+
+	memcpy(&bits, &value, sizeof(bits));
+	sign = (bits >> (FLOAT_MANTISSA_BITS + FLOAT_EXPONENT_BITS)) != 0;
+	ieee_mantissa = bits & ((1u << FLOAT_MANTISSA_BITS) - 1);
+	ieee_exponent = (bits >> FLOAT_MANTISSA_BITS) & ((1u << FLOAT_EXPONENT_BITS) - 1);
+
+	if (ieee_exponent == ((1u << FLOAT_EXPONENT_BITS) - 1u))
+		return sprintf(buf, "%g", value);
+	if (ieee_exponent == 0 && ieee_mantissa == 0)
+		return format_decimal(buf, sign, 0, 1, 0, 9);
+
+	if (ieee_exponent == 0) {
+		e2 = 1 - FLOAT_BIAS - FLOAT_MANTISSA_BITS - 2;
+		m2 = ieee_mantissa;
+	} else {
+		e2 = (int32_t) ieee_exponent - FLOAT_BIAS - FLOAT_MANTISSA_BITS - 2;
+		m2 = (1u << FLOAT_MANTISSA_BITS) | ieee_mantissa;
+	}
+	accept_bounds = (m2 & 1) == 0;
+
+	mv = 4 * m2;
+	mp = 4 * m2 + 2;
+	mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+	mm = 4 * m2 - 1 - mm_shift;
+
+	if (e2 >= 0) {
+		const uint32_t q = (uint32_t) log10_pow2(e2);
+		const int32_t k = FLOAT_POW5_INV_BITCOUNT + pow5_bits((int32_t) q) - 1;
+		const int32_t i = -e2 + (int32_t) q + k;
+
+		e10 = (int32_t) q;
+		vr = mul_shift_32(mv, float_pow5_inv_split[q], i);
+		vp = mul_shift_32(mp, float_pow5_inv_split[q], i);
+		vm = mul_shift_32(mm, float_pow5_inv_split[q], i);
+		if (q != 0 && (vp - 1) / 10u <= vm / 10u) {
+			/* we need to know one removed digit even if we are not going to loop below */
+			const int32_t l = FLOAT_POW5_INV_BITCOUNT + pow5_bits((int32_t) (q - 1)) - 1;
+
+			last_removed_digit = (uint8_t) (mul_shift_32(mv, float_pow5_inv_split[q - 1],
+								     -e2 + (int32_t) q - 1 + l) % 10u);
+		}
+		if (q <= 9) {
+			if (mv % 5u == 0)
+				vr_is_trailing_zeros = multiple_of_pow5(mv, q);
+			else if (accept_bounds)
+				vm_is_trailing_zeros = multiple_of_pow5(mm, q);
+			else
+				vp -= multiple_of_pow5(mp, q);
+		}
+	} else {
+		const uint32_t q = (uint32_t) log10_pow5(-e2);
+		const int32_t i = -e2 - (int32_t) q;
+		const int32_t k = pow5_bits(i) - FLOAT_POW5_BITCOUNT;
+		int32_t j = (int32_t) q - k;
+
+		e10 = (int32_t) q + e2;
+		vr = mul_shift_32(mv, float_pow5_split[i], j);
+		vp = mul_shift_32(mp, float_pow5_split[i], j);
+		vm = mul_shift_32(mm, float_pow5_split[i], j);
+		if (q != 0 && (vp - 1) / 10u <= vm / 10u) {
+			j = (int32_t) q - 1 - (pow5_bits(i + 1) - FLOAT_POW5_BITCOUNT);
+			last_removed_digit = (uint8_t) (mul_shift_32(mv, float_pow5_split[i + 1], j) % 10u);
+		}
+		if (q <= 1) {
+			vr_is_trailing_zeros = true;
+			if (accept_bounds)
+				vm_is_trailing_zeros = mm_shift == 1;
+			else
+				--vp;
+		} else if (q < 31) {
+			vr_is_trailing_zeros = multiple_of_pow2(mv, q - 1);
+		}
+	}
+
+	if (vm_is_trailing_zeros || vr_is_trailing_zeros) {
+		while (vp / 10u > vm / 10u) {
+			vm_is_trailing_zeros &= vm % 10u == 0;
+			vr_is_trailing_zeros &= last_removed_digit == 0;
+			last_removed_digit = (uint8_t) (vr % 10u);
+			vr /= 10u;
+			vp /= 10u;
+			vm /= 10u;
+			++removed;
+		}
+		if (vm_is_trailing_zeros) {
+			while (vm % 10u == 0) {
+				vr_is_trailing_zeros &= last_removed_digit == 0;
+				last_removed_digit = (uint8_t) (vr % 10u);
+				vr /= 10u;
+				vp /= 10u;
+				vm /= 10u;
+				++removed;
+			}
+		}
+		if (vr_is_trailing_zeros && last_removed_digit == 5 && vr % 2u == 0)
+			last_removed_digit = 4;
+		output = vr + ((vr == vm && (!accept_bounds || !vm_is_trailing_zeros)) || last_removed_digit >= 5);
+	} else {
+		while (vp / 10u > vm / 10u) {
+			last_removed_digit = (uint8_t) (vr % 10u);
+			vr /= 10u;
+			vp /= 10u;
+			vm /= 10u;
+			++removed;
+		}
+		output = vr + (vr == vm || last_removed_digit >= 5);
+	}
+
+	return format_decimal(buf, sign, output, decimal_length(output), e10 + removed, 9);
+}
+
+#else
+
+size_t
+tds_double_to_string(double value, char *buf)
+{
+	return sprintf(buf, "%.17g", value);
+}
+
+size_t
+tds_real_to_string(float value, char *buf)
+{
+	return sprintf(buf, "%.9g", value);
+}
+
+#endif
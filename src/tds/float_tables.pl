@@ -0,0 +1,75 @@
+#!/usr/bin/perl
+
+#
+# Compute power of 5 tables used to format floating point numbers
+# (see float.c)
+#
+
+use strict;
+use Math::BigInt;
+
+# Return a number split in 64 bit words, least significant first
+sub split64($$)
+{
+	my ($num, $words) = @_;
+	my $hex = substr($num->as_hex(), 2);
+	my @out = ();
+
+	$hex = ('0' x (16 * $words - length($hex))) . $hex;
+	die('number too big') if (length($hex) != 16 * $words);
+	for my $i (1..$words) {
+		push @out, '0x' . substr($hex, length($hex) - 16 * $i, 16);
+	}
+	return @out;
+}
+
+sub bit_length($)
+{
+	my ($num) = @_;
+	return length(substr($num->as_bin(), 2));
+}
+
+# Print table of 5^i normalized to given number of bits
+sub print_pow5($$$)
+{
+	my ($name, $count, $bits) = @_;
+	my $words = int(($bits + 63) / 64);
+
+	printf("static const uint64_t %s[%d]%s = {\n", $name, $count, $words > 1 ? "[$words]" : '');
+	for my $i (0..$count-1) {
+		my $pow5 = Math::BigInt->new(5)->bpow($i);
+		my $shift = bit_length($pow5) - $bits;
+		my $num = $shift > 0 ? $pow5->copy()->brsft($shift) : $pow5->copy()->blsft(-$shift);
+		my @w = split64($num, $words);
+		printf("\t%s,\t/* %3d */\n", $words > 1 ? '{ ' . join(', ', map { $_ . 'u' } @w) . ' }' : "$w[0]u", $i);
+	}
+	print "};\n\n";
+}
+
+# Print table of 2^n / 5^i, with n chosen to keep given number of bits
+sub print_pow5_inv($$$)
+{
+	my ($name, $count, $bits) = @_;
+	my $words = int(($bits + 63) / 64);
+
+	printf("static const uint64_t %s[%d]%s = {\n", $name, $count, $words > 1 ? "[$words]" : '');
+	for my $i (0..$count-1) {
+		my $pow5 = Math::BigInt->new(5)->bpow($i);
+		my $num = Math::BigInt->new(1)->blsft(bit_length($pow5) - 1 + $bits);
+		$num->bdiv($pow5);
+		$num->binc();
+		my @w = split64($num, $words);
+		printf("\t%s,\t/* %3d */\n", $words > 1 ? '{ ' . join(', ', map { $_ . 'u' } @w) . ' }' : "$w[0]u", $i);
+	}
+	print "};\n\n";
+}
+
+print "/* Generated by float_tables.pl, do not edit */\n\n";
+print "#define DOUBLE_POW5_INV_BITCOUNT 125\n";
+print "#define DOUBLE_POW5_BITCOUNT 125\n";
+print "#define FLOAT_POW5_INV_BITCOUNT 59\n";
+print "#define FLOAT_POW5_BITCOUNT 61\n\n";
+&print_pow5_inv('double_pow5_inv_split', 342, 125);
+&print_pow5('double_pow5_split', 326, 125);
+&print_pow5_inv('float_pow5_inv_split', 31, 59);
+&print_pow5('float_pow5_split', 47, 61);
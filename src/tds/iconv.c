@@ -302,6 +302,8 @@ tds_iconv_reset(TDSICONV *conv)
 	conv->to.charset.canonic = conv->from.charset.canonic = 0;
 	conv->to.cd = (iconv_t) -1;
 	conv->from.cd = (iconv_t) -1;
+	conv->to.fast = conv->from.fast = NULL;
+	conv->to.ascii = conv->from.ascii = TDS_ASCII_NONE;
 }
 
 /**
@@ -468,6 +470,9 @@ tds_iconv_info_init(TDSICONV * char_conv, int client_canonical, int server_canon
 	*client = canonic_charsets[client_canonical];
 	*server = canonic_charsets[server_canonical];
 
+	char_conv->to.fast = char_conv->from.fast = NULL;
+	char_conv->to.ascii = char_conv->from.ascii = TDS_ASCII_NONE;
+
 	/* special case, same charset, no conversion */
 	if (client_canonical == server_canonical) {
 		char_conv->to.cd = (iconv_t) -1;
@@ -503,6 +508,21 @@ tds_iconv_info_init(TDSICONV * char_conv, int client_canonical, int server_canon
 		tdsdump_log(TDS_DBG_FUNC, "tds_iconv_info_init: cannot convert \"%s\"->\"%s\"\n", server->name, client->name);
 	}
 
+	/*
+	 * Use built-in converters for most common conversions.
+	 * System descriptors are still needed to handle invalid sequences.
+	 */
+	if (char_conv->to.cd != (iconv_t) -1) {
+		char_conv->to.fast = tds_fast_iconv_get(client_canonical, server_canonical);
+		if (!char_conv->to.fast)
+			char_conv->to.ascii = tds_ascii_mode(client_canonical, server_canonical);
+	}
+	if (char_conv->from.cd != (iconv_t) -1) {
+		char_conv->from.fast = tds_fast_iconv_get(server_canonical, client_canonical);
+		if (!char_conv->from.fast)
+			char_conv->from.ascii = tds_ascii_mode(server_canonical, client_canonical);
+	}
+
 	/* TODO, do some optimizations like UCS2 -> UTF8 min,max = 2,2 (UCS2) and 1,4 (UTF8) */
 
 	/* tdsdump_log(TDS_DBG_FUNC, "tds_iconv_info_init: converting \"%s\"->\"%s\"\n", client->name, server->name); */
@@ -563,6 +583,51 @@ tds_iconv_err(TDSSOCKET *tds, int err)
 		tdserror(tds_get_ctx(tds), tds, err, 0);
 }
 
+/**
+ * Same as iconv(3) but ASCII runs are converted directly, only the
+ * characters between them are passed to iconv.
+ * Input charset must be stateless and ASCII code units must not
+ * be part of other characters, see tds_ascii_mode().
+ */
+static size_t
+tds_iconv_ascii(TDSICONVDIR *to, const char **inbuf, size_t *inbytesleft, char **outbuf, size_t *outbytesleft)
+{
+	const size_t width = (to->ascii == TDS_ASCII_NARROW || to->ascii == TDS_ASCII_COPY2) ? 2 : 1;
+	const unsigned char *p;
+	size_t irreversible = 0, res, segment, rest;
+
+	for (;;) {
+		tds_ascii_convert(to->ascii, inbuf, inbytesleft, outbuf, outbytesleft);
+		if (!*inbytesleft)
+			return irreversible;
+
+		/* find next ASCII character, partial code units go to iconv */
+		p = (const unsigned char *) *inbuf;
+		for (segment = 0; segment + width <= *inbytesleft; segment += width)
+			if ((width == 1 ? p[segment] : TDS_GET_UA2LE(p + segment)) < 0x80)
+				break;
+		if (segment + width > *inbytesleft)
+			segment = *inbytesleft;
+
+		/* stopped at an ASCII character, output is full */
+		if (!segment) {
+			errno = E2BIG;
+			return (size_t) -1;
+		}
+
+		rest = *inbytesleft - segment;
+		res = tds_sys_iconv(to->cd, (ICONV_CONST char **) inbuf, &segment, outbuf, outbytesleft);
+		*inbytesleft = segment + rest;
+		if (res == (size_t) -1) {
+			/* sequence truncated by us, let iconv see following bytes */
+			if (errno == EINVAL && rest)
+				return tds_sys_iconv(to->cd, (ICONV_CONST char **) inbuf, inbytesleft, outbuf, outbytesleft);
+			return res;
+		}
+		irreversible += res;
+	}
+}
+
 /** 
  * Wrapper around iconv(3).  Same parameters, with slightly different behavior.
  * \param tds state information for the socket and the TDS protocol
@@ -664,7 +729,12 @@ tds_iconv(TDSSOCKET * tds, TDSICONV * conv, TDS_ICONV_DIRECTION io,
 	 */
 	for (;;) {
 		conv_errno = 0;
-		irreversible = tds_sys_iconv(to->cd, (ICONV_CONST char **) inbuf, inbytesleft, outbuf, outbytesleft);
+		if (to->fast)
+			irreversible = to->fast(inbuf, inbytesleft, outbuf, outbytesleft);
+		else if (to->ascii && inbuf)
+			irreversible = tds_iconv_ascii(to, inbuf, inbytesleft, outbuf, outbytesleft);
+		else
+			irreversible = tds_sys_iconv(to->cd, (ICONV_CONST char **) inbuf, inbytesleft, outbuf, outbytesleft);
 
 		/* iconv success, return */
 		if (irreversible != (size_t) - 1) {
@@ -50,6 +50,7 @@
 #include <freetds/utils/string.h>
 #include <freetds/bytes.h>
 #include <freetds/tls.h>
+#include <freetds/uring.h>
 #include <freetds/stream.h>
 #include <freetds/checks.h>
 #include <freetds/replacements.h>
@@ -486,6 +487,52 @@ tds_setup_connection(TDSSOCKET *tds, TDSLOGIN *login, bool set_db, bool single_q
 	return tds_parse_login_results(tds, false);
 }
 
+/**
+ * Get port of a named instance, asking the discovery cache first
+ * @param login info for login
+ * @param addr address of the server
+ * @param from_cache set if value comes from the cache, NULL to refresh the cache
+ * @return port number or 0 if not found
+ */
+static int
+tds_get_instance_port_cached(TDSLOGIN * login, struct addrinfo *addr, bool *from_cache)
+{
+	char key[256], ipaddr[128];
+	int port = 0;
+
+	snprintf(key, sizeof(key), "port %s %s", tds_addrinfo2str(addr, ipaddr, sizeof(ipaddr)),
+		 tds_dstr_cstr(&login->instance_name));
+
+	if (from_cache) {
+		port = tds_discovery_cache_get(login, key);
+		*from_cache = (port > 0);
+		if (port > 0)
+			return port;
+	}
+
+	port = tds7_get_instance_port(addr, tds_dstr_cstr(&login->instance_name));
+	if (port > 0 || !from_cache)
+		tds_discovery_cache_set(login, key, port > 0 ? port : 0);
+	return port;
+}
+
+/**
+ * Build the discovery cache key for the TDS version detected for a server
+ */
+static bool
+tds_version_cache_key(TDSLOGIN * login, char *key, size_t key_len)
+{
+	char ipaddr[128];
+
+	/* a version configured explicitly is never replaced by a cached one */
+	if (TDS_MAJOR(login) != 0 || !login->ip_addrs || tds_dstr_isempty(&login->discovery_cache))
+		return false;
+
+	snprintf(key, key_len, "version %s %d %s", tds_addrinfo2str(login->ip_addrs, ipaddr, sizeof(ipaddr)),
+		 login->port, tds_dstr_cstr(&login->instance_name));
+	return true;
+}
+
 /**
  * Do a connection to socket
  * @param tds connection structure. This should be a non-connected connection.
@@ -506,6 +553,7 @@ tds_connect(TDSSOCKET * tds, TDSLOGIN * login, int *p_oserr)
 	bool db_selected = false;
 	struct addrinfo *addrs;
 	int orig_port;
+	bool port_cached;
 	bool rerouted = false;
 	/* save to restore during redirected connection */
 	unsigned int orig_mars = login->mars;
@@ -530,6 +578,18 @@ tds_connect(TDSSOCKET * tds, TDSLOGIN * login, int *p_oserr)
 		const TDSCONTEXT *old_ctx = tds_get_ctx(tds);
 		typedef void (*env_chg_func_t) (TDSSOCKET * tds, int type, char *oldval, char *newval);
 		env_chg_func_t old_env_chg = tds->env_chg_func;
+		char key[256];
+		bool use_cache = tds_version_cache_key(login, key, sizeof(key));
+		unsigned int first = 0;
+		int cached = 0;
+
+		/* start with the version detected previously */
+		if (use_cache) {
+			cached = tds_discovery_cache_get(login, key);
+			for (i = 0; i < TDS_VECTOR_SIZE(versions); ++i)
+				if (versions[i] == cached)
+					first = i;
+		}
 
 		init_save_context(&save_ctx, old_ctx);
 		tds_set_ctx(tds, &save_ctx.ctx);
@@ -537,7 +597,7 @@ tds_connect(TDSSOCKET * tds, TDSLOGIN * login, int *p_oserr)
 
 		for (i = 0; i < TDS_VECTOR_SIZE(versions); ++i) {
 			int orig_size = tds->conn->env.block_size;
-			login->tds_version = versions[i];
+			login->tds_version = versions[(first + i) % TDS_VECTOR_SIZE(versions)];
 			reset_save_context(&save_ctx);
 
 			erc = tds_connect(tds, login, p_oserr);
@@ -557,6 +617,12 @@ tds_connect(TDSSOCKET * tds, TDSLOGIN * login, int *p_oserr)
 		tds_set_ctx(tds, old_ctx);
 		replay_save_context(tds, &save_ctx);
 		free_save_context(&save_ctx);
+
+		/* remember working version, forget it on failure */
+		if (use_cache && TDS_SUCCEED(erc) && login->tds_version != cached)
+			tds_discovery_cache_set(login, key, login->tds_version);
+		else if (use_cache && TDS_FAILED(erc) && cached)
+			tds_discovery_cache_set(login, key, 0);
 		
 		if (TDS_FAILED(erc))
 			tdserror(tds_get_ctx(tds), tds, -erc, *p_oserr);
@@ -641,12 +707,30 @@ reroute:
 #endif
 
 		login->port = orig_port;
+		port_cached = false;
 
 		if (!IS_TDS50(tds->conn) && !tds_dstr_isempty(&login->instance_name) && !login->port)
-			login->port = tds7_get_instance_port(addrs, tds_dstr_cstr(&login->instance_name));
+			login->port = tds_get_instance_port_cached(login, addrs, &port_cached);
 
 		if (login->port >= 1) {
-			if ((erc = tds_open_socket(tds, addrs, login->port, connect_timeout, p_oserr)) == TDSEOK)
+			erc = tds_open_socket(tds, login, addrs, login->port, connect_timeout, p_oserr);
+			if (erc != TDSEOK && port_cached) {
+				/* instance could have been moved to another port, ask again */
+				int cached_port = login->port;
+
+				login->port = tds_get_instance_port_cached(login, addrs, NULL);
+				if (login->port >= 1 && login->port != cached_port)
+					erc = tds_open_socket(tds, login, addrs, login->port, connect_timeout, p_oserr);
+				else if (login->port < 1)
+					login->port = cached_port;
+			}
+			if (erc == TDSEOK)
+				break;
+			/*
+			 * tds_open_socket tried all remaining addresses together,
+			 * try again only if next address could use another port
+			 */
+			if (login->port == orig_port)
 				break;
 		} else {
 			erc = TDSECONN;
@@ -669,6 +753,21 @@ reroute:
 		
 	tds_set_state(tds, TDS_IDLE);
 	tds->conn->spid = -1;
+	tds->conn->partial_packets = 0;
+	tds->conn->rpc_no_metadata = login->rpc_no_metadata;
+	tds->in_partial = 0;
+
+	if (login->use_io_uring && !tds_uring_init(tds->conn))
+		tdsdump_log(TDS_DBG_INFO1, "io_uring not available, using poll\n");
+
+	if (login->packet_pool_size >= 0
+	    && !tds_connection_set_packet_pool_size(tds->conn, login->packet_pool_size))
+		tdsdump_log(TDS_DBG_WARN, "Unable to allocate packet pool\n");
+
+	/* io_uring does its own read-ahead */
+	if (!tds_set_read_ahead(tds->conn, tds->conn->uring ? 0 :
+				login->read_ahead_size >= 0 ? login->read_ahead_size : TDS_DEF_READ_AHEAD_SIZE))
+		tdsdump_log(TDS_DBG_WARN, "Unable to allocate read-ahead buffer\n");
 
 	/* discard possible previous authentication */
 	if (tds->conn->authentication) {
@@ -763,6 +862,9 @@ reroute:
 	}
 #endif
 
+	/* login is done, tokens can now be decoded while packets are still arriving */
+	tds->conn->partial_packets = 1;
+
 	erc = tds_setup_connection(tds, login, !db_selected, true);
 	/* try one query at a time, some servers do not support some queries */
 	if (TDS_FAILED(erc))
@@ -1501,6 +1603,8 @@ tds71_do_login(TDSSOCKET * tds, TDSLOGIN* login)
 	/* server just encrypt the first packet */
 	if (crypt_flag == TDS7_ENCRYPT_OFF)
 		tds->conn->encrypt_single_packet = 1;
+	else
+		tds_ssl_ktls_start(tds);
 
 	ret = tds7_send_login(tds, login);
 
@@ -122,31 +122,252 @@ tds_get_dynid(TDSCONNECTION * conn, char *id)
 extern const TDSCOLUMNFUNCS tds_invalid_funcs;
 #include <freetds/popvis.h>
 
-static TDSCOLUMN *
-tds_alloc_column(void)
+/* initialize a zeroed column */
+static void
+tds_init_column(TDSCOLUMN *col)
 {
-	TDSCOLUMN *col;
-
-	TEST_MALLOC(col, TDSCOLUMN);
 	tds_dstr_init(&col->table_name);
 	tds_dstr_init(&col->column_name);
 	tds_dstr_init(&col->table_column_name);
 	col->funcs = &tds_invalid_funcs;
 	col->use_iconv_out = 1;
+}
+
+static TDSCOLUMN *
+tds_alloc_column(void)
+{
+	TDSCOLUMN *col;
+
+	TEST_MALLOC(col, TDSCOLUMN);
+	tds_init_column(col);
 
       Cleanup:
 	return col;
 }
 
 static void
-tds_free_column(TDSCOLUMN *col)
+tds_deinit_column(TDSCOLUMN *col)
 {
 	tds_dstr_free(&col->table_name);
 	tds_dstr_free(&col->column_name);
 	tds_dstr_free(&col->table_column_name);
+}
+
+static void
+tds_free_column(TDSCOLUMN *col)
+{
+	tds_deinit_column(col);
 	free(col);
 }
 
+/*
+ * Arena for results.
+ * Results owned by a socket, with their columns and rows, are carved
+ * from chunks of memory of the socket instead of being allocated piece
+ * by piece. The arena is emptied as soon as all its blocks are released,
+ * usually when the next result set or batch arrives.
+ * Results retained by the application (dblib row buffering, ODBC
+ * descriptors) keep the arena busy; when full the heap is used instead.
+ * The arena outlives its socket if some blocks are still in use.
+ * Like the socket, an arena must be used by a thread at a time.
+ */
+
+/** size of first chunk of an arena */
+#define TDS_ARENA_MIN_CHUNK 4096u
+/** maximum memory reserved by an arena */
+#define TDS_ARENA_MAX_SIZE (256u * 1024u)
+
+#define TDS_ARENA_ALIGN(n) (((n) + (TDS_ALIGN_SIZE - 1)) / TDS_ALIGN_SIZE * TDS_ALIGN_SIZE)
+
+typedef struct tds_arena_chunk
+{
+	struct tds_arena_chunk *next;
+	size_t size;
+} TDSARENACHUNK;
+
+/** offset of blocks inside a chunk */
+#define TDS_ARENA_CHUNK_HDR TDS_ARENA_ALIGN(sizeof(TDSARENACHUNK))
+
+typedef struct tds_arena
+{
+	/** chunks of memory, blocks are taken from the first */
+	TDSARENACHUNK *chunks;
+	/** bytes used in first chunk */
+	size_t used;
+	/** blocks not released yet */
+	unsigned int live;
+	/** socket was freed, free the arena when last block is released */
+	bool orphan;
+	TDSARENASTATS stats;
+} TDSARENA;
+
+static TDSARENACHUNK *
+tds_arena_add_chunk(TDSARENA *arena, size_t size)
+{
+	TDSARENACHUNK *chunk = (TDSARENACHUNK *) malloc(TDS_ARENA_CHUNK_HDR + size);
+
+	if (!chunk)
+		return NULL;
+	chunk->size = size;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	arena->used = 0;
+	arena->stats.reserved += size;
+	++arena->stats.chunks;
+	return chunk;
+}
+
+static void
+tds_arena_free_chunks(TDSARENA *arena)
+{
+	TDSARENACHUNK *chunk;
+
+	while ((chunk = arena->chunks) != NULL) {
+		arena->chunks = chunk->next;
+		free(chunk);
+	}
+	arena->used = 0;
+	arena->stats.reserved = 0;
+}
+
+/* empty an unused arena, chunks are merged so next time one is enough */
+static void
+tds_arena_reset(TDSARENA *arena)
+{
+	size_t reserved = arena->stats.reserved;
+
+	assert(arena->live == 0);
+	if (arena->chunks && arena->chunks->next) {
+		tds_arena_free_chunks(arena);
+		tds_arena_add_chunk(arena, reserved);
+	}
+	arena->used = 0;
+	++arena->stats.resets;
+}
+
+/**
+ * Allocate a zeroed block from an arena.
+ * \return block allocated, NULL if arena is full, the caller should use the heap
+ */
+static void *
+tds_arena_alloc(TDSARENA *arena, size_t size)
+{
+	TDSARENACHUNK *chunk;
+	unsigned char *p;
+
+	if (!arena || arena->orphan)
+		return NULL;
+
+	if (!arena->live && arena->used)
+		tds_arena_reset(arena);
+
+	size = TDS_ARENA_ALIGN(size);
+	chunk = arena->chunks;
+	if (!chunk || chunk->size - arena->used < size) {
+		size_t chunk_size = chunk ? chunk->size * 2u : TDS_ARENA_MIN_CHUNK;
+
+		if (chunk_size > TDS_ARENA_MAX_SIZE - arena->stats.reserved)
+			chunk_size = TDS_ARENA_MAX_SIZE - arena->stats.reserved;
+		if (chunk_size < size || !(chunk = tds_arena_add_chunk(arena, chunk_size))) {
+			++arena->stats.fallbacks;
+			return NULL;
+		}
+	}
+	p = (unsigned char *) chunk + TDS_ARENA_CHUNK_HDR + arena->used;
+	arena->used += size;
+	++arena->live;
+	++arena->stats.allocs;
+	memset(p, 0, size);
+	return p;
+}
+
+static void
+tds_arena_release(TDSARENA *arena)
+{
+	assert(arena->live > 0);
+	if (--arena->live == 0 && arena->orphan) {
+		tds_arena_free_chunks(arena);
+		free(arena);
+	}
+}
+
+static bool
+tds_arena_owns(const TDSARENA *arena, const void *p)
+{
+	const TDSARENACHUNK *chunk;
+
+	for (chunk = arena->chunks; chunk; chunk = chunk->next) {
+		const unsigned char *start = (const unsigned char *) chunk + TDS_ARENA_CHUNK_HDR;
+
+		if ((const unsigned char *) p >= start && (const unsigned char *) p < start + chunk->size)
+			return true;
+	}
+	return false;
+}
+
+static TDSARENA *
+tds_get_arena(TDSSOCKET *tds)
+{
+	if (!tds->arena)
+		tds->arena = tds_new0(TDSARENA, 1);
+	return tds->arena;
+}
+
+/* called when the owner socket is freed */
+static void
+tds_free_arena(TDSARENA *arena)
+{
+	if (!arena)
+		return;
+	if (arena->live) {
+		arena->orphan = true;
+		return;
+	}
+	tds_arena_free_chunks(arena);
+	free(arena);
+}
+
+/**
+ * Get counters of the arena of a socket.
+ * Compare allocs and fallbacks to know how many results and rows
+ * avoided the heap.
+ */
+void
+tds_get_arena_stats(TDSSOCKET * tds, TDSARENASTATS * stats)
+{
+	if (tds->arena)
+		*stats = tds->arena->stats;
+	else
+		memset(stats, 0, sizeof(*stats));
+}
+
+/* allocate a result with its columns in a single arena block */
+static TDSRESULTINFO *
+tds_arena_alloc_results(TDSARENA *arena, TDS_USMALLINT num_cols)
+{
+	const size_t cols_offset = TDS_ARENA_ALIGN(sizeof(TDSRESULTINFO) + sizeof(TDSCOLUMN *) * num_cols);
+	TDSRESULTINFO *res_info;
+	TDSCOLUMN *cols;
+	TDS_USMALLINT col;
+
+	res_info = (TDSRESULTINFO *) tds_arena_alloc(arena, cols_offset + sizeof(TDSCOLUMN) * num_cols);
+	if (!res_info)
+		return NULL;
+
+	res_info->arena = arena;
+	res_info->ref_count = 1;
+	if (num_cols) {
+		res_info->columns = (TDSCOLUMN **) (res_info + 1);
+		cols = (TDSCOLUMN *) ((unsigned char *) res_info + cols_offset);
+		for (col = 0; col < num_cols; col++) {
+			tds_init_column(&cols[col]);
+			res_info->columns[col] = &cols[col];
+		}
+	}
+	res_info->num_cols = num_cols;
+	return res_info;
+}
+
 
 /**
  * \fn TDSDYNAMIC *tds_alloc_dynamic(TDSCONNECTION *conn, const char *id)
@@ -263,11 +484,24 @@ tds_release_dynamic(TDSDYNAMIC ** pdyn)
 	tds_detach_results(dyn->res_info);
 
 	tds_free_results(dyn->res_info);
+	tds_free_results(dyn->meta);
 	tds_free_input_params(dyn);
 	free(dyn->query);
 	free(dyn);
 }
 
+/**
+ * Discard result metadata cached by a dynamic statement.
+ * Server will send them again on next execution.
+ * \param dyn  dynamic statement
+ */
+void
+tds_dynamic_free_meta(TDSDYNAMIC * dyn)
+{
+	tds_free_results(dyn->meta);
+	dyn->meta = NULL;
+}
+
 /**
  * \fn TDSPARAMINFO *tds_alloc_param_result(TDSPARAMINFO *old_param)
  * \brief Adds a output parameter to TDSPARAMINFO.
@@ -402,11 +636,15 @@ tds_alloc_param_data(TDSCOLUMN * curparam)
  */
 
 static TDSCOMPUTEINFO *
-tds_alloc_compute_result(TDS_USMALLINT num_cols, TDS_USMALLINT by_cols)
+tds_alloc_compute_result(TDSARENA *arena, TDS_USMALLINT num_cols, TDS_USMALLINT by_cols)
 {
 	TDS_USMALLINT col;
 	TDSCOMPUTEINFO *info;
 
+	info = tds_arena_alloc_results(arena, num_cols);
+	if (info)
+		goto by_columns;
+
 	TEST_MALLOC(info, TDSCOMPUTEINFO);
 	info->ref_count = 1;
 
@@ -417,6 +655,8 @@ tds_alloc_compute_result(TDS_USMALLINT num_cols, TDS_USMALLINT by_cols)
 		if (!(info->columns[col] = tds_alloc_column()))
 			goto Cleanup;
 
+by_columns:
+
 	if (by_cols) {
 		TEST_CALLOC(info->bycolumns, TDS_SMALLINT, by_cols);
 		info->by_cols = by_cols;
@@ -438,7 +678,7 @@ tds_alloc_compute_results(TDSSOCKET * tds, TDS_USMALLINT num_cols, TDS_USMALLINT
 	tdsdump_log(TDS_DBG_FUNC, "alloc_compute_result. num_cols = %d bycols = %d\n", num_cols, by_cols);
 	tdsdump_log(TDS_DBG_FUNC, "alloc_compute_result. num_comp_info = %d\n", tds->num_comp_info);
 
-	cur_comp_info = tds_alloc_compute_result(num_cols, by_cols);
+	cur_comp_info = tds_alloc_compute_result(tds_get_arena(tds), num_cols, by_cols);
 	if (!cur_comp_info)
 		return NULL;
 
@@ -479,6 +719,22 @@ tds_alloc_results(TDS_USMALLINT num_cols)
 	return NULL;
 }
 
+/**
+ * Allocate a result for a socket.
+ * Memory is taken from the socket arena if possible so the result should
+ * be referenced only by tds->res_info or users of the same socket.
+ */
+TDSRESULTINFO *
+tds_alloc_socket_results(TDSSOCKET * tds, TDS_USMALLINT num_cols)
+{
+	TDSRESULTINFO *res_info;
+
+	res_info = tds_arena_alloc_results(tds_get_arena(tds), num_cols);
+	if (res_info)
+		return res_info;
+	return tds_alloc_results(num_cols);
+}
+
 void
 tds_set_current_results(TDSSOCKET *tds, TDSRESULTINFO *info)
 {
@@ -505,14 +761,11 @@ tds_detach_results(TDSRESULTINFO *info)
 }
 
 static void
-tds_row_free(TDSRESULTINFO *res_info, unsigned char *row)
+tds_row_free_blobs(TDSRESULTINFO *res_info, unsigned char *row)
 {
 	int i;
 	const TDSCOLUMN *col;
 
-	if (!res_info || !row)
-		return;
-
 	for (i = 0; i < res_info->num_cols; ++i) {
 		col = res_info->columns[i];
 		
@@ -522,10 +775,32 @@ tds_row_free(TDSRESULTINFO *res_info, unsigned char *row)
 				TDS_ZERO_FREE(blob->textvalue);
 		}
 	}
+}
 
+static void
+tds_row_free(TDSRESULTINFO *res_info, unsigned char *row)
+{
+	if (!res_info || !row)
+		return;
+
+	tds_row_free_blobs(res_info, row);
 	free(row);
 }
 
+/* free a row of a result allocated from an arena, row can be on the heap */
+static void
+tds_arena_row_free(TDSRESULTINFO *res_info, unsigned char *row)
+{
+	if (!res_info || !row)
+		return;
+
+	tds_row_free_blobs(res_info, row);
+	if (tds_arena_owns(res_info->arena, row))
+		tds_arena_release(res_info->arena);
+	else
+		free(row);
+}
+
 /**
  * Allocate space for row store
  * return NULL on out of memory
@@ -551,11 +826,13 @@ tds_alloc_row(TDSRESULTINFO * res_info)
 	}
 	res_info->row_size = row_size;
 
-	ptr = tds_new0(unsigned char, row_size ? row_size : 1);
+	ptr = (unsigned char *) tds_arena_alloc(res_info->arena, row_size ? row_size : 1);
+	if (!ptr)
+		ptr = tds_new0(unsigned char, row_size ? row_size : 1);
 	res_info->current_row = ptr;
 	if (!ptr)
 		return TDS_FAIL;
-	res_info->row_free = tds_row_free;
+	res_info->row_free = res_info->arena ? tds_arena_row_free : tds_row_free;
 
 	/* fill column_data */
 	row_size = 0;
@@ -648,6 +925,18 @@ tds_free_results(TDSRESULTINFO * res_info)
 	if (res_info->current_row && res_info->row_free)
 		res_info->row_free(res_info, res_info->current_row);
 
+	free(res_info->row_plan);
+
+	free(res_info->bycolumns);
+
+	/* columns are in the same block of the result */
+	if (res_info->arena) {
+		for (i = 0; i < res_info->num_cols; i++)
+			tds_deinit_column(res_info->columns[i]);
+		tds_arena_release(res_info->arena);
+		return;
+	}
+
 	if (res_info->num_cols && res_info->columns) {
 		for (i = 0; i < res_info->num_cols; i++)
 			if ((curcol = res_info->columns[i]) != NULL)
@@ -655,11 +944,23 @@ tds_free_results(TDSRESULTINFO * res_info)
 		free(res_info->columns);
 	}
 
-	free(res_info->bycolumns);
-
 	free(res_info);
 }
 
+/**
+ * Drop metadata cached by the socket, see tds7_process_result()
+ */
+void
+tds_free_meta_cache(TDSSOCKET * tds)
+{
+	TDSRESULTINFO *info = tds->meta_cache.info;
+
+	TDS_ZERO_FREE(tds->meta_cache.wire);
+	tds->meta_cache.len = 0;
+	tds->meta_cache.info = NULL;
+	tds_free_results(info);
+}
+
 void
 tds_free_all_results(TDSSOCKET * tds)
 {
@@ -735,6 +1036,14 @@ tds_alloc_context(void * parent)
 	context->parent = parent;
 	context->money_use_2_digits = false;
 
+	if ((context->packet_pool = tds_alloc_packet_pool()) == NULL) {
+		tds_free_context(context);
+		return NULL;
+	}
+
+	/* without a cache sessions are just not resumed */
+	context->tls_sessions = tds_tls_session_cache_alloc();
+
 	return context;
 }
 
@@ -745,6 +1054,8 @@ tds_free_context(TDSCONTEXT * context)
 		return;
 
 	tds_free_locale(context->locale);
+	tds_release_packet_pool(context->packet_pool);
+	tds_tls_session_cache_free(context->tls_sessions);
 	free(context);
 }
 
@@ -754,6 +1065,8 @@ tds_alloc_locale(void)
 	TDSLOCALE *locale;
 
 	TEST_MALLOC(locale, TDSLOCALE);
+	if ((locale->date_plans = tds_alloc_date_plans()) == NULL)
+		goto Cleanup;
 
 	return locale;
 
@@ -988,6 +1301,16 @@ tds_alloc_login(bool use_environment)
 	login->check_ssl_hostname = 1;
 	login->use_utf16 = 1;
 	login->bulk_copy = 1;
+	login->tcp_cork = 1;
+	login->packet_pool_size = -1;
+	login->read_ahead_size = -1;
+	login->socket_rcvbuf = -1;
+	login->socket_sndbuf = -1;
+	login->socket_busy_poll = -1;
+	login->keepalive_idle = -1;
+	login->keepalive_interval = -1;
+	login->connect_attempt_delay = -1;
+	login->discovery_cache_ttl = -1;
 	tds_dstr_init(&login->server_name);
 	tds_dstr_init(&login->language);
 	tds_dstr_init(&login->server_charset);
@@ -1008,6 +1331,7 @@ tds_alloc_login(bool use_environment)
 	tds_dstr_init(&login->server_realm_name);
 	tds_dstr_init(&login->server_spn);
 	tds_dstr_init(&login->cafile);
+	tds_dstr_init(&login->discovery_cache);
 	tds_dstr_init(&login->crlfile);
 	tds_dstr_init(&login->certificate_host_name);
 	tds_dstr_init(&login->db_filename);
@@ -1059,7 +1383,7 @@ tds_free_login(TDSLOGIN * login)
 	tds_dstr_free(&login->server_host_name);
 
 	if (login->ip_addrs != NULL)
-		freeaddrinfo(login->ip_addrs);
+		tds_addrinfo_free(login->ip_addrs);
 
 	tds_dstr_free(&login->database);
 	free(login->dump_file);
@@ -1067,6 +1391,7 @@ tds_free_login(TDSLOGIN * login)
 	tds_dstr_free(&login->server_realm_name);
 	tds_dstr_free(&login->server_spn);
 	tds_dstr_free(&login->cafile);
+	tds_dstr_free(&login->discovery_cache);
 	tds_dstr_free(&login->crlfile);
 	tds_dstr_free(&login->certificate_host_name);
 	tds_dstr_free(&login->db_filename);
@@ -1115,6 +1440,48 @@ tds_free_packets(TDSPACKET *packet)
 	}
 }
 
+TDSPACKETPOOL *
+tds_alloc_packet_pool(void)
+{
+	TDSPACKETPOOL *pool;
+
+	TEST_MALLOC(pool, TDSPACKETPOOL);
+	if (tds_mutex_init(&pool->mtx)) {
+		free(pool);
+		return NULL;
+	}
+	pool->ref_count = 1;
+	pool->max_packets = TDS_DEF_PACKET_POOL_SIZE;
+	return pool;
+
+      Cleanup:
+	return NULL;
+}
+
+/**
+ * Release a reference to a packet pool, freeing it with all cached
+ * packets when the last reference goes away.
+ */
+void
+tds_release_packet_pool(TDSPACKETPOOL *pool)
+{
+	unsigned ref_count, n;
+
+	if (!pool)
+		return;
+
+	tds_mutex_lock(&pool->mtx);
+	ref_count = --pool->ref_count;
+	tds_mutex_unlock(&pool->mtx);
+	if (ref_count)
+		return;
+
+	for (n = 0; n < TDS_PACKET_POOL_CLASSES; ++n)
+		tds_free_packets(pool->packets[n]);
+	tds_mutex_free(&pool->mtx);
+	free(pool);
+}
+
 static void
 tds_deinit_connection(TDSCONNECTION *conn)
 {
@@ -1133,7 +1500,8 @@ tds_deinit_connection(TDSCONNECTION *conn)
 	free(conn->product_name);
 	free(conn->server);
 	tds_free_env(conn);
-	tds_free_packets(conn->packet_cache);
+	tds_release_packet_pool(conn->packet_pool);
+	free(conn->read_ahead.buf);
 	tds_mutex_free(&conn->list_mtx);
 #if ENABLE_ODBC_MARS
 	tds_free_packets(conn->packets);
@@ -1162,6 +1530,16 @@ tds_init_connection(TDSCONNECTION *conn, TDSCONTEXT *context, unsigned int bufsi
 	if (tds_mutex_init(&conn->list_mtx))
 		goto Cleanup;
 
+	/* share context packets if possible */
+	if (context && context->packet_pool) {
+		conn->packet_pool = context->packet_pool;
+		tds_mutex_lock(&conn->packet_pool->mtx);
+		++conn->packet_pool->ref_count;
+		tds_mutex_unlock(&conn->packet_pool->mtx);
+	} else if ((conn->packet_pool = tds_alloc_packet_pool()) == NULL) {
+		goto Cleanup;
+	}
+
 #if ENABLE_ODBC_MARS
 	TEST_CALLOC(conn->sessions, TDSSOCKET*, 64);
 	conn->num_sessions = 64;
@@ -1445,12 +1823,16 @@ tds_free_socket(TDSSOCKET * tds)
 	}
 #endif
 	tds_free_all_results(tds);
+	tds_free_meta_cache(tds);
+	tds_free_arena(tds->arena);
 #if ENABLE_ODBC_MARS
 	tds_cond_destroy(&tds->packet_cond);
 #endif
 
 	tds_connection_remove_socket(tds->conn, tds);
 	tds_free_packets(tds->recv_packet);
+	tds_free_packets(tds->borrowed_packets);
+	tds_free_packets(tds->send_queue);
 	if (tds->frozen_packets)
 		tds_free_packets(tds->frozen_packets);
 	else
@@ -1469,6 +1851,7 @@ tds_free_locale(TDSLOCALE * locale)
 	free(locale->datetime_fmt);
 	free(locale->date_fmt);
 	free(locale->time_fmt);
+	tds_free_date_plans(locale->date_plans);
 	free(locale);
 }
 
@@ -77,6 +77,14 @@
 #include <sys/eventfd.h>
 #endif /* HAVE_SYS_EVENTFD_H */
 
+#if HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif /* HAVE_SYS_UIO_H */
+
+#if HAVE_LIMITS_H
+#include <limits.h>
+#endif /* HAVE_LIMITS_H */
+
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
@@ -87,6 +95,7 @@
 #include <freetds/utils/string.h>
 #include <freetds/utils/nosigpipe.h>
 #include <freetds/tls.h>
+#include <freetds/uring.h>
 #include <freetds/replacements.h>
 
 #include <signal.h>
@@ -101,6 +110,21 @@ static void tds_check_cancel(TDSCONNECTION *conn);
 #endif
 
 
+/*
+ * Use vectored writes to send multiple packets with a single system call.
+ * We need to avoid SIGPIPE without changing signal handlers so require
+ * either MSG_NOSIGNAL (used with sendmsg) or SO_NOSIGPIPE (used with writev).
+ */
+#if !defined(_WIN32) && defined(HAVE_WRITEV) && (defined(MSG_NOSIGNAL) || defined(SO_NOSIGPIPE))
+#define USE_WRITEV 1
+/* maximum number of buffers to send in a single call */
+#if defined(IOV_MAX) && IOV_MAX < 64
+#define TDS_MAX_IOVEC IOV_MAX
+#else
+#define TDS_MAX_IOVEC 64
+#endif
+#endif
+
 /**
  * \addtogroup network
  * @{ 
@@ -216,6 +240,7 @@ tds_get_socket_error(TDS_SYS_SOCKET sock)
  * Function allocate the socket in *p_sock and try to start a connection.
  * @param p_sock where returned socket is stored. Socket is stored even on error.
  *        Can be INVALID_SOCKET.
+ * @param login login with socket options to apply
  * @param addr address to use for attempting the connection
  * @param port port to connect to
  * @param p_oserr where system error is returned
@@ -223,7 +248,7 @@ tds_get_socket_error(TDS_SYS_SOCKET sock)
  *          or any other error.
  */
 static TDSERRNO
-tds_setup_socket(TDS_SYS_SOCKET *p_sock, struct addrinfo *addr, unsigned int port, int *p_oserr)
+tds_setup_socket(TDS_SYS_SOCKET *p_sock, const TDSLOGIN *login, struct addrinfo *addr, unsigned int port, int *p_oserr)
 {
 	enum {
 		TDS_SOCKET_KEEPALIVE_IDLE = 40,
@@ -233,11 +258,13 @@ tds_setup_socket(TDS_SYS_SOCKET *p_sock, struct addrinfo *addr, unsigned int por
 	char ipaddr[128];
 	int retval, len, err;
 	char *errstr;
+	int keepalive_idle = login->keepalive_idle > 0 ? login->keepalive_idle : TDS_SOCKET_KEEPALIVE_IDLE;
+	int keepalive_interval = login->keepalive_interval > 0 ? login->keepalive_interval : TDS_SOCKET_KEEPALIVE_INTERVAL;
 #if defined(_WIN32)
 	struct tcp_keepalive keepalive = {
 		TRUE,
-		TDS_SOCKET_KEEPALIVE_IDLE * 1000,
-		TDS_SOCKET_KEEPALIVE_INTERVAL * 1000
+		keepalive_idle * 1000,
+		keepalive_interval * 1000
 	};
 	DWORD written;
 #endif
@@ -268,10 +295,29 @@ tds_setup_socket(TDS_SYS_SOCKET *p_sock, struct addrinfo *addr, unsigned int por
 		sock_strerror_free(errstr);
 	}
 #elif defined(TCP_KEEPIDLE) && defined(TCP_KEEPINTVL)
-	len = TDS_SOCKET_KEEPALIVE_IDLE;
-	setsockopt(sock, SOL_TCP, TCP_KEEPIDLE, (const void *) &len, sizeof(len));
-	len = TDS_SOCKET_KEEPALIVE_INTERVAL;
-	setsockopt(sock, SOL_TCP, TCP_KEEPINTVL, (const void *) &len, sizeof(len));
+	setsockopt(sock, SOL_TCP, TCP_KEEPIDLE, (const void *) &keepalive_idle, sizeof(keepalive_idle));
+	setsockopt(sock, SOL_TCP, TCP_KEEPINTVL, (const void *) &keepalive_interval, sizeof(keepalive_interval));
+#endif
+
+	/* socket buffers must be set before connecting to affect TCP window scaling */
+	if (login->socket_rcvbuf > 0
+	    && setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const void *) &login->socket_rcvbuf, sizeof(int)) != 0)
+		tdsdump_log(TDS_DBG_WARN, "error setting SO_RCVBUF to %d\n", login->socket_rcvbuf);
+	if (login->socket_sndbuf > 0
+	    && setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (const void *) &login->socket_sndbuf, sizeof(int)) != 0)
+		tdsdump_log(TDS_DBG_WARN, "error setting SO_SNDBUF to %d\n", login->socket_sndbuf);
+
+#if defined(SO_BUSY_POLL)
+	if (login->socket_busy_poll >= 0
+	    && setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, (const void *) &login->socket_busy_poll, sizeof(int)) != 0)
+		tdsdump_log(TDS_DBG_WARN, "error setting SO_BUSY_POLL to %d\n", login->socket_busy_poll);
+#endif
+
+#if defined(TCP_QUICKACK)
+	if (login->tcp_quickack) {
+		len = 1;
+		setsockopt(sock, SOL_TCP, TCP_QUICKACK, (const void *) &len, sizeof(len));
+	}
 #endif
 
 #if defined(SO_NOSIGPIPE)
@@ -287,7 +333,8 @@ tds_setup_socket(TDS_SYS_SOCKET *p_sock, struct addrinfo *addr, unsigned int por
 	setsockopt(sock, SOL_TCP, TCP_NODELAY, (const void *) &len, sizeof(len));
 #elif defined(USE_CORK)
 	setsockopt(sock, SOL_TCP, TCP_NODELAY, (const void *) &len, sizeof(len));
-	setsockopt(sock, SOL_TCP, TCP_CORK, (const void *) &len, sizeof(len));
+	if (login->tcp_cork)
+		setsockopt(sock, SOL_TCP, TCP_CORK, (const void *) &len, sizeof(len));
 #else
 #error One should be defined
 #endif
@@ -344,8 +391,53 @@ typedef struct {
 	unsigned retry_count;
 } retry_addr;
 
+/**
+ * Reorder addresses alternating address families, as suggested by RFC 8305.
+ * Relative order of addresses of the same family is preserved.
+ */
+static void
+tds_interleave_addresses(retry_addr *addresses, size_t len)
+{
+	size_t i, j;
+
+	for (i = 1; i < len; ++i) {
+		retry_addr tmp;
+		int family = addresses[i - 1].addr->ai_family;
+
+		if (addresses[i].addr->ai_family != family)
+			continue;
+		for (j = i + 1; j < len && addresses[j].addr->ai_family == family; ++j)
+			continue;
+		if (j >= len)
+			break;
+		tmp = addresses[j];
+		memmove(&addresses[i + 1], &addresses[i], (j - i) * sizeof(addresses[0]));
+		addresses[i] = tmp;
+	}
+}
+
+/**
+ * An attempt failed, start the next scheduled one without waiting.
+ */
+static void
+tds_start_next_attempt(retry_addr *addresses, const struct pollfd *fds, size_t len, unsigned curr_time)
+{
+	size_t i, next = len;
+
+	for (i = 0; i < len; ++i) {
+		if (!TDS_IS_SOCKET_INVALID(fds[i].fd) || addresses[i].retry_count != 0)
+			continue;
+		if ((int) (addresses[i].next_retry_time - curr_time) <= 0)
+			continue;
+		if (next == len || (int) (addresses[i].next_retry_time - addresses[next].next_retry_time) < 0)
+			next = i;
+	}
+	if (next < len)
+		addresses[next].next_retry_time = curr_time;
+}
+
 TDSERRNO
-tds_open_socket(TDSSOCKET *tds, struct addrinfo *addr, unsigned int port, int timeout, int *p_oserr)
+tds_open_socket(TDSSOCKET *tds, const TDSLOGIN *login, struct addrinfo *addr, unsigned int port, int timeout, int *p_oserr)
 {
 	TDSCONNECTION *conn = tds->conn;
 	size_t len, i;
@@ -360,8 +452,11 @@ tds_open_socket(TDSSOCKET *tds, struct addrinfo *addr, unsigned int port, int ti
 		struct pollfd fd;
 	} alloc_addr;
 	enum { MAX_RETRY = 10 };
+	unsigned attempt_delay;
 
 	*p_oserr = 0;
+	conn->no_cork = !login->tcp_cork;
+	conn->quickack = login->tcp_quickack;
 
 	if (!addr)
 		return TDSECONN;
@@ -380,14 +475,19 @@ tds_open_socket(TDSSOCKET *tds, struct addrinfo *addr, unsigned int port, int ti
 	tds_error = TDSECONN;
 
 	/* fill all structures */
-	curr_time = start_time = tds_gettime_ms();
 	for (len = 0, curr_addr = addr; curr_addr != NULL; curr_addr = curr_addr->ai_next) {
 		fds[len].fd = INVALID_SOCKET;
 		addresses[len].addr = curr_addr;
-		addresses[len].next_retry_time = curr_time;
 		addresses[len].retry_count = 0;
 		++len;
 	}
+	tds_interleave_addresses(addresses, len);
+
+	/* stagger connection attempts, a failure starts the next one immediately */
+	attempt_delay = login->connect_attempt_delay >= 0 ? login->connect_attempt_delay : TDS_DEF_CONNECT_ATTEMPT_DELAY;
+	curr_time = start_time = tds_gettime_ms();
+	for (i = 0; i < len; ++i)
+		addresses[i].next_retry_time = curr_time + (unsigned) i * attempt_delay;
 
 	/* if we have only one address means that availability groups feature is not
 	 * present, avoid to check the addresses multiple times */
@@ -422,7 +522,7 @@ tds_open_socket(TDSSOCKET *tds, struct addrinfo *addr, unsigned int port, int ti
 			time_left = addresses[i].next_retry_time - curr_time;
 			if (time_left <= 0) {
 				TDS_SYS_SOCKET sock;
-				tds_error = tds_setup_socket(&sock, addresses[i].addr, port, p_oserr);
+				tds_error = tds_setup_socket(&sock, login, addresses[i].addr, port, p_oserr);
 				switch (tds_error) {
 				case TDSEOK:
 					/* connected! */
@@ -438,10 +538,12 @@ tds_open_socket(TDSSOCKET *tds, struct addrinfo *addr, unsigned int port, int ti
 					/* error, continue with other addresses */
 					if (!TDS_IS_SOCKET_INVALID(sock))
 						CLOSESOCKET(sock);
+					tds_start_next_attempt(addresses, fds, len, curr_time);
 					--len;
 					fds[i] = fds[len];
 					addresses[i] = addresses[len];
-					--i;
+					/* scan again, an earlier attempt could be due now */
+					i = (size_t) -1;
 					continue;
 				}
 			} else {
@@ -481,6 +583,7 @@ tds_open_socket(TDSSOCKET *tds, struct addrinfo *addr, unsigned int port, int ti
 				 * the loop exit */
 				CLOSESOCKET(fds[i].fd);
 				fds[i].fd = INVALID_SOCKET;
+				tds_start_next_attempt(addresses, fds, len, curr_time);
 				addresses[i].next_retry_time = curr_time + 1000;
 				if (++addresses[i].retry_count >= MAX_RETRY || len == 1) {
 					--len;
@@ -545,9 +648,11 @@ tds_close_socket(TDSSOCKET * tds)
 		}
 #else
 		tds_disconnect(tds);
+		tds_uring_free(tds->conn);
 		if (!TDS_IS_SOCKET_INVALID(tds_get_s(tds)) && CLOSESOCKET(tds_get_s(tds)) == -1)
 			tdserror(tds_get_ctx(tds), tds,  TDSECLOS, sock_errno);
 		tds_set_s(tds, INVALID_SOCKET);
+		tds->conn->read_ahead.pos = tds->conn->read_ahead.len = 0;
 		tds_set_state(tds, TDS_DEAD);
 #endif
 	}
@@ -560,11 +665,14 @@ tds_connection_close(TDSCONNECTION *conn)
 	unsigned n = 0;
 #endif
 
+	tds_uring_free(conn);
+
 	if (!TDS_IS_SOCKET_INVALID(conn->s)) {
 		/* TODO check error ?? how to return it ?? */
 		CLOSESOCKET(conn->s);
 		conn->s = INVALID_SOCKET;
 	}
+	conn->read_ahead.pos = conn->read_ahead.len = 0;
 
 #if ENABLE_ODBC_MARS
 	tds_mutex_lock(&conn->list_mtx);
@@ -620,6 +728,23 @@ tds_select(TDSSOCKET * tds, unsigned tds_sel, int timeout_seconds)
 		if ((tds_sel & TDSSELREAD) != 0 && tds->conn->tls_session && tds_ssl_pending(tds->conn))
 			return POLLIN;
 
+		/* data already read in advance */
+		if ((tds_sel & TDSSELREAD) != 0 && tds->conn->read_ahead.pos < tds->conn->read_ahead.len)
+			return POLLIN;
+
+#ifdef TDS_HAVE_IO_URING
+		if (tds->conn->uring) {
+			bool wakeup;
+
+			rc = tds_uring_poll(tds->conn, tds_sel, timeout, &wakeup);
+			if (rc >= 0 && wakeup)
+				rc |= TDSPOLLURG;
+			if (rc > 0)
+				return rc;
+			goto check_error;
+		}
+#endif
+
 		fds[0].fd = tds_get_s(tds);
 		fds[0].events = tds_sel;
 		fds[0].revents = 0;
@@ -643,6 +768,9 @@ tds_select(TDSSOCKET * tds, unsigned tds_sel, int timeout_seconds)
 			return rc;
 		}
 
+#ifdef TDS_HAVE_IO_URING
+	check_error:
+#endif
 		if (rc < 0) {
 			char *errstr;
 
@@ -705,12 +833,80 @@ tds_select(TDSSOCKET * tds, unsigned tds_sel, int timeout_seconds)
  * @TODO remove tds, save error somewhere, report error in another way
  * @returns 0 if blocking, <0 error >0 bytes read
  */
+/* copy data from read-ahead buffer */
+static size_t
+tds_read_ahead_get(TDSCONNECTION * conn, unsigned char *buf, size_t buflen)
+{
+	size_t len = conn->read_ahead.len - conn->read_ahead.pos;
+
+	if (len > buflen)
+		len = buflen;
+	memcpy(buf, conn->read_ahead.buf + conn->read_ahead.pos, len);
+	conn->read_ahead.pos += (unsigned) len;
+	return len;
+}
+
+/**
+ * Set size of the buffer used to read data from the network in advance.
+ * \param conn connection
+ * \param size buffer size, 0 to disable read-ahead
+ * \return false on memory error (read-ahead is disabled)
+ */
+bool
+tds_set_read_ahead(TDSCONNECTION *conn, unsigned size)
+{
+	/* data still in buffer */
+	if (conn->read_ahead.pos < conn->read_ahead.len)
+		return false;
+
+	conn->read_ahead.pos = conn->read_ahead.len = 0;
+	if (size == conn->read_ahead.size)
+		return true;
+
+	TDS_ZERO_FREE(conn->read_ahead.buf);
+	conn->read_ahead.size = 0;
+	if (!size)
+		return true;
+
+	conn->read_ahead.buf = tds_new(unsigned char, size);
+	if (!conn->read_ahead.buf)
+		return false;
+	conn->read_ahead.size = size;
+	return true;
+}
+
+static inline void
+tds_socket_quickack(TDSCONNECTION * conn TDS_UNUSED)
+{
+#if defined(TCP_QUICKACK)
+	/* the system can turn off quick acknowledgements, enable them again */
+	if (conn->quickack) {
+		int opt = 1;
+		setsockopt(conn->s, SOL_TCP, TCP_QUICKACK, (const void *) &opt, sizeof(opt));
+	}
+#endif
+}
+
+static inline ptrdiff_t
+tds_socket_recv(TDSCONNECTION * conn, unsigned char *buf, size_t buflen)
+{
+#ifdef TDS_HAVE_KTLS
+	if (conn->ktls_rx)
+		return tds_ktls_recv(conn, buf, buflen);
+#endif
+	return READSOCKET(conn->s, buf, buflen);
+}
+
 static ptrdiff_t
 tds_socket_read(TDSCONNECTION * conn, TDSSOCKET *tds, unsigned char *buf, size_t buflen)
 {
 	ptrdiff_t len;
 	int err;
 
+	/* return data already read */
+	if (conn->read_ahead.pos < conn->read_ahead.len)
+		return tds_read_ahead_get(conn, buf, buflen);
+
 #if ENABLE_EXTRA_CHECKS
 	/* this simulate the fact that recv can return less bytes */
 	if (buflen >= 5) {
@@ -722,10 +918,23 @@ tds_socket_read(TDSCONNECTION * conn, TDSSOCKET *tds, unsigned char *buf, size_t
 	}
 #endif
 
-	/* read directly from socket*/
-	len = READSOCKET(conn->s, buf, buflen);
-	if (len > 0)
-		return len;
+	/* read as much as possible, small reads are served from read-ahead buffer */
+	if (buflen < conn->read_ahead.size) {
+		len = tds_socket_recv(conn, conn->read_ahead.buf, conn->read_ahead.size);
+		if (len > 0) {
+			conn->read_ahead.pos = 0;
+			conn->read_ahead.len = (unsigned) len;
+			tds_socket_quickack(conn);
+			return tds_read_ahead_get(conn, buf, buflen);
+		}
+	} else {
+		/* read directly from socket*/
+		len = tds_socket_recv(conn, buf, buflen);
+		if (len > 0) {
+			tds_socket_quickack(conn);
+			return len;
+		}
+	}
 
 	err = sock_errno;
 	if (len < 0 && TDSSOCK_WOULDBLOCK(err))
@@ -760,7 +969,7 @@ tds_socket_write(TDSCONNECTION *conn, TDSSOCKET *tds, const unsigned char *buf,
 #endif
 
 #ifdef USE_CORK
-	if (!conn->corked) {
+	if (!conn->corked && !conn->no_cork) {
 		int opt = 1;
 		setsockopt(conn->s, SOL_TCP, TCP_CORK, (const void *) &opt, sizeof(opt));
 		conn->corked = true;
@@ -790,6 +999,56 @@ tds_socket_write(TDSCONNECTION *conn, TDSSOCKET *tds, const unsigned char *buf,
 	return -1;
 }
 
+#ifdef USE_WRITEV
+/**
+ * Write multiple buffers to an OS socket
+ * @returns 0 if blocking, <0 error >0 bytes written
+ */
+static ptrdiff_t
+tds_socket_writev(TDSCONNECTION *conn, TDSSOCKET *tds, struct iovec *iov, int iovcnt)
+{
+	int err;
+	ptrdiff_t len;
+	char *errstr;
+#if !defined(SO_NOSIGPIPE)
+	struct msghdr msg;
+#endif
+
+#ifdef USE_CORK
+	if (!conn->corked && !conn->no_cork) {
+		int opt = 1;
+		setsockopt(conn->s, SOL_TCP, TCP_CORK, (const void *) &opt, sizeof(opt));
+		conn->corked = true;
+	}
+#endif
+
+#if defined(SO_NOSIGPIPE)
+	len = writev(conn->s, iov, iovcnt);
+#else
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovcnt;
+	len = sendmsg(conn->s, &msg, MSG_NOSIGNAL);
+#endif
+	if (len > 0)
+		return len;
+
+	err = sock_errno;
+	if (0 == len || TDSSOCK_WOULDBLOCK(err) || err == TDSSOCK_EINTR)
+		return 0;
+
+	assert(len < 0);
+
+	/* detect connection close */
+	errstr = sock_strerror(err);
+	tdsdump_log(TDS_DBG_NETWORK, "sendmsg(2) failed: %d (%s)\n", err, errstr);
+	sock_strerror_free(errstr);
+	tds_connection_close(conn);
+	tdserror(conn->tds_ctx, tds, TDSEWRIT, err);
+	return -1;
+}
+#endif /* USE_WRITEV */
+
 int
 tds_wakeup_init(TDSPOLLWAKEUP *wakeup)
 {
@@ -926,7 +1185,13 @@ tds_goodread(TDSSOCKET * tds, unsigned char *buf, size_t buflen)
 		}
 #endif
 		if (len > 0) {
-			len = tds_socket_read(tds->conn, tds, buf, buflen);
+#ifdef TDS_HAVE_IO_URING
+			/* io_uring cannot receive TLS control records */
+			if (tds->conn->uring && !tds->conn->ktls_rx)
+				len = tds_uring_recv(tds, buf, buflen);
+			else
+#endif
+				len = tds_socket_read(tds->conn, tds, buf, buflen);
 			if (len == 0)
 				continue;
 			return len;
@@ -959,7 +1224,7 @@ tds_connection_read(TDSSOCKET * tds, unsigned char *buf, size_t buflen)
 {
 	TDSCONNECTION *conn = tds->conn;
 
-	if (conn->tls_session)
+	if (conn->tls_session && !conn->ktls_rx)
 		return tds_ssl_read(conn, buf, buflen);
 
 #if ENABLE_ODBC_MARS
@@ -969,6 +1234,106 @@ tds_connection_read(TDSSOCKET * tds, unsigned char *buf, size_t buflen)
 #endif
 }
 
+/**
+ * Wait for the socket to be ready for writing.
+ * Timeouts are reported to the client which can decide to continue waiting.
+ * \return >0 socket ready, 0 should retry, <0 on failure (error already reported)
+ */
+static int
+tds_select_write(TDSSOCKET * tds)
+{
+	int rc = tds_select(tds, TDSSELWRITE, tds->query_timeout);
+
+	if (rc > 0)
+		return rc;
+
+	/* error */
+	if (rc < 0) {
+		int err = sock_errno;
+		char *errstr;
+
+		if (TDSSOCK_WOULDBLOCK(err)) /* shouldn't happen, but OK, retry */
+			return 0;
+		errstr = sock_strerror(err);
+		tdsdump_log(TDS_DBG_NETWORK, "select(2) failed: %d (%s)\n", err, errstr);
+		sock_strerror_free(errstr);
+		tds_connection_close(tds->conn);
+		tdserror(tds_get_ctx(tds), tds, TDSEWRIT, err);
+		return -1;
+	}
+
+	/* timeout */
+	tdsdump_log(TDS_DBG_NETWORK, "tds_goodwrite(): timed out, asking client\n");
+	switch (tdserror(tds_get_ctx(tds), tds, TDSETIME, sock_errno)) {
+	case TDS_INT_CONTINUE:
+		return 0;
+	default:
+	case TDS_INT_CANCEL:
+		tds_close_socket(tds);
+		return -1;
+	}
+}
+
+#if (defined(USE_WRITEV) && !ENABLE_ODBC_MARS) || defined(TDS_HAVE_IO_URING)
+/* skip the first len bytes of buffers */
+static void
+tds_iov_advance(struct iovec **p_iov, int *p_iovcnt, size_t len)
+{
+	struct iovec *iov = *p_iov;
+	int iovcnt = *p_iovcnt;
+
+	/* skip buffers fully written */
+	while (iovcnt > 0 && len >= iov->iov_len) {
+		len -= iov->iov_len;
+		++iov;
+		--iovcnt;
+	}
+	if (iovcnt > 0) {
+		iov->iov_base = (char *) iov->iov_base + len;
+		iov->iov_len -= len;
+	}
+	*p_iov = iov;
+	*p_iovcnt = iovcnt;
+}
+#endif
+
+#ifdef TDS_HAVE_IO_URING
+/**
+ * Write all buffers using io_uring, similar to tds_goodwrite.
+ * \return length written (>0), <0 on failure
+ */
+static ptrdiff_t
+tds_uring_goodwritev(TDSSOCKET * tds, struct iovec *iov, int iovcnt)
+{
+	ptrdiff_t len;
+	size_t sent = 0;
+
+	while (iovcnt > 0) {
+		if (!tds_uring_post_send(tds->conn, iov, iovcnt)) {
+			tds_connection_close(tds->conn);
+			tdserror(tds_get_ctx(tds), tds, TDSEWRIT, ENOBUFS);
+			return -1;
+		}
+
+		/* wait send completion */
+		do {
+			len = tds_select_write(tds);
+			if (len < 0)
+				return -1;
+		} while (!(len & POLLOUT));
+
+		len = tds_uring_send_result(tds);
+		if (len < 0)
+			return len;
+
+		sent += len;
+		tds_iov_advance(&iov, &iovcnt, len);
+	}
+
+	return sent;
+}
+#endif
+
 /**
  * \param tds the famous socket
  * \param buffer data to send
@@ -984,50 +1349,68 @@ tds_goodwrite(TDSSOCKET * tds, const unsigned char *buffer, size_t buflen)
 
 	assert(tds && buffer);
 
+#ifdef TDS_HAVE_IO_URING
+	if (tds->conn->uring) {
+		struct iovec iov;
+
+		iov.iov_base = (void *) buffer;
+		iov.iov_len = buflen;
+		return tds_uring_goodwritev(tds, &iov, 1);
+	}
+#endif
+
 	while (sent < buflen) {
 		/* TODO if send buffer is full we block receive !!! */
-		len = tds_select(tds, TDSSELWRITE, tds->query_timeout);
+		len = tds_select_write(tds);
+		if (len < 0)
+			return -1;
+		if (len == 0)
+			continue;
 
-		if (len > 0) {
-			len = tds_socket_write(tds->conn, tds, buffer + sent, buflen - sent);
-			if (len == 0)
-				continue;
-			if (len < 0)
-				return len;
+		len = tds_socket_write(tds->conn, tds, buffer + sent, buflen - sent);
+		if (len < 0)
+			return len;
 
-			sent += len;
-			continue;
-		}
+		sent += len;
+	}
 
-		/* error */
-		if (len < 0) {
-			int err = sock_errno;
-			char *errstr;
+	return (int) sent;
+}
 
-			if (TDSSOCK_WOULDBLOCK(err)) /* shouldn't happen, but OK, retry */
-				continue;
-			errstr = sock_strerror(err);
-			tdsdump_log(TDS_DBG_NETWORK, "select(2) failed: %d (%s)\n", err, errstr);
-			sock_strerror_free(errstr);
-			tds_connection_close(tds->conn);
-			tdserror(tds_get_ctx(tds), tds, TDSEWRIT, err);
-			return -1;
-		}
+#if defined(USE_WRITEV) && !ENABLE_ODBC_MARS
+/**
+ * Write all buffers, similar to tds_goodwrite.
+ * \return length written (>0), <0 on failure
+ */
+static ptrdiff_t
+tds_goodwritev(TDSSOCKET * tds, struct iovec *iov, int iovcnt)
+{
+	ptrdiff_t len;
+	size_t sent = 0;
 
-		/* timeout */
-		tdsdump_log(TDS_DBG_NETWORK, "tds_goodwrite(): timed out, asking client\n");
-		switch (tdserror(tds_get_ctx(tds), tds, TDSETIME, sock_errno)) {
-		case TDS_INT_CONTINUE:
-			break;
-		default:
-		case TDS_INT_CANCEL:
-			tds_close_socket(tds);
+#ifdef TDS_HAVE_IO_URING
+	if (tds->conn->uring)
+		return tds_uring_goodwritev(tds, iov, iovcnt);
+#endif
+
+	while (iovcnt > 0) {
+		len = tds_select_write(tds);
+		if (len < 0)
 			return -1;
-		}
+		if (len == 0)
+			continue;
+
+		len = tds_socket_writev(tds->conn, tds, iov, iovcnt);
+		if (len < 0)
+			return len;
+
+		sent += len;
+		tds_iov_advance(&iov, &iovcnt, len);
 	}
 
-	return (int) sent;
+	return sent;
 }
+#endif
 
 void
 tds_connection_coalesce(TDSSOCKET *tds TDS_UNUSED)
@@ -1035,7 +1418,7 @@ tds_connection_coalesce(TDSSOCKET *tds TDS_UNUSED)
 #ifdef USE_CORK
 	TDSCONNECTION *conn = tds->conn;
 
-	if (!conn->corked) {
+	if (!conn->corked && !conn->no_cork) {
 		int opt = 1;
 		setsockopt(conn->s, SOL_TCP, TCP_CORK, (const void *) &opt, sizeof(opt));
 		conn->corked = true;
@@ -1072,7 +1455,7 @@ tds_connection_write(TDSSOCKET *tds, const unsigned char *buf, size_t buflen, in
 	}
 #endif
 
-	if (conn->tls_session)
+	if (conn->tls_session && !conn->ktls_tx)
 		sent = tds_ssl_write(conn, buf, buflen);
 	else
 #if ENABLE_ODBC_MARS
@@ -1093,6 +1476,91 @@ tds_connection_write(TDSSOCKET *tds, const unsigned char *buf, size_t buflen, in
 	return sent;
 }
 
+/**
+ * Write a list of packets to the server.
+ * When possible packets are gathered and sent using a single system call.
+ * \tds
+ * \param packets      packets to send
+ * \param num_packets  number of packets in the array
+ * \param skip         bytes of the first packet already sent
+ * \param final        1 if the last packet of the array ends the message, else 0
+ * \return length written (>=0), <0 on failure.
+ *         Under MARS the function does not wait so it can write only part of the data.
+ */
+ptrdiff_t
+tds_connection_write_packets(TDSSOCKET *tds, TDSPACKET *const *packets, unsigned num_packets, unsigned skip, int final)
+{
+	const TDSPACKET *pkt;
+	ptrdiff_t sent;
+	unsigned n;
+#ifdef USE_WRITEV
+	struct iovec iov[TDS_MAX_IOVEC];
+	int iovcnt;
+	size_t total;
+#endif
+
+	assert(packets && num_packets > 0);
+
+#ifdef USE_WRITEV
+	if (!tds->conn->tls_session || tds->conn->ktls_tx) {
+		sent = 0;
+		do {
+			ptrdiff_t len;
+			int last;
+
+			iovcnt = 0;
+			total = 0;
+			for (; num_packets && iovcnt < TDS_MAX_IOVEC; ++packets, --num_packets) {
+				pkt = *packets;
+				iov[iovcnt].iov_base = (void *) (pkt->buf + skip);
+				iov[iovcnt].iov_len = tds_packet_get_data_start(pkt) + pkt->data_len - skip;
+				total += iov[iovcnt].iov_len;
+				++iovcnt;
+				skip = 0;
+			}
+			last = final && !num_packets;
+
+#if ENABLE_ODBC_MARS
+			len = tds_socket_writev(tds->conn, tds, iov, iovcnt);
+#else
+			len = tds_goodwritev(tds, iov, iovcnt);
+#endif
+			if (len < 0)
+				return len;
+			sent += len;
+
+			/* force packet flush */
+			if (last && (size_t) len >= total)
+				tds_connection_flush(tds);
+#if ENABLE_ODBC_MARS
+			/* do not wait socket, caller will send remaining data */
+			break;
+#endif
+		} while (num_packets);
+		return sent;
+	}
+#endif
+
+	/* send packets one by one */
+	sent = 0;
+	for (n = 0; n < num_packets; ++n) {
+		size_t len;
+		ptrdiff_t res;
+
+		pkt = packets[n];
+		len = tds_packet_get_data_start(pkt) + pkt->data_len - skip;
+		res = tds_connection_write(tds, pkt->buf + skip, len, final && n + 1 == num_packets);
+		if (res < 0)
+			return res;
+		sent += res;
+		/* partial write, caller will send remaining data */
+		if ((size_t) res < len)
+			break;
+		skip = 0;
+	}
+	return sent;
+}
+
 /**
  * Get port of all instances
  * @return default port number or 0 if error
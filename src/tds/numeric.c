@@ -58,6 +58,115 @@ const uint8_t tds_numeric_bytes_per_prec[] = {
 TDS_COMPILE_CHECK(maxprecision,
 	MAXPRECISION < TDS_VECTOR_SIZE(tds_numeric_bytes_per_prec) );
 
+/*
+ * Numbers with precision up to 38 (the maximum for MSSQL) fit in
+ * a 128-bit integer, use it if the compiler supports it.
+ * Other numbers use the generic code working on arrays.
+ */
+#undef USE_NUMERIC_128
+#if defined(__GNUC__) && SIZEOF___INT128 > 0
+#define USE_NUMERIC_128 1
+#define NUMERIC_128_MAX_PREC 38
+
+typedef unsigned __int128 tds_uint128;
+
+static const uint64_t pow10_64[20] = {
+	UINT64_C(1), UINT64_C(10), UINT64_C(100), UINT64_C(1000), UINT64_C(10000),
+	UINT64_C(100000), UINT64_C(1000000), UINT64_C(10000000), UINT64_C(100000000),
+	UINT64_C(1000000000), UINT64_C(10000000000), UINT64_C(100000000000),
+	UINT64_C(1000000000000), UINT64_C(10000000000000), UINT64_C(100000000000000),
+	UINT64_C(1000000000000000), UINT64_C(10000000000000000), UINT64_C(100000000000000000),
+	UINT64_C(1000000000000000000), UINT64_C(10000000000000000000)
+};
+
+/** 10^n, n <= 38 */
+static inline tds_uint128
+pow10_128(unsigned n)
+{
+	if (n < 20)
+		return pow10_64[n];
+	return (tds_uint128) pow10_64[19] * pow10_64[n - 19];
+}
+
+/** Get absolute value of a numeric with precision <= 38 */
+static inline tds_uint128
+numeric_get_128(const TDS_NUMERIC * numeric)
+{
+	const unsigned char *p = numeric->array + 1;
+	const unsigned char *const end = numeric->array + tds_numeric_bytes_per_prec[numeric->precision];
+	tds_uint128 n = 0;
+
+	for (; end - p >= 4; p += 4)
+		n = (n << 32) | TDS_GET_UA4BE(p);
+	for (; p != end; ++p)
+		n = (n << 8) | *p;
+	return n;
+}
+
+/** Set absolute value of a numeric with precision <= 38, precision must be already set */
+static inline void
+numeric_put_128(TDS_NUMERIC * numeric, tds_uint128 n)
+{
+	unsigned char *const start = numeric->array + 1;
+	unsigned char *p = numeric->array + tds_numeric_bytes_per_prec[numeric->precision];
+
+	for (; p - start >= 4; p -= 4, n >>= 32)
+		TDS_PUT_UA4BE(p - 4, (uint32_t) n);
+	for (; p != start; n >>= 8)
+		*--p = (unsigned char) n;
+}
+
+/** Append decimal digits to a number, 19 digits at a time */
+static inline tds_uint128
+numeric_add_digits(tds_uint128 num, const char *p, size_t len)
+{
+	while (len) {
+		size_t i, n = TDS_MIN(len, 19);
+		uint64_t chunk = 0;
+
+		for (i = 0; i < n; ++i)
+			chunk = chunk * 10u + (unsigned) (p[i] - '0');
+		num = num * pow10_64[n] + chunk;
+		p += n;
+		len -= n;
+	}
+	return num;
+}
+
+static const char digit_pairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+/**
+ * Write decimal digits of a number before \a end.
+ * \param min_digits  pad with zeroes up to this number of digits
+ * \return pointer to first digit
+ */
+static inline char *
+numeric_digits_64(uint64_t n, char *end, int min_digits)
+{
+	char *const stop = end - min_digits;
+
+	while (n >= 100u) {
+		const char *pair = &digit_pairs[(n % 100u) * 2];
+
+		n /= 100u;
+		*--end = pair[1];
+		*--end = pair[0];
+	}
+	if (n >= 10u) {
+		*--end = digit_pairs[n * 2 + 1];
+		*--end = digit_pairs[n * 2];
+	} else if (n) {
+		*--end = (char) ('0' + n);
+	}
+	while (end > stop)
+		*--end = '0';
+	return end;
+}
+#endif
+
 /*
  * money is a special case of numeric really...that why its here
  */
@@ -120,6 +229,49 @@ tds_numeric_to_string(const TDS_NUMERIC * numeric, char *s)
 	if (numeric->array[0] == 1)
 		*s++ = '-';
 
+#ifdef USE_NUMERIC_128
+	if (numeric->precision <= NUMERIC_128_MAX_PREC) {
+		tds_uint128 num = numeric_get_128(numeric);
+
+		if (num < pow10_128(38)) {
+			char digits[38];
+			char *const digits_end = digits + TDS_VECTOR_SIZE(digits);
+			const char *d;
+			size_t len;
+
+			/* split in 10^19 chunks, each fits in 64 bit */
+			if ((uint64_t) (num >> 64) == 0) {
+				d = numeric_digits_64((uint64_t) num, digits_end, 0);
+			} else {
+				uint64_t high = (uint64_t) (num / pow10_64[19]);
+
+				d = numeric_digits_64((uint64_t) num - high * pow10_64[19], digits_end, 19);
+				d = numeric_digits_64(high, (char *) d, 0);
+			}
+			len = digits_end - d;
+
+			if (len <= numeric->scale) {
+				*s++ = '0';
+				if (numeric->scale) {
+					*s++ = '.';
+					memset(s, '0', numeric->scale - len);
+					s += numeric->scale - len;
+				}
+			} else {
+				memcpy(s, d, len - numeric->scale);
+				s += len - numeric->scale;
+				d += len - numeric->scale;
+				len = numeric->scale;
+				if (len)
+					*s++ = '.';
+			}
+			memcpy(s, d, len);
+			s[len] = 0;
+			return 1;
+		}
+	}
+#endif
+
 	/* put number in a 16bit array */
 	number = numeric->array;
 	num_bytes = tds_numeric_bytes_per_prec[numeric->precision];
@@ -328,6 +480,27 @@ tds_numeric_change_prec_scale(TDS_NUMERIC * numeric, unsigned char new_prec, uns
 		return sizeof(TDS_NUMERIC);
 	}
 
+#ifdef USE_NUMERIC_128
+	if (numeric->precision <= NUMERIC_128_MAX_PREC && new_prec <= NUMERIC_128_MAX_PREC) {
+		tds_uint128 num = numeric_get_128(numeric);
+
+		if (scale_diff >= 0) {
+			/* check overflow before multiply */
+			if (num >= pow10_128(new_prec - scale_diff))
+				return TDS_CONVERT_OVERFLOW;
+			num *= pow10_128(scale_diff);
+		} else {
+			num /= pow10_128(-scale_diff);
+			if (num >= pow10_128(new_prec))
+				return TDS_CONVERT_OVERFLOW;
+		}
+		numeric->precision = new_prec;
+		numeric->scale = new_scale;
+		numeric_put_128(numeric, num);
+		return sizeof(TDS_NUMERIC);
+	}
+#endif
+
 	/* package number */
 	bytes = tds_numeric_bytes_per_prec[numeric->precision] - 1;
 	i = 0;
@@ -446,3 +619,137 @@ tds_numeric_change_prec_scale(TDS_NUMERIC * numeric, unsigned char new_prec, uns
 	return sizeof(TDS_NUMERIC);
 }
 
+
+/**
+ * Set a numeric from its decimal digits if possible without generic code.
+ * Sign, precision and scale must be already set and digits must fit.
+ * \param integer       digits of the integer part
+ * \param digits        number of integer digits
+ * \param decimals      digits of the decimal part
+ * \param num_decimals  number of decimal digits, not more than scale
+ * \return true if set, false if caller must compute the number
+ */
+bool
+tds_numeric_set_digits(TDS_NUMERIC * numeric, const char *integer, size_t digits,
+		       const char *decimals, size_t num_decimals)
+{
+#ifdef USE_NUMERIC_128
+	tds_uint128 num;
+
+	if (numeric->precision > NUMERIC_128_MAX_PREC)
+		return false;
+
+	num = numeric_add_digits(0, integer, digits);
+	num = numeric_add_digits(num, decimals, num_decimals);
+	num *= pow10_128(numeric->scale - num_decimals);
+
+	memset(numeric->array + 1, 0, sizeof(numeric->array) - 1);
+	numeric_put_128(numeric, num);
+	return true;
+#else
+	return false;
+#endif
+}
+
+/* compare absolute values using their string representation */
+static int
+numeric_abs_cmp_generic(const TDS_NUMERIC * a, const TDS_NUMERIC * b)
+{
+	char sa[MAXPRECISION + 4], sb[MAXPRECISION + 4];
+	const char *pa = sa, *pb = sb;
+	size_t ia, ib;
+	int res;
+
+	tds_numeric_to_string(a, sa);
+	tds_numeric_to_string(b, sb);
+	pa += (*pa == '-');
+	pb += (*pb == '-');
+
+	/* longer integer part is bigger */
+	ia = strcspn(pa, ".");
+	ib = strcspn(pb, ".");
+	if (ia != ib)
+		return ia < ib ? -1 : 1;
+	res = memcmp(pa, pb, ia);
+	if (res)
+		return res < 0 ? -1 : 1;
+
+	/* compare decimals, missing ones are zeroes */
+	pa += ia + (pa[ia] == '.');
+	pb += ib + (pb[ib] == '.');
+	while (*pa || *pb) {
+		char ca = *pa ? *pa++ : '0';
+		char cb = *pb ? *pb++ : '0';
+
+		if (ca != cb)
+			return ca < cb ? -1 : 1;
+	}
+	return 0;
+}
+
+static int
+numeric_abs_cmp(const TDS_NUMERIC * a, const TDS_NUMERIC * b)
+{
+#ifdef USE_NUMERIC_128
+	if (a->precision <= NUMERIC_128_MAX_PREC && b->precision <= NUMERIC_128_MAX_PREC) {
+		tds_uint128 na = numeric_get_128(a), nb = numeric_get_128(b);
+		const tds_uint128 max = ~(tds_uint128) 0;
+
+		/* bring to same scale, if multiply overflows number is bigger */
+		if (a->scale < b->scale) {
+			const tds_uint128 factor = pow10_128(b->scale - a->scale);
+
+			if (na > max / factor)
+				return 1;
+			na *= factor;
+		} else if (a->scale > b->scale) {
+			const tds_uint128 factor = pow10_128(a->scale - b->scale);
+
+			if (nb > max / factor)
+				return -1;
+			nb *= factor;
+		}
+		return na < nb ? -1 : na > nb;
+	}
+#endif
+	return numeric_abs_cmp_generic(a, b);
+}
+
+static bool
+numeric_is_zero(const TDS_NUMERIC * numeric)
+{
+	unsigned i, bytes = tds_numeric_bytes_per_prec[numeric->precision];
+
+	for (i = 1; i < bytes; ++i)
+		if (numeric->array[i])
+			return false;
+	return true;
+}
+
+/**
+ * Compare two numeric values, scales can be different.
+ * \param[out] result -1, 0 or 1 if \a a is less, equal or greater than \a b
+ * \return 0 or TDS_CONVERT_FAIL if a number is not valid
+ */
+TDS_INT
+tds_numeric_cmp(const TDS_NUMERIC * a, const TDS_NUMERIC * b, int *result)
+{
+	bool neg_a, neg_b;
+	int res;
+
+	if (a->precision < 1 || a->precision > MAXPRECISION || a->scale > a->precision
+	    || b->precision < 1 || b->precision > MAXPRECISION || b->scale > b->precision)
+		return TDS_CONVERT_FAIL;
+
+	/* -0 is equal to 0 */
+	neg_a = a->array[0] == 1 && !numeric_is_zero(a);
+	neg_b = b->array[0] == 1 && !numeric_is_zero(b);
+	if (neg_a != neg_b) {
+		*result = neg_a ? -1 : 1;
+		return 0;
+	}
+
+	res = numeric_abs_cmp(a, b);
+	*result = neg_a ? -res : res;
+	return 0;
+}
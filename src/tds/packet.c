@@ -39,6 +39,10 @@
 #include <unistd.h>
 #endif /* HAVE_UNISTD_H */
 
+#if HAVE_LIMITS_H
+#include <limits.h>
+#endif /* HAVE_LIMITS_H */
+
 #include <freetds/tds.h>
 #include <freetds/bytes.h>
 #include <freetds/iconv.h>
@@ -56,70 +60,206 @@ static TDSRET tds_update_recv_wnd(TDSSOCKET *tds, TDS_UINT new_recv_wnd);
 static int tds_packet_write(TDSCONNECTION *conn);
 #endif
 
+/* compute pool size class of a packet with given capacity */
+static unsigned
+tds_packet_pool_class(unsigned capacity)
+{
+	unsigned cls = 0;
+
+	capacity >>= 10;
+	while (capacity && cls < TDS_PACKET_POOL_CLASSES - 1) {
+		capacity >>= 1;
+		++cls;
+	}
+	return cls;
+}
+
 /* get packet from the cache */
 static TDSPACKET *
 tds_get_packet(TDSCONNECTION *conn, unsigned len)
 {
-	TDSPACKET *packet, *to_free = NULL;
-
-	tds_mutex_lock(&conn->list_mtx);
-	while ((packet = conn->packet_cache) != NULL) {
-		--conn->num_cached_packets;
-		conn->packet_cache = packet->next;
-
-		/* return it */
-		if (packet->capacity >= len) {
-			TDS_MARK_UNDEFINED(packet->buf, packet->capacity);
-			packet->next = NULL;
-			tds_packet_zero_data_start(packet);
-			packet->data_len = 0;
-			packet->sid = 0;
+	TDSPACKETPOOL *pool = conn->packet_pool;
+	TDSPACKET *packet = NULL, **p_packet;
+	unsigned cls = tds_packet_pool_class(len);
+
+	tds_mutex_lock(&pool->mtx);
+	/* in the first class we must check the capacity, next classes contain only bigger packets */
+	for (p_packet = &pool->packets[cls]; *p_packet; p_packet = &(*p_packet)->next)
+		if ((*p_packet)->capacity >= len)
 			break;
-		}
-
-		/* discard packet if too small */
-		packet->next = to_free;
-		to_free = packet;
+	while (!*p_packet && ++cls < TDS_PACKET_POOL_CLASSES)
+		p_packet = &pool->packets[cls];
+
+	if (*p_packet) {
+		packet = *p_packet;
+		*p_packet = packet->next;
+		--pool->num_packets[cls];
+		--pool->stats.cached;
+		++pool->stats.hits;
+	} else {
+		++pool->stats.misses;
 	}
-	tds_mutex_unlock(&conn->list_mtx);
+	tds_mutex_unlock(&pool->mtx);
 
-	if (to_free)
-		tds_free_packets(to_free);
-
-	if (!packet)
-		packet = tds_alloc_packet(NULL, len);
+	/* return it */
+	if (packet) {
+		TDS_MARK_UNDEFINED(packet->buf, packet->capacity);
+		packet->next = NULL;
+		tds_packet_zero_data_start(packet);
+		packet->data_len = 0;
+		packet->sid = 0;
+		return packet;
+	}
 
-	return packet;
+	return tds_alloc_packet(NULL, len);
 }
 
-/* append packets in cached list. must have the lock! */
+/* append packets in cached list */
 static void
 tds_packet_cache_add(TDSCONNECTION *conn, TDSPACKET *packet)
 {
-	TDSPACKET *last;
-	unsigned count = 1;
+	TDSPACKETPOOL *pool;
+	TDSPACKET *next, *to_free = NULL;
 
 	assert(conn && packet);
-	tds_mutex_check_owned(&conn->list_mtx);
-
-	if (conn->num_cached_packets >= 8) {
-		tds_free_packets(packet);
-		return;
-	}
 
-	for (last = packet; last->next; last = last->next)
-		++count;
+	pool = conn->packet_pool;
+	tds_mutex_lock(&pool->mtx);
+	for (; packet; packet = next) {
+		unsigned cls = tds_packet_pool_class(packet->capacity);
 
-	last->next = conn->packet_cache;
-	conn->packet_cache = packet;
-	conn->num_cached_packets += count;
+		next = packet->next;
+		if (pool->num_packets[cls] >= pool->max_packets) {
+			packet->next = to_free;
+			to_free = packet;
+			++pool->stats.discards;
+			continue;
+		}
+		packet->next = pool->packets[cls];
+		pool->packets[cls] = packet;
+		++pool->num_packets[cls];
+		++pool->stats.cached;
+	}
 
 #if ENABLE_EXTRA_CHECKS
-	count = 0;
-	for (packet = conn->packet_cache; packet; packet = packet->next)
-		++count;
-	assert(count == conn->num_cached_packets);
+	{
+		unsigned cls, count, total = 0;
+
+		for (cls = 0; cls < TDS_PACKET_POOL_CLASSES; ++cls) {
+			count = 0;
+			for (packet = pool->packets[cls]; packet; packet = packet->next) {
+				assert(tds_packet_pool_class(packet->capacity) == cls);
+				++count;
+			}
+			assert(count == pool->num_packets[cls]);
+			total += count;
+		}
+		assert(total == pool->stats.cached);
+	}
 #endif
+	tds_mutex_unlock(&pool->mtx);
+
+	tds_free_packets(to_free);
+}
+
+/**
+ * Set the high-water mark of a packet pool, that is the maximum number
+ * of unused packets kept for each size class.
+ * Packets exceeding the new limit are freed.
+ */
+void
+tds_set_packet_pool_size(TDSPACKETPOOL *pool, unsigned max_packets)
+{
+	TDSPACKET *to_free = NULL, *packet;
+	unsigned cls;
+
+	tds_mutex_lock(&pool->mtx);
+	pool->max_packets = max_packets;
+	for (cls = 0; cls < TDS_PACKET_POOL_CLASSES; ++cls) {
+		while (pool->num_packets[cls] > max_packets) {
+			packet = pool->packets[cls];
+			pool->packets[cls] = packet->next;
+			packet->next = to_free;
+			to_free = packet;
+			--pool->num_packets[cls];
+			--pool->stats.cached;
+			++pool->stats.discards;
+		}
+	}
+	tds_mutex_unlock(&pool->mtx);
+
+	tds_free_packets(to_free);
+}
+
+/**
+ * Set the high-water mark of the packet pool used by a connection.
+ * A pool shared with the context or other connections is left untouched,
+ * the connection gets its own pool instead.
+ * \return false if a new pool could not be allocated
+ */
+bool
+tds_connection_set_packet_pool_size(TDSCONNECTION *conn, unsigned max_packets)
+{
+	TDSPACKETPOOL *pool = conn->packet_pool;
+	unsigned ref_count, cur_max;
+
+	tds_mutex_lock(&pool->mtx);
+	ref_count = pool->ref_count;
+	cur_max = pool->max_packets;
+	tds_mutex_unlock(&pool->mtx);
+
+	if (cur_max == max_packets)
+		return true;
+
+	if (ref_count == 1) {
+		tds_set_packet_pool_size(pool, max_packets);
+		return true;
+	}
+
+	/* packets allocated from the shared pool will be released to the new one */
+	if ((pool = tds_alloc_packet_pool()) == NULL)
+		return false;
+	pool->max_packets = max_packets;
+	tds_release_packet_pool(conn->packet_pool);
+	conn->packet_pool = pool;
+	return true;
+}
+
+/**
+ * Retrieve usage counters of a packet pool.
+ */
+void
+tds_get_packet_pool_stats(TDSPACKETPOOL *pool, TDSPACKETPOOLSTATS *stats)
+{
+	tds_mutex_lock(&pool->mtx);
+	*stats = pool->stats;
+	tds_mutex_unlock(&pool->mtx);
+}
+
+/* keep current packet, referenced by borrowed column data, till next row */
+static void
+tds_keep_borrowed_packet(TDSSOCKET *tds)
+{
+	tds->recv_packet->next = tds->borrowed_packets;
+	tds->borrowed_packets = tds->recv_packet;
+	tds->recv_packet = NULL;
+	tds->packet_borrowed = false;
+}
+
+/**
+ * Release packets kept for data borrowed by columns.
+ * Called before reading a new row, borrowed data are no longer valid.
+ * \tds
+ */
+void
+tds_release_borrowed_packets(TDSSOCKET *tds)
+{
+	tds->borrow_data = false;
+	tds->packet_borrowed = false;
+	if (tds->borrowed_packets) {
+		tds_packet_cache_add(tds->conn, tds->borrowed_packets);
+		tds->borrowed_packets = NULL;
+	}
 }
 
 #if ENABLE_ODBC_MARS
@@ -258,8 +398,14 @@ tds_packet_read(TDSCONNECTION *conn, TDSSOCKET *tds)
 	}
 	return false;
 
-Memory_Error:
 Severe_Error:
+	tds_connection_close(conn);
+	/* packet could be referenced by a session, see tds_read_partial_packet() */
+	packet->data_len = 8;
+	conn->recv_pos = 0;
+	return false;
+
+Memory_Error:
 	tds_connection_close(conn);
 	tds_free_packets(packet);
 	conn->recv_packet = NULL;
@@ -330,6 +476,41 @@ tds_append_cancel(TDSSOCKET *tds)
 	return TDS_SUCCESS;
 }
 
+/* move the packet just read to the session it belongs to */
+static void
+tds_packet_dispatch(TDSCONNECTION *conn)
+{
+	TDSPACKET *packet = conn->recv_packet;
+	TDSSOCKET *s;
+
+	conn->recv_packet = NULL;
+	conn->recv_pos = 0;
+
+	tdsdump_dump_buf(TDS_DBG_NETWORK, "Received packet", packet->buf, packet->data_start + packet->data_len);
+
+	tds_mutex_lock(&conn->list_mtx);
+	if (packet->sid < conn->num_sessions) {
+		s = conn->sessions[packet->sid];
+		if (TDSSOCKET_VALID(s)) {
+			/* append to correct session */
+			if (packet->buf[0] == TDS72_SMP && packet->buf[1] != TDS_SMP_DATA) {
+				tds_packet_cache_add(conn, packet);
+			} else {
+				if (packet->buf[packet->data_start + 1] & TDS_STATUS_EOM)
+					++s->recv_eom;
+				tds_append_packet(&conn->packets, packet);
+			}
+			packet = NULL;
+			/* notify */
+			tds_cond_signal(&s->packet_cond);
+		}
+	}
+	tds_mutex_unlock(&conn->list_mtx);
+	tds_free_packets(packet);
+}
+
+/* value for send parameter of tds_connection_network() to return as soon as some data are received */
+#define TDS_NET_PARTIAL 2
 
 static void
 tds_connection_network(TDSCONNECTION *conn, TDSSOCKET *tds, int send)
@@ -369,58 +550,28 @@ tds_connection_network(TDSCONNECTION *conn, TDSSOCKET *tds, int send)
 		 */
 		/* something to send */
 		if (conn->send_packets && (rc & POLLOUT) != 0) {
-			TDSSOCKET *s;
-
+			/* other sessions are signaled by tds_packet_write */
 			int sid = tds_packet_write(conn);
-			if (sid < 0)
-				continue;
 
 			if (sid == tds->sid)
 				break;	/* return to caller */
 
-			tds_mutex_lock(&conn->list_mtx);
-			if (sid < conn->num_sessions) {
-				s = conn->sessions[sid];
-				if (TDSSOCKET_VALID(s))
-					tds_cond_signal(&s->packet_cond);
-			}
-			tds_mutex_unlock(&conn->list_mtx);
 			/* avoid using a possible closed connection */
 			continue;
 		}
 
 		/* received */
 		if (rc & (POLLIN|POLLHUP)) {
-			TDSPACKET *packet;
-			TDSSOCKET *s;
-
 			/* try to read a packet */
-			if (!tds_packet_read(conn, tds))
+			if (!tds_packet_read(conn, tds)) {
+				/* return data of an incomplete packet if requested */
+				if (send == TDS_NET_PARTIAL && conn->recv_packet && conn->recv_pos > 8)
+					break;
 				continue;	/* packet not complete */
-			packet = conn->recv_packet;
-			conn->recv_packet = NULL;
-			conn->recv_pos = 0;
-
-			tdsdump_dump_buf(TDS_DBG_NETWORK, "Received packet", packet->buf, packet->data_start + packet->data_len);
-
-			tds_mutex_lock(&conn->list_mtx);
-			if (packet->sid < conn->num_sessions) {
-				s = conn->sessions[packet->sid];
-				if (TDSSOCKET_VALID(s)) {
-					/* append to correct session */
-					if (packet->buf[0] == TDS72_SMP && packet->buf[1] != TDS_SMP_DATA)
-						tds_packet_cache_add(conn, packet);
-					else
-						tds_append_packet(&conn->packets, packet);
-					packet = NULL;
-					/* notify */
-					tds_cond_signal(&s->packet_cond);
-				}
 			}
-			tds_mutex_unlock(&conn->list_mtx);
-			tds_free_packets(packet);
+			tds_packet_dispatch(conn);
 			/* if we are receiving return the packet */
-			if (!send) break;
+			if (!send || send == TDS_NET_PARTIAL) break;
 		}
 	}
 
@@ -428,17 +579,39 @@ tds_connection_network(TDSCONNECTION *conn, TDSSOCKET *tds, int send)
 	conn->in_net_tds = NULL;
 }
 
+/**
+ * Send a list of packets to the server.
+ * Packets are linked using next field and are all owned by the function.
+ */
 static TDSRET
 tds_connection_put_packet(TDSSOCKET *tds, TDSPACKET *packet)
 {
 	TDSCONNECTION *conn = tds->conn;
+	TDSPACKET *last;
 
 	CHECK_TDS_EXTRA(tds);
 
-	packet->sid = tds->sid;
+	for (last = packet;; last = last->next) {
+		last->sid = tds->sid;
+		if (!last->next)
+			break;
+	}
+
+	/* queue packets, the application will send them calling tds_process_events */
+	if (conn->nonblocking) {
+		if (IS_TDSDEAD(tds)) {
+			tds_free_packets(packet);
+			return TDS_FAIL;
+		}
+		tds_mutex_lock(&conn->list_mtx);
+		tds_append_packet(&conn->send_packets, packet);
+		tds_mutex_unlock(&conn->list_mtx);
+		return TDS_SUCCESS;
+	}
 
 	tds_mutex_lock(&conn->list_mtx);
-	tds->sending_packet = packet;
+	/* packets are sent in order so we need to wait just the last one */
+	tds->sending_packet = last;
 	while (tds->sending_packet) {
 		int wait_res;
 
@@ -449,26 +622,37 @@ tds_connection_put_packet(TDSSOCKET *tds, TDSPACKET *packet)
 
 		/* limit packet sending looking at sequence/window */
 		if (packet && (int32_t) (tds->send_seq - tds->send_wnd) < 0) {
-			/* prepare MARS header if needed */
-			if (tds->conn->mars) {
-				TDS72_SMP_HEADER *hdr;
-
-				/* fill SMP data */
-				hdr = (TDS72_SMP_HEADER *) packet->buf;
-				hdr->signature = TDS72_SMP;
-				hdr->type = TDS_SMP_DATA;
-				TDS_PUT_A2LE(&hdr->sid, packet->sid);
-				TDS_PUT_A4LE(&hdr->size, packet->data_start + packet->data_len);
-				++tds->send_seq;
-				TDS_PUT_A4LE(&hdr->seq, tds->send_seq);
-				/* this is the acknowledge we give to server to stop sending */
-				tds->recv_wnd = tds->recv_seq + 4;
-				TDS_PUT_A4LE(&hdr->wnd, tds->recv_wnd);
-			}
+			TDSPACKET **p_tail = &conn->send_packets;
+
+			while (*p_tail)
+				p_tail = &(*p_tail)->next;
+
+			do {
+				TDSPACKET *next = packet->next;
+
+				/* prepare MARS header if needed */
+				if (tds->conn->mars) {
+					TDS72_SMP_HEADER *hdr;
+
+					/* fill SMP data */
+					hdr = (TDS72_SMP_HEADER *) packet->buf;
+					hdr->signature = TDS72_SMP;
+					hdr->type = TDS_SMP_DATA;
+					TDS_PUT_A2LE(&hdr->sid, packet->sid);
+					TDS_PUT_A4LE(&hdr->size, packet->data_start + packet->data_len);
+					++tds->send_seq;
+					TDS_PUT_A4LE(&hdr->seq, tds->send_seq);
+					/* this is the acknowledge we give to server to stop sending */
+					tds->recv_wnd = tds->recv_seq + 4;
+					TDS_PUT_A4LE(&hdr->wnd, tds->recv_wnd);
+				}
 
-			/* append packet */
-			tds_append_packet(&conn->send_packets, packet);
-			packet = NULL;
+				/* append packet */
+				packet->next = NULL;
+				*p_tail = packet;
+				p_tail = &packet->next;
+				packet = next;
+			} while (packet && (int32_t) (tds->send_seq - tds->send_wnd) < 0);
 		}
 
 		/* network ok ? process network */
@@ -508,8 +692,362 @@ tds_connection_put_packet(TDSSOCKET *tds, TDSPACKET *packet)
 		return TDS_FAIL;
 	return TDS_SUCCESS;
 }
+
+/**
+ * Enable or disable non-blocking mode.
+ * In non-blocking mode packets are queued instead of being sent and
+ * tds_process_tokens() returns TDS_WOULD_BLOCK till the response is
+ * fully received. The application should wait for the events returned
+ * by tds_get_poll_events() (for instance using its own event loop) and
+ * call tds_process_events() when they are signaled.
+ * The whole response is buffered before being processed so memory used
+ * grows with the size of the response.
+ * Other functions reading from the server can still block.
+ * Only connections not using MARS can use this mode and it is available
+ * only in builds with MARS support.
+ * \tds
+ * \param nonblocking true to enable non-blocking mode
+ */
+TDSRET
+tds_set_nonblocking(TDSSOCKET *tds, bool nonblocking)
+{
+	TDSCONNECTION *conn = tds->conn;
+
+	if (nonblocking && conn->mars)
+		return TDS_FAIL;
+
+	tds_mutex_lock(&conn->list_mtx);
+	conn->nonblocking = nonblocking;
+	tds_mutex_unlock(&conn->list_mtx);
+	return TDS_SUCCESS;
+}
+
+/**
+ * Get socket and events to wait for in non-blocking mode.
+ * \tds
+ * \param events events to wait for (POLLIN and/or POLLOUT)
+ * \return socket to wait on
+ */
+TDS_SYS_SOCKET
+tds_get_poll_events(TDSSOCKET *tds, short *events)
+{
+	TDSCONNECTION *conn = tds->conn;
+
+	tds_mutex_lock(&conn->list_mtx);
+	*events = POLLIN;
+	if (conn->send_packets)
+		*events |= POLLOUT;
+	tds_mutex_unlock(&conn->list_mtx);
+	return conn->s;
+}
+
+/**
+ * Send queued packets and read received data without blocking.
+ * \tds
+ * \param revents events signaled on the socket returned by tds_get_poll_events()
+ * \return TDS_FAIL if the connection is closed
+ */
+TDSRET
+tds_process_events(TDSSOCKET *tds, short revents)
+{
+	TDSCONNECTION *conn = tds->conn;
+
+	tds_mutex_lock(&conn->list_mtx);
+	/* another thread is already handling the network */
+	if (conn->in_net_tds) {
+		tds_mutex_unlock(&conn->list_mtx);
+		return TDS_SUCCESS;
+	}
+	conn->in_net_tds = tds;
+	tds_mutex_unlock(&conn->list_mtx);
+
+	if ((revents & POLLOUT) != 0 && conn->send_packets)
+		tds_packet_write(conn);
+
+	/* read all packets available, TLS could have buffered data */
+	if ((revents & (POLLIN|POLLHUP|POLLERR)) != 0 || conn->tls_session) {
+		while (!TDS_IS_SOCKET_INVALID(conn->s)) {
+			unsigned recv_pos = conn->recv_pos;
+
+			if (tds_packet_read(conn, tds))
+				tds_packet_dispatch(conn);
+			else if (conn->recv_pos == recv_pos)
+				break;
+		}
+	}
+
+	tds_mutex_lock(&conn->list_mtx);
+	conn->in_net_tds = NULL;
+	tds_mutex_unlock(&conn->list_mtx);
+
+	return IS_TDSDEAD(tds) ? TDS_FAIL : TDS_SUCCESS;
+}
+
+/**
+ * Check whether the current response was fully received so
+ * tds_process_tokens() can process it without blocking.
+ * \tds
+ */
+bool
+tds_response_received(TDSSOCKET *tds)
+{
+	bool received;
+
+	if (IS_TDSDEAD(tds) || (tds->state != TDS_PENDING && tds->state != TDS_READING))
+		return true;
+
+	if (tds->in_pos < tds->in_len && !tds->in_partial && (tds->in_buf[1] & TDS_STATUS_EOM) != 0)
+		return true;
+
+	tds_mutex_lock(&tds->conn->list_mtx);
+	received = tds->recv_eom != 0;
+	tds_mutex_unlock(&tds->conn->list_mtx);
+	return received;
+}
+
+/* remove first packet received for the session, list_mtx must be locked */
+static TDSPACKET *
+tds_unlink_packet(TDSSOCKET *tds)
+{
+	TDSPACKET **p_packet, *packet;
+
+	for (p_packet = &tds->conn->packets; *p_packet; p_packet = &(*p_packet)->next)
+		if ((*p_packet)->sid == tds->sid)
+			break;
+
+	packet = *p_packet;
+	if (packet) {
+		*p_packet = packet->next;
+		packet->next = NULL;
+		if (packet->buf[packet->data_start + 1] & TDS_STATUS_EOM)
+			--tds->recv_eom;
+	}
+	return packet;
+}
+
+/* make packet the current input packet of the session, list_mtx must be locked */
+static void
+tds_set_recv_packet(TDSSOCKET *tds, TDSPACKET *packet)
+{
+	if (tds->packet_borrowed)
+		tds_keep_borrowed_packet(tds);
+	else
+		tds_packet_cache_add(tds->conn, tds->recv_packet);
+
+	tds->recv_packet = packet;
+	tds->in_buf = packet->buf + packet->data_start;
+	tds->in_len = packet->data_len;
+	tds->in_partial = 0;
+	++tds->in_packets;
+}
+
+/* stop referencing the packet partially received, owned by the connection */
+static void
+tds_drop_partial(TDSSOCKET *tds)
+{
+	if (tds->in_partial) {
+		tds->in_buf = tds->recv_packet->buf;
+		tds->in_pos = tds->in_len = tds->in_partial = 0;
+	}
+}
 #endif /* ENABLE_ODBC_MARS */
 
+#if !ENABLE_ODBC_MARS
+/**
+ * Read the header of a new packet.
+ * On success in_buf contains the header, in_pos and in_len point
+ * after it and in_partial is set to the length of the payload.
+ * \tds
+ * \return false on failure (the socket is closed)
+ */
+static bool
+tds_read_packet_header(TDSSOCKET * tds)
+{
+	unsigned char *pkt, *p, *end;
+	unsigned pktlen;
+
+	/* do not overwrite data borrowed by columns, receive in a new packet */
+	if (tds->packet_borrowed) {
+		TDSPACKET *packet = tds_get_packet(tds->conn, tds->recv_packet->capacity);
+
+		if (TDS_UNLIKELY(!packet)) {
+			tds_close_socket(tds);
+			return false;
+		}
+		tds_keep_borrowed_packet(tds);
+		tds->recv_packet = packet;
+		tds->in_buf = packet->buf;
+	}
+
+	pkt = tds->in_buf;
+	tds->in_len = 0;
+	tds->in_pos = 0;
+	tds->in_partial = 0;
+	for (p = pkt, end = p+8; p < end;) {
+		ptrdiff_t len = tds_connection_read(tds, p, end - p);
+		if (len <= 0) {
+			tds_close_socket(tds);
+			return false;
+		}
+		p += len;
+	}
+
+	pktlen = TDS_GET_A2BE(pkt+2);
+	/* packet must at least contains header */
+	if (TDS_UNLIKELY(pktlen < 8)) {
+		tds_close_socket(tds);
+		return false;
+	}
+	if (TDS_UNLIKELY(pktlen > tds->recv_packet->capacity)) {
+		TDSPACKET *packet = tds_realloc_packet(tds->recv_packet, pktlen);
+		if (TDS_UNLIKELY(!packet)) {
+			tds_close_socket(tds);
+			return false;
+		}
+		tds->recv_packet = packet;
+		tds->in_buf = packet->buf;
+	}
+
+	/* set the received packet type flag */
+	tds->in_flag = tds->in_buf[0];
+
+	tds->in_len = 8;
+	tds->in_pos = 8;
+	tds->in_partial = pktlen - 8;
+	++tds->in_packets;
+	if (!tds->in_partial)
+		tdsdump_dump_buf(TDS_DBG_NETWORK, "Received packet", tds->in_buf, tds->in_len);
+	return true;
+}
+
+/**
+ * Receive the remaining payload of current packet, appending it to in_buf.
+ * \tds
+ * \param wait_all true to wait for the entire packet, false to return
+ *        as soon as some data are available
+ * \return false on failure (the socket is closed)
+ */
+static bool
+tds_read_packet_rest(TDSSOCKET * tds, bool wait_all)
+{
+	do {
+		ptrdiff_t len = tds_connection_read(tds, tds->in_buf + tds->in_len, tds->in_partial);
+		if (len <= 0) {
+			tds_close_socket(tds);
+			return false;
+		}
+		tds->in_len += (unsigned) len;
+		tds->in_partial -= (unsigned) len;
+	} while (wait_all && tds->in_partial);
+
+	if (!tds->in_partial)
+		tdsdump_dump_buf(TDS_DBG_NETWORK, "Received packet", tds->in_buf, tds->in_len);
+	return true;
+}
+
+#endif /* !ENABLE_ODBC_MARS */
+
+/**
+ * Make some more data of the current packet available.
+ * If the connection allows it (see TDSCONNECTION::partial_packets)
+ * returns as soon as some payload is received so tokens can be decoded
+ * while the rest of the packet is still on the wire; in this case
+ * in_partial tells how many bytes of the packet are still missing.
+ * Otherwise behaves like tds_read_packet().
+ * \tds
+ * \return bytes available in in_buf or -1 on failure
+ */
+int
+tds_read_partial_packet(TDSSOCKET * tds)
+{
+#if ENABLE_ODBC_MARS
+	TDSCONNECTION *conn = tds->conn;
+	TDSPACKET *packet;
+
+	/* with MARS packets of different sessions are interleaved */
+	if (!conn->partial_packets || conn->mars)
+		return tds_read_packet(tds);
+
+	tds_mutex_lock(&conn->list_mtx);
+
+	for (;;) {
+		int wait_res;
+
+		if (IS_TDSDEAD(tds)) {
+			tdsdump_log(TDS_DBG_NETWORK, "Read attempt when state is TDS_DEAD\n");
+			break;
+		}
+
+		/* packet completely received, continue from current position if partially read */
+		packet = tds_unlink_packet(tds);
+		if (packet) {
+			if (!tds->in_partial)
+				tds->in_pos = 8;
+			tds_set_recv_packet(tds, packet);
+			tds_mutex_unlock(&conn->list_mtx);
+			tds->in_flag = tds->in_buf[0];
+			return tds->in_len;
+		}
+
+		/*
+		 * Some more data of the packet being received.
+		 * The packet is still owned by the connection, its header is
+		 * already processed so it won't be reallocated.
+		 */
+		packet = conn->recv_packet;
+		if (packet && conn->recv_pos > 8 && (!tds->in_partial || conn->recv_pos > tds->in_len)) {
+			if (!tds->in_partial)
+				tds->in_pos = 8;
+			tds->in_buf = packet->buf;
+			tds->in_len = conn->recv_pos;
+			tds->in_partial = packet->data_len - conn->recv_pos;
+			tds->in_flag = tds->in_buf[0];
+			tds_mutex_unlock(&conn->list_mtx);
+			return tds->in_len;
+		}
+
+		/* network ok ? process network */
+		if (!conn->in_net_tds) {
+			tds_connection_network(conn, tds, TDS_NET_PARTIAL);
+			continue;
+		}
+
+		/* wait local condition */
+		wait_res = tds_cond_timedwait(&tds->packet_cond, &conn->list_mtx, tds->query_timeout);
+		if (wait_res != ETIMEDOUT)
+			continue;
+
+		tds_mutex_unlock(&conn->list_mtx);
+		if (tdserror(tds_get_ctx(tds), tds, TDSETIME, ETIMEDOUT) != TDS_INT_CONTINUE) {
+			tds_close_socket(tds);
+			tds_drop_partial(tds);
+			return -1;
+		}
+		tds_mutex_lock(&conn->list_mtx);
+	}
+
+	tds_mutex_unlock(&conn->list_mtx);
+	tds_drop_partial(tds);
+	return -1;
+#else /* !ENABLE_ODBC_MARS */
+	if (!tds->conn->partial_packets)
+		return tds_read_packet(tds);
+
+	if (IS_TDSDEAD(tds)) {
+		tdsdump_log(TDS_DBG_NETWORK, "Read attempt when state is TDS_DEAD");
+		return -1;
+	}
+
+	if (!tds->in_partial && !tds_read_packet_header(tds))
+		return -1;
+
+	if (tds->in_partial && !tds_read_packet_rest(tds, false))
+		return -1;
+
+	return tds->in_len;
+#endif /* !ENABLE_ODBC_MARS */
+}
+
 /**
  * Read in one 'packet' from the server.  This is a wrapped outer packet of
  * the protocol (they bundle result packets into chunks and wrap them at
@@ -527,7 +1065,7 @@ tds_read_packet(TDSSOCKET * tds)
 
 	for (;;) {
 		int wait_res;
-		TDSPACKET **p_packet;
+		TDSPACKET *packet;
 
 		if (IS_TDSDEAD(tds)) {
 			tdsdump_log(TDS_DBG_NETWORK, "Read attempt when state is TDS_DEAD\n");
@@ -535,22 +1073,18 @@ tds_read_packet(TDSSOCKET * tds)
 		}
 
 		/* if there is a packet for me return it */
-		for (p_packet = &conn->packets; *p_packet; p_packet = &(*p_packet)->next)
-			if ((*p_packet)->sid == tds->sid)
-				break;
+		packet = tds_unlink_packet(tds);
 
-		if (*p_packet) {
-			/* remove our packet from list */
-			TDSPACKET *packet = *p_packet;
-			*p_packet = packet->next;
-			tds_packet_cache_add(conn, tds->recv_packet);
-			tds_mutex_unlock(&conn->list_mtx);
+		/* discard rest of a packet partially received */
+		if (packet && tds->in_partial) {
+			tds_set_recv_packet(tds, packet);
+			continue;
+		}
 
-			packet->next = NULL;
-			tds->recv_packet = packet;
+		if (packet) {
+			tds_set_recv_packet(tds, packet);
+			tds_mutex_unlock(&conn->list_mtx);
 
-			tds->in_buf = packet->buf + packet->data_start;
-			tds->in_len = packet->data_len;
 			tds->in_pos  = 8;
 			tds->in_flag = tds->in_buf[0];
 
@@ -575,60 +1109,30 @@ tds_read_packet(TDSSOCKET * tds)
 		tds_mutex_unlock(&conn->list_mtx);
 		if (tdserror(tds_get_ctx(tds), tds, TDSETIME, ETIMEDOUT) != TDS_INT_CONTINUE) {
 			tds_close_socket(tds);
+			tds_drop_partial(tds);
 			return -1;
 		}
 		tds_mutex_lock(&conn->list_mtx);
 	}
 
 	tds_mutex_unlock(&conn->list_mtx);
+	tds_drop_partial(tds);
 	return -1;
 #else /* !ENABLE_ODBC_MARS */
-	unsigned char *pkt = tds->in_buf, *p, *end;
-
 	if (IS_TDSDEAD(tds)) {
 		tdsdump_log(TDS_DBG_NETWORK, "Read attempt when state is TDS_DEAD");
 		return -1;
 	}
 
-	tds->in_len = 0;
-	tds->in_pos = 0;
-	for (p = pkt, end = p+8; p < end;) {
-		ptrdiff_t len = tds_connection_read(tds, p, end - p);
-		if (len <= 0) {
-			tds_close_socket(tds);
-			return -1;
-		}
-
-		p += len;
-		if (p - pkt >= 4) {
-			unsigned pktlen = TDS_GET_A2BE(pkt+2);
-			/* packet must at least contains header */
-			if (TDS_UNLIKELY(pktlen < 8)) {
-				tds_close_socket(tds);
-				return -1;
-			}
-			if (TDS_UNLIKELY(pktlen > tds->recv_packet->capacity)) {
-				TDSPACKET *packet = tds_realloc_packet(tds->recv_packet, pktlen);
-				if (TDS_UNLIKELY(!packet)) {
-					tds_close_socket(tds);
-					return -1;
-				}
-				tds->recv_packet = packet;
-				pkt = packet->buf;
-				p = pkt + (p-tds->in_buf);
-				tds->in_buf = pkt;
-			}
-			end = pkt + pktlen;
-		}
-	}
+	/* discard rest of a packet partially received */
+	if (tds->in_partial && !tds_read_packet_rest(tds, true))
+		return -1;
 
-	/* set the received packet type flag */
-	tds->in_flag = pkt[0];
+	if (!tds_read_packet_header(tds))
+		return -1;
 
-	/* Set the length and pos (not sure what pos is used for now */
-	tds->in_len = (unsigned int) (p - pkt);
-	tds->in_pos = 8;
-	tdsdump_dump_buf(TDS_DBG_NETWORK, "Received packet", tds->in_buf, tds->in_len);
+	if (tds->in_partial && !tds_read_packet_rest(tds, true))
+		return -1;
 
 	return tds->in_len;
 #endif /* !ENABLE_ODBC_MARS */
@@ -730,33 +1234,85 @@ tds_append_syn(TDSSOCKET *tds)
 
 TDS_COMPILE_CHECK(additional, TDS_ADDITIONAL_SPACE != 0);
 
+/**
+ * Append a list of packets to the ones waiting to be sent.
+ * Packets are linked using next field and get owned by the socket.
+ */
+static void
+tds_send_queue_append(TDSSOCKET *tds, TDSPACKET *packet)
+{
+	TDSPACKET **p_tail = &tds->send_queue;
+
+	while (*p_tail)
+		p_tail = &(*p_tail)->next;
+	*p_tail = packet;
+	for (; packet; packet = packet->next)
+		++tds->send_queued;
+}
+
+/**
+ * Send all packets waiting in the queue.
+ * Packets are gathered so they can be written with few system calls.
+ * \tds
+ * \param final  1 if last packet queued ends the message, else 0
+ */
+static TDSRET
+tds_send_queue_flush(TDSSOCKET *tds, int final)
+{
+	TDSPACKET *pkt = tds->send_queue;
+	TDSRET res = TDS_SUCCESS;
+
+	if (!pkt)
+		return TDS_SUCCESS;
+
+	tds->send_queue = NULL;
+	tds->send_queued = 0;
+
+#if ENABLE_ODBC_MARS
+	/* packets will get owned by function, no need to release them */
+	res = tds_connection_put_packet(tds, pkt);
+#else
+	{
+		TDSPACKET *packets[TDS_MAX_SEND_BATCH], *next = pkt;
+		unsigned num_packets;
+
+		while (next && TDS_SUCCEED(res)) {
+			for (num_packets = 0; next && num_packets < TDS_MAX_SEND_BATCH; next = next->next) {
+				tdsdump_dump_buf(TDS_DBG_NETWORK, "Sending packet", next->buf, next->data_len);
+				packets[num_packets++] = next;
+			}
+
+			/* GW added in check for write() returning <0 and SIGPIPE checking */
+			if (tds_connection_write_packets(tds, packets, num_packets, 0, final && !next) <= 0)
+				res = TDS_FAIL;
+		}
+		tds_packet_cache_add(tds->conn, pkt);
+	}
+#endif
+	return res;
+}
+
 TDSRET
 tds_write_packet(TDSSOCKET * tds, unsigned char final)
 {
-	TDSRET res;
+	TDSRET res = TDS_SUCCESS;
 	unsigned int left = 0;
-	TDSPACKET *pkt = tds->send_packet, *pkt_next = NULL;
+	TDSPACKET *pkt = tds->send_packet, *pkt_next;
 
 	CHECK_TDS_EXTRA(tds);
 
-#if !ENABLE_ODBC_MARS
-	if (tds->frozen)
-#endif
-	{
-		pkt->next = pkt_next = tds_get_packet(tds->conn, pkt->capacity);
-		if (!pkt_next)
-			return TDS_FAIL;
+	pkt->next = pkt_next = tds_get_packet(tds->conn, pkt->capacity);
+	if (!pkt_next)
+		return TDS_FAIL;
 
 #if ENABLE_ODBC_MARS
-		if (tds->conn->mars)
-			pkt_next->data_start = sizeof(TDS72_SMP_HEADER);
+	if (tds->conn->mars)
+		pkt_next->data_start = sizeof(TDS72_SMP_HEADER);
 #endif
-	}
 
 	if (tds->out_pos > tds->out_buf_max) {
 		left = tds->out_pos - tds->out_buf_max;
-		if (pkt_next)
-			memcpy(pkt_next->buf + tds_packet_get_data_start(pkt_next) + 8, tds->out_buf + tds->out_buf_max, left);
+		memcpy(pkt_next->buf + tds_packet_get_data_start(pkt_next) + 8, tds->out_buf + tds->out_buf_max, left);
 		tds->out_pos = tds->out_buf_max;
 	}
 
@@ -771,30 +1327,23 @@ tds_write_packet(TDSSOCKET * tds, unsigned char final)
 	if (IS_TDS7_PLUS(tds->conn) && !tds->login)
 		tds->out_buf[6] = 0x01;
 
+	pkt->data_len = tds->out_pos;
+	tds_set_current_send_packet(tds, pkt_next);
+	tds->out_pos = left + 8;
+
 	if (tds->frozen) {
-		pkt->data_len = tds->out_pos;
-		tds_set_current_send_packet(tds, pkt_next);
-		tds->out_pos = left + 8;
 		CHECK_TDS_EXTRA(tds);
 		return TDS_SUCCESS;
 	}
 
-#if ENABLE_ODBC_MARS
-	pkt->data_len = tds->out_pos;
+	/*
+	 * Gather the packets of a message and send them together.
+	 * A packet to encrypt alone must be sent before changing encryption.
+	 */
 	pkt->next = NULL;
-	tds_set_current_send_packet(tds, pkt_next);
-	res = tds_connection_put_packet(tds, pkt);
-#else /* !ENABLE_ODBC_MARS */
-	tdsdump_dump_buf(TDS_DBG_NETWORK, "Sending packet", tds->out_buf, tds->out_pos);
-
-	/* GW added in check for write() returning <0 and SIGPIPE checking */
-	res = tds_connection_write(tds, tds->out_buf, tds->out_pos, final) <= 0 ?
-		TDS_FAIL : TDS_SUCCESS;
-
-	memcpy(tds->out_buf + 8, tds->out_buf + tds->out_buf_max, left);
-#endif /* !ENABLE_ODBC_MARS */
-
-	tds->out_pos = left + 8;
+	tds_send_queue_append(tds, pkt);
+	if (final || tds->send_queued >= TDS_MAX_SEND_BATCH || tds->conn->encrypt_single_packet)
+		res = tds_send_queue_flush(tds, final);
 
 	if (TDS_UNLIKELY(tds->conn->encrypt_single_packet)) {
 		tds->conn->encrypt_single_packet = 0;
@@ -819,6 +1368,10 @@ tds_put_cancel(TDSSOCKET * tds)
 	if (IS_TDS7_PLUS(tds->conn) && !tds->login)
 		out_buf[6] = 0x01;
 
+	/* packets of a message not completed are still sent before the cancel */
+	if (TDS_FAILED(tds_send_queue_flush(tds, 0)))
+		return TDS_FAIL;
+
 	tdsdump_dump_buf(TDS_DBG_NETWORK, "Sending packet", out_buf, 8);
 
 	sent = tds_connection_write(tds, out_buf, 8, 1);
@@ -833,29 +1386,38 @@ tds_put_cancel(TDSSOCKET * tds)
 
 
 #if ENABLE_ODBC_MARS
+/**
+ * Write queued packets to the server.
+ * All packets already queued are sent together if possible.
+ * @return SID of a session which packets were fully sent (preferring
+ *         the session handling network) or -1 if none
+ */
 static int
 tds_packet_write(TDSCONNECTION *conn)
 {
-	int sent;
-	int final;
-	TDSPACKET *packet = conn->send_packets;
-
-	assert(packet);
+	ptrdiff_t sent;
+	int final, sid = -1;
+	unsigned num_packets = 0;
+	TDSPACKET *packets[TDS_MAX_SEND_BATCH], *packet, *last;
 
-	if (conn->send_pos == 0)
-		tdsdump_dump_buf(TDS_DBG_NETWORK, "Sending packet", packet->buf, packet->data_start + packet->data_len);
+	/*
+	 * get a snapshot of the packets to send, other sessions can append to
+	 * the list so we must not follow next pointers without the lock
+	 */
+	tds_mutex_lock(&conn->list_mtx);
+	for (packet = conn->send_packets; packet && num_packets < TDS_MAX_SEND_BATCH; packet = packet->next)
+		packets[num_packets++] = packet;
+	tds_mutex_unlock(&conn->list_mtx);
+	assert(num_packets > 0);
+	last = packets[num_packets - 1];
 
-	/* take into account other session packets */
-	if (packet->next != NULL)
-		final = 0;
 	/* take into account other packets for this session */
-	else if (packet->buf[0] != TDS72_SMP)
-		final = packet->buf[1] & 1;
+	if (last->buf[0] != TDS72_SMP)
+		final = last->buf[1] & 1;
 	else
 		final = 1;
 
-	sent = tds_connection_write(conn->in_net_tds, packet->buf + conn->send_pos,
-				    packet->data_start + packet->data_len - conn->send_pos, final);
+	sent = tds_connection_write_packets(conn->in_net_tds, packets, num_packets, conn->send_pos, final);
 
 	if (TDS_UNLIKELY(sent < 0)) {
 		/* TODO tdserror called ?? */
@@ -864,24 +1426,36 @@ tds_packet_write(TDSCONNECTION *conn)
 	}
 
 	/* update sent data */
-	conn->send_pos += sent;
-	/* remove packet if sent all data */
-	if (conn->send_pos >= packet->data_start + packet->data_len) {
-		uint16_t sid = packet->sid;
+	sent += conn->send_pos;
+
+	/* remove packets sent completely */
+	tds_mutex_lock(&conn->list_mtx);
+	while ((packet = conn->send_packets) != NULL) {
+		unsigned len = packet->data_start + packet->data_len;
 		TDSSOCKET *tds;
-		tds_mutex_lock(&conn->list_mtx);
-		tds = conn->sessions[sid];
-		if (TDSSOCKET_VALID(tds) && tds->sending_packet == packet)
+
+		if ((size_t) sent < len)
+			break;
+		sent -= len;
+
+		tdsdump_dump_buf(TDS_DBG_NETWORK, "Sending packet", packet->buf, len);
+
+		tds = conn->sessions[packet->sid];
+		if (TDSSOCKET_VALID(tds) && tds->sending_packet == packet) {
 			tds->sending_packet = NULL;
+			if (tds != conn->in_net_tds)
+				tds_cond_signal(&tds->packet_cond);
+		}
+		if (sid != conn->in_net_tds->sid)
+			sid = packet->sid;
 		conn->send_packets = packet->next;
 		packet->next = NULL;
 		tds_packet_cache_add(conn, packet);
-		tds_mutex_unlock(&conn->list_mtx);
-		conn->send_pos = 0;
-		return sid;
 	}
+	tds_mutex_unlock(&conn->list_mtx);
+	conn->send_pos = (unsigned) sent;
 
-	return -1;
+	return sid;
 }
 #endif /* ENABLE_ODBC_MARS */
 
@@ -960,9 +1534,7 @@ tds_freeze_abort(TDSFREEZE *freeze)
 	CHECK_FREEZE_EXTRA(freeze);
 
 	if (pkt->next) {
-		tds_mutex_lock(&tds->conn->list_mtx);
 		tds_packet_cache_add(tds->conn, pkt->next);
-		tds_mutex_unlock(&tds->conn->list_mtx);
 		pkt->next = NULL;
 
 		tds_set_current_send_packet(tds, pkt);
@@ -1045,9 +1617,6 @@ tds_freeze_close_len(TDSFREEZE *freeze, int32_t size)
 {
 	TDSSOCKET *tds = freeze->tds;
 	TDSPACKET *pkt;
-#if !ENABLE_ODBC_MARS
-	TDSPACKET *last_pkt_sent = NULL;
-#endif
 
 	CHECK_FREEZE_EXTRA(freeze);
 
@@ -1061,48 +1630,21 @@ tds_freeze_close_len(TDSFREEZE *freeze, int32_t size)
 
 	tds->frozen_packets = NULL;
 	pkt = freeze->pkt;
-	while (pkt->next) {
-		TDSPACKET *next = pkt->next;
-		TDSRET rc;
-#if ENABLE_ODBC_MARS
-		pkt->next = NULL;
-		freeze->pkt = next;
-		/* packet will get owned by function, no need to release it */
-		rc = tds_connection_put_packet(tds, pkt);
-#else
-		rc = tds_connection_write(tds, pkt->buf, pkt->data_len, 0) <= 0 ?
-			TDS_FAIL : TDS_SUCCESS;
-		last_pkt_sent = pkt;
-#endif
-		if (TDS_UNLIKELY(TDS_FAILED(rc))) {
-			while (next->next) {
-				pkt = next;
-				next = pkt->next;
-			}
-			tds_extra_assert(pkt->next != NULL);
-			tds_extra_assert(pkt->next == tds->send_packet);
-
-			pkt->next = NULL;
-			tds_mutex_lock(&tds->conn->list_mtx);
-			tds_packet_cache_add(tds->conn, freeze->pkt);
-			tds_mutex_unlock(&tds->conn->list_mtx);
-			return rc;
-		}
-		pkt = next;
-	}
+	if (pkt->next) {
+		TDSPACKET *last;
 
-	tds_extra_assert(pkt->next == NULL);
-	tds_extra_assert(pkt == tds->send_packet);
+		/* detach all packets but current one, we'll send them all together */
+		for (last = pkt; last->next != tds->send_packet; last = last->next)
+			continue;
+		last->next = NULL;
 
-#if !ENABLE_ODBC_MARS
-	if (last_pkt_sent) {
-		tds_extra_assert(last_pkt_sent->next == pkt);
-		last_pkt_sent->next = NULL;
-		tds_mutex_lock(&tds->conn->list_mtx);
-		tds_packet_cache_add(tds->conn, freeze->pkt);
-		tds_mutex_unlock(&tds->conn->list_mtx);
+		/* queue them with the other packets of the message */
+		tds_send_queue_append(tds, pkt);
+		if (tds->send_queued >= TDS_MAX_SEND_BATCH)
+			return tds_send_queue_flush(tds, 0);
 	}
-#endif
+
+	tds_extra_assert(tds->send_packet->next == NULL);
 
 	/* keep final packet so we can continue to add data */
 	return TDS_SUCCESS;
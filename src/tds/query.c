@@ -1649,12 +1649,28 @@ tds_put_data_info(TDSSOCKET * tds, TDSCOLUMN * curcol, int flags)
 }
 
 /**
- * Send dynamic request on TDS 7+ to be executed
+ * Check if server can be asked to not send result metadata executing
+ * a prepared statement. Metadata cached by the statement must not be
+ * used by anybody else, they will be filled again.
  * \tds
  * \param dyn  dynamic query to execute
  */
+static bool
+tds7_can_skip_meta(TDSSOCKET * tds, TDSDYNAMIC * dyn)
+{
+	return tds->conn->rpc_no_metadata && IS_TDS72_PLUS(tds->conn)
+	       && dyn->meta && !dyn->multiple_results
+	       && dyn->meta->ref_count == 1;
+}
+
+/**
+ * Send dynamic request on TDS 7+ to be executed
+ * \tds
+ * \param dyn    dynamic query to execute
+ * \param flags  RPC option flags, see TDS_RPC_NO_METADATA
+ */
 static TDSRET
-tds7_send_execute(TDSSOCKET * tds, TDSDYNAMIC * dyn)
+tds7_send_execute(TDSSOCKET * tds, TDSDYNAMIC * dyn, TDS_SMALLINT flags)
 {
 	TDSCOLUMN *param;
 	TDSPARAMINFO *info;
@@ -1663,7 +1679,7 @@ tds7_send_execute(TDSSOCKET * tds, TDSDYNAMIC * dyn)
 	/* procedure name */
 	/* NOTE do not call this procedure using integer name (TDS_SP_EXECUTE) on mssql2k, it doesn't work! */
 	TDS_PUT_N_AS_UCS2(tds, "sp_execute");
-	tds_put_smallint(tds, 0);	/* flags */
+	tds_put_smallint(tds, flags);
 
 	/* id of prepared statement */
 	tds_put_byte(tds, 0);
@@ -1714,7 +1730,8 @@ tds_submit_execute(TDSSOCKET * tds, TDSDYNAMIC * dyn)
 		/* RPC on sp_execute */
 		tds_start_query(tds, TDS_RPC);
 
-		tds7_send_execute(tds, dyn);
+		dyn->num_results = 0;
+		tds7_send_execute(tds, dyn, tds7_can_skip_meta(tds, dyn) ? TDS_RPC_NO_METADATA : 0);
 
 		return tds_query_flush_packet(tds);
 	}
@@ -3421,7 +3438,8 @@ tds_multiple_execute(TDSSOCKET *tds, TDSMULTIPLE *multiple, TDSDYNAMIC * dyn)
 		}
 		multiple->flags |= MUL_STARTED;
 
-		tds7_send_execute(tds, dyn);
+		/* results are not associated to the dynamic, metadata are required */
+		tds7_send_execute(tds, dyn, 0);
 
 		return TDS_SUCCESS;
 	}
@@ -72,7 +72,7 @@ unsigned char
 tds_get_byte(TDSSOCKET * tds)
 {
 	while (tds->in_pos >= tds->in_len) {
-		if (tds_read_packet(tds) < 0)
+		if (tds_read_partial_packet(tds) < 0)
 			return 0;
 	}
 	return tds->in_buf[tds->in_pos++];
@@ -239,8 +239,9 @@ tds_get_n(TDSSOCKET * tds, void *dest, size_t need)
 			dest = (char *) dest + have;
 		}
 		need -= have;
-		if (TDS_UNLIKELY((tds->in_buf[1] & TDS_STATUS_EOM) != 0
-				 || tds_read_packet(tds) < 0)) {
+		tds->in_pos = tds->in_len;
+		if (TDS_UNLIKELY((!tds->in_partial && (tds->in_buf[1] & TDS_STATUS_EOM) != 0)
+				 || tds_read_partial_packet(tds) < 0)) {
 			tds_close_socket(tds); /* evidently out of sync */
 			return false;
 		}
@@ -255,6 +256,37 @@ tds_get_n(TDSSOCKET * tds, void *dest, size_t need)
 	return true;
 }
 
+/**
+ * Convert data available in the current packet.
+ * Like tds_convert_stream() all data are consumed even if output
+ * buffer is too small.
+ * \tds
+ * \param char_conv conversion structure
+ * \param[in,out] wire_size size to read from wire, 0 on return
+ * \param outbuf buffer to write to
+ * \param outbytesleft buffer length
+ * \return bytes written to \a outbuf
+ */
+static size_t
+convert_in_packet(TDSSOCKET * tds, TDSICONV * char_conv, size_t * wire_size, char *outbuf, size_t outbytesleft)
+{
+	const char *ib = (const char *) tds->in_buf + tds->in_pos;
+	size_t il = *wire_size;
+	char *ob = outbuf;
+	/* cast away const for message suppression sub-structure */
+	TDS_ERRNO_MESSAGE_FLAGS *suppress = (TDS_ERRNO_MESSAGE_FLAGS*) &char_conv->suppress;
+
+	memset(suppress, 0, sizeof(char_conv->suppress));
+	suppress->e2big = 1;
+	if (tds_iconv(tds, char_conv, to_client, &ib, &il, &ob, &outbytesleft) == (size_t) -1
+	    && errno == E2BIG && ob == outbuf)
+		tdserror(tds_get_ctx(tds), tds, TDSEICONVIU, 0);
+
+	tds->in_pos += (unsigned) *wire_size;
+	*wire_size = 0;
+	return ob - outbuf;
+}
+
 /**
  * For UTF-8 and similar, tds_iconv() may encounter a partial sequence when the chunk boundary
  * is not aligned with the character boundary.  In that event, it will return an error, and
@@ -275,6 +307,10 @@ read_and_convert(TDSSOCKET * tds, TDSICONV * char_conv, size_t * wire_size, char
 	TDSDATAINSTREAM r;
 	TDSSTATICOUTSTREAM w;
 
+	/* whole data in current packet, convert directly from it */
+	if (*wire_size <= (size_t) (tds->in_len - tds->in_pos))
+		return convert_in_packet(tds, char_conv, wire_size, outbuf, outbytesleft);
+
 	tds_datain_stream_init(&r, tds, *wire_size);
 	tds_staticout_stream_init(&w, outbuf, outbytesleft);
 
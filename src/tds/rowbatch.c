@@ -0,0 +1,272 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * \file
+ * \brief Fetch rows by column
+ *
+ * A TDSROWBATCH stores many rows of a result set in per column arrays
+ * of values, lengths and NULL bitmaps, an easier layout for APIs
+ * binding arrays of rows.
+ * While fetching, column data of the result point to the batch so rows
+ * are decoded directly into it and values are copied only once, from the
+ * packet to the batch. Only blobs are copied from the result row.
+ */
+
+#include <config.h>
+
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif /* HAVE_STDLIB_H */
+
+#if HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+
+#include <freetds/tds.h>
+#include <freetds/checks.h>
+
+/** initial allocation for values of variable layout columns */
+#define TDS_BATCH_MIN_ALLOC 1024
+
+/* strings and binaries are stored contiguously, not padded to the column size */
+static bool
+tds_batch_variable_col(const TDSCOLUMN *col)
+{
+	return is_blob_col(col) || is_char_type(col->column_type) || is_binary_type(col->column_type);
+}
+
+/**
+ * Allocate a batch able to store up to max_rows rows of a result.
+ * \param info     result to fetch rows from
+ * \param max_rows maximum rows returned by a single tds_fetch_row_batch()
+ * \return batch allocated or NULL on failure
+ */
+TDSROWBATCH *
+tds_alloc_row_batch(TDSRESULTINFO * info, TDS_UINT max_rows)
+{
+	TDSROWBATCH *batch;
+	unsigned int i;
+
+	if (!info || !max_rows)
+		return NULL;
+
+	batch = tds_new0(TDSROWBATCH, 1);
+	if (!batch)
+		return NULL;
+	batch->info = info;
+	batch->max_rows = max_rows;
+	batch->num_cols = info->num_cols;
+	batch->columns = tds_new0(TDSBATCHCOLUMN, TDS_MAX(info->num_cols, 1));
+	if (!batch->columns)
+		goto Cleanup;
+
+	for (i = 0; i < info->num_cols; ++i) {
+		TDSCOLUMN *col = info->columns[i];
+		TDSBATCHCOLUMN *bcol = &batch->columns[i];
+
+		bcol->lengths = tds_new(TDS_INT, max_rows);
+		bcol->nulls = tds_new0(unsigned char, (max_rows + 7u) / 8u);
+		if (!bcol->lengths || !bcol->nulls)
+			goto Cleanup;
+		if (tds_batch_variable_col(col)) {
+			bcol->offsets = tds_new(TDS_UINT, max_rows);
+			if (!bcol->offsets)
+				goto Cleanup;
+			continue;
+		}
+		bcol->stride = col->funcs->row_len(col);
+		if (bcol->stride && max_rows > ~(TDS_UINT) 0 / bcol->stride)
+			goto Cleanup;
+		bcol->values = tds_new0(unsigned char, (size_t) bcol->stride * max_rows);
+		if (!bcol->values)
+			goto Cleanup;
+	}
+	return batch;
+
+Cleanup:
+	tds_free_row_batch(batch);
+	return NULL;
+}
+
+void
+tds_free_row_batch(TDSROWBATCH * batch)
+{
+	unsigned int i;
+
+	if (!batch)
+		return;
+
+	if (batch->columns) {
+		for (i = 0; i < batch->num_cols; ++i) {
+			TDSBATCHCOLUMN *bcol = &batch->columns[i];
+
+			free(bcol->values);
+			free(bcol->lengths);
+			free(bcol->offsets);
+			free(bcol->nulls);
+		}
+		free(batch->columns);
+	}
+	free(batch);
+}
+
+/* make room for len more bytes in values of a variable layout column */
+static TDSRET
+tds_batch_reserve(TDSBATCHCOLUMN * bcol, TDS_UINT len)
+{
+	size_t new_alloc;
+
+	if (len <= bcol->values_alloc - bcol->values_len)
+		return TDS_SUCCESS;
+
+	new_alloc = TDS_MAX(bcol->values_alloc, TDS_BATCH_MIN_ALLOC / 2u) * (size_t) 2u;
+	if (new_alloc < (size_t) bcol->values_len + len)
+		new_alloc = (size_t) bcol->values_len + len;
+	if (new_alloc > ~(TDS_UINT) 0)
+		return TDS_FAIL;
+	if (!TDS_RESIZE(bcol->values, new_alloc))
+		return TDS_FAIL;
+	bcol->values_alloc = (TDS_UINT) new_alloc;
+	return TDS_SUCCESS;
+}
+
+/* point column data of the result to the batch slots of next row */
+static TDSRET
+tds_batch_set_row_data(TDSROWBATCH * batch)
+{
+	const TDS_UINT row = batch->num_rows;
+	unsigned int i;
+
+	for (i = 0; i < batch->num_cols; ++i) {
+		TDSCOLUMN *col = batch->info->columns[i];
+		TDSBATCHCOLUMN *bcol = &batch->columns[i];
+
+		if (bcol->stride) {
+			col->column_data = bcol->values + (size_t) row * bcol->stride;
+			continue;
+		}
+		/* blobs are stored in the result row */
+		if (is_blob_col(col))
+			continue;
+		TDS_PROPAGATE(tds_batch_reserve(bcol, col->funcs->row_len(col)));
+		col->column_data = bcol->values + bcol->values_len;
+	}
+	return TDS_SUCCESS;
+}
+
+/* add row just decoded to the batch */
+static TDSRET
+tds_batch_add_row(TDSROWBATCH * batch)
+{
+	const TDS_UINT row = batch->num_rows;
+	const unsigned char null_mask = 1u << (row % 8u);
+	unsigned int i;
+
+	for (i = 0; i < batch->num_cols; ++i) {
+		TDSCOLUMN *col = batch->info->columns[i];
+		TDSBATCHCOLUMN *bcol = &batch->columns[i];
+		TDS_INT len = col->column_cur_size;
+
+		if (len < 0) {
+			bcol->nulls[row / 8u] |= null_mask;
+			len = 0;
+		} else {
+			bcol->nulls[row / 8u] &= ~null_mask;
+		}
+		bcol->lengths[row] = len;
+		if (bcol->stride)
+			continue;
+
+		if (is_blob_col(col)) {
+			TDS_PROPAGATE(tds_batch_reserve(bcol, len));
+			if (len)
+				memcpy(bcol->values + bcol->values_len, ((const TDSBLOB *) col->column_data)->textvalue, len);
+		}
+		bcol->offsets[row] = bcol->values_len;
+		bcol->values_len += len;
+	}
+	++batch->num_rows;
+	return TDS_SUCCESS;
+}
+
+/**
+ * Fetch rows of current result set into a batch.
+ * Rows are read till the batch is full or a token different from a row
+ * is found. This token is not processed, call tds_process_tokens() to
+ * handle it; messages and other informational tokens are handled as usual.
+ * Previous content of the batch is discarded.
+ * Rows are not stored in the current row of the result.
+ * \tds
+ * \param batch        batch to fill, allocated for current result
+ * \param result_type  TDS_ROW_RESULT if batch got filled, otherwise
+ *                     result type of the token which stopped the fetch;
+ *                     not changed if TDS_WOULD_BLOCK is returned
+ * \return TDS_SUCCESS, TDS_WOULD_BLOCK if in non-blocking mode the rest of
+ *         the response was not received yet, or result of tds_process_tokens()
+ *         on failure or end of results. batch->num_rows is valid in any case.
+ */
+TDSRET
+tds_fetch_row_batch(TDSSOCKET * tds, TDSROWBATCH * batch, TDS_INT * result_type)
+{
+	const unsigned flag = TDS_RETURN_ROW|TDS_STOPAT_ROWFMT|TDS_STOPAT_COMPUTEFMT|TDS_STOPAT_PARAMFMT
+			      |TDS_STOPAT_DONE|TDS_STOPAT_COMPUTE|TDS_STOPAT_PROC;
+	TDSRESULTINFO *info = batch->info;
+	bool borrow_data = info->borrow_data;
+	TDS_INT type = TDS_ROW_RESULT;
+	TDSRET rc = TDS_SUCCESS;
+	unsigned int i;
+	int done_flags;
+
+	CHECK_TDS_EXTRA(tds);
+
+	batch->num_rows = 0;
+	for (i = 0; i < batch->num_cols; ++i) {
+		batch->columns[i].values_len = 0;
+		batch->columns[i].row_data = info->columns[i]->column_data;
+	}
+
+	/* data are copied to the batch anyway, do not keep packets */
+	info->borrow_data = false;
+	while (batch->num_rows < batch->max_rows) {
+		rc = tds_batch_set_row_data(batch);
+		if (TDS_FAILED(rc))
+			break;
+		rc = tds_process_tokens(tds, &type, &done_flags, flag);
+		if (rc != TDS_SUCCESS || type != TDS_ROW_RESULT)
+			break;
+		if (tds->current_results != info) {
+			rc = TDS_FAIL;
+			break;
+		}
+		rc = tds_batch_add_row(batch);
+		if (TDS_FAILED(rc))
+			break;
+	}
+	info->borrow_data = borrow_data;
+	for (i = 0; i < batch->num_cols; ++i)
+		info->columns[i]->column_data = batch->columns[i].row_data;
+
+	if (rc != TDS_WOULD_BLOCK)
+		*result_type = type;
+
+	tdsdump_log(TDS_DBG_FUNC, "tds_fetch_row_batch: %u rows, result type %d, rc %d\n", batch->num_rows, type, rc);
+	return rc;
+}
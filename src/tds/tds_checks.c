@@ -92,6 +92,17 @@ tds_check_tds_extra(const TDSSOCKET * tds)
 	assert(tds->send_packet->next == NULL);
 	tds_check_packet_extra(tds->send_packet);
 	tds_check_packet_extra(tds->recv_packet);
+	if (tds->send_queue) {
+		const TDSPACKET *pkt;
+		unsigned num_packets = 0;
+
+		tds_check_packet_extra(tds->send_queue);
+		for (pkt = tds->send_queue; pkt; pkt = pkt->next)
+			++num_packets;
+		assert(num_packets == tds->send_queued);
+	} else {
+		assert(tds->send_queued == 0);
+	}
 
 #if ENABLE_ODBC_MARS
 	if (tds->conn->send_packets)
@@ -105,7 +116,13 @@ tds_check_tds_extra(const TDSSOCKET * tds)
 #endif
 
 	assert(tds->in_pos <= tds->in_len);
-	assert(tds->in_len <= tds->recv_packet->capacity);
+#if ENABLE_ODBC_MARS
+	/* a packet partially received is still owned by the connection */
+	if (!tds->in_partial)
+		assert(tds->in_len <= tds->recv_packet->capacity);
+#else
+	assert(tds->in_len + tds->in_partial <= tds->recv_packet->capacity);
+#endif
 	/* TODO remove blocksize from env and use out_len ?? */
 /*	assert(tds->out_pos <= tds->out_len); */
 /* 	assert(tds->out_len == 0 || tds->out_buf != NULL); */
@@ -323,6 +340,10 @@ tds_check_dynamic_extra(const TDSDYNAMIC * dyn)
 		tds_check_resultinfo_extra(dyn->res_info);
 	if (dyn->params)
 		tds_check_resultinfo_extra(dyn->params);
+	if (dyn->meta) {
+		assert(!dyn->multiple_results);
+		tds_check_resultinfo_extra(dyn->meta);
+	}
 
 	assert(!dyn->emulated || dyn->query);
 }
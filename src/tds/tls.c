@@ -62,6 +62,22 @@
 
 #include <assert.h>
 
+#ifdef TDS_HAVE_KTLS
+#include <sys/uio.h>
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+#ifndef HAVE_GNUTLS
+#include <openssl/kdf.h>
+#endif
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#endif
+
 /**
  * \addtogroup network
  * @{ 
@@ -221,6 +237,417 @@ wanted_certificate_hostname(TDSLOGIN *login)
 	return tds_dstr_cstr(&login->server_host_name);
 }
 
+/*
+ * TLS sessions to resume, by server.
+ * Data are stored serialized so a session can be offered to any
+ * connection of the context.
+ */
+enum { TDS_TLS_SESSION_CACHE_MAX = 64 };
+
+typedef struct tds_tls_cached_session
+{
+	struct tds_tls_cached_session *next;
+	size_t len;
+	unsigned char *data;
+	char key[1];
+} TDS_TLS_CACHED_SESSION;
+
+struct tds_tls_session_cache
+{
+	tds_mutex mtx;
+	unsigned int num_sessions;
+	/** most recently stored first */
+	TDS_TLS_CACHED_SESSION *sessions;
+};
+
+struct tds_tls_session_cache *
+tds_tls_session_cache_alloc(void)
+{
+	struct tds_tls_session_cache *cache;
+
+	cache = tds_new0(struct tds_tls_session_cache, 1);
+	if (!cache)
+		return NULL;
+	if (tds_mutex_init(&cache->mtx)) {
+		free(cache);
+		return NULL;
+	}
+	return cache;
+}
+
+void
+tds_tls_session_cache_free(struct tds_tls_session_cache *cache)
+{
+	TDS_TLS_CACHED_SESSION *session, *next;
+
+	if (!cache)
+		return;
+
+	for (session = cache->sessions; session; session = next) {
+		next = session->next;
+		free(session->data);
+		free(session);
+	}
+	tds_mutex_free(&cache->mtx);
+	free(cache);
+}
+
+/**
+ * Build the key identifying the server a connection talks to.
+ * Sessions are bound to the certificate name and to all settings used to
+ * verify the peer, so a session established with weaker checks is never
+ * offered to a connection requiring stronger ones.
+ * File names are prefixed by their length so keys cannot be ambiguous.
+ */
+static void
+tds_tls_session_set_key(TDSSOCKET *tds)
+{
+	TDSCONNECTION *conn = tds->conn;
+	TDSLOGIN *login = tds->login;
+
+	TDS_ZERO_FREE(conn->tls_session_key);
+	conn->tls_resumed = 0;
+
+	if (!login || !conn->tds_ctx || !conn->tds_ctx->tls_sessions)
+		return;
+
+	if (asprintf(&conn->tls_session_key, "%s:%d:%s:%d:%d:%u:%s:%u:%s", tds_dstr_cstr(&login->server_host_name),
+		     login->port, wanted_certificate_hostname(login), (int) login->encryption_level,
+		     (int) login->check_ssl_hostname,
+		     (unsigned) tds_dstr_len(&login->cafile), tds_dstr_cstr(&login->cafile),
+		     (unsigned) tds_dstr_len(&login->crlfile), tds_dstr_cstr(&login->crlfile)) < 0)
+		conn->tls_session_key = NULL;
+}
+
+/**
+ * Get a copy of the session stored for the connection server.
+ * \return data to free or NULL if none
+ */
+static unsigned char *
+tds_tls_session_get(TDSCONNECTION *conn, size_t *len)
+{
+	struct tds_tls_session_cache *cache;
+	TDS_TLS_CACHED_SESSION *session;
+	unsigned char *data = NULL;
+
+	if (!conn->tls_session_key)
+		return NULL;
+	cache = conn->tds_ctx->tls_sessions;
+
+	tds_mutex_lock(&cache->mtx);
+	for (session = cache->sessions; session; session = session->next) {
+		if (strcmp(session->key, conn->tls_session_key) != 0)
+			continue;
+		data = tds_new(unsigned char, session->len);
+		if (data) {
+			memcpy(data, session->data, session->len);
+			*len = session->len;
+		}
+		break;
+	}
+	tds_mutex_unlock(&cache->mtx);
+	return data;
+}
+
+/**
+ * Store the session for the connection server replacing any previous one.
+ * If len is 0 the session is just removed.
+ */
+static void
+tds_tls_session_put(TDSCONNECTION *conn, const void *data, size_t len)
+{
+	struct tds_tls_session_cache *cache;
+	TDS_TLS_CACHED_SESSION *session = NULL, **prev, *cur;
+	size_t key_len;
+
+	if (!conn->tls_session_key)
+		return;
+	cache = conn->tds_ctx->tls_sessions;
+
+	if (len) {
+		key_len = strlen(conn->tls_session_key);
+		session = (TDS_TLS_CACHED_SESSION *) malloc(sizeof(*session) + key_len);
+		if (!session)
+			return;
+		session->data = tds_new(unsigned char, len);
+		if (!session->data) {
+			free(session);
+			return;
+		}
+		memcpy(session->data, data, len);
+		session->len = len;
+		memcpy(session->key, conn->tls_session_key, key_len + 1);
+	}
+
+	tds_mutex_lock(&cache->mtx);
+	for (prev = &cache->sessions; (cur = *prev) != NULL; ) {
+		/* drop the old session and the oldest one if the cache is full */
+		if (strcmp(cur->key, conn->tls_session_key) == 0
+		    || (session && !cur->next && cache->num_sessions >= TDS_TLS_SESSION_CACHE_MAX)) {
+			*prev = cur->next;
+			--cache->num_sessions;
+			free(cur->data);
+			free(cur);
+			continue;
+		}
+		prev = &cur->next;
+	}
+	if (session) {
+		session->next = cache->sessions;
+		cache->sessions = session;
+		++cache->num_sessions;
+	}
+	tds_mutex_unlock(&cache->mtx);
+}
+
+static void
+tds_tls_session_log_resumed(TDSCONNECTION *conn)
+{
+	if (conn->tls_session_key)
+		tdsdump_log(TDS_DBG_INFO1, "TLS session for %s %s\n", conn->tls_session_key,
+			    conn->tls_resumed ? "resumed" : "not resumed");
+}
+
+#ifdef TDS_HAVE_KTLS
+/* TLS record content types */
+enum {
+	TDS_TLS_ALERT = 21,
+	TDS_TLS_HANDSHAKE = 22,
+	TDS_TLS_APPLICATION_DATA = 23,
+};
+
+/* TLS handshake message types */
+enum {
+	TDS_TLS_KEY_UPDATE = 24,
+};
+
+/** Record keys for a direction */
+typedef struct tds_ktls_dir_keys
+{
+	unsigned char key[32];
+	/** nonce base, for AES-GCM with TLS 1.2 only 4 bytes (implicit part) */
+	unsigned char iv[12];
+	/** sequence number of next record, big endian */
+	unsigned char seq[8];
+} TDS_KTLS_DIR_KEYS;
+
+/** Record keys used by the kernel */
+typedef struct tds_ktls_keys
+{
+	/** TLS_1_2_VERSION or TLS_1_3_VERSION */
+	unsigned short version;
+	/** TLS_CIPHER_xxx */
+	unsigned short cipher;
+	unsigned int key_len;
+	TDS_KTLS_DIR_KEYS tx, rx;
+} TDS_KTLS_KEYS;
+
+static bool tds_ktls_get_keys(TDSCONNECTION *conn, TDS_KTLS_KEYS *keys);
+
+#define TDS_KTLS_FILL(ci) do { \
+	ci.info.version = keys->version; \
+	ci.info.cipher_type = keys->cipher; \
+	memcpy(ci.key, dir_keys->key, sizeof(ci.key)); \
+	memcpy(ci.salt, dir_keys->iv, sizeof(ci.salt)); \
+	memcpy(ci.rec_seq, dir_keys->seq, sizeof(ci.rec_seq)); \
+	len = sizeof(ci); \
+} while(0)
+
+static bool
+tds_ktls_set(TDSCONNECTION *conn, int dir, const TDS_KTLS_KEYS *keys)
+{
+	const TDS_KTLS_DIR_KEYS *dir_keys = dir == TLS_TX ? &keys->tx : &keys->rx;
+	union {
+		struct tls12_crypto_info_aes_gcm_128 aes_gcm_128;
+		struct tls12_crypto_info_aes_gcm_256 aes_gcm_256;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+		struct tls12_crypto_info_chacha20_poly1305 chacha20_poly1305;
+#endif
+	} ci;
+	socklen_t len;
+	int rc;
+
+	memset(&ci, 0, sizeof(ci));
+	switch (keys->cipher) {
+	case TLS_CIPHER_AES_GCM_128:
+		TDS_KTLS_FILL(ci.aes_gcm_128);
+		/* explicit part of the nonce, TLS 1.2 uses the sequence number */
+		if (keys->version == TLS_1_3_VERSION)
+			memcpy(ci.aes_gcm_128.iv, dir_keys->iv + 4, 8);
+		else
+			memcpy(ci.aes_gcm_128.iv, dir_keys->seq, 8);
+		break;
+	case TLS_CIPHER_AES_GCM_256:
+		TDS_KTLS_FILL(ci.aes_gcm_256);
+		if (keys->version == TLS_1_3_VERSION)
+			memcpy(ci.aes_gcm_256.iv, dir_keys->iv + 4, 8);
+		else
+			memcpy(ci.aes_gcm_256.iv, dir_keys->seq, 8);
+		break;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+	case TLS_CIPHER_CHACHA20_POLY1305:
+		TDS_KTLS_FILL(ci.chacha20_poly1305);
+		memcpy(ci.chacha20_poly1305.iv, dir_keys->iv, 12);
+		break;
+#endif
+	default:
+		return false;
+	}
+
+	rc = setsockopt(conn->s, SOL_TLS, dir, &ci, len);
+	if (rc)
+		tdsdump_log(TDS_DBG_INFO1, "setting kernel TLS %s keys failed: %s\n",
+			    dir == TLS_TX ? "send" : "receive", strerror(errno));
+	memset(&ci, 0, sizeof(ci));
+	return rc == 0;
+}
+
+/** Check whether data read from the socket were not used yet */
+static inline bool
+tds_ktls_read_ahead_pending(const TDSCONNECTION *conn)
+{
+	return conn->read_ahead.pos < conn->read_ahead.len;
+}
+
+/**
+ * Check post-handshake messages received by the kernel for key updates.
+ * Following records use new keys so kernel cannot decrypt them.
+ * Messages are expected to be in a single record.
+ */
+static bool
+tds_ktls_key_update(const unsigned char *buf, size_t len)
+{
+	while (len >= 4) {
+		size_t msg_len = 4 + ((size_t) buf[1] << 16) + ((size_t) buf[2] << 8) + buf[3];
+
+		if (buf[0] == TDS_TLS_KEY_UPDATE)
+			return true;
+		if (msg_len >= len)
+			break;
+		buf += msg_len;
+		len -= msg_len;
+	}
+	return false;
+}
+
+/**
+ * Let the kernel handle the records of an established TLS session.
+ * Data are then sent and received with plain socket calls avoiding
+ * encryption in user space and the additional copies.
+ * If kernel does not support the session the TLS library keeps
+ * handling the records.
+ * Both directions are offloaded or none: with only sending offloaded
+ * the library could still write records (like alerts or key update
+ * replies) which kernel would encrypt again. Receiving is set first as
+ * it is the direction kernels support less; if sending fails after it
+ * the keys cannot be removed so the connection fails.
+ * With TLS 1.3 session tickets are received by the kernel and discarded
+ * so the session is not saved in the context cache.
+ * \return TDS_SUCCESS if the session is usable, TDS_FAIL otherwise
+ */
+TDSRET
+tds_ssl_ktls_start(TDSSOCKET *tds)
+{
+	TDSCONNECTION *conn = tds->conn;
+	TDS_KTLS_KEYS keys;
+	TDSRET ret = TDS_SUCCESS;
+
+	if (!conn->tls_session || conn->ktls_tx || !tds->login || !tds->login->use_ktls)
+		return TDS_SUCCESS;
+
+	/* records in read-ahead buffer are behind kernel sequence number */
+	if (tds_ktls_read_ahead_pending(conn)) {
+		tdsdump_log(TDS_DBG_INFO1, "kernel TLS not used, records already read from socket\n");
+		return TDS_SUCCESS;
+	}
+
+	if (!tds_ktls_get_keys(conn, &keys)) {
+		tdsdump_log(TDS_DBG_INFO1, "kernel TLS not used, session not supported\n");
+		return TDS_SUCCESS;
+	}
+
+	/* without keys the socket still passes records unchanged */
+	if (setsockopt(conn->s, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) != 0) {
+		tdsdump_log(TDS_DBG_INFO1, "kernel TLS not available: %s\n", strerror(errno));
+	} else if (tds_ktls_set(conn, TLS_RX, &keys)) {
+		conn->ktls_rx = 1;
+		if (tds_ktls_set(conn, TLS_TX, &keys)) {
+			conn->ktls_tx = 1;
+		} else {
+			tdsdump_log(TDS_DBG_ERROR, "kernel TLS: cannot send after receive was offloaded\n");
+			ret = TDS_FAIL;
+		}
+	}
+	if (conn->ktls_rx && keys.version == TLS_1_3_VERSION && conn->tls_session_key)
+		tdsdump_log(TDS_DBG_INFO1, "kernel TLS: session tickets will not be saved\n");
+	memset(&keys, 0, sizeof(keys));
+
+	tdsdump_log(TDS_DBG_INFO1, "kernel TLS send %d receive %d\n", conn->ktls_tx, conn->ktls_rx);
+	return ret;
+}
+
+/**
+ * Receive application data from a socket decrypted by the kernel.
+ * Post-handshake messages (like TLS 1.3 session tickets) are discarded,
+ * so tickets never reach the session cache.
+ * Key updates are not supported, the connection fails.
+ * \return like recv(2)
+ */
+ptrdiff_t
+tds_ktls_recv(TDSCONNECTION *conn, unsigned char *buf, size_t buflen)
+{
+	for (;;) {
+		union {
+			char buf[CMSG_SPACE(sizeof(unsigned char))];
+			struct cmsghdr align;
+		} control;
+		struct msghdr msg;
+		struct iovec iov;
+		struct cmsghdr *cmsg;
+		unsigned char record_type = TDS_TLS_APPLICATION_DATA;
+		ptrdiff_t len;
+
+		memset(&msg, 0, sizeof(msg));
+		iov.iov_base = buf;
+		iov.iov_len = buflen;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control.buf;
+		msg.msg_controllen = sizeof(control.buf);
+
+		len = recvmsg(conn->s, &msg, 0);
+		if (len <= 0)
+			return len;
+
+		cmsg = CMSG_FIRSTHDR(&msg);
+		if (cmsg && cmsg->cmsg_level == SOL_TLS && cmsg->cmsg_type == TLS_GET_RECORD_TYPE)
+			record_type = *CMSG_DATA(cmsg);
+
+		switch (record_type) {
+		case TDS_TLS_APPLICATION_DATA:
+			return len;
+		case TDS_TLS_HANDSHAKE:
+			if (tds_ktls_key_update(buf, len)) {
+				tdsdump_log(TDS_DBG_ERROR, "kernel TLS: key update not supported\n");
+				errno = EPROTO;
+				return -1;
+			}
+			tdsdump_log(TDS_DBG_NETWORK, "kernel TLS: discarded post-handshake message\n");
+			continue;
+		case TDS_TLS_ALERT:
+			/* close_notify */
+			if (len >= 2 && buf[1] == 0)
+				return 0;
+			/* fall through */
+		default:
+			tdsdump_log(TDS_DBG_ERROR, "kernel TLS: unexpected record type %d\n", record_type);
+			errno = ECONNRESET;
+			return -1;
+		}
+	}
+}
+#endif /* TDS_HAVE_KTLS */
+
 #ifdef HAVE_GNUTLS
 
 static void
@@ -485,6 +912,32 @@ tds_verify_certificate_conn(gnutls_session_t session)
 	return tds_verify_certificate(session, CONN2TDS(conn));
 }
 
+/**
+ * Store session data to resume later connections.
+ * With TLS 1.3 the server sends tickets after the handshake, data are
+ * saved only once a ticket was received, retrieving them before could
+ * block waiting for it.
+ */
+static void
+tds_gnutls_session_save(TDSCONNECTION *conn, gnutls_session_t session)
+{
+	gnutls_datum_t data;
+
+	if (!conn->tls_session_key)
+		return;
+
+#if GNUTLS_VERSION_NUMBER >= 0x030603
+	if (gnutls_protocol_get_version(session) == GNUTLS_TLS1_3
+	    && !(gnutls_session_get_flags(session) & GNUTLS_SFLAGS_SESSION_TICKET))
+		return;
+#endif
+
+	if (gnutls_session_get_data2(session, &data) != 0)
+		return;
+	tds_tls_session_put(conn, data.data, data.size);
+	gnutls_free(data.data);
+}
+
 TDSRET
 tds_ssl_init(TDSSOCKET *tds, bool full)
 {
@@ -493,6 +946,8 @@ tds_ssl_init(TDSSOCKET *tds, bool full)
 	int ret;
 	const char *tls_msg;
 	int (*verify_func)(gnutls_session_t session);
+	gnutls_datum_t resume_data;
+	size_t resume_len;
 
 	xcred = NULL;
 	session = NULL;	
@@ -609,14 +1064,28 @@ tds_ssl_init(TDSSOCKET *tds, bool full)
 	}
 #endif
 
+	/* offer a previous session to skip full handshake */
+	tds_tls_session_set_key(tds);
+	resume_data.data = tds_tls_session_get(tds->conn, &resume_len);
+	if (resume_data.data) {
+		resume_data.size = (unsigned int) resume_len;
+		if (gnutls_session_set_data(session, resume_data.data, resume_data.size) != 0)
+			tds_tls_session_put(tds->conn, NULL, 0);
+		free(resume_data.data);
+		resume_data.data = NULL;
+	}
+
 	if (full)
 		set_current_tds(tds->conn, tds);
 
 	/* Perform the TLS handshake */
 	tls_msg = "handshake";
 	ret = gnutls_handshake (session);
-	if (ret != 0)
+	if (ret != 0) {
+		/* do not offer again a session that could have caused the failure */
+		tds_tls_session_put(tds->conn, NULL, 0);
 		goto cleanup;
+	}
 
 #ifndef HAVE_GNUTLS_CERTIFICATE_SET_VERIFY_FUNCTION
 	if (!tds_dstr_isempty(&tds->login->cafile)) {
@@ -628,6 +1097,10 @@ tds_ssl_init(TDSSOCKET *tds, bool full)
 
 	tdsdump_log(TDS_DBG_INFO1, "handshake succeeded!!\n");
 
+	tds->conn->tls_resumed = gnutls_session_is_resumed(session) != 0;
+	tds_tls_session_log_resumed(tds->conn);
+	tds_gnutls_session_save(tds->conn, session);
+
 	if (!full) {
 		/* some TLS implementations send some sort of paddind at the end, remove it */
 		tds->in_pos = tds->in_len;
@@ -642,6 +1115,10 @@ tds_ssl_init(TDSSOCKET *tds, bool full)
 	tds->conn->tls_session = session;
 	tds->conn->tls_credentials = xcred;
 
+	/* all following traffic is encrypted */
+	if (full)
+		return tds_ssl_ktls_start(tds);
+
 	return TDS_SUCCESS;
 
 cleanup:
@@ -658,16 +1135,79 @@ void
 tds_ssl_deinit(TDSCONNECTION *conn)
 {
 	if (conn->tls_session) {
+		/* tickets could have been received after the handshake */
+		if (!conn->tls_resumed)
+			tds_gnutls_session_save(conn, (gnutls_session_t) conn->tls_session);
 		gnutls_deinit((gnutls_session_t) conn->tls_session);
 		conn->tls_session = NULL;
 	}
+	TDS_ZERO_FREE(conn->tls_session_key);
 	if (conn->tls_credentials) {
 		gnutls_certificate_free_credentials((gnutls_certificate_credentials_t) conn->tls_credentials);
 		conn->tls_credentials = NULL;
 	}
 	conn->encrypt_single_packet = 0;
+	conn->ktls_tx = 0;
+	conn->ktls_rx = 0;
 }
 
+#ifdef TDS_HAVE_KTLS
+static bool
+tds_ktls_get_keys(TDSCONNECTION *conn, TDS_KTLS_KEYS *keys)
+{
+	gnutls_session_t session = (gnutls_session_t) conn->tls_session;
+	gnutls_datum_t mac_key, iv, cipher_key;
+	unsigned int read;
+
+	memset(keys, 0, sizeof(*keys));
+
+	switch (gnutls_protocol_get_version(session)) {
+	case GNUTLS_TLS1_2:
+		keys->version = TLS_1_2_VERSION;
+		break;
+	case GNUTLS_TLS1_3:
+		keys->version = TLS_1_3_VERSION;
+		break;
+	default:
+		return false;
+	}
+
+	switch (gnutls_cipher_get(session)) {
+	case GNUTLS_CIPHER_AES_128_GCM:
+		keys->cipher = TLS_CIPHER_AES_GCM_128;
+		keys->key_len = 16;
+		break;
+	case GNUTLS_CIPHER_AES_256_GCM:
+		keys->cipher = TLS_CIPHER_AES_GCM_256;
+		keys->key_len = 32;
+		break;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+	case GNUTLS_CIPHER_CHACHA20_POLY1305:
+		keys->cipher = TLS_CIPHER_CHACHA20_POLY1305;
+		keys->key_len = 32;
+		break;
+#endif
+	default:
+		return false;
+	}
+
+	/* data already decrypted by the library would be lost */
+	if (gnutls_record_check_pending(session))
+		return false;
+
+	for (read = 0; read < 2; ++read) {
+		TDS_KTLS_DIR_KEYS *dir_keys = read ? &keys->rx : &keys->tx;
+
+		if (gnutls_record_get_state(session, read, &mac_key, &iv, &cipher_key, dir_keys->seq) != 0
+		    || cipher_key.size != keys->key_len || iv.size > sizeof(dir_keys->iv))
+			return false;
+		memcpy(dir_keys->key, cipher_key.data, cipher_key.size);
+		memcpy(dir_keys->iv, iv.data, iv.size);
+	}
+	return true;
+}
+#endif
+
 size_t
 tds_ssl_get_cb(TDSCONNECTION *conn, void *cb, size_t cblen)
 {
@@ -840,6 +1380,239 @@ tds_init_openssl_thread(void)
 }
 #endif
 
+/**
+ * Called by OpenSSL for every new session established, with TLS 1.3 also
+ * for tickets received after the handshake.
+ */
+static int
+tds_ssl_new_session(SSL *ssl, SSL_SESSION *sess)
+{
+	TDSCONNECTION *conn = (TDSCONNECTION *) SSL_get_app_data(ssl);
+	unsigned char *data, *p;
+	int len;
+
+	if (!conn || !conn->tls_session_key)
+		return 0;
+
+	len = i2d_SSL_SESSION(sess, NULL);
+	if (len <= 0)
+		return 0;
+	p = data = tds_new(unsigned char, len);
+	if (!data)
+		return 0;
+	if (i2d_SSL_SESSION(sess, &p) == len)
+		tds_tls_session_put(conn, data, len);
+	free(data);
+
+	/* session is not retained */
+	return 0;
+}
+
+#ifdef TDS_HAVE_KTLS
+/** index of TLS 1.3 secrets in SSL extra data */
+static int tds_ssl_secrets_index = -1;
+
+/** TLS 1.3 application traffic secrets, saved from the key log */
+typedef struct tds_ssl_secrets
+{
+	unsigned int client_len, server_len;
+	unsigned char client[EVP_MAX_MD_SIZE];
+	unsigned char server[EVP_MAX_MD_SIZE];
+} TDS_SSL_SECRETS;
+
+static void
+tds_ssl_secrets_free(void *parent TDS_UNUSED, void *ptr, CRYPTO_EX_DATA *ad TDS_UNUSED,
+		     int idx TDS_UNUSED, long argl TDS_UNUSED, void *argp TDS_UNUSED)
+{
+	if (ptr) {
+		OPENSSL_cleanse(ptr, sizeof(TDS_SSL_SECRETS));
+		free(ptr);
+	}
+}
+
+static int
+tds_hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+static void
+tds_ssl_keylog(const SSL *ssl, const char *line)
+{
+	TDS_SSL_SECRETS *secrets = (TDS_SSL_SECRETS *) SSL_get_ex_data(ssl, tds_ssl_secrets_index);
+	unsigned char *secret;
+	unsigned int *secret_len, n;
+	const char *p;
+
+	if (!secrets)
+		return;
+
+	if (strncmp(line, "CLIENT_TRAFFIC_SECRET_0 ", 24) == 0) {
+		secret = secrets->client;
+		secret_len = &secrets->client_len;
+	} else if (strncmp(line, "SERVER_TRAFFIC_SECRET_0 ", 24) == 0) {
+		secret = secrets->server;
+		secret_len = &secrets->server_len;
+	} else {
+		return;
+	}
+
+	/* line is "label client_random secret" in hexadecimal */
+	p = strchr(line + 24, ' ');
+	if (!p)
+		return;
+	for (++p, n = 0; n < EVP_MAX_MD_SIZE; ++n, p += 2) {
+		int hi = tds_hex_digit(p[0]), lo;
+
+		if (hi < 0 || (lo = tds_hex_digit(p[1])) < 0)
+			break;
+		secret[n] = (unsigned char) (hi << 4 | lo);
+	}
+	*secret_len = n;
+}
+
+/** TLS 1.2 key block, RFC 5246 section 6.3 */
+static bool
+tds_ktls_tls12_keys(SSL *ssl, const EVP_MD *md, TDS_KTLS_KEYS *keys)
+{
+	unsigned char master[SSL_MAX_MASTER_KEY_LENGTH];
+	unsigned char seed[SSL3_RANDOM_SIZE * 2];
+	unsigned char block[2 * (32 + 12)];
+	size_t master_len, key_len = keys->key_len, iv_len = 4, block_len;
+	EVP_PKEY_CTX *pctx;
+	bool ok = false;
+
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+	if (keys->cipher == TLS_CIPHER_CHACHA20_POLY1305)
+		iv_len = 12;
+#endif
+	block_len = 2 * (key_len + iv_len);
+
+	master_len = SSL_SESSION_get_master_key(SSL_get_session(ssl), master, sizeof(master));
+	SSL_get_server_random(ssl, seed, SSL3_RANDOM_SIZE);
+	SSL_get_client_random(ssl, seed + SSL3_RANDOM_SIZE, SSL3_RANDOM_SIZE);
+
+	pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF, NULL);
+	if (pctx && EVP_PKEY_derive_init(pctx) > 0
+	    && EVP_PKEY_CTX_set_tls1_prf_md(pctx, md) > 0
+	    && EVP_PKEY_CTX_set1_tls1_prf_secret(pctx, master, (int) master_len) > 0
+	    && EVP_PKEY_CTX_add1_tls1_prf_seed(pctx, (const unsigned char *) "key expansion", 13) > 0
+	    && EVP_PKEY_CTX_add1_tls1_prf_seed(pctx, seed, (int) sizeof(seed)) > 0
+	    && EVP_PKEY_derive(pctx, block, &block_len) > 0) {
+		/* client key, server key, client IV, server IV */
+		memcpy(keys->tx.key, block, key_len);
+		memcpy(keys->rx.key, block + key_len, key_len);
+		memcpy(keys->tx.iv, block + 2 * key_len, iv_len);
+		memcpy(keys->rx.iv, block + 2 * key_len + iv_len, iv_len);
+		ok = true;
+	}
+	EVP_PKEY_CTX_free(pctx);
+	OPENSSL_cleanse(master, sizeof(master));
+	OPENSSL_cleanse(block, sizeof(block));
+
+	/* Finished messages used sequence 0 */
+	keys->tx.seq[7] = keys->rx.seq[7] = 1;
+	return ok;
+}
+
+/** HKDF-Expand-Label with empty context, RFC 8446 section 7.1 */
+static bool
+tds_hkdf_expand_label(const EVP_MD *md, const unsigned char *secret, unsigned int secret_len,
+		      const char *label, unsigned char *out, size_t out_len)
+{
+	unsigned char info[2 + 1 + 6 + 8 + 1];
+	size_t label_len = strlen(label);
+	EVP_PKEY_CTX *pctx;
+	bool ok = false;
+
+	assert(label_len <= 8);
+	info[0] = 0;
+	info[1] = (unsigned char) out_len;
+	info[2] = (unsigned char) (6 + label_len);
+	memcpy(info + 3, "tls13 ", 6);
+	memcpy(info + 9, label, label_len);
+	info[9 + label_len] = 0;
+
+	pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL);
+	if (pctx && EVP_PKEY_derive_init(pctx) > 0
+	    && EVP_PKEY_CTX_hkdf_mode(pctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0
+	    && EVP_PKEY_CTX_set_hkdf_md(pctx, md) > 0
+	    && EVP_PKEY_CTX_set1_hkdf_key(pctx, secret, (int) secret_len) > 0
+	    && EVP_PKEY_CTX_add1_hkdf_info(pctx, info, (int) (10 + label_len)) > 0
+	    && EVP_PKEY_derive(pctx, out, &out_len) > 0)
+		ok = true;
+	EVP_PKEY_CTX_free(pctx);
+	return ok;
+}
+
+/** TLS 1.3 traffic keys, RFC 8446 section 7.3 */
+static bool
+tds_ktls_tls13_keys(SSL *ssl, const EVP_MD *md, TDS_KTLS_KEYS *keys)
+{
+	TDS_SSL_SECRETS *secrets = (TDS_SSL_SECRETS *) SSL_get_ex_data(ssl, tds_ssl_secrets_index);
+
+	if (!secrets || !secrets->client_len || !secrets->server_len)
+		return false;
+
+	return tds_hkdf_expand_label(md, secrets->client, secrets->client_len, "key", keys->tx.key, keys->key_len)
+	       && tds_hkdf_expand_label(md, secrets->client, secrets->client_len, "iv", keys->tx.iv, 12)
+	       && tds_hkdf_expand_label(md, secrets->server, secrets->server_len, "key", keys->rx.key, keys->key_len)
+	       && tds_hkdf_expand_label(md, secrets->server, secrets->server_len, "iv", keys->rx.iv, 12);
+}
+
+static bool
+tds_ktls_get_keys(TDSCONNECTION *conn, TDS_KTLS_KEYS *keys)
+{
+	SSL *ssl = (SSL *) conn->tls_session;
+	const SSL_CIPHER *cipher = SSL_get_current_cipher(ssl);
+	const EVP_MD *md;
+
+	memset(keys, 0, sizeof(*keys));
+
+	if (!cipher || (md = SSL_CIPHER_get_handshake_digest(cipher)) == NULL)
+		return false;
+
+	switch (SSL_CIPHER_get_cipher_nid(cipher)) {
+	case NID_aes_128_gcm:
+		keys->cipher = TLS_CIPHER_AES_GCM_128;
+		keys->key_len = 16;
+		break;
+	case NID_aes_256_gcm:
+		keys->cipher = TLS_CIPHER_AES_GCM_256;
+		keys->key_len = 32;
+		break;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+	case NID_chacha20_poly1305:
+		keys->cipher = TLS_CIPHER_CHACHA20_POLY1305;
+		keys->key_len = 32;
+		break;
+#endif
+	default:
+		return false;
+	}
+
+	/* data already read by the library would be lost */
+	if (SSL_has_pending(ssl))
+		return false;
+
+	switch (SSL_version(ssl)) {
+	case TLS1_2_VERSION:
+		keys->version = TLS_1_2_VERSION;
+		return tds_ktls_tls12_keys(ssl, md, keys);
+	case TLS1_3_VERSION:
+		keys->version = TLS_1_3_VERSION;
+		return tds_ktls_tls13_keys(ssl, md, keys);
+	}
+	return false;
+}
+#endif
+
 static SSL_CTX *
 tds_init_openssl(void)
 {
@@ -851,6 +1624,9 @@ tds_init_openssl(void)
 			SSL_library_init();
 			tds_init_openssl_thread();
 			tds_init_ssl_methods();
+#ifdef TDS_HAVE_KTLS
+			tds_ssl_secrets_index = SSL_get_ex_new_index(0, NULL, NULL, NULL, tds_ssl_secrets_free);
+#endif
 			tls_initialized = 1;
 		}
 		tds_mutex_unlock(&tls_mutex);
@@ -1061,6 +1837,8 @@ tds_ssl_init(TDSSOCKET *tds, bool full)
 	const char *tls_msg;
 
 	unsigned long ctx_options = DEFAULT_OPENSSL_CTX_OPTIONS;
+	unsigned char *resume_data;
+	size_t resume_len;
 
 	con = NULL;
 	b = NULL;
@@ -1082,6 +1860,10 @@ tds_ssl_init(TDSSOCKET *tds, bool full)
 		ctx_options &= ~SSL_OP_NO_TLSv1_1;
 	SSL_CTX_set_options(ctx, ctx_options);
 
+	/* sessions are saved in the context cache by our callback */
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb(ctx, tds_ssl_new_session);
+
 	if (!tds_dstr_isempty(&tds->login->cafile)) {
 		tls_msg = "loading CA file";
 		if (strcasecmp(tds_dstr_cstr(&tds->login->cafile), "system") == 0)
@@ -1150,6 +1932,33 @@ tds_ssl_init(TDSSOCKET *tds, bool full)
 	}
 #endif
 
+#ifdef TDS_HAVE_KTLS
+	/* TLS 1.3 keys for the kernel are derived from the traffic secrets */
+	if (tds->login && tds->login->use_ktls && tds_ssl_secrets_index >= 0) {
+		TDS_SSL_SECRETS *secrets = tds_new0(TDS_SSL_SECRETS, 1);
+
+		if (secrets && SSL_set_ex_data(con, tds_ssl_secrets_index, secrets))
+			SSL_CTX_set_keylog_callback(ctx, tds_ssl_keylog);
+		else
+			free(secrets);
+	}
+#endif
+
+	/* offer a previous session to skip full handshake */
+	SSL_set_app_data(con, tds->conn);
+	tds_tls_session_set_key(tds);
+	resume_data = tds_tls_session_get(tds->conn, &resume_len);
+	if (resume_data) {
+		const unsigned char *p = resume_data;
+		SSL_SESSION *sess = d2i_SSL_SESSION(NULL, &p, (long) resume_len);
+
+		if (!sess || !SSL_set_session(con, sess))
+			tds_tls_session_put(tds->conn, NULL, 0);
+		if (sess)
+			SSL_SESSION_free(sess);
+		free(resume_data);
+	}
+
 	if (full)
 		set_current_tds(tds->conn, tds);
 
@@ -1162,9 +1971,14 @@ tds_ssl_init(TDSSOCKET *tds, bool full)
 	if (ret != 0) {
 		tdsdump_log(TDS_DBG_ERROR, "handshake failed with %d %d %d\n",
 			    connect_ret, SSL_get_state(con), SSL_get_error(con, connect_ret));
+		/* do not offer again a session that could have caused the failure */
+		tds_tls_session_put(tds->conn, NULL, 0);
 		goto cleanup;
 	}
 
+	tds->conn->tls_resumed = SSL_session_reused(con) != 0;
+	tds_tls_session_log_resumed(tds->conn);
+
 	/* flush pending data */
 	if (!full && tds->out_pos > 8)
 		tds_flush_packet(tds);
@@ -1196,6 +2010,10 @@ tds_ssl_init(TDSSOCKET *tds, bool full)
 	tds->conn->tls_session = con;
 	tds->conn->tls_ctx = ctx;
 
+	/* all following traffic is encrypted */
+	if (full)
+		return tds_ssl_ktls_start(tds);
+
 	return TDS_SUCCESS;
 
 cleanup:
@@ -1225,7 +2043,10 @@ tds_ssl_deinit(TDSCONNECTION *conn)
 		SSL_CTX_free((SSL_CTX *) conn->tls_ctx);
 		conn->tls_ctx = NULL;
 	}
+	TDS_ZERO_FREE(conn->tls_session_key);
 	conn->encrypt_single_packet = 0;
+	conn->ktls_tx = 0;
+	conn->ktls_rx = 0;
 }
 
 size_t
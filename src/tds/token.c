@@ -528,6 +528,8 @@ tds_process_auth(TDSSOCKET * tds)
  * @retval TDS_SUCCESS if a result set is available for processing.
  * @retval TDS_FAIL on error.
  * @retval TDS_NO_MORE_RESULTS if all results have been completely processed.
+ * @retval TDS_WOULD_BLOCK in non-blocking mode if the response is not fully received yet,
+ *         call again after tds_process_events().
  * @retval anything returned by one of the many functions it calls.  :-(
  */
 TDSRET
@@ -556,6 +558,10 @@ tds_process_tokens(TDSSOCKET *tds, TDS_INT *result_type, int *done_flags, unsign
 	CHECK_TDS_EXTRA(tds);
 
 	tdsdump_log(TDS_DBG_FUNC, "tds_process_tokens(%p, %p, %p, 0x%x)\n", tds, result_type, done_flags, flag);
+
+	/* data borrowed by previous row is no longer needed */
+	if (tds->borrow_data || tds->packet_borrowed || tds->borrowed_packets)
+		tds_release_borrowed_packets(tds);
 	
 	if (tds->state == TDS_IDLE || tds->state == TDS_SENDING) {
 		tdsdump_log(TDS_DBG_FUNC, "tds_process_tokens() state is COMPLETED\n");
@@ -563,6 +569,13 @@ tds_process_tokens(TDSSOCKET *tds, TDS_INT *result_type, int *done_flags, unsign
 		return TDS_NO_MORE_RESULTS;
 	}
 
+#if ENABLE_ODBC_MARS
+	if (tds->conn->nonblocking && !tds_response_received(tds)) {
+		tdsdump_log(TDS_DBG_FUNC, "tds_process_tokens() would block\n");
+		return TDS_WOULD_BLOCK;
+	}
+#endif
+
 	if (tds_set_state(tds, TDS_READING) != TDS_READING)
 		return TDS_FAIL;
 
@@ -996,6 +1009,18 @@ tds_read_namelist(TDSSOCKET * tds, int remainder, struct namelist **p_head, int
 	return num_names;
 }
 
+/*
+ * results of cursors are kept by the cursor and metadata of prepared statements
+ * by the connection (keep set), do not use socket memory for them
+ */
+static TDSRESULTINFO *
+tds_alloc_row_results(TDSSOCKET * tds, TDS_USMALLINT num_cols, bool keep)
+{
+	if (tds->cur_cursor || keep)
+		return tds_alloc_results(num_cols);
+	return tds_alloc_socket_results(tds, num_cols);
+}
+
 /**
  * tds_process_col_name() is one half of the result set under TDS 4.2
  * it contains all the column names, a TDS_COLFMT_TOKEN should 
@@ -1023,7 +1048,7 @@ tds_process_col_name(TDSSOCKET * tds)
 	tds_free_all_results(tds);
 	tds->rows_affected = TDS_NO_COUNT;
 
-	if ((info = tds_alloc_results(num_names)) == NULL)
+	if ((info = tds_alloc_socket_results(tds, num_names)) == NULL)
 		goto memory_error;
 
 	tds->res_info = info;
@@ -1255,6 +1280,10 @@ tds_process_colinfo(TDSSOCKET * tds, char **names, int num_names)
 
 	info = tds->current_results;
 
+	/* columns get changed, do not reuse them */
+	if (info && info == tds->meta_cache.info)
+		tds_free_meta_cache(tds);
+
 	while (bytes_read < hdrsize) {
 
 		tds_get_n(tds, &col_info, 3);
@@ -1564,6 +1593,133 @@ tds7_get_data_info(TDSSOCKET * tds, TDSCOLUMN * curcol)
 	return TDS_SUCCESS;
 }
 
+/* prepare cached metadata to receive a new result set */
+static void
+tds_reset_results(TDSRESULTINFO * info)
+{
+	int i;
+
+	info->rows_exist = false;
+	info->more_results = false;
+	info->borrow_data = false;
+	for (i = 0; i < info->num_cols; ++i) {
+		TDSCOLUMN *col = info->columns[i];
+
+		col->column_borrowed = NULL;
+		col->column_bindtype = 0;
+		col->column_bindfmt = 0;
+		col->column_bindlen = 0;
+		col->column_nullbind = NULL;
+		col->column_varaddr = NULL;
+		col->column_lenbind = NULL;
+		col->column_textpos = 0;
+		col->column_text_sqlgetdatapos = 0;
+		col->column_text_sqlputdatainfo = 0;
+		col->column_iconv_left = 0;
+	}
+}
+
+/**
+ * Check if metadata being received are the same of the cached ones and
+ * use the cached result in this case.
+ * Number of columns is already read.
+ * \tds
+ * \return true if cached result is used
+ */
+static bool
+tds7_reuse_meta(TDSSOCKET * tds, int num_cols)
+{
+	TDSRESULTINFO *info = tds->meta_cache.info;
+	const unsigned int len = tds->meta_cache.len - 2;
+
+	/* cached result still referenced by someone */
+	if (!info || info->ref_count != 1 || info->num_cols != num_cols
+	    || tds->meta_cache.charset_changes != tds->conn->charset_changes)
+		return false;
+
+	if (tds->in_len - tds->in_pos < len || memcmp(tds->in_buf + tds->in_pos, tds->meta_cache.wire + 2, len) != 0)
+		return false;
+	tds->in_pos += len;
+
+	tdsdump_log(TDS_DBG_INFO1, "reusing %d columns of previous result metadata\n", num_cols);
+	tds_reset_results(info);
+	++info->ref_count;
+	tds_set_current_results(tds, info);
+	tds->res_info = info;
+	return true;
+}
+
+/* keep metadata of a result to recognize it if received again */
+static void
+tds7_save_meta(TDSSOCKET * tds, TDSRESULTINFO * info, unsigned int start_pos)
+{
+	const unsigned int len = tds->in_pos - start_pos;
+	unsigned char *wire;
+
+	if (tds->in_pos < start_pos + 2 || !(wire = tds_new(unsigned char, len)))
+		return;
+	memcpy(wire, tds->in_buf + start_pos, len);
+
+	tds->meta_cache.wire = wire;
+	tds->meta_cache.len = len;
+	tds->meta_cache.charset_changes = tds->conn->charset_changes;
+	tds->meta_cache.info = info;
+	++info->ref_count;
+}
+
+/* prepared statement whose result metadata are cached, if any */
+static TDSDYNAMIC *
+tds7_meta_dyn(TDSSOCKET * tds)
+{
+	if (!tds->conn->rpc_no_metadata || !tds->cur_dyn)
+		return NULL;
+	if (tds->current_op != TDS_OP_EXECUTE && tds->current_op != TDS_OP_PREPEXEC)
+		return NULL;
+	return tds->cur_dyn;
+}
+
+/* keep metadata of a prepared statement result, see TDSDYNAMIC::meta */
+static void
+tds7_save_dyn_meta(TDSDYNAMIC * dyn, TDSRESULTINFO * info)
+{
+	tds_dynamic_free_meta(dyn);
+	if (++dyn->num_results > 1)
+		dyn->multiple_results = true;
+	if (dyn->multiple_results)
+		return;
+	dyn->meta = info;
+	++info->ref_count;
+}
+
+/**
+ * Use metadata cached by a prepared statement as server did not send them.
+ * \tds
+ * \param dyn  prepared statement being executed
+ */
+static TDSRET
+tds7_use_dyn_meta(TDSSOCKET * tds, TDSDYNAMIC * dyn)
+{
+	TDSRESULTINFO *info = dyn->meta;
+
+	tds_free_all_results(tds);
+	tds->rows_affected = TDS_NO_COUNT;
+
+	/* rows cannot be decoded without knowing their format */
+	if (!info || info->ref_count != 1 || ++dyn->num_results > 1) {
+		tdsdump_log(TDS_DBG_ERROR, "no metadata available for prepared statement %s\n", dyn->id);
+		dyn->multiple_results = true;
+		tds_dynamic_free_meta(dyn);
+		return TDS_FAIL;
+	}
+
+	tdsdump_log(TDS_DBG_INFO1, "using %d columns of cached metadata\n", info->num_cols);
+	tds_reset_results(info);
+	++info->ref_count;
+	tds_set_current_results(tds, info);
+	tds->res_info = info;
+	return TDS_SUCCESS;
+}
+
 /**
  * tds7_process_result() is the TDS 7.0 result set processing routine.  It 
  * is responsible for populating the tds->res_info structure.
@@ -1576,6 +1732,8 @@ tds7_process_result(TDSSOCKET * tds)
 	int col, num_cols;
 	TDSRET result;
 	TDSRESULTINFO *info;
+	TDSDYNAMIC *dyn;
+	const unsigned start_pos = tds->in_pos, start_packets = tds->in_packets;
 
 	CHECK_TDS_EXTRA(tds);
 	tdsdump_log(TDS_DBG_INFO1, "processing TDS7 result metadata.\n");
@@ -1583,18 +1741,26 @@ tds7_process_result(TDSSOCKET * tds)
 	/* read number of columns and allocate the columns structure */
 
 	num_cols = tds_get_smallint(tds);
+	dyn = tds7_meta_dyn(tds);
 
 	/* This can be a DUMMY results token from a cursor fetch */
 
 	if (num_cols < 0) {
 		tdsdump_log(TDS_DBG_INFO1, "no meta data\n");
+		if (dyn)
+			return tds7_use_dyn_meta(tds, dyn);
 		return TDS_SUCCESS;
 	}
 
 	tds_free_all_results(tds);
 	tds->rows_affected = TDS_NO_COUNT;
 
-	if ((info = tds_alloc_results(num_cols)) == NULL)
+	if (!tds->cur_cursor && !dyn && tds7_reuse_meta(tds, num_cols))
+		return TDS_SUCCESS;
+	/* free before allocating, memory can be reused */
+	tds_free_meta_cache(tds);
+
+	if ((info = tds_alloc_row_results(tds, num_cols, dyn != NULL)) == NULL)
 		return TDS_FAIL;
 	tds_set_current_results(tds, info);
 	if (tds->cur_cursor) {
@@ -1634,6 +1800,12 @@ tds7_process_result(TDSSOCKET * tds)
 
 	/* all done now allocate a row for tds_process_row to use */
 	result = tds_alloc_row(info);
+
+	/* metadata entirely in a packet can be recognized next time */
+	if (TDS_SUCCEED(result) && dyn)
+		tds7_save_dyn_meta(dyn, info);
+	else if (TDS_SUCCEED(result) && !tds->cur_cursor && start_packets == tds->in_packets)
+		tds7_save_meta(tds, info, start_pos);
 	CHECK_TDS_EXTRA(tds);
 	return result;
 }
@@ -1750,7 +1922,7 @@ tds5_process_result(TDSSOCKET * tds)
 	/* read number of columns and allocate the columns structure */
 	num_cols = tds_get_usmallint(tds);
 
-	if ((info = tds_alloc_results(num_cols)) == NULL)
+	if ((info = tds_alloc_row_results(tds, num_cols, false)) == NULL)
 		return TDS_FAIL;
 	tds_set_current_results(tds, info);
 	if (tds->cur_cursor)
@@ -1806,7 +1978,7 @@ tds5_process_result2(TDSSOCKET * tds)
 	/* read number of columns and allocate the columns structure */
 	num_cols = tds_get_usmallint(tds);
 
-	if ((info = tds_alloc_results(num_cols)) == NULL)
+	if ((info = tds_alloc_row_results(tds, num_cols, false)) == NULL)
 		return TDS_FAIL;
 	tds_set_current_results(tds, info);
 	if (tds->cur_cursor)
@@ -1944,9 +2116,8 @@ tds_process_compute(TDSSOCKET * tds)
 static TDSRET
 tds_process_row(TDSSOCKET * tds)
 {
-	unsigned int i;
-	TDSCOLUMN *curcol;
 	TDSRESULTINFO *info;
+	TDSRET rc;
 
 	CHECK_TDS_EXTRA(tds);
 
@@ -1954,12 +2125,10 @@ tds_process_row(TDSSOCKET * tds)
 	if (!info || info->num_cols <= 0)
 		return TDS_FAIL;
 
-	for (i = 0; i < info->num_cols; i++) {
-		tdsdump_log(TDS_DBG_INFO1, "tds_process_row(): reading column %d \n", i);
-		curcol = info->columns[i];
-		TDS_PROPAGATE(curcol->funcs->get_data(tds, curcol));
-	}
-	return TDS_SUCCESS;
+	tds->borrow_data = info->borrow_data;
+	rc = tds_get_row_data(tds, info, NULL);
+	tds->borrow_data = false;
+	return rc;
 }
 
 /**
@@ -1968,10 +2137,9 @@ tds_process_row(TDSSOCKET * tds)
 static TDSRET
 tds_process_nbcrow(TDSSOCKET * tds)
 {
-	unsigned int i;
-	TDSCOLUMN *curcol;
 	TDSRESULTINFO *info;
-	char *nbcbuf;
+	unsigned char *nbcbuf;
+	TDSRET rc;
 
 	CHECK_TDS_EXTRA(tds);
 
@@ -1979,35 +2147,40 @@ tds_process_nbcrow(TDSSOCKET * tds)
 	if (!info || info->num_cols <= 0)
 		return TDS_FAIL;
 
-	nbcbuf = (char *) alloca((info->num_cols + 7) / 8);
+	nbcbuf = (unsigned char *) alloca((info->num_cols + 7) / 8);
 	tds_get_n(tds, nbcbuf, (info->num_cols + 7) / 8);
-	for (i = 0; i < info->num_cols; i++) {
-		curcol = info->columns[i];
-		tdsdump_log(TDS_DBG_INFO1, "tds_process_nbcrow(): reading column %d \n", i);
-		if (nbcbuf[i / 8] & (1 << (i % 8))) {
-			curcol->column_cur_size = -1;
-		} else {
-			TDS_PROPAGATE(curcol->funcs->get_data(tds, curcol));
-		}
-	}
-	return TDS_SUCCESS;
+	tds->borrow_data = info->borrow_data;
+	rc = tds_get_row_data(tds, info, nbcbuf);
+	tds->borrow_data = false;
+	return rc;
 }
 
+/**
+ * Process features acknowledged by the server.
+ * Features not requested or not known are ignored.
+ * \tds
+ */
 static TDSRET
 tds_process_featureextack(TDSSOCKET * tds)
 {
 	CHECK_TDS_EXTRA(tds);
 
-	/* TODO do something with it */
 	for (;;) {
 		TDS_UINT data_len;
 		TDS_TINYINT feature_id;
 
 		feature_id = tds_get_byte(tds);
-		if (feature_id == 0xff)
+		if (feature_id == TDS_FEATURE_TERMINATOR)
 			break;
 
 		data_len = tds_get_uint(tds);
+		/* UTF-8 data are detected by column collations, just log it */
+		if (feature_id == TDS_FEATURE_UTF8_SUPPORT && data_len >= 1) {
+			TDS_TINYINT utf8_support = tds_get_byte(tds);
+
+			--data_len;
+			tdsdump_log(TDS_DBG_INFO1, "server UTF-8 support: %d\n", utf8_support);
+		}
 		tds_get_n(tds, NULL, data_len);
 	}
 	return TDS_SUCCESS;
@@ -2107,6 +2280,14 @@ tds_process_end(TDSSOCKET * tds, int marker TDS_UNUSED, int *flags_parm)
 
 	tds->in_row = false;
 
+	/* results could be different next time, for instance if schema changed */
+	if (error || was_cancelled) {
+		TDSDYNAMIC *dyn = tds7_meta_dyn(tds);
+
+		if (dyn)
+			tds_dynamic_free_meta(dyn);
+	}
+
 	if (tds->res_info) {
 		tds->res_info->more_results = more_results;
 		/* FIXME this should not happen !!! */
@@ -2243,6 +2424,7 @@ tds_process_env_chg(TDSSOCKET * tds)
 		tdsdump_dump_buf(TDS_DBG_NETWORK, "tds->conn->collation now", tds->conn->collation, 5);
 		/* discard old one */
 		tds_get_n(tds, NULL, tds_get_byte(tds));
+		++tds->conn->charset_changes;
 		return TDS_SUCCESS;
 	}
 
@@ -2308,6 +2490,7 @@ tds_process_env_chg(TDSSOCKET * tds)
 		tdsdump_log(TDS_DBG_FUNC, "server indicated charset change to \"%s\"\n", newval);
 		dest = &tds->conn->env.charset;
 		tds_srv_charset_changed(tds->conn, newval);
+		++tds->conn->charset_changes;
 		break;
 	}
 	if (tds->env_chg_func) {
@@ -2572,6 +2755,8 @@ tds_process_cancel(TDSSOCKET * tds)
 		switch (tds_process_tokens(tds, &result_type, NULL, 0)) {
 		case TDS_FAIL:
 			return TDS_FAIL;
+		case TDS_WOULD_BLOCK:
+			return TDS_WOULD_BLOCK;
 		case TDS_CANCELLED:
 		case TDS_SUCCESS:
 		case TDS_NO_MORE_RESULTS:
@@ -0,0 +1,113 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: test allocation of results from the socket arena
+ */
+#include "common.h"
+#include <assert.h>
+
+static TDSRESULTINFO *
+alloc_results(TDSSOCKET *tds, TDS_USMALLINT num_cols)
+{
+	TDSRESULTINFO *info;
+	TDS_USMALLINT i;
+
+	info = tds_alloc_socket_results(tds, num_cols);
+	assert(info && info->num_cols == num_cols && info->ref_count == 1);
+	for (i = 0; i < num_cols; ++i) {
+		tds_set_column_type(tds->conn, info->columns[i], i % 2 ? SYBINT4 : SYBTEXT);
+		assert(tds_dstr_copy(&info->columns[i]->column_name, "name"));
+	}
+	assert(TDS_SUCCEED(tds_alloc_row(info)));
+	return info;
+}
+
+TEST_MAIN()
+{
+	TDSCONTEXT *ctx;
+	TDSSOCKET *tds;
+	TDSRESULTINFO *info, *kept;
+	TDSARENASTATS stats;
+	void *first;
+	unsigned char *row;
+	int i;
+
+	ctx = tds_alloc_context(NULL);
+	assert(ctx);
+	tds = tds_alloc_socket(ctx, 512);
+	assert(tds);
+	tds->conn->tds_version = 0x704;
+
+	/* result and row from the arena */
+	info = alloc_results(tds, 4);
+	assert(info->arena != NULL);
+	tds_get_arena_stats(tds, &stats);
+	assert(stats.allocs == 2 && stats.fallbacks == 0 && stats.chunks == 1);
+	first = info;
+	tds->res_info = info;
+	tds_free_all_results(tds);
+
+	/* arena is reused */
+	for (i = 0; i < 20; ++i) {
+		info = alloc_results(tds, 4);
+		assert(info == first);
+		tds->res_info = info;
+		tds_free_all_results(tds);
+	}
+	tds_get_arena_stats(tds, &stats);
+	assert(stats.allocs == 42 && stats.resets == 20 && stats.chunks == 1);
+
+	/* compute results too */
+	tds->res_info = alloc_results(tds, 2);
+	assert(tds_alloc_compute_results(tds, 3, 2));
+	assert(tds->comp_info[0]->arena == tds->res_info->arena);
+	assert(tds->comp_info[0]->num_cols == 3 && tds->comp_info[0]->by_cols == 2);
+	tds_free_all_results(tds);
+
+	/* a result retained keeps the arena busy */
+	kept = alloc_results(tds, 2);
+	++kept->ref_count;
+	tds->res_info = kept;
+	tds_free_all_results(tds);
+	for (i = 0; i < 200; ++i) {
+		row = kept->current_row;
+		assert(TDS_SUCCEED(tds_alloc_row(kept)));
+		tds_free_row(kept, row);
+	}
+	info = alloc_results(tds, 1);
+	assert(info != first);
+	tds_free_results(info);
+
+	/* too large for the arena */
+	info = alloc_results(tds, 4000);
+	assert(info->arena == NULL);
+	tds_free_results(info);
+	tds_get_arena_stats(tds, &stats);
+	assert(stats.fallbacks >= 1);
+	assert(stats.reserved <= 256u * 1024u);
+
+	/* arena outlives the socket */
+	tds_free_socket(tds);
+	tds_free_results(kept);
+
+	tds_free_context(ctx);
+	return 0;
+}
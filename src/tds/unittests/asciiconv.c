@@ -0,0 +1,233 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: test tds_iconv() gives same results converting ASCII
+ * characters directly.
+ * To compare performance call this program with an iteration count:
+ * $ ./asciiconv 100
+ */
+#include "common.h"
+#include <assert.h>
+#include <freetds/iconv.h>
+#include <freetds/time.h>
+
+static const struct {
+	const char *client, *server;
+	TDS_ASCII_MODE to, from;
+} pairs[] = {
+	{ "UTF-8", "CP1252", TDS_ASCII_COPY, TDS_ASCII_COPY },
+	{ "ISO-8859-15", "UTF-8", TDS_ASCII_COPY, TDS_ASCII_COPY },
+	{ "CP1252", "UCS-2LE", TDS_ASCII_WIDEN, TDS_ASCII_NARROW },
+	{ "KOI8-R", "UTF-16LE", TDS_ASCII_WIDEN, TDS_ASCII_NARROW },
+	{ "UTF-16LE", "UCS-2LE", TDS_ASCII_COPY2, TDS_ASCII_COPY2 },
+};
+
+static unsigned int seed = 1;
+
+static unsigned
+rnd(unsigned max)
+{
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % max;
+}
+
+/* build random input, mainly ASCII, with some random code units */
+static size_t
+build_input(unsigned width, unsigned char *buf, size_t max)
+{
+	size_t len = 0;
+	unsigned n = rnd(2) ? rnd(8) : rnd(100);
+
+	while (n-- && len + 2 <= max) {
+		if (rnd(3) == 0) {
+			/* any code unit */
+			buf[len++] = rnd(256);
+			if (width == 2)
+				buf[len++] = rnd(4) ? 0 : rnd(256);
+		} else {
+			unsigned run = rnd(40);
+
+			while (run-- && len + 2 <= max) {
+				buf[len++] = 0x20 + rnd(0x5f);
+				if (width == 2)
+					buf[len++] = 0;
+			}
+		}
+	}
+	/* odd length */
+	if (width == 2 && len && rnd(10) == 0)
+		--len;
+	return len;
+}
+
+static void
+compare(TDSICONV *conv, TDS_ICONV_DIRECTION io, const unsigned char *in, size_t in_len, size_t out_len)
+{
+	TDSICONV ref = *conv;
+	char out_ref[2048], out_ascii[2048];
+	const char *ib;
+	char *ob;
+	size_t il, ol, res_ref, res_ascii, in_ref, out_ref_len;
+	int errno_ref, errno_ascii;
+
+	ref.to.ascii = ref.from.ascii = TDS_ASCII_NONE;
+
+	ib = (const char *) in;
+	il = in_len;
+	ob = out_ref;
+	ol = out_len;
+	errno = 0;
+	res_ref = tds_iconv(NULL, &ref, io, &ib, &il, &ob, &ol);
+	errno_ref = errno;
+	in_ref = il;
+	out_ref_len = ol;
+
+	ib = (const char *) in;
+	il = in_len;
+	ob = out_ascii;
+	ol = out_len;
+	errno = 0;
+	res_ascii = tds_iconv(NULL, conv, io, &ib, &il, &ob, &ol);
+	errno_ascii = errno;
+
+	if (res_ref != res_ascii || errno_ref != errno_ascii || in_ref != il || out_ref_len != ol
+	    || memcmp(out_ref, out_ascii, out_len - ol) != 0) {
+		size_t i;
+
+		fprintf(stderr, "%s -> %s different results: %d/%d errno %d/%d input left %u/%u output left %u/%u\ninput:",
+			io == to_server ? conv->from.charset.name : conv->to.charset.name,
+			io == to_server ? conv->to.charset.name : conv->from.charset.name,
+			(int) res_ref, (int) res_ascii, errno_ref, errno_ascii,
+			(unsigned) in_ref, (unsigned) il, (unsigned) out_ref_len, (unsigned) ol);
+		for (i = 0; i < in_len; ++i)
+			fprintf(stderr, " %02x", in[i]);
+		fprintf(stderr, "\n");
+		exit(1);
+	}
+}
+
+static void
+test_direction(TDSICONV *conv, TDS_ICONV_DIRECTION io)
+{
+	const TDS_ENCODING *from = io == to_server ? &conv->from.charset : &conv->to.charset;
+	unsigned char in[512];
+	size_t len;
+	int i;
+
+	for (i = 0; i < 20000; ++i) {
+		len = build_input(from->min_bytes_per_char, in, sizeof(in));
+		compare(conv, io, in, len, 2048);
+		compare(conv, io, in, len, rnd(len * 2 + 1));
+	}
+}
+
+static double
+elapsed(const struct timeval *start)
+{
+	struct timeval end;
+
+	gettimeofday(&end, NULL);
+	return (end.tv_sec - start->tv_sec) + (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static double
+bench_conv(TDSICONV *conv, const char *in, size_t in_len, char *out, int iterations)
+{
+	struct timeval start;
+	int i;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < iterations; ++i) {
+		const char *ib = in;
+		char *ob = out;
+		size_t il = in_len, ol = in_len * 4;
+
+		tds_iconv(NULL, conv, to_server, &ib, &il, &ob, &ol);
+		assert(il == 0);
+	}
+	return elapsed(&start);
+}
+
+/* compare speed converting mainly ASCII text */
+static void
+bench(TDSICONV *conv, int iterations)
+{
+	enum { IN_SIZE = 256 * 1024 };
+	char *in = (char *) malloc(IN_SIZE);
+	char *out = (char *) malloc(IN_SIZE * 4);
+	TDSICONV ref = *conv;
+	double t_ref, t_ascii;
+	size_t i;
+
+	assert(in && out);
+	for (i = 0; i < IN_SIZE; ++i)
+		in[i] = 0x20 + rnd(0x5f);
+	/* some accented characters */
+	for (i = 0; i < IN_SIZE / 256; ++i)
+		in[rnd(IN_SIZE)] = (char) 0xe9;
+
+	ref.to.ascii = TDS_ASCII_NONE;
+	t_ref = bench_conv(&ref, in, IN_SIZE, out, iterations);
+	t_ascii = bench_conv(conv, in, IN_SIZE, out, iterations);
+
+	printf("%s -> %s iconv %8.1f MB/s  ASCII runs %8.1f MB/s\n", conv->from.charset.name, conv->to.charset.name,
+	       IN_SIZE * (double) iterations / 1e6 / (t_ref > 0 ? t_ref : 1e-9),
+	       IN_SIZE * (double) iterations / 1e6 / (t_ascii > 0 ? t_ascii : 1e-9));
+
+	free(in);
+	free(out);
+}
+
+TEST_MAIN()
+{
+	TDSCONTEXT *ctx = tds_alloc_context(NULL);
+	TDSSOCKET *tds = tds_alloc_socket(ctx, 512);
+	TDSICONV *conv;
+	size_t i;
+	int iterations = argc > 1 ? atoi(argv[1]) : 0;
+
+	assert(ctx && tds);
+	tds_iconv_open(tds->conn, "ISO-8859-1", 0);
+
+	/* charsets where ASCII bytes can be part of other characters */
+	assert(tds_ascii_mode(tds_canonical_charset("SJIS"), tds_canonical_charset("UTF-8")) == TDS_ASCII_NONE);
+	assert(tds_ascii_mode(tds_canonical_charset("UTF-8"), tds_canonical_charset("UCS-2BE")) == TDS_ASCII_NONE);
+
+	for (i = 0; i < TDS_VECTOR_SIZE(pairs); ++i) {
+		conv = tds_iconv_get(tds->conn, pairs[i].client, pairs[i].server);
+		if (!conv || conv->to.cd == (iconv_t) -1 || conv->from.cd == (iconv_t) -1) {
+			printf("%s <-> %s not supported\n", pairs[i].client, pairs[i].server);
+			continue;
+		}
+		assert(conv->to.ascii == pairs[i].to);
+		assert(conv->from.ascii == pairs[i].from);
+
+		test_direction(conv, to_server);
+		test_direction(conv, to_client);
+
+		if (iterations > 0 && conv->from.charset.max_bytes_per_char == 1)
+			bench(conv, iterations);
+	}
+
+	tds_free_socket(tds);
+	tds_free_context(ctx);
+	return 0;
+}
@@ -0,0 +1,175 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Purpose: test column data borrowed from received packets
+ */
+#include "common.h"
+#include <assert.h>
+#include <freetds/bytes.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#include <freetds/replacements.h>
+
+#ifndef _WIN32
+static TDSSOCKET *tds = NULL;
+
+/* add a row with an int and a varchar */
+static unsigned char *
+add_row(unsigned char *p, TDS_INT num, const char *s)
+{
+	size_t len = strlen(s);
+
+	*p++ = TDS_ROW_TOKEN;
+	TDS_PUT_A4LE(p, num);
+	TDS_PUT_A2LE(p + 4, len);
+	memcpy(p + 6, s, len);
+	return p + 6 + len;
+}
+
+/* add an ignored token to move next data by len bytes (at least 3) */
+static unsigned char *
+add_pad(unsigned char *p, size_t len)
+{
+	*p++ = TDS_ORDERBY_TOKEN;
+	TDS_PUT_A2LE(p, len - 3);
+	memset(p + 2, 0, len - 3);
+	return p + len - 1;
+}
+
+static TDSRET
+process_tokens(void)
+{
+	TDS_INT result_type;
+	int done_flags;
+
+	return tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_ROW|TDS_RETURN_DONE);
+}
+
+static void
+test_borrow(void)
+{
+	TDSRESULTINFO *info;
+	TDSCOLUMN *col_num, *col_str;
+	unsigned char buf[256], *p;
+	size_t split;
+	TDS_INT num;
+
+	info = tds_alloc_results(2);
+	assert(info);
+	col_num = info->columns[0];
+	col_str = info->columns[1];
+	tds->conn->tds_version = 0x704;
+	tds_set_column_type(tds->conn, col_num, SYBINT4);
+	tds_set_column_type(tds->conn, col_str, XSYBVARCHAR);
+	col_str->column_size = col_str->on_server.column_size = 100;
+	assert(TDS_SUCCEED(tds_alloc_row(info)));
+	tds->res_info = info;
+	tds_set_current_results(tds, info);
+	info->borrow_data = true;
+
+	/* packet data are aligned, integers after a 3 byte padding and the row token are aligned too */
+	assert(TDS_OFFSET(TDSPACKET, buf) % 4 == 0);
+
+	/* first row split between two packets */
+	p = add_pad(buf, 3);
+	p = add_row(p, 1234, "borrowed");
+	split = p - buf - 3;
+	fake_server_send_packet(buf, split, false);
+	p = add_row(p, 5678, "second");
+	*p++ = TDS_DONE_TOKEN;
+	memset(p, 0, 12);
+	p += 12;
+	fake_server_send_packet(buf + split, p - buf - split, true);
+	tds->state = TDS_PENDING;
+
+	/* integer is borrowed, string is copied */
+	assert(process_tokens() == TDS_SUCCESS);
+	assert(col_num->column_borrowed != NULL);
+	assert(col_str->column_borrowed == NULL);
+	memcpy(&num, tds_column_data(col_num), sizeof(num));
+	assert(num == 1234);
+	assert(col_str->column_cur_size == 8 && memcmp(tds_column_data(col_str), "borrowed", 8) == 0);
+	/* packet with borrowed data is still alive */
+	assert(tds->borrowed_packets != NULL);
+
+	/* all data inside a single packet */
+	assert(process_tokens() == TDS_SUCCESS);
+	assert(tds->borrowed_packets == NULL);
+	assert(col_num->column_borrowed != NULL && col_str->column_borrowed != NULL);
+	memcpy(&num, tds_column_data(col_num), sizeof(num));
+	assert(num == 5678);
+	assert(col_str->column_cur_size == 6 && memcmp(tds_column_data(col_str), "second", 6) == 0);
+	assert(process_tokens() == TDS_SUCCESS);
+
+	/* misaligned integer is copied, string is borrowed */
+	p = add_row(buf, 4321, "unaligned");
+	*p++ = TDS_DONE_TOKEN;
+	memset(p, 0, 12);
+	p += 12;
+	fake_server_send_packet(buf, p - buf, true);
+	tds->state = TDS_PENDING;
+	assert(process_tokens() == TDS_SUCCESS);
+	assert(col_num->column_borrowed == NULL && col_str->column_borrowed != NULL);
+	assert(*(TDS_INT *) col_num->column_data == 4321);
+	assert(col_str->column_cur_size == 9 && memcmp(tds_column_data(col_str), "unaligned", 9) == 0);
+
+	/* not enabled, data are copied */
+	assert(process_tokens() == TDS_SUCCESS);
+	assert(!tds->packet_borrowed && !tds->borrow_data);
+	info->borrow_data = false;
+	p = add_row(buf, 42, "copied");
+	*p++ = TDS_DONE_TOKEN;
+	memset(p, 0, 12);
+	p += 12;
+	fake_server_send_packet(buf, p - buf, true);
+	tds->state = TDS_PENDING;
+	assert(process_tokens() == TDS_SUCCESS);
+	assert(col_num->column_borrowed == NULL && col_str->column_borrowed == NULL);
+	assert(*(TDS_INT *) col_num->column_data == 42);
+	assert(memcmp(col_str->column_data, "copied", 6) == 0);
+}
+
+TEST_MAIN()
+{
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	tdsdump_topen(tds_dir_getenv(TDS_DIR("TDSDUMP")));
+
+	/* provide connection to a fake remote server */
+	tds = fake_server_open();
+
+	test_borrow();
+
+	fake_server_close(tds);
+
+	return 0;
+}
+#else
+TEST_MAIN()
+{
+	printf("Test requires socketpair.\n");
+	return 0;
+}
+#endif
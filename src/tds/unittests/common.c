@@ -1,5 +1,13 @@
 #define TDS_DONT_DEFINE_DEFAULT_FUNCTIONS
 #include "common.h"
+#include <assert.h>
+#include <freetds/bytes.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
 #include <freetds/replacements.h>
 
 int read_login_info(void);
@@ -139,3 +147,64 @@ run_query(TDSSOCKET * tds, const char *query)
 
 	return TDS_SUCCESS;
 }
+
+#ifndef _WIN32
+TDS_SYS_SOCKET fake_server_socket = INVALID_SOCKET;
+
+/* allocate a socket connected to the fake server */
+TDSSOCKET *
+fake_server_open(void)
+{
+	TDS_SYS_SOCKET sockets[2];
+	TDSSOCKET *tds;
+
+	test_context = tds_alloc_context(NULL);
+	assert(test_context);
+	tds = tds_alloc_socket(test_context, 512);
+	assert(tds);
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) >= 0);
+	tds->state = TDS_IDLE;
+	tds_set_s(tds, sockets[0]);
+	fake_server_socket = sockets[1];
+	return tds;
+}
+
+void
+fake_server_close(TDSSOCKET *tds)
+{
+	tds_free_socket(tds);
+	tds_free_context(test_context);
+	test_context = NULL;
+	CLOSESOCKET(fake_server_socket);
+	fake_server_socket = INVALID_SOCKET;
+}
+
+/* fill header of a reply packet of len bytes (header included) */
+void
+fake_server_header(unsigned char *pkt, size_t len, bool final)
+{
+	pkt[0] = TDS_REPLY;
+	pkt[1] = final ? TDS_STATUS_EOM : 0;
+	TDS_PUT_A2BE(pkt + 2, len);
+	memset(pkt + 4, 0, 4);
+}
+
+void
+fake_server_send(const void *data, size_t len)
+{
+	assert(WRITESOCKET(fake_server_socket, data, len) == (ptrdiff_t) len);
+}
+
+/* send a reply packet containing data */
+void
+fake_server_send_packet(const void *data, size_t len, bool final)
+{
+	unsigned char pkt[256];
+
+	assert(len + 8 <= sizeof(pkt));
+	fake_server_header(pkt, len + 8, final);
+	memcpy(pkt + 8, data, len);
+	fake_server_send(pkt, len + 8);
+}
+#endif
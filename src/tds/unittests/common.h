@@ -36,4 +36,15 @@ char *to_utf8(const char *src, char *dest);
 typedef void tds_any_type_t(TDSSOCKET *tds, TDSCOLUMN *col);
 void tds_all_types(TDSSOCKET *tds, tds_any_type_t *func);
 
+#ifndef _WIN32
+/* fake server connected with a socket pair, tests write replies on its socket */
+extern TDS_SYS_SOCKET fake_server_socket;
+
+TDSSOCKET *fake_server_open(void);
+void fake_server_close(TDSSOCKET *tds);
+void fake_server_header(unsigned char *pkt, size_t len, bool final);
+void fake_server_send(const void *data, size_t len);
+void fake_server_send_packet(const void *data, size_t len, bool final);
+#endif
+
 #endif
@@ -0,0 +1,129 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: test connecting to a server with multiple addresses
+ */
+#include "common.h"
+#include <assert.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#if HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#endif /* HAVE_NETINET_IN_H */
+
+#if HAVE_ARPA_INET_H
+#include <arpa/inet.h>
+#endif /* HAVE_ARPA_INET_H */
+
+#include <freetds/replacements.h>
+
+#ifdef __linux__
+static TDS_SYS_SOCKET listen_sock = INVALID_SOCKET;
+static unsigned int port;
+
+static void
+start_server(void)
+{
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+
+	listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+	assert(!TDS_IS_SOCKET_INVALID(listen_sock));
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	assert(bind(listen_sock, (struct sockaddr *) &sin, sizeof(sin)) == 0);
+	assert(listen(listen_sock, 4) == 0);
+	assert(getsockname(listen_sock, (struct sockaddr *) &sin, &len) == 0);
+	port = ntohs(sin.sin_port);
+}
+
+static void
+test_connect(const char *first, const char *second, int delay)
+{
+	TDSCONTEXT *ctx;
+	TDSSOCKET *tds;
+	TDSLOGIN *login;
+	struct addrinfo *addr1 = NULL, *addr2 = NULL;
+	unsigned start;
+	int oserr;
+
+	ctx = tds_alloc_context(NULL);
+	assert(ctx);
+	tds = tds_alloc_socket(ctx, 512);
+	assert(tds);
+	login = tds_alloc_login(false);
+	assert(login);
+	login->connect_attempt_delay = delay;
+
+	assert(TDS_SUCCEED(tds_lookup_host_set(first, &addr1)));
+	assert(TDS_SUCCEED(tds_lookup_host_set(second, &addr2)));
+	assert(addr1->ai_next == NULL);
+	addr1->ai_next = addr2;
+
+	start = tds_gettime_ms();
+	assert(tds_open_socket(tds, login, addr1, port, 5, &oserr) == TDSEOK);
+	/* the working address must be used without waiting for the delay */
+	assert(tds_gettime_ms() - start < 2000);
+
+	addr1->ai_next = NULL;
+	tds_addrinfo_free(addr1);
+	tds_addrinfo_free(addr2);
+	tds_free_login(login);
+	tds_free_socket(tds);
+	tds_free_context(ctx);
+}
+
+TEST_MAIN()
+{
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	tdsdump_topen(tds_dir_getenv(TDS_DIR("TDSDUMP")));
+
+	start_server();
+
+	/* first address refuses the connection, the failure starts the next attempt */
+	test_connect("127.0.0.2", "127.0.0.1", 60000);
+
+	/* all addresses at once */
+	test_connect("127.0.0.2", "127.0.0.1", 0);
+
+	/* default */
+	test_connect("127.0.0.2", "127.0.0.1", -1);
+
+	/* first address works */
+	test_connect("127.0.0.1", "127.0.0.2", 60000);
+
+	CLOSESOCKET(listen_sock);
+	return 0;
+}
+#else	/* !__linux__ */
+TEST_MAIN()
+{
+	printf("Test requires the whole 127.0.0.0/8 network on loopback.\n");
+	return 0;
+}
+#endif
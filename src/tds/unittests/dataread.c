@@ -184,7 +184,7 @@ TEST_MAIN()
 
 	/* floating point */
 	test("REAL", "1.25", NULL);
-	test("FLOAT", "-49586.345", "-49586.345000000001");
+	test("FLOAT", "-49586.345", NULL);
 
 	/* money */
 	test("MONEY", "-123.3400", "-123.3400");
@@ -0,0 +1,270 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: test compiled datetime formats give same results as tds_strftime.
+ * To compare performance call this program with an iteration count.
+ */
+#include "common.h"
+#include <assert.h>
+#include <freetds/convert.h>
+#include <freetds/thread.h>
+
+#include <freetds/time.h>
+
+#if HAVE_LOCALE_H
+#include <locale.h>
+#endif /* HAVE_LOCALE_H */
+
+static const char *const formats[] = {
+	"%b %e %Y %l:%M:%S:%z%p",
+	"%b %e %Y %I:%M%p",
+	"%Y-%m-%d %H:%M:%S.%z",
+	"%Y-%m-%d",
+	"%H:%M:%S.%z",
+	"%H:%M:%S",
+	"%d/%m/%y %3z",
+	"%a %A %B %h %%",
+	"%Y%m%d%H%M%S%7z",
+	".%z",
+	"%z",
+	"x%",
+	/* not compiled, left to strftime */
+	"%j %Y",
+	"%c",
+	"%9z",
+	"%1",
+	NULL
+};
+
+static unsigned rnd_state = 12345;
+
+static unsigned
+rnd(unsigned n)
+{
+	rnd_state = rnd_state * 1103515245u + 12345u;
+	return (rnd_state >> 8) % n;
+}
+
+static void
+random_date(TDSDATEREC *dr)
+{
+	TDS_DATETIMEALL dta;
+
+	memset(&dta, 0, sizeof(dta));
+	/* years from 1 to 9999 */
+	dta.date = (TDS_INT) rnd(3652059u) - 693595;
+	dta.time = (TDS_UINT8) rnd(86400u) * 10000000u + rnd(10000000u);
+	dta.time_prec = 7;
+	tds_datecrack(SYBMSDATETIME2, &dta, dr);
+}
+
+static void
+check(const TDSDATEPLAN *plan, const char *format, const TDSDATEREC *dr, int prec, size_t size)
+{
+	char expected[256], got[256];
+	size_t len_expected, len_got;
+
+	len_expected = tds_strftime(expected, size, format, dr, prec);
+	len_got = tds_date_plan_format(plan, got, size, dr, prec);
+	if (len_expected != len_got || (len_got && strcmp(expected, got) != 0)) {
+		fprintf(stderr, "Format \"%s\" prec %d size %u: got \"%s\" (%u) expected \"%s\" (%u)\n",
+			format, prec, (unsigned) size, len_got ? got : "", (unsigned) len_got,
+			len_expected ? expected : "", (unsigned) len_expected);
+		exit(1);
+	}
+}
+
+static void
+test_formats(void)
+{
+	const char *const *format;
+	TDSDATEREC dr;
+	int i;
+
+	for (format = formats; *format; ++format) {
+		TDSDATEPLAN *plan = tds_date_plan_compile(*format);
+
+		assert(plan);
+		for (i = 0; i < 20000; ++i) {
+			random_date(&dr);
+			check(plan, *format, &dr, (int) rnd(10) - 1, 256);
+			/* output not fitting in buffer */
+			check(plan, *format, &dr, 3, 1 + rnd(24));
+		}
+		tds_date_plan_free(plan);
+	}
+}
+
+/* formats used by a locale are compiled once */
+static void
+test_locale(void)
+{
+	TDSLOCALE *locale = tds_alloc_locale();
+	TDSDATEREC dr;
+	char buf[64], expected[64];
+	const char *const *format;
+	char copy[64];
+
+	assert(locale);
+	random_date(&dr);
+	for (format = formats; *format; ++format) {
+		/* lookup is done by content, not address */
+		strcpy(copy, *format);
+		tds_strftime(expected, sizeof(expected), *format, &dr, 3);
+		assert(tds_locale_strftime(locale, buf, sizeof(buf), *format, &dr, 3) == strlen(expected));
+		assert(strcmp(buf, expected) == 0);
+		assert(tds_locale_strftime(locale, buf, sizeof(buf), copy, &dr, 3) == strlen(expected));
+		assert(strcmp(buf, expected) == 0);
+	}
+	/* no locale */
+	assert(tds_locale_strftime(NULL, buf, sizeof(buf), formats[2], &dr, 3) == strlen(buf));
+	tds_free_locale(locale);
+}
+
+#ifdef TDS_HAVE_MUTEX
+enum {
+	THREADS = 4,
+};
+
+static TDSLOCALE *thread_locale;
+
+/* formats are more than the cached ones so plans are replaced while used */
+static TDS_THREAD_PROC_DECLARE(format_proc, idx_ptr)
+{
+	unsigned state = 1000u + (unsigned) TDS_PTR2INT(idx_ptr);
+	const char *const *format;
+	TDSDATEREC dr;
+	TDS_DATETIME dt;
+	char buf[64], expected[64];
+	size_t len;
+	int i;
+
+	for (i = 0; i < 3000; ++i) {
+		state = state * 1103515245u + 12345u;
+		dt.dtdays = 36500 + (state >> 8) % 10000u;
+		dt.dttime = (state >> 4) % (300u * 86400u);
+		tds_datecrack(SYBDATETIME, &dt, &dr);
+		for (format = formats; *format; ++format) {
+			len = tds_strftime(expected, sizeof(expected), *format, &dr, 3);
+			assert(tds_locale_strftime(thread_locale, buf, sizeof(buf), *format, &dr, 3) == len);
+			assert(strcmp(buf, expected) == 0);
+		}
+	}
+	return TDS_THREAD_RESULT(0);
+}
+
+static void
+test_threads(void)
+{
+	tds_thread threads[THREADS];
+	int i;
+
+	thread_locale = tds_alloc_locale();
+	assert(thread_locale);
+	for (i = 1; i < THREADS; ++i)
+		assert(tds_thread_create(&threads[i], format_proc, TDS_INT2PTR(i)) == 0);
+	format_proc(TDS_INT2PTR(0));
+	for (i = 1; i < THREADS; ++i)
+		assert(tds_thread_join(threads[i], NULL) == 0);
+	tds_free_locale(thread_locale);
+}
+#else
+static void
+test_threads(void)
+{
+}
+#endif
+
+/* compare speed of tds_strftime with compiled formats */
+static void
+bench(int iterations)
+{
+	struct timeval start, end;
+	TDSLOCALE *locale = tds_alloc_locale();
+	TDSDATEREC dates[64];
+	char buf[64];
+	const char *const *format;
+	int i, n;
+	double t_strftime, t_plan, t_compiled;
+	TDSDATEPLAN *plan;
+
+	assert(locale);
+	/* recent dates */
+	for (n = 0; n < 64; ++n) {
+		TDS_DATETIME dt;
+
+		dt.dtdays = 36500 + rnd(10000);
+		dt.dttime = rnd(300u * 86400u);
+		tds_datecrack(SYBDATETIME, &dt, &dates[n]);
+	}
+
+	for (format = formats; format < formats + 3; ++format) {
+		gettimeofday(&start, NULL);
+		for (i = 0; i < iterations; ++i)
+			for (n = 0; n < 64; ++n)
+				tds_strftime(buf, sizeof(buf), *format, &dates[n], 3);
+		gettimeofday(&end, NULL);
+		t_strftime = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+
+		gettimeofday(&start, NULL);
+		for (i = 0; i < iterations; ++i)
+			for (n = 0; n < 64; ++n)
+				tds_locale_strftime(locale, buf, sizeof(buf), *format, &dates[n], 3);
+		gettimeofday(&end, NULL);
+		t_plan = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+
+		plan = tds_date_plan_compile(*format);
+		assert(plan);
+		gettimeofday(&start, NULL);
+		for (i = 0; i < iterations; ++i)
+			for (n = 0; n < 64; ++n)
+				tds_date_plan_format(plan, buf, sizeof(buf), &dates[n], 3);
+		gettimeofday(&end, NULL);
+		t_compiled = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+		tds_date_plan_free(plan);
+
+		printf("\"%s\" %d dates: tds_strftime %.3f s, locale cache %.3f s, compiled %.3f s\n",
+		       *format, iterations * 64, t_strftime, t_plan, t_compiled);
+	}
+	tds_free_locale(locale);
+}
+
+TEST_MAIN()
+{
+	if (argc > 1) {
+		bench(atoi(argv[1]));
+		return 0;
+	}
+
+	test_formats();
+	test_locale();
+	test_threads();
+
+#if HAVE_LOCALE_H
+	/* names from user locale */
+	if (setlocale(LC_ALL, "")) {
+		test_formats();
+		setlocale(LC_ALL, "C");
+	}
+#endif
+
+	return 0;
+}
@@ -0,0 +1,137 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: test strings are converted directly from packet buffer
+ * or using streams when they span packets
+ */
+#include "common.h"
+#include <assert.h>
+#include <freetds/bytes.h>
+#include <freetds/iconv.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#include <freetds/replacements.h>
+
+#ifndef _WIN32
+static TDSSOCKET *tds = NULL;
+
+/* encode an ASCII string as UCS-2LE */
+static size_t
+put_ucs2(unsigned char *p, const char *s)
+{
+	size_t i, len = strlen(s);
+
+	for (i = 0; i < len; ++i) {
+		p[i * 2] = s[i];
+		p[i * 2 + 1] = 0;
+	}
+	return len * 2;
+}
+
+static void
+test_strings(void)
+{
+	unsigned char buf[256], *p = buf;
+	char out[64];
+	TDSRESULTINFO *info;
+	TDSCOLUMN *col;
+
+	info = tds_alloc_results(1);
+	assert(info);
+	col = info->columns[0];
+	col->char_conv = tds->conn->char_convs[client2ucs2];
+
+	/* marker, short string, invalid character, string spanning packets */
+	*p++ = 0x55;
+	p += put_ucs2(p, "name");
+	p += put_ucs2(p, "truncated");
+	TDS_PUT_A2LE(p, 0xd800);
+	p += 2;
+	p += put_ucs2(p, "x");
+	p += put_ucs2(p, "split ");
+	fake_server_send_packet(buf, p - buf, false);
+	p = buf;
+	p += put_ucs2(p, "string");
+	*p++ = 0xaa;
+	fake_server_send_packet(buf, p - buf, true);
+
+	assert(tds_get_byte(tds) == 0x55);
+
+	/* data inside the packet */
+	assert(tds_get_string(tds, 4, out, sizeof(out)) == 4);
+	assert(memcmp(out, "name", 4) == 0);
+	assert(tds->in_pos == 8 + 1 + 8);
+
+	/* output too small, data are discarded anyway */
+	col->column_size = 5;
+	assert(tds_get_char_data(tds, out, 9 * 2, col) == TDS_SUCCESS);
+	assert(col->column_cur_size == 5);
+	assert(memcmp(out, "trunc", 5) == 0);
+	assert(tds->in_pos == 8 + 1 + 8 + 18);
+
+	/* invalid characters are replaced */
+	col->column_size = sizeof(out);
+	assert(tds_get_char_data(tds, out, 2 * 2, col) == TDS_SUCCESS);
+	assert(col->column_cur_size == 2);
+	assert(memcmp(out, "?x", 2) == 0);
+
+	/* data spanning packets use streams */
+	assert(tds_get_char_data(tds, out, 12 * 2, col) == TDS_SUCCESS);
+	assert(col->column_cur_size == 12);
+	assert(memcmp(out, "split string", 12) == 0);
+	assert(tds_get_byte(tds) == 0xaa);
+
+	tds_free_results(info);
+}
+
+TEST_MAIN()
+{
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	tdsdump_topen(tds_dir_getenv(TDS_DIR("TDSDUMP")));
+
+	/* provide connection to a fake remote server */
+	tds = fake_server_open();
+	tds->conn->tds_version = 0x704;
+	if (TDS_FAILED(tds_iconv_open(tds->conn, "ISO-8859-1", 0))) {
+		printf("Conversions not available\n");
+		fake_server_close(tds);
+		return 0;
+	}
+
+	test_strings();
+
+	fake_server_close(tds);
+
+	return 0;
+}
+#else
+TEST_MAIN()
+{
+	printf("Test requires socketpair.\n");
+	return 0;
+}
+#endif
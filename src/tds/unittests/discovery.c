@@ -0,0 +1,210 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: test discovery cache
+ */
+#include "common.h"
+#include <assert.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#if HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif /* HAVE_SYS_STAT_H */
+
+#include <freetds/thread.h>
+#include <freetds/replacements.h>
+
+static const char cache_file[] = "discovery.cache";
+
+#ifdef TDS_HAVE_MUTEX
+enum {
+	KEYS = 20,
+	THREADS = 4,
+};
+
+static TDSLOGIN *thread_login;
+
+static TDS_THREAD_PROC_DECLARE(writer_proc, idx_ptr)
+{
+	const int idx = TDS_PTR2INT(idx_ptr);
+	char key[64];
+	int i;
+
+	for (i = 0; i < KEYS; ++i) {
+		sprintf(key, "port 127.0.0.1 T%dK%d", idx, i);
+		tds_discovery_cache_set(thread_login, key, 1000 + idx * KEYS + i);
+	}
+	return TDS_THREAD_RESULT(0);
+}
+
+/* writers of the same process must not lose updates */
+static void
+test_threads(TDSLOGIN *login)
+{
+	tds_thread threads[THREADS];
+	char key[64];
+	int i, n;
+
+	remove(cache_file);
+	thread_login = login;
+	for (i = 1; i < THREADS; ++i)
+		assert(tds_thread_create(&threads[i], writer_proc, TDS_INT2PTR(i)) == 0);
+	writer_proc(TDS_INT2PTR(0));
+	for (i = 1; i < THREADS; ++i)
+		assert(tds_thread_join(threads[i], NULL) == 0);
+
+	for (i = 0; i < THREADS; ++i) {
+		for (n = 0; n < KEYS; ++n) {
+			sprintf(key, "port 127.0.0.1 T%dK%d", i, n);
+			assert(tds_discovery_cache_get(login, key) == 1000 + i * KEYS + n);
+		}
+	}
+	remove(cache_file);
+}
+#else
+static void
+test_threads(TDSLOGIN *login)
+{
+}
+#endif
+
+#if !defined(_WIN32) && HAVE_UNISTD_H
+/* a file at a predictable temporary name must not be followed */
+static void
+test_symlink(TDSLOGIN *login)
+{
+	static const char victim[] = "discovery.victim";
+	char tmp_path[64];
+	char line[64];
+	FILE *f;
+
+	sprintf(tmp_path, "%s.%d", cache_file, (int) getpid());
+	remove(tmp_path);
+	f = fopen(victim, "w");
+	assert(f);
+	fputs("victim\n", f);
+	fclose(f);
+	assert(symlink(victim, tmp_path) == 0);
+
+	tds_discovery_cache_set(login, "port 127.0.0.1 LINK", 1433);
+	assert(tds_discovery_cache_get(login, "port 127.0.0.1 LINK") == 1433);
+
+	f = fopen(victim, "r");
+	assert(f);
+	assert(fgets(line, sizeof(line), f) && strcmp(line, "victim\n") == 0);
+	fclose(f);
+
+	remove(tmp_path);
+	remove(victim);
+}
+
+/* only a file private to current user is trusted */
+static void
+test_mode(TDSLOGIN *login)
+{
+	struct stat st;
+
+	tds_discovery_cache_set(login, "port 127.0.0.1 MODE", 1433);
+	assert(stat(cache_file, &st) == 0);
+	assert((st.st_mode & 0777) == 0600);
+	assert(tds_discovery_cache_get(login, "port 127.0.0.1 MODE") == 1433);
+
+	assert(chmod(cache_file, 0644) == 0);
+	assert(tds_discovery_cache_get(login, "port 127.0.0.1 MODE") == 0);
+
+	/* entries of an untrusted file are not kept */
+	tds_discovery_cache_set(login, "port 127.0.0.1 OTHER", 50000);
+	assert(stat(cache_file, &st) == 0);
+	assert((st.st_mode & 0777) == 0600);
+	assert(tds_discovery_cache_get(login, "port 127.0.0.1 MODE") == 0);
+	assert(tds_discovery_cache_get(login, "port 127.0.0.1 OTHER") == 50000);
+}
+#else
+static void
+test_symlink(TDSLOGIN *login)
+{
+}
+
+static void
+test_mode(TDSLOGIN *login)
+{
+}
+#endif
+
+TEST_MAIN()
+{
+	TDSLOGIN *login;
+	FILE *f;
+
+	remove(cache_file);
+
+	login = tds_alloc_login(false);
+	assert(login);
+
+	/* disabled cache */
+	tds_discovery_cache_set(login, "port 127.0.0.1 SQLEXPRESS", 1433);
+	assert(tds_discovery_cache_get(login, "port 127.0.0.1 SQLEXPRESS") == 0);
+
+	assert(tds_dstr_copy(&login->discovery_cache, cache_file));
+
+	/* missing file */
+	assert(tds_discovery_cache_get(login, "port 127.0.0.1 SQLEXPRESS") == 0);
+
+	tds_discovery_cache_set(login, "port 127.0.0.1 SQLEXPRESS", 1433);
+	tds_discovery_cache_set(login, "port 127.0.0.1 OTHER", 50000);
+	tds_discovery_cache_set(login, "version 127.0.0.1 0 SQLEXPRESS", 0x704);
+	assert(tds_discovery_cache_get(login, "port 127.0.0.1 SQLEXPRESS") == 1433);
+	assert(tds_discovery_cache_get(login, "port 127.0.0.1 OTHER") == 50000);
+	assert(tds_discovery_cache_get(login, "version 127.0.0.1 0 SQLEXPRESS") == 0x704);
+	assert(tds_discovery_cache_get(login, "port 127.0.0.1") == 0);
+
+	/* replace and remove */
+	tds_discovery_cache_set(login, "port 127.0.0.1 SQLEXPRESS", 1434);
+	assert(tds_discovery_cache_get(login, "port 127.0.0.1 SQLEXPRESS") == 1434);
+	tds_discovery_cache_set(login, "port 127.0.0.1 OTHER", 0);
+	assert(tds_discovery_cache_get(login, "port 127.0.0.1 OTHER") == 0);
+	assert(tds_discovery_cache_get(login, "version 127.0.0.1 0 SQLEXPRESS") == 0x704);
+
+	/* invalid lines are ignored */
+	f = fopen(cache_file, "a");
+	assert(f);
+	fputs("garbage\n\n", f);
+	fclose(f);
+	assert(tds_discovery_cache_get(login, "version 127.0.0.1 0 SQLEXPRESS") == 0x704);
+
+	/* expired entries */
+	login->discovery_cache_ttl = 0;
+	tds_discovery_cache_set(login, "port 127.0.0.1 OTHER", 50000);
+	assert(tds_discovery_cache_get(login, "port 127.0.0.1 OTHER") == 0);
+
+	login->discovery_cache_ttl = -1;
+	test_mode(login);
+	test_symlink(login);
+	test_threads(login);
+
+	tds_free_login(login);
+	remove(cache_file);
+	return 0;
+}
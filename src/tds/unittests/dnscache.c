@@ -0,0 +1,200 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: test host name resolution cache
+ */
+#undef NDEBUG
+#include "../dnscache.c"
+
+#include "common.h"
+#include <assert.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#include <freetds/replacements.h>
+
+static time_t fake_now = 1000000;
+static unsigned num_resolves = 0;
+static bool resolve_fails = false;
+
+static time_t
+fake_time(time_t *p)
+{
+	if (p)
+		*p = fake_now;
+	return fake_now;
+}
+
+/* resolve without using network, names ending with ".invalid" do not exist */
+static struct addrinfo *
+fake_lookup(const char *host)
+{
+	size_t len = strlen(host);
+
+	++num_resolves;
+	if (resolve_fails || (len >= 8 && strcmp(host + len - 8, ".invalid") == 0))
+		return NULL;
+	return tds_lookup_host("127.0.0.1");
+}
+
+static void
+test_cache(void)
+{
+	struct addrinfo *addrs = NULL;
+	TDSDNSCACHESTATS stats;
+	char buf[128];
+
+	tds_dns_cache_flush();
+
+	/* disabled cache */
+	assert(TDS_SUCCEED(tds_lookup_host_set("db.example", &addrs)));
+	assert(num_resolves == 1);
+	tds_dns_cache_get_stats(&stats);
+	assert(stats.hits == 0 && stats.misses == 0 && stats.entries == 0);
+
+	tds_dns_cache_config(60, 60);
+
+	/* first lookup resolves, next ones use the cache */
+	assert(TDS_SUCCEED(tds_lookup_host_set("db.example", &addrs)));
+	assert(TDS_SUCCEED(tds_lookup_host_set("db.example", &addrs)));
+	assert(TDS_SUCCEED(tds_lookup_host_set("DB.example", &addrs)));
+	assert(strcmp(tds_addrinfo2str(addrs, buf, sizeof(buf)), "127.0.0.1") == 0);
+	assert(num_resolves == 2);
+	tds_dns_cache_get_stats(&stats);
+	assert(stats.misses == 1);
+	assert(stats.hits == 2);
+	assert(stats.entries == 1);
+
+	/* failures are cached too, previous addresses are kept */
+	assert(TDS_FAILED(tds_lookup_host_set("no-such-host.invalid", &addrs)));
+	assert(TDS_FAILED(tds_lookup_host_set("no-such-host.invalid", &addrs)));
+	assert(addrs != NULL);
+	assert(num_resolves == 3);
+	tds_dns_cache_get_stats(&stats);
+	assert(stats.misses == 2);
+	assert(stats.negative_hits == 1);
+	assert(stats.entries == 2);
+
+	/* disabling negative caching removes failures */
+	tds_dns_cache_config(-1, 0);
+	assert(TDS_FAILED(tds_lookup_host_set("no-such-host.invalid", &addrs)));
+	assert(num_resolves == 4);
+	tds_dns_cache_get_stats(&stats);
+	assert(stats.negative_hits == 1);
+	assert(stats.entries == 1);
+
+	/* expired entries are resolved again */
+	fake_now += 60;
+	assert(TDS_SUCCEED(tds_lookup_host_set("db.example", &addrs)));
+	assert(num_resolves == 5);
+
+	tds_dns_cache_flush();
+	tds_dns_cache_get_stats(&stats);
+	assert(stats.hits == 0 && stats.entries == 0);
+
+	/* entries used near expiration are refreshed once by the caller */
+	tds_dns_cache_config(8, -1);
+	num_resolves = 0;
+	assert(TDS_SUCCEED(tds_lookup_host_set("db.example", &addrs)));
+	fake_now += 5;
+	assert(TDS_SUCCEED(tds_lookup_host_set("db.example", &addrs)));
+	assert(num_resolves == 1);
+	fake_now += 1;
+	assert(TDS_SUCCEED(tds_lookup_host_set("db.example", &addrs)));
+	assert(num_resolves == 2);
+	tds_dns_cache_get_stats(&stats);
+	assert(stats.refreshes == 1);
+
+	/* refreshed entry is still valid after the old expiration */
+	fake_now += 4;
+	assert(TDS_SUCCEED(tds_lookup_host_set("db.example", &addrs)));
+	assert(num_resolves == 2);
+	tds_dns_cache_get_stats(&stats);
+	assert(stats.misses == 1 && stats.hits == 3);
+
+	/* a failed refresh keeps old addresses till expiration */
+	resolve_fails = true;
+	fake_now += 2;
+	assert(TDS_SUCCEED(tds_lookup_host_set("db.example", &addrs)));
+	assert(num_resolves == 3);
+	tds_dns_cache_get_stats(&stats);
+	assert(stats.refreshes == 2);
+	fake_now += 3;
+	assert(TDS_FAILED(tds_lookup_host_set("db.example", &addrs)));
+	resolve_fails = false;
+
+	tds_dns_cache_config(0, 0);
+	tds_addrinfo_free(addrs);
+}
+
+/* cache durations are accepted only in [global] section */
+static void
+test_config(void)
+{
+	TDSCONTEXT *ctx;
+	TDSSOCKET *tds;
+	TDSLOGIN *login, *connection;
+	FILE *f;
+
+	f = fopen("dnscache.conf", "w");
+	assert(f);
+	fputs("[global]\n\tdns cache ttl = 30\n\tdns negative cache ttl = 10\n"
+	      "[myserver]\n\thost = 127.0.0.1\n\tdns cache ttl = 5\n\tdns negative cache ttl = 0\n", f);
+	fclose(f);
+	putenv("FREETDSCONF=dnscache.conf");
+
+	ctx = tds_alloc_context(NULL);
+	assert(ctx);
+	tds = tds_alloc_socket(ctx, 512);
+	assert(tds);
+	login = tds_alloc_login(true);
+	assert(login && tds_set_server(login, "myserver"));
+
+	connection = tds_read_config_info(tds, login, ctx->locale);
+	assert(connection);
+	assert(dns_ttl == 30);
+	assert(dns_negative_ttl == 10);
+
+	tds_free_login(connection);
+	tds_free_login(login);
+	tds_free_socket(tds);
+	tds_free_context(ctx);
+	unlink("dnscache.conf");
+	tds_dns_cache_config(0, 0);
+}
+
+TEST_MAIN()
+{
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	tdsdump_topen(tds_dir_getenv(TDS_DIR("TDSDUMP")));
+
+	dns_time = fake_time;
+	dns_lookup = fake_lookup;
+
+	test_cache();
+	test_config();
+	return 0;
+}
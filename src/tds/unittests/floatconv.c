@@ -0,0 +1,241 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: test shortest formatting of FLOAT and REAL values.
+ * To compare performance with printf call this program with an iteration count.
+ */
+#include "common.h"
+#include <assert.h>
+#include <math.h>
+#include <freetds/convert.h>
+
+#include <freetds/time.h>
+
+static uint64_t rnd_state = 0x2545f4914f6cdd1dULL;
+
+static uint64_t
+rnd64(void)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 7;
+	rnd_state ^= rnd_state << 17;
+	return rnd_state;
+}
+
+/* count significant digits of a formatted number */
+static int
+significant_digits(const char *s)
+{
+	char digits[40];
+	int n = 0;
+
+	for (; *s && *s != 'e'; ++s)
+		if (*s >= '0' && *s <= '9' && (n || *s != '0'))
+			digits[n++] = *s;
+	while (n > 1 && digits[n - 1] == '0')
+		--n;
+	return n ? n : 1;
+}
+
+static void
+check_double(double d)
+{
+	char buf[TDS_FLOAT_STRING_MAX], ref[40];
+	size_t len;
+	int prec;
+
+	if (d != d || d - d != 0)
+		return;
+
+	len = tds_double_to_string(d, buf);
+	assert(len == strlen(buf) && len < sizeof(buf));
+	if (strtod(buf, NULL) != d || (signbit(d) != 0) != (buf[0] == '-')) {
+		fprintf(stderr, "%s does not read back as %.17g\n", buf, d);
+		exit(1);
+	}
+
+	/* no representation should be shorter */
+	for (prec = 1; prec < 17; ++prec) {
+		sprintf(ref, "%.*e", prec - 1, d);
+		if (strtod(ref, NULL) == d)
+			break;
+	}
+	if (significant_digits(buf) > prec) {
+		fprintf(stderr, "%s is not the shortest representation, %s is shorter\n", buf, ref);
+		exit(1);
+	}
+}
+
+static void
+check_real(float f)
+{
+	char buf[TDS_FLOAT_STRING_MAX], ref[40];
+	size_t len;
+	int prec;
+
+	if (f != f || f - f != 0)
+		return;
+
+	len = tds_real_to_string(f, buf);
+	assert(len == strlen(buf) && len < sizeof(buf));
+	if (strtof(buf, NULL) != f || (signbit(f) != 0) != (buf[0] == '-')) {
+		fprintf(stderr, "%s does not read back as %.9g\n", buf, f);
+		exit(1);
+	}
+
+	for (prec = 1; prec < 9; ++prec) {
+		sprintf(ref, "%.*e", prec - 1, f);
+		if (strtof(ref, NULL) == f)
+			break;
+	}
+	if (significant_digits(buf) > prec) {
+		fprintf(stderr, "%s is not the shortest representation, %s is shorter\n", buf, ref);
+		exit(1);
+	}
+}
+
+static void
+test_double(double d, const char *expected)
+{
+	char buf[TDS_FLOAT_STRING_MAX];
+
+	tds_double_to_string(d, buf);
+	if (strcmp(buf, expected) != 0) {
+		fprintf(stderr, "Got %s expected %s\n", buf, expected);
+		exit(1);
+	}
+	check_double(d);
+}
+
+static void
+test_real(float f, const char *expected)
+{
+	char buf[TDS_FLOAT_STRING_MAX];
+
+	tds_real_to_string(f, buf);
+	if (strcmp(buf, expected) != 0) {
+		fprintf(stderr, "Got %s expected %s\n", buf, expected);
+		exit(1);
+	}
+	check_real(f);
+}
+
+/* compare speed with the printf formatting used before */
+static void
+bench(int iterations)
+{
+	struct timeval start, end;
+	double values[256];
+	float reals[256];
+	char buf[TDS_FLOAT_STRING_MAX];
+	int i, n;
+	double t_printf, t_shortest, t_printf_real, t_shortest_real;
+
+	/* telemetry like values */
+	for (n = 0; n < 256; ++n) {
+		values[n] = (double) (rnd64() % 100000000u) / 1000.0 - 50000.0;
+		reals[n] = (float) values[n];
+	}
+
+#define TIME(var, code) do { \
+	gettimeofday(&start, NULL); \
+	for (i = 0; i < iterations; ++i) \
+		for (n = 0; n < 256; ++n) \
+			code; \
+	gettimeofday(&end, NULL); \
+	var = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0; \
+	} while(0)
+
+	TIME(t_printf, sprintf(buf, "%.17g", values[n]));
+	TIME(t_shortest, tds_double_to_string(values[n], buf));
+	TIME(t_printf_real, sprintf(buf, "%.9g", reals[n]));
+	TIME(t_shortest_real, tds_real_to_string(reals[n], buf));
+
+	printf("%d numbers: FLOAT printf %.3f s, shortest %.3f s; REAL printf %.3f s, shortest %.3f s\n",
+	       iterations * 256, t_printf, t_shortest, t_printf_real, t_shortest_real);
+}
+
+TEST_MAIN()
+{
+	int i;
+
+	if (argc > 1) {
+		bench(atoi(argv[1]));
+		return 0;
+	}
+
+	test_double(0.0, "0");
+	test_double(-0.0, "-0");
+	test_double(1.0, "1");
+	test_double(0.1, "0.1");
+	test_double(-123.4, "-123.4");
+	test_double(1.0 / 3.0, "0.3333333333333333");
+	test_double(123456.0, "123456");
+	test_double(1e16, "10000000000000000");
+	test_double(1e17, "1e+17");
+	test_double(0.0001, "0.0001");
+	test_double(0.00001, "1e-05");
+	test_double(1.5e-300, "1.5e-300");
+	test_double(1.7976931348623157e308, "1.7976931348623157e+308");
+	test_double(5e-324, "5e-324");
+	test_double(2.2250738585072014e-308, "2.2250738585072014e-308");
+	test_double(9007199254740993.0, "9007199254740992");
+
+	test_real(0.0f, "0");
+	test_real(-0.0f, "-0");
+	test_real(0.1f, "0.1");
+	test_real(3.14159f, "3.14159");
+	test_real(-123.4f, "-123.4");
+	test_real(16777216.0f, "16777216");
+	test_real(1e9f, "1e+09");
+	test_real(3.4028235e38f, "3.4028235e+38");
+	test_real(1e-45f, "1e-45");
+	test_real(1.17549435e-38f, "1.1754944e-38");
+
+	/* random bit patterns */
+	for (i = 0; i < 200000; ++i) {
+		uint64_t bits = rnd64();
+		uint32_t bits32 = (uint32_t) bits;
+		double d;
+		float f;
+
+		memcpy(&d, &bits, sizeof(d));
+		memcpy(&f, &bits32, sizeof(f));
+		check_double(d);
+		check_real(f);
+	}
+
+	/* short decimal numbers */
+	for (i = 0; i < 200000; ++i) {
+		double d = (double) (int64_t) (rnd64() % 2000000000u - 1000000000) / 10000.0;
+
+		check_double(d);
+		check_real((float) d);
+	}
+
+	/* integers */
+	for (i = 0; i < 100000; ++i) {
+		check_double((double) (int64_t) rnd64());
+		check_real((float) (int32_t) rnd64());
+	}
+
+	return 0;
+}
@@ -337,7 +337,8 @@ test_shutdown(void)
 	shutdown_server_socket();
 	was_shutdown = true;
 	tds_freeze_close(&outer);
-	buf.len = BLOCK_SIZE - 8;
+	/* packets are gathered till the end of the message, nothing was sent */
+	buf.len = 0;
 }
 
 /* test freeze cross packet boundary */
@@ -389,6 +390,57 @@ test_end(void)
 	tds_freeze_close(&outer);
 }
 
+/* freeze a lot of packets, more than we can send with a single call */
+static void
+test_many(void)
+{
+	TDSFREEZE outer;
+	unsigned n;
+
+	tds_freeze(tds, &outer, 4);
+	append_num(BLOCK_SIZE * 150, 4);
+	for (n = 0; n < 150; ++n)
+		append(NULL, BLOCK_SIZE);
+	tds_freeze_close(&outer);
+}
+
+/* check packets are reused from the pool */
+static void
+test_pool(void)
+{
+	TDSPACKETPOOL *pool = tds->conn->packet_pool;
+	TDSPACKETPOOLSTATS stats;
+	unsigned long hits;
+
+	test_many();
+	tds_get_packet_pool_stats(pool, &stats);
+	assert(stats.cached > 0 && stats.cached <= TDS_DEF_PACKET_POOL_SIZE * TDS_PACKET_POOL_CLASSES);
+	assert(stats.discards > 0);
+	hits = stats.hits;
+
+	test_many();
+	tds_get_packet_pool_stats(pool, &stats);
+	assert(stats.hits > hits);
+
+	/* reducing the high-water mark frees packets */
+	tds_set_packet_pool_size(pool, 1);
+	tds_get_packet_pool_stats(pool, &stats);
+	assert(stats.cached <= TDS_PACKET_POOL_CLASSES);
+	tds_set_packet_pool_size(pool, TDS_DEF_PACKET_POOL_SIZE);
+
+	/* a pool shared with the context is not changed by a connection */
+	assert(pool == tds_get_ctx(tds)->packet_pool);
+	assert(tds_connection_set_packet_pool_size(tds->conn, 2));
+	assert(tds->conn->packet_pool != pool);
+	assert(pool->max_packets == TDS_DEF_PACKET_POOL_SIZE);
+	assert(tds->conn->packet_pool->max_packets == 2);
+
+	/* a private pool is changed in place */
+	pool = tds->conn->packet_pool;
+	assert(tds_connection_set_packet_pool_size(tds->conn, 3));
+	assert(tds->conn->packet_pool == pool && pool->max_packets == 3);
+}
+
 /* close the socket, force thread to stop also */
 static void
 shutdown_server_socket(void)
@@ -480,6 +532,8 @@ TEST_MAIN()
 		test(mars, test_cross1);
 		test(mars, test_cross2);
 		test(mars, test_end);
+		test(mars, test_many);
+		test(mars, test_pool);
 	}
 
 	return 0;
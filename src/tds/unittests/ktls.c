@@ -0,0 +1,649 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: check record keys passed to kernel TLS.
+ * Records are encrypted and decrypted here using the keys like the
+ * kernel would do and exchanged with an OpenSSL server.
+ * Also check the handoff to the kernel over a TCP connection and that
+ * TLS 1.3 sessions are not saved if kernel receives the tickets; kernel
+ * part is tested only if the kernel supports TLS.
+ */
+#undef NDEBUG
+#include "../tls.c"
+
+#include "common.h"
+#include <assert.h>
+
+#include <freetds/thread.h>
+
+#if defined(HAVE_OPENSSL) && defined(TDS_HAVE_KTLS)
+
+#include <openssl/evp.h>
+
+#if HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#endif /* HAVE_NETINET_IN_H */
+
+typedef struct
+{
+	const char *name;
+	int version;
+	const char *ciphers;
+} TEST_CASE;
+
+static const TEST_CASE *cur_test;
+static EVP_PKEY *server_key;
+static X509 *server_cert;
+
+static void
+create_certificate(void)
+{
+	EVP_PKEY_CTX *kctx;
+	X509_NAME *name;
+
+	kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+	assert(kctx);
+	assert(EVP_PKEY_keygen_init(kctx) > 0);
+	assert(EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx, NID_X9_62_prime256v1) > 0);
+	assert(EVP_PKEY_keygen(kctx, &server_key) > 0);
+	EVP_PKEY_CTX_free(kctx);
+
+	server_cert = X509_new();
+	assert(server_cert);
+	X509_set_version(server_cert, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(server_cert), 1);
+	X509_gmtime_adj(X509_getm_notBefore(server_cert), 0);
+	X509_gmtime_adj(X509_getm_notAfter(server_cert), 3600);
+	X509_set_pubkey(server_cert, server_key);
+	name = X509_get_subject_name(server_cert);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *) "localhost", -1, -1, 0);
+	X509_set_issuer_name(server_cert, name);
+	assert(X509_sign(server_cert, server_key, EVP_sha256()) > 0);
+}
+
+static SSL_CTX *
+create_server_ctx(int version, const char *ciphers)
+{
+	SSL_CTX *ctx;
+
+	ctx = SSL_CTX_new(TLS_server_method());
+	assert(ctx);
+	assert(SSL_CTX_use_certificate(ctx, server_cert) == 1);
+	assert(SSL_CTX_use_PrivateKey(ctx, server_key) == 1);
+	SSL_CTX_set_min_proto_version(ctx, version);
+	SSL_CTX_set_max_proto_version(ctx, version);
+	if (version == TLS1_3_VERSION)
+		assert(SSL_CTX_set_ciphersuites(ctx, ciphers) == 1);
+	else
+		assert(SSL_CTX_set_cipher_list(ctx, ciphers) == 1);
+	return ctx;
+}
+
+/* server, receive some data and reply */
+static TDS_THREAD_PROC_DECLARE(server_proc, arg)
+{
+	TDS_SYS_SOCKET s = (TDS_SYS_SOCKET) TDS_PTR2INT(arg);
+	SSL_CTX *ctx;
+	SSL *ssl;
+	char buf[64];
+	int len;
+
+	ctx = create_server_ctx(cur_test->version, cur_test->ciphers);
+
+	ssl = SSL_new(ctx);
+	assert(ssl);
+	SSL_set_fd(ssl, s);
+	assert(SSL_accept(ssl) == 1);
+
+	len = SSL_read(ssl, buf, sizeof(buf) - 1);
+	assert(len > 0);
+	buf[len] = 0;
+	assert(strcmp(buf, "hello server") == 0);
+
+	assert(SSL_write(ssl, "hello client", 12) == 12);
+
+	len = SSL_read(ssl, buf, sizeof(buf) - 1);
+	assert(len > 0);
+	buf[len] = 0;
+	assert(strcmp(buf, "bye") == 0);
+
+	SSL_free(ssl);
+	SSL_CTX_free(ctx);
+	CLOSESOCKET(s);
+	return TDS_THREAD_RESULT(0);
+}
+
+static const EVP_CIPHER *
+get_cipher(const TDS_KTLS_KEYS *keys)
+{
+	switch (keys->cipher) {
+	case TLS_CIPHER_AES_GCM_128:
+		return EVP_aes_128_gcm();
+	case TLS_CIPHER_AES_GCM_256:
+		return EVP_aes_256_gcm();
+	}
+	return EVP_chacha20_poly1305();
+}
+
+/* TLS 1.2 with AES-GCM sends part of the nonce explicitly */
+static bool
+explicit_nonce(const TDS_KTLS_KEYS *keys)
+{
+	return keys->version == TLS_1_2_VERSION && keys->cipher != 54 /* TLS_CIPHER_CHACHA20_POLY1305 */;
+}
+
+static void
+compute_nonce(const TDS_KTLS_KEYS *keys, const TDS_KTLS_DIR_KEYS *dir_keys, const unsigned char *explicit,
+	      unsigned char *nonce)
+{
+	int i;
+
+	if (explicit_nonce(keys)) {
+		memcpy(nonce, dir_keys->iv, 4);
+		memcpy(nonce + 4, explicit, 8);
+		return;
+	}
+	memcpy(nonce, dir_keys->iv, 12);
+	for (i = 0; i < 8; ++i)
+		nonce[4 + i] ^= dir_keys->seq[i];
+}
+
+static void
+next_seq(TDS_KTLS_DIR_KEYS *dir_keys)
+{
+	int i;
+
+	for (i = 7; i >= 0 && ++dir_keys->seq[i] == 0; --i)
+		continue;
+}
+
+static void
+tls12_aad(const TDS_KTLS_DIR_KEYS *dir_keys, unsigned char type, size_t len, unsigned char *aad)
+{
+	memcpy(aad, dir_keys->seq, 8);
+	aad[8] = type;
+	aad[9] = 3;
+	aad[10] = 3;
+	aad[11] = (unsigned char) (len >> 8);
+	aad[12] = (unsigned char) len;
+}
+
+/* encrypt a record like kernel would do */
+static void
+send_record(TDSCONNECTION *conn, const TDS_KTLS_KEYS *keys, TDS_KTLS_DIR_KEYS *dir_keys, const char *data)
+{
+	unsigned char record[256], plain[128], nonce[12], aad[13], *p;
+	size_t plain_len = strlen(data), aad_len, rec_len;
+	EVP_CIPHER_CTX *c;
+	int len;
+
+	memcpy(plain, data, plain_len);
+	if (keys->version == TLS_1_3_VERSION)
+		plain[plain_len++] = TDS_TLS_APPLICATION_DATA;
+
+	rec_len = (explicit_nonce(keys) ? 8 : 0) + plain_len + 16;
+	record[0] = TDS_TLS_APPLICATION_DATA;
+	record[1] = 3;
+	record[2] = 3;
+	record[3] = (unsigned char) (rec_len >> 8);
+	record[4] = (unsigned char) rec_len;
+	p = record + 5;
+	if (explicit_nonce(keys)) {
+		memcpy(p, dir_keys->seq, 8);
+		p += 8;
+	}
+
+	if (keys->version == TLS_1_3_VERSION) {
+		memcpy(aad, record, 5);
+		aad_len = 5;
+	} else {
+		tls12_aad(dir_keys, TDS_TLS_APPLICATION_DATA, plain_len, aad);
+		aad_len = 13;
+	}
+	compute_nonce(keys, dir_keys, dir_keys->seq, nonce);
+
+	c = EVP_CIPHER_CTX_new();
+	assert(c);
+	assert(EVP_EncryptInit_ex(c, get_cipher(keys), NULL, NULL, NULL) == 1);
+	assert(EVP_CIPHER_CTX_ctrl(c, EVP_CTRL_AEAD_SET_IVLEN, 12, NULL) == 1);
+	assert(EVP_EncryptInit_ex(c, NULL, NULL, dir_keys->key, nonce) == 1);
+	assert(EVP_EncryptUpdate(c, NULL, &len, aad, (int) aad_len) == 1);
+	assert(EVP_EncryptUpdate(c, p, &len, plain, (int) plain_len) == 1);
+	p += len;
+	assert(EVP_EncryptFinal_ex(c, p, &len) == 1);
+	p += len;
+	assert(EVP_CIPHER_CTX_ctrl(c, EVP_CTRL_AEAD_GET_TAG, 16, p) == 1);
+	p += 16;
+	EVP_CIPHER_CTX_free(c);
+
+	assert(p - record == 5 + (ptrdiff_t) rec_len);
+	assert(WRITESOCKET(conn->s, record, p - record) == p - record);
+	next_seq(dir_keys);
+}
+
+static void
+read_all(TDS_SYS_SOCKET s, unsigned char *buf, size_t len)
+{
+	while (len) {
+		ptrdiff_t got = READSOCKET(s, buf, len);
+
+		assert(got > 0);
+		buf += got;
+		len -= got;
+	}
+}
+
+/* decrypt a record like kernel would do */
+static unsigned char
+recv_record(TDSCONNECTION *conn, const TDS_KTLS_KEYS *keys, TDS_KTLS_DIR_KEYS *dir_keys, char *data)
+{
+	unsigned char header[5], record[4096], nonce[12], aad[13], *ct;
+	size_t rec_len, ct_len, aad_len;
+	unsigned char type;
+	EVP_CIPHER_CTX *c;
+	int len, plain_len;
+
+	read_all(conn->s, header, 5);
+	type = header[0];
+	rec_len = header[3] * 256u + header[4];
+	assert(rec_len <= sizeof(record));
+	read_all(conn->s, record, rec_len);
+
+	ct = record;
+	ct_len = rec_len - 16;
+	if (explicit_nonce(keys)) {
+		ct += 8;
+		ct_len -= 8;
+	}
+
+	if (keys->version == TLS_1_3_VERSION) {
+		memcpy(aad, header, 5);
+		aad_len = 5;
+	} else {
+		tls12_aad(dir_keys, type, ct_len, aad);
+		aad_len = 13;
+	}
+	compute_nonce(keys, dir_keys, record, nonce);
+
+	c = EVP_CIPHER_CTX_new();
+	assert(c);
+	assert(EVP_DecryptInit_ex(c, get_cipher(keys), NULL, NULL, NULL) == 1);
+	assert(EVP_CIPHER_CTX_ctrl(c, EVP_CTRL_AEAD_SET_IVLEN, 12, NULL) == 1);
+	assert(EVP_DecryptInit_ex(c, NULL, NULL, dir_keys->key, nonce) == 1);
+	assert(EVP_DecryptUpdate(c, NULL, &len, aad, (int) aad_len) == 1);
+	assert(EVP_DecryptUpdate(c, (unsigned char *) data, &len, ct, (int) ct_len) == 1);
+	plain_len = len;
+	assert(EVP_CIPHER_CTX_ctrl(c, EVP_CTRL_AEAD_SET_TAG, 16, ct + ct_len) == 1);
+	assert(EVP_DecryptFinal_ex(c, (unsigned char *) data + plain_len, &len) == 1);
+	plain_len += len;
+	EVP_CIPHER_CTX_free(c);
+	next_seq(dir_keys);
+
+	/* TLS 1.3 has real type at the end */
+	if (keys->version == TLS_1_3_VERSION) {
+		while (plain_len > 0 && data[plain_len - 1] == 0)
+			--plain_len;
+		assert(plain_len > 0);
+		type = (unsigned char) data[--plain_len];
+	}
+	data[plain_len] = 0;
+	return type;
+}
+
+static void
+test(const TEST_CASE *test_case)
+{
+	TDSCONTEXT *ctx;
+	TDSSOCKET *tds;
+	TDSLOGIN *login;
+	TDS_SYS_SOCKET sockets[2];
+	tds_thread server_thread;
+	TDS_KTLS_KEYS keys;
+	char buf[4096];
+
+	printf("Testing %s\n", test_case->name);
+	cur_test = test_case;
+
+	ctx = tds_alloc_context(NULL);
+	assert(ctx);
+	tds = tds_alloc_socket(ctx, 512);
+	assert(tds);
+	login = tds_alloc_login(false);
+	assert(login);
+	login->use_ktls = 1;
+	tds->login = login;
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) >= 0);
+	tds->state = TDS_IDLE;
+	tds_set_s(tds, sockets[0]);
+	assert(tds_thread_create(&server_thread, server_proc, TDS_INT2PTR(sockets[1])) == 0);
+
+	assert(TDS_SUCCEED(tds_ssl_init(tds, true)));
+
+	/* kernel does not support TLS on Unix sockets, library is still used */
+	assert(!tds->conn->ktls_tx && !tds->conn->ktls_rx);
+
+	assert(tds_ktls_get_keys(tds->conn, &keys));
+	assert(keys.version == (test_case->version == TLS1_3_VERSION ? TLS_1_3_VERSION : TLS_1_2_VERSION));
+
+	send_record(tds->conn, &keys, &keys.tx, "hello server");
+
+	/* skip session tickets */
+	while (recv_record(tds->conn, &keys, &keys.rx, buf) == TDS_TLS_HANDSHAKE)
+		continue;
+	assert(strcmp(buf, "hello client") == 0);
+
+	/* check sequence numbers are updated */
+	send_record(tds->conn, &keys, &keys.tx, "bye");
+
+	assert(tds_thread_join(server_thread, NULL) == 0);
+
+	tds->login = NULL;
+	tds_free_login(login);
+	tds_free_socket(tds);
+	tds_free_context(ctx);
+}
+
+/* connected TCP sockets, kernel supports TLS only on TCP */
+static void
+tcp_pair(TDS_SYS_SOCKET sockets[2])
+{
+	TDS_SYS_SOCKET listen_sock;
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+
+	listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+	assert(!TDS_IS_SOCKET_INVALID(listen_sock));
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	assert(bind(listen_sock, (struct sockaddr *) &sin, sizeof(sin)) == 0);
+	assert(listen(listen_sock, 1) == 0);
+	assert(getsockname(listen_sock, (struct sockaddr *) &sin, &len) == 0);
+	sockets[0] = socket(AF_INET, SOCK_STREAM, 0);
+	assert(!TDS_IS_SOCKET_INVALID(sockets[0]));
+	assert(connect(sockets[0], (struct sockaddr *) &sin, sizeof(sin)) == 0);
+	sockets[1] = accept(listen_sock, NULL, NULL);
+	assert(!TDS_IS_SOCKET_INVALID(sockets[1]));
+	CLOSESOCKET(listen_sock);
+}
+
+/* handoff test, server side */
+static SSL *handoff_ssl;
+
+/* handshake then send a session ticket and two records at once */
+static TDS_THREAD_PROC_DECLARE(handoff_accept_proc, arg)
+{
+	TDS_SYS_SOCKET s = (TDS_SYS_SOCKET) TDS_PTR2INT(arg);
+	SSL_CTX *ctx;
+	BIO *mem;
+	char *data;
+	long len;
+
+	ctx = create_server_ctx(TLS1_3_VERSION, "TLS_AES_128_GCM_SHA256");
+	handoff_ssl = SSL_new(ctx);
+	assert(handoff_ssl);
+	SSL_CTX_free(ctx);
+	SSL_set_fd(handoff_ssl, s);
+	SSL_set_num_tickets(handoff_ssl, 0);
+	assert(SSL_accept(handoff_ssl) == 1);
+
+	mem = BIO_new(BIO_s_mem());
+	assert(mem);
+	BIO_up_ref(mem);
+	SSL_set0_wbio(handoff_ssl, mem);
+	assert(SSL_new_session_ticket(handoff_ssl) == 1);
+	assert(SSL_write(handoff_ssl, "one", 3) == 3);
+	assert(SSL_write(handoff_ssl, "two", 3) == 3);
+	len = BIO_get_mem_data(mem, &data);
+	assert(len > 0);
+	assert(WRITESOCKET(s, data, len) == len);
+	BIO_free(mem);
+	SSL_set0_wbio(handoff_ssl, BIO_new_socket(s, BIO_NOCLOSE));
+	return TDS_THREAD_RESULT(0);
+}
+
+/* send a record, update keys and send another one */
+static TDS_THREAD_PROC_DECLARE(handoff_update_proc, arg)
+{
+	char buf[64];
+	int len;
+
+	len = SSL_read(handoff_ssl, buf, sizeof(buf) - 1);
+	assert(len > 0);
+	buf[len] = 0;
+	assert(strcmp(buf, "next") == 0);
+
+	assert(SSL_write(handoff_ssl, "three", 5) == 5);
+	assert(SSL_key_update(handoff_ssl, SSL_KEY_UPDATE_NOT_REQUESTED) == 1);
+	assert(SSL_write(handoff_ssl, "four", 4) == 4);
+
+	/* wait for client to close */
+	SSL_read(handoff_ssl, buf, sizeof(buf));
+	return TDS_THREAD_RESULT(0);
+}
+
+static void
+test_handoff(void)
+{
+	TDSCONTEXT *ctx;
+	TDSSOCKET *tds;
+	TDSLOGIN *login;
+	TDS_SYS_SOCKET sockets[2];
+	tds_thread server_thread;
+	unsigned char buf[64];
+
+	printf("Testing handoff\n");
+
+	tcp_pair(sockets);
+
+	ctx = tds_alloc_context(NULL);
+	assert(ctx);
+	tds = tds_alloc_socket(ctx, 512);
+	assert(tds);
+	login = tds_alloc_login(false);
+	assert(login);
+	tds->login = login;
+	tds->state = TDS_IDLE;
+	tds_set_s(tds, sockets[0]);
+	assert(tds_set_read_ahead(tds->conn, 32768));
+
+	assert(tds_thread_create(&server_thread, handoff_accept_proc, TDS_INT2PTR(sockets[1])) == 0);
+	assert(TDS_SUCCEED(tds_ssl_init(tds, true)));
+	assert(tds_thread_join(server_thread, NULL) == 0);
+	set_current_tds(tds->conn, tds);
+
+	/* reading first record reads the ticket and the second record too */
+	assert(tds_connection_read(tds, buf, 3) == 3);
+	assert(memcmp(buf, "one", 3) == 0);
+	assert(tds_ktls_read_ahead_pending(tds->conn));
+
+	/* kernel would not see the record */
+	login->use_ktls = 1;
+	assert(TDS_SUCCEED(tds_ssl_ktls_start(tds)));
+	assert(!tds->conn->ktls_tx && !tds->conn->ktls_rx);
+
+	assert(tds_connection_read(tds, buf, 3) == 3);
+	assert(memcmp(buf, "two", 3) == 0);
+	assert(!tds_ktls_read_ahead_pending(tds->conn));
+
+	/* now kernel can be used, if supported, in both directions or none */
+	assert(TDS_SUCCEED(tds_ssl_ktls_start(tds)));
+	assert(tds->conn->ktls_tx == tds->conn->ktls_rx);
+	printf("kernel TLS send %d receive %d\n", tds->conn->ktls_tx, tds->conn->ktls_rx);
+
+	assert(tds_thread_create(&server_thread, handoff_update_proc, NULL) == 0);
+	assert(tds_connection_write(tds, (const unsigned char *) "next", 4, 1) == 4);
+	assert(tds_connection_read(tds, buf, 5) == 5);
+	assert(memcmp(buf, "three", 5) == 0);
+
+	/* kernel cannot follow the key update, library can */
+	if (tds->conn->ktls_rx) {
+		assert(tds_connection_read(tds, buf, 4) < 0);
+	} else {
+		assert(tds_connection_read(tds, buf, 4) == 4);
+		assert(memcmp(buf, "four", 4) == 0);
+	}
+	set_current_tds(tds->conn, NULL);
+
+	tds->login = NULL;
+	tds_free_login(login);
+	tds_free_socket(tds);
+	tds_free_context(ctx);
+	assert(tds_thread_join(server_thread, NULL) == 0);
+	SSL_free(handoff_ssl);
+	CLOSESOCKET(sockets[1]);
+}
+
+/* TLS 1.3 handshake then send a record, tickets are sent by default */
+static TDS_THREAD_PROC_DECLARE(ticket_proc, arg)
+{
+	TDS_SYS_SOCKET s = (TDS_SYS_SOCKET) TDS_PTR2INT(arg);
+	SSL_CTX *ctx;
+	SSL *ssl;
+	char buf[64];
+
+	ctx = create_server_ctx(TLS1_3_VERSION, "TLS_AES_128_GCM_SHA256");
+	ssl = SSL_new(ctx);
+	assert(ssl);
+	SSL_set_fd(ssl, s);
+	assert(SSL_accept(ssl) == 1);
+	assert(SSL_write(ssl, "data", 4) == 4);
+
+	/* wait for client to close */
+	SSL_read(ssl, buf, sizeof(buf));
+	SSL_free(ssl);
+	SSL_CTX_free(ctx);
+	CLOSESOCKET(s);
+	return TDS_THREAD_RESULT(0);
+}
+
+/*
+ * Kernel TLS and TLS 1.3 session cache exclude each other, tickets
+ * are discarded by the kernel so session is saved only if library
+ * keeps receiving.
+ */
+static void
+test_session_ticket(void)
+{
+	TDSCONTEXT *ctx;
+	TDSSOCKET *tds;
+	TDSLOGIN *login;
+	TDS_SYS_SOCKET sockets[2];
+	tds_thread server_thread;
+	unsigned char buf[64], *session;
+	size_t len;
+
+	printf("Testing session tickets\n");
+
+	tcp_pair(sockets);
+
+	ctx = tds_alloc_context(NULL);
+	assert(ctx && ctx->tls_sessions);
+	tds = tds_alloc_socket(ctx, 512);
+	assert(tds);
+	login = tds_alloc_login(false);
+	assert(login);
+	login->use_ktls = 1;
+	tds->login = login;
+	tds->state = TDS_IDLE;
+	tds_set_s(tds, sockets[0]);
+
+	assert(tds_thread_create(&server_thread, ticket_proc, TDS_INT2PTR(sockets[1])) == 0);
+	assert(TDS_SUCCEED(tds_ssl_init(tds, true)));
+	assert(tds->conn->ktls_tx == tds->conn->ktls_rx);
+	printf("kernel TLS send %d receive %d\n", tds->conn->ktls_tx, tds->conn->ktls_rx);
+	assert(tds->conn->tls_session_key);
+
+	set_current_tds(tds->conn, tds);
+	assert(tds_connection_read(tds, buf, 4) == 4);
+	assert(memcmp(buf, "data", 4) == 0);
+	set_current_tds(tds->conn, NULL);
+
+	session = tds_tls_session_get(tds->conn, &len);
+	if (tds->conn->ktls_rx)
+		assert(session == NULL);
+	else
+		assert(session != NULL && len > 0);
+	free(session);
+
+	tds->login = NULL;
+	tds_free_login(login);
+	tds_free_socket(tds);
+	tds_free_context(ctx);
+	assert(tds_thread_join(server_thread, NULL) == 0);
+}
+
+/* only key updates stop the kernel */
+static void
+test_key_update(void)
+{
+	static const unsigned char ticket[] = { 4, 0, 0, 3, 1, 2, 3 };
+	static const unsigned char update[] = { 4, 0, 0, 3, 1, 2, 3, TDS_TLS_KEY_UPDATE, 0, 0, 1, 0 };
+
+	assert(!tds_ktls_key_update(ticket, sizeof(ticket)));
+	assert(tds_ktls_key_update(update, sizeof(update)));
+	assert(tds_ktls_key_update(update + 7, 5));
+	assert(!tds_ktls_key_update(update, 4));
+}
+
+static const TEST_CASE tests[] = {
+	{ "TLS 1.2 AES-128-GCM", TLS1_2_VERSION, "ECDHE-ECDSA-AES128-GCM-SHA256" },
+	{ "TLS 1.2 AES-256-GCM", TLS1_2_VERSION, "ECDHE-ECDSA-AES256-GCM-SHA384" },
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+	{ "TLS 1.2 CHACHA20-POLY1305", TLS1_2_VERSION, "ECDHE-ECDSA-CHACHA20-POLY1305" },
+#endif
+	{ "TLS 1.3 AES-128-GCM", TLS1_3_VERSION, "TLS_AES_128_GCM_SHA256" },
+	{ "TLS 1.3 AES-256-GCM", TLS1_3_VERSION, "TLS_AES_256_GCM_SHA384" },
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+	{ "TLS 1.3 CHACHA20-POLY1305", TLS1_3_VERSION, "TLS_CHACHA20_POLY1305_SHA256" },
+#endif
+};
+
+TEST_MAIN()
+{
+	size_t i;
+
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	tdsdump_topen(tds_dir_getenv(TDS_DIR("TDSDUMP")));
+
+	create_certificate();
+
+	for (i = 0; i < TDS_VECTOR_SIZE(tests); ++i)
+		test(&tests[i]);
+
+	test_key_update();
+	test_handoff();
+	test_session_ticket();
+
+	X509_free(server_cert);
+	EVP_PKEY_free(server_key);
+	return 0;
+}
+#else
+TEST_MAIN()
+{
+	printf("Kernel TLS not supported.\n");
+	return 0;
+}
+#endif
@@ -0,0 +1,232 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: test reuse of result metadata received again
+ */
+#include "common.h"
+#include <assert.h>
+#include <freetds/bytes.h>
+#include <freetds/iconv.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#include <freetds/replacements.h>
+
+#ifndef _WIN32
+static TDSSOCKET *tds = NULL;
+
+/* metadata with an int and a varbinary(20), extra columns are nullable ints */
+static unsigned char *
+add_meta(unsigned char *p, int extra)
+{
+	int i;
+
+	*p++ = TDS7_RESULT_TOKEN;
+	TDS_PUT_A2LE(p, 2 + extra);
+	p += 2;
+
+	memset(p, 0, 6);		/* usertype, flags */
+	p[6] = SYBINT4;
+	p[7] = 1;			/* name "a" */
+	p[8] = 'a';
+	p[9] = 0;
+	p += 10;
+
+	memset(p, 0, 6);
+	p[6] = XSYBVARBINARY;
+	TDS_PUT_A2LE(p + 7, 20);
+	p[9] = 1;			/* name "b" */
+	p[10] = 'b';
+	p[11] = 0;
+	p += 12;
+
+	for (i = 0; i < extra; ++i) {
+		memset(p, 0, 6);
+		p[6] = SYBINTN;
+		p[7] = 4;
+		p[8] = 1;		/* name "c" */
+		p[9] = 'c';
+		p[10] = 0;
+		p += 11;
+	}
+	return p;
+}
+
+static unsigned char *
+add_row(unsigned char *p, TDS_INT num, const char *s, int extra)
+{
+	size_t len = strlen(s);
+
+	*p++ = TDS_ROW_TOKEN;
+	TDS_PUT_A4LE(p, num);
+	TDS_PUT_A2LE(p + 4, len);
+	memcpy(p + 6, s, len);
+	p += 6 + len;
+	for (; extra > 0; --extra)
+		*p++ = 0;
+	return p;
+}
+
+static unsigned char *
+add_done(unsigned char *p)
+{
+	*p++ = TDS_DONE_TOKEN;
+	memset(p, 0, 12);
+	return p + 12;
+}
+
+/*
+ * Send a result with a row and read it.
+ * If split is not 0 metadata are split at this position.
+ */
+static TDSRESULTINFO *
+query(TDS_INT num, const char *s, int extra, size_t split)
+{
+	unsigned char buf[256], *p;
+	TDS_INT result_type;
+	int done_flags;
+	TDSCOLUMN *col;
+
+	/* new query, like tds_submit_query() */
+	tds_free_all_results(tds);
+
+	p = add_meta(buf, extra);
+	p = add_row(p, num, s, extra);
+	p = add_done(p);
+	if (split) {
+		fake_server_send_packet(buf, split, false);
+		fake_server_send_packet(buf + split, p - buf - split, true);
+	} else {
+		fake_server_send_packet(buf, p - buf, true);
+	}
+	tds->state = TDS_PENDING;
+
+	assert(tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_ROWFMT) == TDS_SUCCESS);
+	assert(result_type == TDS_ROWFMT_RESULT);
+	assert(tds->res_info && tds->res_info == tds->current_results);
+	assert(tds->res_info->num_cols == 2 + extra);
+	assert(strcmp(tds_dstr_cstr(&tds->res_info->columns[1]->column_name), "b") == 0);
+	/* binding of a previous query must not survive */
+	col = tds->res_info->columns[0];
+	assert(col->column_varaddr == NULL && col->column_bindtype == 0);
+	col->column_varaddr = (TDS_CHAR *) buf;
+	col->column_bindtype = 1;
+
+	assert(tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_ROW) == TDS_SUCCESS);
+	assert(result_type == TDS_ROW_RESULT);
+	assert(*(TDS_INT *) col->column_data == num);
+	col = tds->res_info->columns[1];
+	assert(col->column_cur_size == (TDS_INT) strlen(s) && memcmp(col->column_data, s, strlen(s)) == 0);
+	if (extra)
+		assert(tds->res_info->columns[2]->column_cur_size < 0);
+
+	assert(tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_DONE) == TDS_SUCCESS);
+	assert(result_type == TDS_DONE_RESULT);
+	assert(tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_DONE) == TDS_NO_MORE_RESULTS);
+	tds_set_state(tds, TDS_IDLE);
+
+	return tds->res_info;
+}
+
+/* allocations done by the socket arena, results not reused need new ones */
+static unsigned long
+allocs(void)
+{
+	TDSARENASTATS stats;
+
+	tds_get_arena_stats(tds, &stats);
+	return stats.allocs;
+}
+
+static void
+test_reuse(void)
+{
+	TDSRESULTINFO *info, *kept;
+	unsigned long n;
+
+	/* same metadata, same result */
+	info = query(1, "first", 0, 0);
+	assert(tds->meta_cache.info == info);
+	n = allocs();
+	assert(query(2, "second", 0, 0) == info);
+	assert(query(3, "third", 0, 0) == info);
+	assert(allocs() == n);
+
+	/* different metadata */
+	info = query(4, "other", 1, 0);
+	assert(tds->meta_cache.info == info && info->num_cols == 3);
+	assert(allocs() > n);
+	n = allocs();
+	assert(query(5, "again", 1, 0) == info);
+	assert(allocs() == n);
+	info = query(6, "back", 0, 0);
+	assert(tds->meta_cache.info == info && info->num_cols == 2);
+
+	/* a result still used by the application is not reused */
+	kept = query(7, "kept", 0, 0);
+	++kept->ref_count;
+	info = query(8, "new", 0, 0);
+	assert(info != kept);
+	assert(kept->ref_count == 1);
+	tds_free_results(kept);
+	assert(query(9, "cached", 0, 0) == info);
+
+	/* metadata split between packets are read but not cached */
+	query(10, "split", 0, 10);
+	assert(tds->meta_cache.info == NULL);
+	info = query(11, "not split", 0, 0);
+	assert(tds->meta_cache.info == info);
+
+	/* changing charset invalidates the cache */
+	++tds->conn->charset_changes;
+	n = allocs();
+	query(12, "charset", 0, 0);
+	assert(allocs() > n);
+}
+
+TEST_MAIN()
+{
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	tdsdump_topen(tds_dir_getenv(TDS_DIR("TDSDUMP")));
+
+	/* provide connection to a fake remote server */
+	tds = fake_server_open();
+	tds_iconv_open(tds->conn, "ISO-8859-1", 0);
+	tds->conn->tds_version = 0x704;
+
+	test_reuse();
+
+	fake_server_close(tds);
+
+	return 0;
+}
+#else
+TEST_MAIN()
+{
+	printf("Test requires socketpair.\n");
+	return 0;
+}
+#endif
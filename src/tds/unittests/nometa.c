@@ -0,0 +1,254 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: test executing prepared statements without receiving metadata
+ */
+#include "common.h"
+#include <assert.h>
+#include <freetds/bytes.h>
+#include <freetds/iconv.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#include <freetds/replacements.h>
+
+#ifndef _WIN32
+static TDSSOCKET *tds = NULL;
+static TDSDYNAMIC *dyn = NULL;
+
+/* metadata with an int and a varbinary(20), or no metadata */
+static unsigned char *
+add_meta(unsigned char *p, bool no_meta)
+{
+	*p++ = TDS7_RESULT_TOKEN;
+	if (no_meta) {
+		TDS_PUT_A2LE(p, 0xffff);
+		return p + 2;
+	}
+	TDS_PUT_A2LE(p, 2);
+	p += 2;
+
+	memset(p, 0, 6);		/* usertype, flags */
+	p[6] = SYBINT4;
+	p[7] = 1;			/* name "a" */
+	p[8] = 'a';
+	p[9] = 0;
+	p += 10;
+
+	memset(p, 0, 6);
+	p[6] = XSYBVARBINARY;
+	TDS_PUT_A2LE(p + 7, 20);
+	p[9] = 1;			/* name "b" */
+	p[10] = 'b';
+	p[11] = 0;
+	return p + 12;
+}
+
+static unsigned char *
+add_row(unsigned char *p, TDS_INT num, const char *s)
+{
+	size_t len = strlen(s);
+
+	*p++ = TDS_ROW_TOKEN;
+	TDS_PUT_A4LE(p, num);
+	TDS_PUT_A2LE(p + 4, len);
+	memcpy(p + 6, s, len);
+	return p + 6 + len;
+}
+
+static unsigned char *
+add_done(unsigned char *p, unsigned status)
+{
+	*p++ = TDS_DONE_TOKEN;
+	memset(p, 0, 12);
+	TDS_PUT_A2LE(p, status);
+	return p + 12;
+}
+
+/* read sp_execute request from the fake server side and return its flags */
+static unsigned
+read_flags(void)
+{
+	static const unsigned char name[] = "s\0p\0_\0e\0x\0e\0c\0u\0t\0e";
+	unsigned char buf[512];
+	size_t len = 0, pos;
+	ptrdiff_t got;
+
+	while (len < 8 || len < TDS_GET_A2BE(buf + 2)) {
+		got = READSOCKET(fake_server_socket, buf + len, sizeof(buf) - len);
+		assert(got > 0);
+		len += got;
+	}
+	assert(buf[0] == TDS_RPC && len == TDS_GET_A2BE(buf + 2));
+
+	for (pos = 8; pos + sizeof(name) + 2 <= len; ++pos)
+		if (memcmp(buf + pos, name, sizeof(name)) == 0)
+			return TDS_GET_A2LE(buf + pos + sizeof(name));
+	assert(!"sp_execute not found");
+	return 0;
+}
+
+/* read a result set with a row from the server */
+static TDSRESULTINFO *
+read_result(TDS_INT num, const char *s)
+{
+	TDS_INT result_type;
+	int done_flags;
+	TDSCOLUMN *col;
+
+	assert(tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_ROWFMT) == TDS_SUCCESS);
+	assert(result_type == TDS_ROWFMT_RESULT);
+	assert(tds->res_info && tds->res_info == tds->current_results);
+	assert(tds->res_info->num_cols == 2);
+	assert(strcmp(tds_dstr_cstr(&tds->res_info->columns[1]->column_name), "b") == 0);
+
+	assert(tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_ROW) == TDS_SUCCESS);
+	assert(result_type == TDS_ROW_RESULT);
+	col = tds->res_info->columns[0];
+	assert(*(TDS_INT *) col->column_data == num);
+	col = tds->res_info->columns[1];
+	assert(col->column_cur_size == (TDS_INT) strlen(s) && memcmp(col->column_data, s, strlen(s)) == 0);
+
+	return tds->res_info;
+}
+
+/*
+ * Execute the statement, the server returns results number of result sets.
+ * Server omits metadata if requested.
+ * Returns flags sent by the client.
+ */
+static unsigned
+execute(TDS_INT num, const char *s, int results, unsigned done_status)
+{
+	unsigned char buf[256], *p = buf;
+	unsigned flags;
+	TDS_INT result_type;
+	int i, done_flags;
+
+	assert(tds_submit_execute(tds, dyn) == TDS_SUCCESS);
+	flags = read_flags();
+
+	for (i = 0; i < results; ++i) {
+		p = add_meta(p, (flags & TDS_RPC_NO_METADATA) != 0);
+		p = add_row(p, num + i, s);
+		p = add_done(p, i + 1 < results ? TDS_DONE_MORE_RESULTS : done_status);
+	}
+	fake_server_send_packet(buf, p - buf, true);
+
+	for (i = 0; i < results; ++i) {
+		read_result(num + i, s);
+		assert(tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_DONE) == TDS_SUCCESS);
+		assert(result_type == TDS_DONE_RESULT);
+	}
+	assert(tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_DONE) == TDS_NO_MORE_RESULTS);
+	assert(tds->state == TDS_IDLE);
+
+	return flags;
+}
+
+static void
+test_no_meta(void)
+{
+	TDSRESULTINFO *info;
+
+	dyn = tds_alloc_dynamic(tds->conn, "test");
+	assert(dyn);
+	dyn->num_id = 1;
+
+	/* first execution receives metadata, next ones reuse them */
+	assert(execute(1, "first", 1, 0) == 0);
+	info = dyn->meta;
+	assert(info && info == tds->res_info);
+	/* cached by the connection, not in socket memory */
+	assert(info->arena == NULL);
+	assert(execute(2, "second", 1, 0) == TDS_RPC_NO_METADATA);
+	assert(tds->res_info == info);
+	assert(execute(3, "third", 1, 0) == TDS_RPC_NO_METADATA);
+	assert(tds->res_info == info);
+
+	/* metadata still used by the application are requested again */
+	++info->ref_count;
+	tds_free_all_results(tds);
+	assert(execute(4, "kept", 1, 0) == 0);
+	assert(tds->res_info != info && dyn->meta == tds->res_info);
+	tds_free_results(info);
+	assert(execute(5, "new", 1, 0) == TDS_RPC_NO_METADATA);
+
+	/* an error discards cached metadata */
+	assert(execute(6, "error", 1, TDS_DONE_ERROR) == TDS_RPC_NO_METADATA);
+	assert(dyn->meta == NULL);
+	assert(execute(7, "again", 1, 0) == 0);
+	assert(execute(8, "cached", 1, 0) == TDS_RPC_NO_METADATA);
+
+	tds_dynamic_deallocated(tds->conn, dyn);
+	tds_release_dynamic(&dyn);
+
+	/* with multiple result sets metadata are always requested */
+	dyn = tds_alloc_dynamic(tds->conn, "test2");
+	assert(dyn);
+	dyn->num_id = 2;
+	assert(execute(9, "multiple", 2, 0) == 0);
+	assert(dyn->meta == NULL && dyn->multiple_results);
+	assert(execute(11, "multiple", 2, 0) == 0);
+
+	/* feature is disabled by default */
+	tds_dynamic_deallocated(tds->conn, dyn);
+	tds_release_dynamic(&dyn);
+	dyn = tds_alloc_dynamic(tds->conn, "test3");
+	assert(dyn);
+	dyn->num_id = 3;
+	tds->conn->rpc_no_metadata = 0;
+	assert(execute(12, "disabled", 1, 0) == 0);
+	assert(dyn->meta == NULL);
+	assert(execute(13, "disabled", 1, 0) == 0);
+	tds_dynamic_deallocated(tds->conn, dyn);
+	tds_release_dynamic(&dyn);
+}
+
+TEST_MAIN()
+{
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	tdsdump_topen(tds_dir_getenv(TDS_DIR("TDSDUMP")));
+
+	/* provide connection to a fake remote server */
+	tds = fake_server_open();
+	tds_iconv_open(tds->conn, "ISO-8859-1", 0);
+	tds->conn->tds_version = 0x702;
+	tds->conn->rpc_no_metadata = 1;
+
+	test_no_meta();
+
+	fake_server_close(tds);
+
+	return 0;
+}
+#else
+TEST_MAIN()
+{
+	printf("Test requires socketpair.\n");
+	return 0;
+}
+#endif
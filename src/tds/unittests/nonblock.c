@@ -0,0 +1,215 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Purpose: test non-blocking mode driven by application
+ */
+#include "common.h"
+#include <assert.h>
+#include <freetds/bytes.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif /* HAVE_FCNTL_H */
+
+#if HAVE_POLL_H
+#include <poll.h>
+#endif /* HAVE_POLL_H */
+
+#include <freetds/replacements.h>
+
+#if ENABLE_ODBC_MARS && !defined(_WIN32)
+static TDSSOCKET *tds = NULL;
+
+/* two packets, each containing a DONE token */
+static unsigned char packet1[8 + 9];
+static unsigned char packet2[8 + 9];
+
+static void
+prepare_packet(unsigned char *pkt, bool final)
+{
+	fake_server_header(pkt, 8 + 9, final);
+	pkt[8] = TDS_DONE_TOKEN;
+	TDS_PUT_A2LE(pkt + 9, final ? TDS_DONE_COUNT : TDS_DONE_COUNT|TDS_DONE_MORE_RESULTS);
+	TDS_PUT_A2LE(pkt + 11, 0);
+	TDS_PUT_A4LE(pkt + 13, 1);
+}
+
+static void
+send_part(const unsigned char *pkt, size_t from, size_t to)
+{
+	fake_server_send(pkt + from, to - from);
+}
+
+static TDSRET
+process_tokens(void)
+{
+	TDS_INT result_type;
+	int done_flags;
+
+	return tds_process_tokens(tds, &result_type, &done_flags, TDS_TOKEN_RESULTS);
+}
+
+static void
+test_nonblock(void)
+{
+	unsigned char buf[64];
+	short events;
+	TDSRET rc;
+
+	assert(tds_set_nonblocking(tds, true) == TDS_SUCCESS);
+
+	/* request is queued */
+	tds->out_flag = TDS_QUERY;
+	assert(TDS_SUCCEED(tds_put_n(tds, "query", 5)));
+	assert(TDS_SUCCEED(tds_flush_packet(tds)));
+	tds->state = TDS_PENDING;
+	assert(tds_get_poll_events(tds, &events) == tds_get_s(tds));
+	assert(events == (POLLIN|POLLOUT));
+
+	/* send it */
+	assert(tds_process_events(tds, POLLOUT) == TDS_SUCCESS);
+	assert(tds_get_poll_events(tds, &events) == tds_get_s(tds));
+	assert(events == POLLIN);
+	assert(READSOCKET(fake_server_socket, buf, sizeof(buf)) == 8 + 5);
+	assert(buf[0] == TDS_QUERY && memcmp(buf + 8, "query", 5) == 0);
+
+	/* nothing received */
+	assert(process_tokens() == TDS_WOULD_BLOCK);
+	assert(tds_process_events(tds, POLLIN) == TDS_SUCCESS);
+	assert(process_tokens() == TDS_WOULD_BLOCK);
+
+	/* response partially received */
+	send_part(packet1, 0, sizeof(packet1));
+	send_part(packet2, 0, 5);
+	assert(tds_process_events(tds, POLLIN) == TDS_SUCCESS);
+	assert(process_tokens() == TDS_WOULD_BLOCK);
+	assert(tds->state == TDS_PENDING);
+
+	/* full response */
+	send_part(packet2, 5, sizeof(packet2));
+	assert(tds_process_events(tds, POLLIN) == TDS_SUCCESS);
+	while ((rc = process_tokens()) == TDS_SUCCESS)
+		continue;
+	assert(rc == TDS_NO_MORE_RESULTS);
+	assert(tds->state == TDS_IDLE);
+	assert(tds->recv_eom == 0);
+
+	/* connection closed by server */
+	shutdown(fake_server_socket, SHUT_WR);
+	assert(tds_process_events(tds, POLLIN) == TDS_FAIL);
+	assert(IS_TDSDEAD(tds));
+}
+
+/* send data to client processing events so neither side blocks */
+static void
+send_all(const unsigned char *data, size_t len)
+{
+	short events;
+
+	while (len) {
+		ptrdiff_t sent = WRITESOCKET(fake_server_socket, data, len);
+
+		if (sent > 0) {
+			data += sent;
+			len -= sent;
+		}
+		assert(tds_get_poll_events(tds, &events) == tds_get_s(tds));
+		assert(events == POLLIN);
+		assert(tds_process_events(tds, POLLIN) == TDS_SUCCESS);
+	}
+}
+
+static void
+test_big(void)
+{
+	/* packet filled with DONE tokens */
+	static unsigned char packet[8 + 9 * 455];
+	unsigned i;
+	TDSRET rc;
+
+	assert(tds_set_nonblocking(tds, true) == TDS_SUCCESS);
+	tds->state = TDS_PENDING;
+
+	for (i = 8; i < sizeof(packet); i += 9) {
+		packet[i] = TDS_DONE_TOKEN;
+		TDS_PUT_A2LE(packet + i + 1, TDS_DONE_COUNT|TDS_DONE_MORE_RESULTS);
+		TDS_PUT_A2LE(packet + i + 3, 0);
+		TDS_PUT_A4LE(packet + i + 5, 1);
+	}
+
+	/* a big response is buffered without blocking till its end */
+	fake_server_header(packet, sizeof(packet), false);
+	for (i = 0; i < 100; ++i) {
+		send_all(packet, sizeof(packet));
+		assert(!tds_response_received(tds));
+		assert(process_tokens() == TDS_WOULD_BLOCK);
+	}
+	assert(tds->state == TDS_PENDING);
+
+	send_all(packet2, sizeof(packet2));
+	assert(tds_response_received(tds));
+	while ((rc = process_tokens()) == TDS_SUCCESS)
+		continue;
+	assert(rc == TDS_NO_MORE_RESULTS);
+	assert(tds->state == TDS_IDLE);
+	assert(tds->recv_eom == 0);
+}
+
+static void
+test(void (*real_test)(void))
+{
+	/* provide connection to a fake remote server */
+	tds = fake_server_open();
+	assert(fcntl(tds_get_s(tds), F_SETFL, O_NONBLOCK) == 0);
+	assert(fcntl(fake_server_socket, F_SETFL, O_NONBLOCK) == 0);
+
+	real_test();
+
+	fake_server_close(tds);
+	tds = NULL;
+}
+
+TEST_MAIN()
+{
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	tdsdump_topen(tds_dir_getenv(TDS_DIR("TDSDUMP")));
+
+	prepare_packet(packet1, false);
+	prepare_packet(packet2, true);
+
+	test(test_nonblock);
+	test(test_big);
+
+	return 0;
+}
+#else
+TEST_MAIN()
+{
+	printf("Non-blocking mode requires MARS support.\n");
+	return 0;
+}
+#endif
@@ -20,11 +20,13 @@
 #include "common.h"
 #include <freetds/convert.h>
 #include <assert.h>
+#include <freetds/time.h>
 
 /* test numeric scale */
 
 static int g_result = 0;
 static TDSCONTEXT ctx;
+static bool verbose = true;
 
 static void
 test0(const char *src, int prec, int scale, int prec2, unsigned char scale2)
@@ -79,7 +81,7 @@ test0(const char *src, int prec, int scale, int prec2, unsigned char scale2)
 			src, prec, scale, prec2, scale2, buf, result);
 		g_result = 1;
 		exit(1);
-	} else {
+	} else if (verbose) {
 		printf("%s -> %s ok!\n", src, buf);
 	}
 }
@@ -90,11 +92,153 @@ test(const char *src, int prec, int scale, int scale2)
 	test0(src, prec, scale, prec, scale2);
 }
 
+static unsigned int seed = 1;
+
+static unsigned
+rnd(unsigned max)
+{
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % max;
+}
+
+static TDS_NUMERIC
+get_numeric(const char *src, int prec, int scale)
+{
+	CONV_RESULT cr;
+
+	memset(&cr.n, 0, sizeof(cr.n));
+	cr.n.precision = prec;
+	cr.n.scale = scale;
+	if (tds_convert(&ctx, SYBVARCHAR, src, (TDS_UINT)strlen(src), SYBNUMERIC, &cr) < 0) {
+		fprintf(stderr, "Error getting numeric %s(%d,%d)\n", src, prec, scale);
+		exit(1);
+	}
+	return cr.n;
+}
+
+/* random number with given integer digits and decimals */
+static void
+rnd_number(char *buf, int digits, int decimals)
+{
+	int i;
+
+	if (rnd(2))
+		*buf++ = '-';
+	for (i = 0; i < digits; ++i)
+		*buf++ = rnd(3) ? '0' + rnd(10) : '9';
+	if (!digits)
+		*buf++ = '0';
+	if (decimals) {
+		*buf++ = '.';
+		for (i = 0; i < decimals; ++i)
+			*buf++ = '0' + rnd(10);
+	}
+	*buf = 0;
+}
+
+/*
+ * Numbers with precision up to 38 can use a different engine,
+ * check results are the same of numbers with higher precision.
+ */
+static void
+test_random(void)
+{
+	int i;
+
+	verbose = false;
+	for (i = 0; i < 100000; ++i) {
+		char src[80], src2[80], s1[100], s2[100];
+		int prec = 1 + rnd(38), scale = rnd(prec + 1);
+		int prec2 = 1 + rnd(38), scale2 = rnd(prec2 + 1);
+		TDS_NUMERIC a, b, big_a, big_b;
+		int cmp, big_cmp;
+
+		rnd_number(src, rnd(prec - scale + 1), rnd(scale + 3));
+		rnd_number(src2, rnd(prec2 - scale2 + 1), rnd(scale2 + 3));
+		a = get_numeric(src, prec, scale);
+		b = get_numeric(src2, prec2, scale2);
+		big_a = get_numeric(src, prec + 39, scale);
+		big_b = get_numeric(src2, prec2 + 39, scale2);
+
+		/* to string */
+		tds_numeric_to_string(&a, s1);
+		tds_numeric_to_string(&big_a, s2);
+		if (strcmp(s1, s2) != 0) {
+			fprintf(stderr, "Wrong string for %s(%d,%d): %s expected %s\n", src, prec, scale, s1, s2);
+			exit(1);
+		}
+
+		/* compare */
+		assert(tds_numeric_cmp(&a, &b, &cmp) == 0);
+		assert(tds_numeric_cmp(&big_a, &big_b, &big_cmp) == 0);
+		assert(tds_numeric_cmp(&a, &big_b, &big_cmp) == 0);
+		if (cmp != big_cmp) {
+			fprintf(stderr, "Wrong compare %s(%d,%d) %s(%d,%d): %d expected %d\n",
+				src, prec, scale, src2, prec2, scale2, cmp, big_cmp);
+			exit(1);
+		}
+		assert(tds_numeric_cmp(&a, &a, &cmp) == 0 && cmp == 0);
+
+		/* rescale */
+		test0(src, prec, scale, prec2, scale2);
+	}
+}
+
+/* compare speed of numeric conversions */
+static void
+bench(int iterations)
+{
+	struct timeval start, end;
+	TDS_NUMERIC nums[64], num;
+	char buf[100];
+	int i, n;
+	double t_parse, t_string, t_scale;
+
+	for (n = 0; n < 64; ++n) {
+		rnd_number(buf, 14, 4);
+		nums[n] = get_numeric(buf, 18, 4);
+	}
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < iterations; ++i)
+		for (n = 0; n < 64; ++n) {
+			rnd_number(buf, 14, 4);
+			num = get_numeric(buf, 18, 4);
+		}
+	gettimeofday(&end, NULL);
+	t_parse = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < iterations; ++i)
+		for (n = 0; n < 64; ++n)
+			tds_numeric_to_string(&nums[n], buf);
+	gettimeofday(&end, NULL);
+	t_string = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < iterations; ++i)
+		for (n = 0; n < 64; ++n) {
+			num = nums[n];
+			tds_numeric_change_prec_scale(&num, 38, 10);
+			tds_numeric_change_prec_scale(&num, 18, 2);
+		}
+	gettimeofday(&end, NULL);
+	t_scale = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+
+	printf("%d numbers: parse %.3f s (including random generation), to string %.3f s, rescale %.3f s\n",
+	       iterations * 64, t_parse, t_string, t_scale);
+}
+
 TEST_MAIN()
 {
 	int i;
 	memset(&ctx, 0, sizeof(ctx));
 
+	if (argc > 1) {
+		bench(atoi(argv[1]));
+		return 0;
+	}
+
 	/* increase scale */
 	for (i = 0; i < 10; ++i) {
 		test("1234", 18+i, 0, 2+i);
@@ -125,6 +269,14 @@ TEST_MAIN()
 	test0("10000000000000000", 30, 10, 19, 0);
 	test0("10000000000000000", 30, 10, 12, 0);
 
+	/* limits */
+	test0("99999999999999999999999999999999999999", 38, 0, 38, 0);
+	test0("-99999999999999999999999999999999999999", 38, 0, 38, 38);
+	test0("9999999999999999999.9999999999999999999", 38, 19, 38, 0);
+	test0("0", 38, 0, 38, 38);
+
+	test_random();
+
 #if 0
 	{
 		int p1, s1, p2, s2;
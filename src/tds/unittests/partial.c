@@ -0,0 +1,142 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Purpose: test decoding data from partially received packets
+ */
+#include "common.h"
+#include <assert.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#include <freetds/replacements.h>
+
+static TDSSOCKET *tds = NULL;
+
+enum {
+	LEN1 = 100,
+	LEN2 = 50,
+};
+
+static unsigned char packet1[8 + LEN1];
+static unsigned char packet2[8 + LEN2];
+
+static void
+prepare_packet(unsigned char *pkt, size_t len, bool final, unsigned char start)
+{
+	size_t n;
+
+	fake_server_header(pkt, len, final);
+	for (n = 8; n < len; ++n)
+		pkt[n] = (unsigned char) (start + n);
+}
+
+/* send part of a packet from the fake server */
+static void
+send_part(const unsigned char *pkt, size_t from, size_t to)
+{
+	fake_server_send(pkt + from, to - from);
+}
+
+static void
+test_partial(void)
+{
+	unsigned char buf[256];
+
+	/* only the beginning of first packet is available */
+	send_part(packet1, 0, 8 + 40);
+	assert(tds_get_n(tds, buf, 30));
+	assert(memcmp(buf, packet1 + 8, 30) == 0);
+	assert(tds->in_partial == LEN1 - 40);
+	assert(tds_get_byte(tds) == packet1[8 + 30]);
+
+	/* read across packets, second one partially received */
+	send_part(packet1, 8 + 40, sizeof(packet1));
+	send_part(packet2, 0, 8 + 2);
+	assert(tds_get_n(tds, buf, LEN1 - 31 + 2));
+	assert(memcmp(buf, packet1 + 8 + 31, LEN1 - 31) == 0);
+	assert(memcmp(buf + LEN1 - 31, packet2 + 8, 2) == 0);
+	assert(tds->in_partial == LEN2 - 2);
+
+	/* complete last packet */
+	send_part(packet2, 8 + 2, sizeof(packet2));
+	assert(tds_get_n(tds, buf, LEN2 - 2));
+	assert(memcmp(buf, packet2 + 8 + 2, LEN2 - 2) == 0);
+	assert(tds->in_partial == 0);
+	assert(tds->in_buf[1] & TDS_STATUS_EOM);
+}
+
+static void
+test_discard(void)
+{
+	/* tds_read_packet should skip rest of partial packet */
+	send_part(packet1, 0, 8 + 10);
+	assert(tds_get_byte(tds) == packet1[8]);
+	assert(tds->in_partial == LEN1 - 10);
+
+	send_part(packet1, 8 + 10, sizeof(packet1));
+	send_part(packet2, 0, sizeof(packet2));
+	assert(tds_read_packet(tds) == sizeof(packet2));
+	assert(tds->in_partial == 0);
+	assert(memcmp(tds->in_buf, packet2, sizeof(packet2)) == 0);
+}
+
+static void
+test_disabled(void)
+{
+	/* without partial packets support whole packets are read */
+	tds->conn->partial_packets = 0;
+	send_part(packet1, 0, sizeof(packet1));
+	assert(tds_get_byte(tds) == packet1[8]);
+	assert(tds->in_partial == 0);
+	assert(tds->in_len == sizeof(packet1));
+}
+
+static void
+test(void (*real_test)(void))
+{
+	/* provide connection to a fake remote server */
+	tds = fake_server_open();
+	tds->conn->partial_packets = 1;
+
+	real_test();
+
+	fake_server_close(tds);
+	tds = NULL;
+}
+
+TEST_MAIN()
+{
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	tdsdump_topen(tds_dir_getenv(TDS_DIR("TDSDUMP")));
+
+	prepare_packet(packet1, sizeof(packet1), false, 0);
+	prepare_packet(packet2, sizeof(packet2), true, 0x80);
+
+	test(test_partial);
+	test(test_discard);
+	test(test_disabled);
+
+	return 0;
+}
@@ -0,0 +1,118 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Purpose: test receiving multiple packets with read-ahead buffer
+ */
+#include "common.h"
+#include <assert.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#include <freetds/replacements.h>
+
+#ifndef _WIN32
+static TDSSOCKET *tds = NULL;
+
+static void
+send_packet(size_t len, unsigned char start)
+{
+	unsigned char pkt[4096];
+	size_t n;
+
+	assert(len <= sizeof(pkt));
+	fake_server_header(pkt, len, true);
+	for (n = 8; n < len; ++n)
+		pkt[n] = (unsigned char) (start + n);
+	fake_server_send(pkt, len);
+}
+
+static void
+check_packet(size_t len, unsigned char start)
+{
+	size_t n;
+
+	assert(tds_read_packet(tds) == (int) len);
+	for (n = 8; n < len; ++n)
+		assert(tds->in_buf[n] == (unsigned char) (start + n));
+}
+
+static void
+test_read_ahead(void)
+{
+	assert(tds_set_read_ahead(tds->conn, 1024));
+
+	/* small packets are all read together */
+	send_packet(100, 1);
+	send_packet(200, 2);
+	send_packet(50, 3);
+	check_packet(100, 1);
+	assert(tds->conn->read_ahead.len == 350);
+	check_packet(200, 2);
+	check_packet(50, 3);
+	assert(tds->conn->read_ahead.pos == tds->conn->read_ahead.len);
+
+	/* packet not fitting in the buffer */
+	send_packet(3000, 4);
+	send_packet(20, 5);
+	check_packet(3000, 4);
+	check_packet(20, 5);
+
+	/* cannot change buffer with pending data */
+	send_packet(30, 6);
+	send_packet(40, 7);
+	check_packet(30, 6);
+	assert(!tds_set_read_ahead(tds->conn, 0));
+	check_packet(40, 7);
+
+	/* disabled */
+	assert(tds_set_read_ahead(tds->conn, 0));
+	send_packet(30, 8);
+	send_packet(40, 9);
+	check_packet(30, 8);
+	assert(tds->conn->read_ahead.len == 0);
+	check_packet(40, 9);
+}
+
+TEST_MAIN()
+{
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	tdsdump_topen(tds_dir_getenv(TDS_DIR("TDSDUMP")));
+
+	/* provide connection to a fake remote server */
+	tds = fake_server_open();
+
+	test_read_ahead();
+
+	fake_server_close(tds);
+
+	return 0;
+}
+#else
+TEST_MAIN()
+{
+	printf("Test requires socketpair.\n");
+	return 0;
+}
+#endif
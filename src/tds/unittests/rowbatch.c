@@ -0,0 +1,262 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: test fetching rows by column
+ */
+#include "common.h"
+#include <assert.h>
+#include <freetds/bytes.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif /* HAVE_FCNTL_H */
+
+#if HAVE_POLL_H
+#include <poll.h>
+#endif /* HAVE_POLL_H */
+
+#include <freetds/replacements.h>
+
+#ifndef _WIN32
+static TDSSOCKET *tds = NULL;
+
+#define NUM_ROWS 5
+
+/* add a row with an int, a nullable int and a varchar, odd numbers have NULLs */
+static unsigned char *
+add_row(unsigned char *p, TDS_INT num)
+{
+	char s[32];
+	size_t len;
+
+	*p++ = TDS_ROW_TOKEN;
+	TDS_PUT_A4LE(p, num);
+	p += 4;
+	if (num % 2) {
+		*p++ = 0;
+		TDS_PUT_A2LE(p, 0xffff);
+		return p + 2;
+	}
+	*p++ = 4;
+	TDS_PUT_A4LE(p, num * 10);
+	p += 4;
+	len = sprintf(s, "row %d", (int) num);
+	TDS_PUT_A2LE(p, len);
+	memcpy(p + 2, s, len);
+	return p + 2 + len;
+}
+
+/* check a row of the batch */
+static void
+check_row(TDSROWBATCH *batch, TDS_UINT row, TDS_INT num)
+{
+	TDSBATCHCOLUMN *cols = batch->columns;
+	TDS_INT value;
+	char s[32];
+	size_t len;
+
+	assert(cols[0].lengths[row] == 4 && !(cols[0].nulls[row / 8] & (1 << (row % 8))));
+	memcpy(&value, cols[0].values + row * cols[0].stride, 4);
+	assert(value == num);
+
+	if (num % 2) {
+		assert(cols[1].nulls[row / 8] & (1 << (row % 8)));
+		assert(cols[2].nulls[row / 8] & (1 << (row % 8)));
+		assert(cols[1].lengths[row] == 0 && cols[2].lengths[row] == 0);
+		return;
+	}
+	assert(!(cols[1].nulls[row / 8] & (1 << (row % 8))));
+	memcpy(&value, cols[1].values + row * cols[1].stride, 4);
+	assert(value == num * 10);
+
+	len = sprintf(s, "row %d", (int) num);
+	assert(!(cols[2].nulls[row / 8] & (1 << (row % 8))));
+	assert(cols[2].lengths[row] == (TDS_INT) len);
+	assert(memcmp(cols[2].values + cols[2].offsets[row], s, len) == 0);
+}
+
+/* result with an int, a nullable int and a varchar */
+static TDSRESULTINFO *
+alloc_results(void)
+{
+	TDSRESULTINFO *info;
+
+	info = tds_alloc_results(3);
+	assert(info);
+	tds->conn->tds_version = 0x704;
+	tds_set_column_type(tds->conn, info->columns[0], SYBINT4);
+	tds_set_column_type(tds->conn, info->columns[1], SYBINTN);
+	tds_set_column_type(tds->conn, info->columns[2], XSYBVARCHAR);
+	info->columns[1]->column_size = info->columns[1]->on_server.column_size = 4;
+	info->columns[2]->column_size = info->columns[2]->on_server.column_size = 100;
+	assert(TDS_SUCCEED(tds_alloc_row(info)));
+	tds_free_all_results(tds);
+	tds->res_info = info;
+	tds_set_current_results(tds, info);
+	return info;
+}
+
+static void
+test_batch(void)
+{
+	TDSRESULTINFO *info;
+	TDSROWBATCH *batch;
+	unsigned char buf[256], *p;
+	unsigned char *row_data[3];
+	size_t split;
+	TDS_INT result_type;
+	int done_flags, i;
+
+	info = alloc_results();
+	for (i = 0; i < 3; ++i)
+		row_data[i] = info->columns[i]->column_data;
+
+	batch = tds_alloc_row_batch(info, 2);
+	assert(batch);
+	assert(batch->columns[0].stride == 4 && batch->columns[1].stride == 4);
+	assert(batch->columns[2].stride == 0 && batch->columns[2].offsets != NULL);
+
+	/* rows split among packets */
+	p = buf;
+	for (i = 0; i < NUM_ROWS; ++i)
+		p = add_row(p, i);
+	*p++ = TDS_DONE_TOKEN;
+	memset(p, 0, 12);
+	p += 12;
+	split = 20;
+	fake_server_send_packet(buf, split, false);
+	fake_server_send_packet(buf + split, p - buf - split, true);
+	tds->state = TDS_PENDING;
+
+	/* full batches */
+	for (i = 0; i < NUM_ROWS - 1; i += 2) {
+		assert(tds_fetch_row_batch(tds, batch, &result_type) == TDS_SUCCESS);
+		assert(result_type == TDS_ROW_RESULT);
+		assert(batch->num_rows == 2);
+		check_row(batch, 0, i);
+		check_row(batch, 1, i + 1);
+	}
+
+	/* last row, fetch stops before DONE */
+	assert(tds_fetch_row_batch(tds, batch, &result_type) == TDS_SUCCESS);
+	assert(result_type == TDS_DONE_RESULT);
+	assert(batch->num_rows == 1);
+	check_row(batch, 0, NUM_ROWS - 1);
+	assert(!info->borrow_data);
+	for (i = 0; i < 3; ++i)
+		assert(info->columns[i]->column_data == row_data[i]);
+
+	/* DONE is left to be processed */
+	assert(tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_DONE) == TDS_SUCCESS);
+	assert(result_type == TDS_DONE_RESULT);
+	assert(tds_fetch_row_batch(tds, batch, &result_type) == TDS_NO_MORE_RESULTS);
+	assert(batch->num_rows == 0);
+
+	tds_free_row_batch(batch);
+}
+
+#if ENABLE_ODBC_MARS
+/* in non-blocking mode fetch stops till the response is received */
+static void
+test_would_block(void)
+{
+	TDSRESULTINFO *info;
+	TDSROWBATCH *batch;
+	unsigned char buf[256], *p;
+	TDS_INT result_type;
+	int done_flags, i;
+
+	info = alloc_results();
+	batch = tds_alloc_row_batch(info, 4);
+	assert(batch);
+
+	assert(fcntl(tds_get_s(tds), F_SETFL, O_NONBLOCK) == 0);
+	assert(tds_set_nonblocking(tds, true) == TDS_SUCCESS);
+	tds->state = TDS_PENDING;
+
+	/* first part of the response */
+	p = buf;
+	for (i = 0; i < 2; ++i)
+		p = add_row(p, i);
+	fake_server_send_packet(buf, p - buf, false);
+	assert(tds_process_events(tds, POLLIN) == TDS_SUCCESS);
+
+	result_type = -1;
+	assert(tds_fetch_row_batch(tds, batch, &result_type) == TDS_WOULD_BLOCK);
+	assert(result_type == -1);
+	assert(batch->num_rows == 0);
+
+	/* rest of the response */
+	p = buf;
+	p = add_row(p, 2);
+	*p++ = TDS_DONE_TOKEN;
+	memset(p, 0, 12);
+	p += 12;
+	fake_server_send_packet(buf, p - buf, true);
+	assert(tds_process_events(tds, POLLIN) == TDS_SUCCESS);
+
+	assert(tds_fetch_row_batch(tds, batch, &result_type) == TDS_SUCCESS);
+	assert(result_type == TDS_DONE_RESULT);
+	assert(batch->num_rows == 3);
+	for (i = 0; i < 3; ++i)
+		check_row(batch, i, i);
+
+	assert(tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_DONE) == TDS_SUCCESS);
+	assert(tds_set_nonblocking(tds, false) == TDS_SUCCESS);
+
+	tds_free_row_batch(batch);
+}
+#else
+static void
+test_would_block(void)
+{
+}
+#endif
+
+TEST_MAIN()
+{
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	tdsdump_topen(tds_dir_getenv(TDS_DIR("TDSDUMP")));
+
+	/* provide connection to a fake remote server */
+	tds = fake_server_open();
+
+	test_batch();
+	test_would_block();
+
+	fake_server_close(tds);
+
+	return 0;
+}
+#else
+TEST_MAIN()
+{
+	printf("Test requires socketpair.\n");
+	return 0;
+}
+#endif
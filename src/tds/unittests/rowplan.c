@@ -0,0 +1,257 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: test decoding rows using the result row plan
+ */
+#include "common.h"
+#include <assert.h>
+#include <freetds/bytes.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#include <freetds/replacements.h>
+
+#ifndef _WIN32
+static TDSSOCKET *tds = NULL;
+static TDSRESULTINFO *info = NULL;
+
+/* values of a row, NULL string means a NULL column */
+typedef struct
+{
+	TDS_INT i1, i2;
+	double f;
+	TDS_INT n;
+	bool n_null;
+	const char *s;
+} ROW;
+
+static unsigned char *
+add_row(unsigned char *p, const ROW *row, bool nbc)
+{
+	size_t len;
+
+	if (nbc) {
+		*p++ = TDS_NBC_ROW_TOKEN;
+		*p++ = (row->n_null ? 8 : 0) | (row->s ? 0 : 16);
+	} else {
+		*p++ = TDS_ROW_TOKEN;
+	}
+	TDS_PUT_A4LE(p, row->i1);
+	TDS_PUT_A4LE(p + 4, row->i2);
+	memcpy(p + 8, &row->f, 8);
+	p += 16;
+	if (!row->n_null) {
+		*p++ = 4;
+		TDS_PUT_A4LE(p, row->n);
+		p += 4;
+	} else if (!nbc) {
+		*p++ = 0;
+	}
+	if (row->s) {
+		len = strlen(row->s);
+		TDS_PUT_A2LE(p, len);
+		memcpy(p + 2, row->s, len);
+		p += 2 + len;
+	} else if (!nbc) {
+		TDS_PUT_A2LE(p, 0xffff);
+		p += 2;
+	}
+	return p;
+}
+
+/*
+ * Add an ignored token so that the first column of the following
+ * (not NBC) row starts at an address equal to rem modulo 8.
+ * Packets are allocated by malloc so their alignment is known.
+ */
+static unsigned char *
+add_align(unsigned char *buf, unsigned char *p, unsigned rem)
+{
+	size_t pos = TDS_OFFSET(TDSPACKET, buf) + 8 + (p - buf) + 3 + 1;
+	size_t len = 3 + (rem + 8 - pos % 8) % 8;
+
+	*p++ = TDS_ORDERBY_TOKEN;
+	TDS_PUT_A2LE(p, len - 3);
+	memset(p + 2, 0, len - 3);
+	return p + len - 1;
+}
+
+static unsigned char *
+add_done(unsigned char *p)
+{
+	*p++ = TDS_DONE_TOKEN;
+	memset(p, 0, 12);
+	return p + 12;
+}
+
+static TDSRET
+process_tokens(void)
+{
+	TDS_INT result_type;
+	int done_flags;
+
+	return tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_ROW|TDS_RETURN_DONE);
+}
+
+/* read a row and check values against expected ones */
+static void
+check_row(const ROW *row, bool borrowed)
+{
+	TDSCOLUMN **cols = info->columns;
+	TDS_INT num;
+	double f;
+
+	assert(process_tokens() == TDS_SUCCESS);
+	assert(info->row_plan != NULL);
+
+	assert(cols[0]->column_cur_size == 4 && cols[1]->column_cur_size == 4 && cols[2]->column_cur_size == 8);
+	memcpy(&num, tds_column_data(cols[0]), 4);
+	assert(num == row->i1);
+	memcpy(&num, tds_column_data(cols[1]), 4);
+	assert(num == row->i2);
+	memcpy(&f, tds_column_data(cols[2]), 8);
+	assert(f == row->f);
+	assert((cols[0]->column_borrowed != NULL) == borrowed);
+	assert((cols[2]->column_borrowed != NULL) == borrowed);
+
+	if (row->n_null) {
+		assert(cols[3]->column_cur_size < 0);
+	} else {
+		assert(cols[3]->column_cur_size == 4);
+		memcpy(&num, tds_column_data(cols[3]), 4);
+		assert(num == row->n);
+	}
+
+	if (!row->s) {
+		assert(cols[4]->column_cur_size < 0);
+		assert(cols[4]->column_borrowed == NULL);
+	} else {
+		assert(cols[4]->column_cur_size == (TDS_INT) strlen(row->s));
+		assert(memcmp(tds_column_data(cols[4]), row->s, strlen(row->s)) == 0);
+		assert((cols[4]->column_borrowed != NULL) == borrowed);
+	}
+}
+
+static void
+test_rows(void)
+{
+	static const ROW rows[] = {
+		{ 1, 2, 3.5, 4, false, "abc" },
+		{ -1, 0x12345678, -0.25, 0, true, NULL },
+		{ 100, 200, 1e100, -7, false, "" },
+		{ 5, 6, 7.0, 8, false, "split" },
+		{ 9, 10, 11.0, 12, true, "nbc" },
+		{ 13, 14, 15.0, 16, false, NULL },
+	};
+	unsigned char buf[256], *p;
+	size_t split;
+
+	/* plain rows, data copied */
+	p = add_row(buf, &rows[0], false);
+	p = add_row(p, &rows[1], false);
+	p = add_done(p);
+	fake_server_send_packet(buf, p - buf, true);
+	tds->state = TDS_PENDING;
+	check_row(&rows[0], false);
+	check_row(&rows[1], false);
+	assert(process_tokens() == TDS_SUCCESS);
+
+	/* borrowing, last row split inside the float column */
+	info->borrow_data = true;
+	p = add_align(buf, buf, 0);
+	p = add_row(p, &rows[2], false);
+	split = p - buf;
+	p = add_row(p, &rows[3], false);
+	p = add_done(p);
+	fake_server_send_packet(buf, split + 10, false);
+	fake_server_send_packet(buf + split + 10, p - buf - split - 10, true);
+	tds->state = TDS_PENDING;
+	check_row(&rows[2], true);
+	assert(process_tokens() == TDS_SUCCESS);
+	assert(info->columns[2]->column_borrowed == NULL);
+	assert(info->columns[4]->column_borrowed != NULL);
+	assert(process_tokens() == TDS_SUCCESS);
+
+	/* integers are aligned and borrowed, float is not aligned and copied */
+	p = add_align(buf, buf, 4);
+	p = add_row(p, &rows[0], false);
+	p = add_done(p);
+	fake_server_send_packet(buf, p - buf, true);
+	tds->state = TDS_PENDING;
+	assert(process_tokens() == TDS_SUCCESS);
+	assert(info->columns[0]->column_borrowed != NULL && info->columns[1]->column_borrowed != NULL);
+	assert(info->columns[2]->column_borrowed == NULL);
+	assert(*(TDS_INT *) tds_column_data(info->columns[1]) == rows[0].i2);
+	assert(*(double *) info->columns[2]->column_data == rows[0].f);
+	assert(process_tokens() == TDS_SUCCESS);
+
+	/* null bitmap compressed rows */
+	info->borrow_data = false;
+	p = add_row(buf, &rows[4], true);
+	p = add_row(p, &rows[5], true);
+	p = add_done(p);
+	fake_server_send_packet(buf, p - buf, true);
+	tds->state = TDS_PENDING;
+	check_row(&rows[4], false);
+	check_row(&rows[5], false);
+	assert(process_tokens() == TDS_SUCCESS);
+}
+
+TEST_MAIN()
+{
+	static const int types[] = { SYBINT4, SYBINT4, SYBFLT8, SYBINTN, XSYBVARBINARY };
+	int i;
+
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	tdsdump_topen(tds_dir_getenv(TDS_DIR("TDSDUMP")));
+
+	/* provide connection to a fake remote server */
+	tds = fake_server_open();
+	tds->conn->tds_version = 0x704;
+
+	info = tds_alloc_results(TDS_VECTOR_SIZE(types));
+	assert(info);
+	for (i = 0; i < TDS_VECTOR_SIZE(types); ++i)
+		tds_set_column_type(tds->conn, info->columns[i], types[i]);
+	info->columns[3]->column_size = info->columns[3]->on_server.column_size = 4;
+	info->columns[4]->column_size = info->columns[4]->on_server.column_size = 100;
+	assert(TDS_SUCCEED(tds_alloc_row(info)));
+	tds->res_info = info;
+	tds_set_current_results(tds, info);
+
+	test_rows();
+
+	fake_server_close(tds);
+
+	return 0;
+}
+#else
+TEST_MAIN()
+{
+	printf("Test requires socketpair.\n");
+	return 0;
+}
+#endif
@@ -0,0 +1,200 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: test socket tuning options are parsed and applied
+ */
+#include "common.h"
+#include <assert.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#if HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#endif /* HAVE_NETINET_IN_H */
+
+#if HAVE_NETINET_TCP_H
+#include <netinet/tcp.h>
+#endif /* HAVE_NETINET_TCP_H */
+
+#if HAVE_ARPA_INET_H
+#include <arpa/inet.h>
+#endif /* HAVE_ARPA_INET_H */
+
+#include <freetds/replacements.h>
+
+#ifndef _WIN32
+static void
+test_parse(TDSLOGIN *login)
+{
+	assert(login->socket_rcvbuf == -1);
+	assert(login->keepalive_idle == -1);
+	assert(login->tcp_cork);
+	assert(!login->tcp_quickack);
+	assert(!login->tcp_quickack_specified);
+
+	tds_parse_conf_section(TDS_STR_SOCKET_RCVBUF, "262144", login);
+	tds_parse_conf_section(TDS_STR_SOCKET_SNDBUF, "131072", login);
+	tds_parse_conf_section(TDS_STR_SOCKET_BUSY_POLL, "50", login);
+	tds_parse_conf_section(TDS_STR_TCP_CORK, "no", login);
+	tds_parse_conf_section(TDS_STR_TCP_QUICKACK, "yes", login);
+	tds_parse_conf_section(TDS_STR_KEEPALIVE_IDLE, "30", login);
+	tds_parse_conf_section(TDS_STR_KEEPALIVE_INTERVAL, "5", login);
+
+	/* invalid values are ignored */
+	tds_parse_conf_section(TDS_STR_SOCKET_SNDBUF, "-1", login);
+	tds_parse_conf_section(TDS_STR_KEEPALIVE_INTERVAL, "0", login);
+
+	assert(login->socket_rcvbuf == 262144);
+	assert(login->socket_sndbuf == 131072);
+	assert(login->socket_busy_poll == 50);
+	assert(!login->tcp_cork);
+	assert(login->tcp_quickack);
+	assert(login->tcp_quickack_specified);
+	assert(login->keepalive_idle == 30);
+	assert(login->keepalive_interval == 5);
+}
+
+static int
+get_option(TDS_SYS_SOCKET s, int level, int name)
+{
+	int val = 0;
+	socklen_t len = sizeof(val);
+
+	assert(getsockopt(s, level, name, (void *) &val, &len) == 0);
+	return val;
+}
+
+static void
+test_apply(TDSLOGIN *login)
+{
+	TDSCONTEXT *ctx;
+	TDSSOCKET *tds;
+	TDS_SYS_SOCKET listen_sock, s;
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+	struct addrinfo *addr = NULL;
+	int oserr;
+
+	/* local server to connect to */
+	listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+	assert(!TDS_IS_SOCKET_INVALID(listen_sock));
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	assert(bind(listen_sock, (struct sockaddr *) &sin, sizeof(sin)) == 0);
+	assert(listen(listen_sock, 1) == 0);
+	assert(getsockname(listen_sock, (struct sockaddr *) &sin, &len) == 0);
+
+	ctx = tds_alloc_context(NULL);
+	assert(ctx);
+	tds = tds_alloc_socket(ctx, 512);
+	assert(tds);
+	assert(TDS_SUCCEED(tds_lookup_host_set("127.0.0.1", &addr)));
+
+	assert(tds_open_socket(tds, login, addr, ntohs(sin.sin_port), 5, &oserr) == TDSEOK);
+	s = tds_get_s(tds);
+
+	/* the system can round buffer sizes up */
+	assert(get_option(s, SOL_SOCKET, SO_RCVBUF) >= login->socket_rcvbuf);
+	assert(get_option(s, SOL_SOCKET, SO_SNDBUF) >= login->socket_sndbuf);
+#if defined(TCP_KEEPIDLE) && defined(TCP_KEEPINTVL)
+	assert(get_option(s, IPPROTO_TCP, TCP_KEEPIDLE) == login->keepalive_idle);
+	assert(get_option(s, IPPROTO_TCP, TCP_KEEPINTVL) == login->keepalive_interval);
+#endif
+#if defined(TCP_CORK)
+	assert(get_option(s, IPPROTO_TCP, TCP_CORK) == 0);
+#endif
+	assert(tds->conn->no_cork);
+	assert(tds->conn->quickack);
+
+	tds_addrinfo_free(addr);
+	tds_free_socket(tds);
+	tds_free_context(ctx);
+	CLOSESOCKET(listen_sock);
+}
+
+/* options given by the application override configuration file */
+static void
+test_config(bool quickack, bool override)
+{
+	TDSCONTEXT *ctx;
+	TDSSOCKET *tds;
+	TDSLOGIN *login, *connection;
+	FILE *f;
+
+	f = fopen("sockopts.conf", "w");
+	assert(f);
+	fprintf(f, "[global]\n\ttcp quickack = %s\n", quickack ? "yes" : "no");
+	fclose(f);
+	putenv("FREETDSCONF=sockopts.conf");
+
+	ctx = tds_alloc_context(NULL);
+	assert(ctx);
+	tds = tds_alloc_socket(ctx, 512);
+	assert(tds);
+	login = tds_alloc_login(true);
+	assert(login && tds_set_server(login, "localhost"));
+	if (override)
+		tds_parse_conf_section(TDS_STR_TCP_QUICKACK, quickack ? "no" : "yes", login);
+
+	connection = tds_read_config_info(tds, login, ctx->locale);
+	assert(connection);
+	assert(connection->tcp_quickack == (quickack != override));
+
+	tds_free_login(connection);
+	tds_free_login(login);
+	tds_free_socket(tds);
+	tds_free_context(ctx);
+	unlink("sockopts.conf");
+}
+
+TEST_MAIN()
+{
+	TDSLOGIN *login;
+
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	tdsdump_topen(tds_dir_getenv(TDS_DIR("TDSDUMP")));
+
+	login = tds_alloc_login(false);
+	assert(login);
+
+	test_parse(login);
+	test_apply(login);
+	test_config(false, false);
+	test_config(false, true);
+	test_config(true, false);
+	test_config(true, true);
+
+	tds_free_login(login);
+	return 0;
+}
+#else	/* _WIN32 */
+TEST_MAIN()
+{
+	printf("Test not supported on Windows.\n");
+	return 0;
+}
+#endif
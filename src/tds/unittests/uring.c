@@ -0,0 +1,133 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Purpose: test network I/O using io_uring backend
+ */
+#include "common.h"
+#include <assert.h>
+#include <freetds/bytes.h>
+#include <freetds/uring.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#include <freetds/replacements.h>
+
+#ifdef TDS_HAVE_IO_URING
+static TDSSOCKET *tds = NULL;
+
+static unsigned char packet[8 + 200];
+
+static void
+test_read(void)
+{
+	size_t n;
+
+	fake_server_header(packet, sizeof(packet), true);
+	for (n = 8; n < sizeof(packet); ++n)
+		packet[n] = (unsigned char) n;
+
+	/* two packets in a single read-ahead */
+	fake_server_send(packet, sizeof(packet));
+	fake_server_send(packet, sizeof(packet));
+	assert(tds_read_packet(tds) == sizeof(packet));
+	assert(memcmp(tds->in_buf, packet, sizeof(packet)) == 0);
+	assert(tds_read_packet(tds) == sizeof(packet));
+	assert(memcmp(tds->in_buf, packet, sizeof(packet)) == 0);
+
+	/* end of file closes the connection */
+	shutdown(fake_server_socket, SHUT_WR);
+	assert(tds_read_packet(tds) < 0);
+	assert(tds->conn->uring == NULL);
+}
+
+static void
+test_write(void)
+{
+	unsigned char buf[1024];
+	ptrdiff_t len;
+	size_t got = 0;
+
+	tds->out_flag = TDS_QUERY;
+	assert(TDS_SUCCEED(tds_put_n(tds, "0123456789", 10)));
+	assert(TDS_SUCCEED(tds_flush_packet(tds)));
+
+	while (got < 18) {
+		len = READSOCKET(fake_server_socket, buf + got, sizeof(buf) - got);
+		assert(len > 0);
+		got += len;
+	}
+	assert(got == 18);
+	assert(buf[0] == TDS_QUERY);
+	assert(TDS_GET_A2BE(buf + 2) == 18);
+	assert(memcmp(buf + 8, "0123456789", 10) == 0);
+}
+
+static void
+test_timeout(void)
+{
+	/* nothing to read, should time out */
+	tds->query_timeout = 1;
+	assert(tds_read_packet(tds) < 0);
+}
+
+static int
+test(void (*real_test)(void))
+{
+	/* provide connection to a fake remote server */
+	tds = fake_server_open();
+	if (!tds_uring_init(tds->conn)) {
+		fake_server_close(tds);
+		tds = NULL;
+		return 0;
+	}
+
+	real_test();
+
+	fake_server_close(tds);
+	tds = NULL;
+	return 1;
+}
+
+TEST_MAIN()
+{
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	tdsdump_topen(tds_dir_getenv(TDS_DIR("TDSDUMP")));
+
+	if (!test(test_read)) {
+		printf("io_uring not supported by the kernel.\n");
+		return 0;
+	}
+	test(test_write);
+	test(test_timeout);
+
+	return 0;
+}
+#else	/* !TDS_HAVE_IO_URING */
+TEST_MAIN()
+{
+	printf("io_uring backend not enabled.\n");
+	return 0;
+}
+#endif
@@ -0,0 +1,155 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: test UTF-8 columns are received without conversion
+ */
+#include "common.h"
+#include <assert.h>
+#include <freetds/bytes.h>
+#include <freetds/iconv.h>
+
+#if HAVE_UNISTD_H
+#undef getpid
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#include <freetds/replacements.h>
+
+#ifndef _WIN32
+static TDSSOCKET *tds = NULL;
+
+/* Latin1_General_100_CI_AS_SC_UTF8 and SQL_Latin1_General_CP1_CI_AS */
+static const unsigned char utf8_collate[5] = { 0x09, 0x04, 0xd0, 0x04, 0x00 };
+static const unsigned char cp1252_collate[5] = { 0x09, 0x04, 0xd0, 0x00, 0x34 };
+
+static unsigned char *
+add_varchar(unsigned char *p, const unsigned char collate[5], char name)
+{
+	memset(p, 0, 6);		/* usertype, flags */
+	p[6] = XSYBVARCHAR;
+	TDS_PUT_A2LE(p + 7, 20);
+	memcpy(p + 9, collate, 5);
+	p[14] = 1;
+	p[15] = name;
+	p[16] = 0;
+	return p + 17;
+}
+
+static unsigned char *
+add_string(unsigned char *p, const char *s)
+{
+	size_t len = strlen(s);
+
+	TDS_PUT_A2LE(p, len);
+	memcpy(p + 2, s, len);
+	return p + 2 + len;
+}
+
+static void
+test_utf8(void)
+{
+	static const char utf8[] = "\xc3\xa0 \xe2\x82\xac";
+	unsigned char buf[256], *p = buf;
+	TDS_INT result_type;
+	int done_flags;
+	TDSCOLUMN *col_utf8, *col_cp1252;
+
+	/* server acknowledges UTF-8 support */
+	*p++ = TDS_CONTROL_FEATUREEXTACK_TOKEN;
+	*p++ = TDS_FEATURE_UTF8_SUPPORT;
+	TDS_PUT_A4LE(p, 1);
+	p[4] = 1;
+	p[5] = TDS_FEATURE_TERMINATOR;
+	p += 6;
+
+	*p++ = TDS7_RESULT_TOKEN;
+	TDS_PUT_A2LE(p, 2);
+	p += 2;
+	p = add_varchar(p, utf8_collate, 'u');
+	p = add_varchar(p, cp1252_collate, 'l');
+
+	*p++ = TDS_ROW_TOKEN;
+	p = add_string(p, utf8);
+	p = add_string(p, "\xe0 \x80");
+
+	*p++ = TDS_DONE_TOKEN;
+	memset(p, 0, 12);
+	p += 12;
+	fake_server_send_packet(buf, p - buf, true);
+	tds->state = TDS_PENDING;
+
+	assert(tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_ROWFMT) == TDS_SUCCESS);
+	assert(result_type == TDS_ROWFMT_RESULT);
+	col_utf8 = tds->res_info->columns[0];
+	col_cp1252 = tds->res_info->columns[1];
+
+	/* UTF-8 column does not need any conversion */
+	assert(col_utf8->char_conv->flags & TDS_ENCODING_MEMCPY);
+	assert(!(col_cp1252->char_conv->flags & TDS_ENCODING_MEMCPY));
+	assert(col_utf8->column_size == 20);
+
+	tds->res_info->borrow_data = true;
+	assert(tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_ROW) == TDS_SUCCESS);
+	assert(result_type == TDS_ROW_RESULT);
+
+	/* data are left in the packet as they are */
+	assert(col_utf8->column_borrowed != NULL);
+	assert(col_utf8->column_cur_size == (TDS_INT) strlen(utf8));
+	assert(memcmp(tds_column_data(col_utf8), utf8, strlen(utf8)) == 0);
+
+	/* other columns are converted */
+	assert(col_cp1252->column_borrowed == NULL);
+	assert(col_cp1252->column_cur_size == (TDS_INT) strlen(utf8));
+	assert(memcmp(col_cp1252->column_data, utf8, strlen(utf8)) == 0);
+
+	assert(tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_DONE) == TDS_SUCCESS);
+	assert(tds_process_tokens(tds, &result_type, &done_flags, TDS_RETURN_DONE) == TDS_NO_MORE_RESULTS);
+}
+
+TEST_MAIN()
+{
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	tdsdump_topen(tds_dir_getenv(TDS_DIR("TDSDUMP")));
+
+	/* provide connection to a fake remote server */
+	tds = fake_server_open();
+	tds->conn->tds_version = 0x704;
+	if (TDS_FAILED(tds_iconv_open(tds->conn, "UTF-8", 1))) {
+		printf("UTF-8 conversions not available\n");
+		fake_server_close(tds);
+		return 0;
+	}
+
+	test_utf8();
+
+	fake_server_close(tds);
+
+	return 0;
+}
+#else
+TEST_MAIN()
+{
+	printf("Test requires socketpair.\n");
+	return 0;
+}
+#endif
@@ -0,0 +1,326 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Purpose: test built-in converters give same results of system iconv.
+ * To compare performance call this program with an iteration count:
+ * $ ./utfconv 100
+ */
+#include "common.h"
+#include <assert.h>
+#include <freetds/iconv.h>
+#include <freetds/time.h>
+
+#if HAVE_ICONV
+static const struct {
+	const char *from, *to;
+} pairs[] = {
+	{ "UCS-2LE", "UTF-8" },
+	{ "UTF-16LE", "UTF-8" },
+	{ "UTF-8", "UCS-2LE" },
+	{ "UTF-8", "UTF-16LE" },
+	{ "UCS-2LE", "ISO-8859-1" },
+	{ "UTF-16LE", "ISO-8859-1" },
+	{ "ISO-8859-1", "UCS-2LE" },
+	{ "ISO-8859-1", "UTF-16LE" },
+};
+
+static unsigned int seed = 1;
+
+static unsigned
+rnd(unsigned max)
+{
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % max;
+}
+
+/* a random character, mostly ASCII */
+static unsigned
+rnd_char(void)
+{
+	switch (rnd(10)) {
+	case 0:
+		return 0x80 + rnd(0x80);
+	case 1:
+		return 0x100 + rnd(0x700);
+	case 2:
+		return 0x800 + rnd(0xd000);
+	case 3:
+		return 0x10000 + rnd(0x100000);
+	default:
+		return rnd(0x80);
+	}
+}
+
+static size_t
+encode(const char *charset, unsigned c, unsigned char *p)
+{
+	if (strcmp(charset, "UTF-8") == 0) {
+		if (c < 0x80) {
+			p[0] = c;
+			return 1;
+		}
+		if (c < 0x800) {
+			p[0] = 0xc0 | (c >> 6);
+			p[1] = 0x80 | (c & 0x3f);
+			return 2;
+		}
+		if (c < 0x10000) {
+			p[0] = 0xe0 | (c >> 12);
+			p[1] = 0x80 | ((c >> 6) & 0x3f);
+			p[2] = 0x80 | (c & 0x3f);
+			return 3;
+		}
+		p[0] = 0xf0 | (c >> 18);
+		p[1] = 0x80 | ((c >> 12) & 0x3f);
+		p[2] = 0x80 | ((c >> 6) & 0x3f);
+		p[3] = 0x80 | (c & 0x3f);
+		return 4;
+	}
+	if (strcmp(charset, "ISO-8859-1") == 0) {
+		p[0] = c;
+		return 1;
+	}
+	if (c < 0x10000) {
+		p[0] = c;
+		p[1] = c >> 8;
+		return 2;
+	}
+	c -= 0x10000;
+	encode(charset, 0xd800 + (c >> 10), p);
+	encode(charset, 0xdc00 + (c & 0x3ff), p + 2);
+	return 4;
+}
+
+/* build a random input, possibly with invalid sequences */
+static size_t
+build_input(const char *charset, unsigned char *buf, size_t max, bool invalid)
+{
+	size_t len = 0;
+	unsigned n = rnd(2) ? rnd(8) : rnd(200);
+
+	while (n-- && len + 4 <= max) {
+		unsigned c = rnd_char();
+
+		if (strcmp(charset, "ISO-8859-1") == 0)
+			c &= 0xff;
+		len += encode(charset, c, buf + len);
+		/* long ASCII runs */
+		if (rnd(8) == 0) {
+			unsigned run = rnd(70);
+
+			while (run-- && len + 4 <= max)
+				len += encode(charset, 'a' + rnd(26), buf + len);
+		}
+	}
+	if (invalid && len) {
+		switch (rnd(4)) {
+		case 0:
+			--len;
+			break;
+		case 1:
+			buf[rnd(len)] = rnd(256);
+			break;
+		case 2:
+			buf[rnd(len)] ^= 0x80;
+			break;
+		default:
+			/* lonely surrogate */
+			if (len + 2 <= max)
+				len += encode("UCS-2LE", 0xd800 + rnd(0x800), buf + len);
+			break;
+		}
+	}
+	return len;
+}
+
+/* convert with both converters and check results */
+static void
+compare(iconv_t cd, TDS_FAST_ICONV fast, const unsigned char *in, size_t in_len, size_t out_len)
+{
+	char out_sys[4096], out_fast[4096];
+	const char *ib;
+	char *ob;
+	size_t il, ol, res_sys, res_fast, in_sys, out_sys_len;
+	int errno_sys = 0, errno_fast = 0;
+
+	iconv(cd, NULL, NULL, NULL, NULL);
+	ib = (const char *) in;
+	il = in_len;
+	ob = out_sys;
+	ol = out_len;
+	res_sys = iconv(cd, (ICONV_CONST char **) &ib, &il, &ob, &ol);
+	if (res_sys == (size_t) -1)
+		errno_sys = errno;
+	in_sys = il;
+	out_sys_len = ol;
+
+	ib = (const char *) in;
+	il = in_len;
+	ob = out_fast;
+	ol = out_len;
+	res_fast = fast(&ib, &il, &ob, &ol);
+	if (res_fast == (size_t) -1)
+		errno_fast = errno;
+
+	if (res_sys != res_fast || errno_sys != errno_fast || in_sys != il || out_sys_len != ol
+	    || memcmp(out_sys, out_fast, out_len - ol) != 0) {
+		size_t i;
+
+		fprintf(stderr, "different results: %d/%d errno %d/%d input left %u/%u output left %u/%u\ninput:",
+			(int) res_sys, (int) res_fast, errno_sys, errno_fast,
+			(unsigned) in_sys, (unsigned) il, (unsigned) out_sys_len, (unsigned) ol);
+		for (i = 0; i < in_len; ++i)
+			fprintf(stderr, " %02x", in[i]);
+		fprintf(stderr, "\n");
+		exit(1);
+	}
+}
+
+static void
+test_pair(const char *from, const char *to)
+{
+	unsigned char in[1024];
+	size_t len;
+	iconv_t cd;
+	TDS_FAST_ICONV fast;
+	int i;
+
+	fast = tds_fast_iconv_get(tds_canonical_charset(from), tds_canonical_charset(to));
+	assert(fast);
+	cd = iconv_open(to, from);
+	if (cd == (iconv_t) -1) {
+		printf("%s -> %s not supported by system iconv\n", from, to);
+		return;
+	}
+
+	for (i = 0; i < 20000; ++i) {
+		len = build_input(from, in, sizeof(in), rnd(4) == 0);
+		/* enough space, or partial output */
+		compare(cd, fast, in, len, 4096);
+		compare(cd, fast, in, len, rnd(len * 2 + 1));
+	}
+
+	/* some edge cases */
+	compare(cd, fast, (const unsigned char *) "", 0, 10);
+	compare(cd, fast, (const unsigned char *) "\xc3", 1, 10);
+	compare(cd, fast, (const unsigned char *) "\xed\xa0\x80", 3, 10);
+	compare(cd, fast, (const unsigned char *) "\xc0\x80", 2, 10);
+	compare(cd, fast, (const unsigned char *) "\xf4\x90\x80\x80", 4, 10);
+	compare(cd, fast, (const unsigned char *) "\x00\xd8", 2, 10);
+	compare(cd, fast, (const unsigned char *) "\x00\xd8\x00\xdc", 4, 10);
+	compare(cd, fast, (const unsigned char *) "\x00\xdc\x41\x00", 4, 10);
+	compare(cd, fast, (const unsigned char *) "A\x00" "B", 3, 10);
+
+	iconv_close(cd);
+}
+
+static double
+elapsed(const struct timeval *start)
+{
+	struct timeval end;
+
+	gettimeofday(&end, NULL);
+	return (end.tv_sec - start->tv_sec) + (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+/* compare speed of system and built-in converter */
+static void
+bench_pair(const char *from, const char *to, int iterations)
+{
+	enum { IN_SIZE = 256 * 1024 };
+	unsigned char *in = (unsigned char *) malloc(IN_SIZE);
+	char *out = (char *) malloc(IN_SIZE * 4);
+	size_t in_len = 0;
+	iconv_t cd;
+	TDS_FAST_ICONV fast;
+	struct timeval start;
+	double t_sys, t_fast;
+	int i;
+
+	assert(in && out);
+	fast = tds_fast_iconv_get(tds_canonical_charset(from), tds_canonical_charset(to));
+	cd = iconv_open(to, from);
+	if (cd == (iconv_t) -1)
+		return;
+
+	/* text mainly ASCII with some characters convertible to Latin1 */
+	while (in_len + 4 <= IN_SIZE) {
+		unsigned c = rnd(16) ? 0x20 + rnd(0x5f) : 0xa0 + rnd(0x60);
+
+		in_len += encode(from, c, in + in_len);
+	}
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < iterations; ++i) {
+		const char *ib = (const char *) in;
+		char *ob = out;
+		size_t il = in_len, ol = IN_SIZE * 4;
+
+		iconv(cd, (ICONV_CONST char **) &ib, &il, &ob, &ol);
+		assert(il == 0);
+	}
+	t_sys = elapsed(&start);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < iterations; ++i) {
+		const char *ib = (const char *) in;
+		char *ob = out;
+		size_t il = in_len, ol = IN_SIZE * 4;
+
+		fast(&ib, &il, &ob, &ol);
+		assert(il == 0);
+	}
+	t_fast = elapsed(&start);
+
+	printf("%10s -> %-10s system %8.1f MB/s  built-in %8.1f MB/s\n", from, to,
+	       in_len * (double) iterations / 1e6 / (t_sys > 0 ? t_sys : 1e-9),
+	       in_len * (double) iterations / 1e6 / (t_fast > 0 ? t_fast : 1e-9));
+
+	iconv_close(cd);
+	free(in);
+	free(out);
+}
+
+TEST_MAIN()
+{
+	size_t i;
+	int iterations = argc > 1 ? atoi(argv[1]) : 0;
+
+	/* unsupported conversions use system iconv */
+	assert(tds_fast_iconv_get(tds_canonical_charset("UTF-8"), tds_canonical_charset("ISO-8859-1")) == NULL);
+	assert(tds_fast_iconv_get(tds_canonical_charset("UCS-2BE"), tds_canonical_charset("UTF-8")) == NULL);
+
+	for (i = 0; i < TDS_VECTOR_SIZE(pairs); ++i)
+		test_pair(pairs[i].from, pairs[i].to);
+
+	if (iterations > 0)
+		for (i = 0; i < TDS_VECTOR_SIZE(pairs); ++i)
+			bench_pair(pairs[i].from, pairs[i].to, iterations);
+
+	return 0;
+}
+#else
+TEST_MAIN()
+{
+	printf("Test requires system iconv.\n");
+	return 0;
+}
+#endif
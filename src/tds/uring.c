@@ -0,0 +1,553 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * \file
+ * \brief io_uring network backend
+ *
+ * Used by the blocking network code (tds_goodread()/tds_goodwrite()) instead
+ * of poll(2) and recv(2)/send(2).
+ * A receive is always kept posted in a read-ahead buffer so most waits
+ * consist of a single io_uring_enter(2) call which submits pending requests
+ * and waits for completions.
+ * Together with the receive a poll on the wakeup descriptor is kept posted
+ * so tds_wakeup_send() still interrupts a wait.
+ */
+
+#include <config.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#if HAVE_ERRNO_H
+#include <errno.h>
+#endif /* HAVE_ERRNO_H */
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif /* HAVE_STDLIB_H */
+
+#if HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+
+#include <freetds/tds.h>
+#include <freetds/uring.h>
+
+#ifdef TDS_HAVE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <signal.h>
+#include <linux/io_uring.h>
+
+/* defined in recent headers only */
+#ifndef IORING_ENTER_EXT_ARG
+#define IORING_ENTER_EXT_ARG (1U << 3)
+#endif
+#ifndef IORING_FEAT_EXT_ARG
+#define IORING_FEAT_EXT_ARG (1U << 8)
+#endif
+#ifndef IORING_FEAT_FAST_POLL
+#define IORING_FEAT_FAST_POLL (1U << 5)
+#endif
+
+/* argument for IORING_ENTER_EXT_ARG, same layout as struct io_uring_getevents_arg */
+typedef struct
+{
+	uint64_t sigmask;
+	uint32_t sigmask_sz;
+	uint32_t pad;
+	uint64_t ts;
+} uring_getevents_arg;
+
+typedef struct
+{
+	int64_t tv_sec;
+	long long tv_nsec;
+} uring_timespec;
+
+/* requests we can have in flight, used as user_data */
+enum
+{
+	URING_RECV = 1,
+	URING_WAKEUP,
+	URING_SEND,
+	URING_CANCEL,
+};
+#define URING_PENDING(op) (1u << (op))
+
+/* submission queue entries, we never have more than a few requests in flight */
+#define URING_ENTRIES 8
+
+/* size of the read-ahead buffer */
+#define URING_RECV_SIZE 32768
+
+/* maximum buffers submitted with a single send */
+#define URING_MAX_IOVEC 64
+
+struct tds_uring
+{
+	int fd;
+
+	/* submission ring */
+	void *sq_ring;
+	size_t sq_ring_size;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned sq_entries;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	/* completion ring, can share mapping with submission ring */
+	void *cq_ring;
+	size_t cq_ring_size;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	/** requests in flight, see URING_PENDING */
+	unsigned pending;
+
+	/** wakeup descriptor was signaled */
+	bool wakeup;
+
+	/* read-ahead buffer */
+	unsigned char *recv_buf;
+	unsigned recv_pos, recv_len;
+	/** last receive failed or got end of file, recv_res contains the result */
+	bool recv_done;
+	int recv_res;
+
+	/* send in progress */
+	struct msghdr send_msg;
+	struct iovec send_iov[URING_MAX_IOVEC];
+	bool send_done;
+	int send_res;
+};
+
+static void
+tds_uring_destroy(struct tds_uring *uring)
+{
+	if (uring->sqes)
+		munmap(uring->sqes, uring->sqes_size);
+	if (uring->cq_ring && uring->cq_ring != uring->sq_ring)
+		munmap(uring->cq_ring, uring->cq_ring_size);
+	if (uring->sq_ring)
+		munmap(uring->sq_ring, uring->sq_ring_size);
+	if (uring->fd >= 0)
+		close(uring->fd);
+	free(uring->recv_buf);
+	free(uring);
+}
+
+static void *
+tds_uring_mmap(int fd, size_t size, off_t offset)
+{
+	void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+
+	return p == MAP_FAILED ? NULL : p;
+}
+
+/**
+ * Start using io_uring for connection I/O.
+ * Must be called after the socket is connected.
+ * \return true on success, false if io_uring is not usable (connection
+ *         continues to use poll(2))
+ */
+bool
+tds_uring_init(TDSCONNECTION *conn)
+{
+	struct io_uring_params params;
+	struct tds_uring *uring;
+	unsigned char *ring;
+
+	if (conn->uring)
+		return true;
+
+	uring = tds_new0(struct tds_uring, 1);
+	if (!uring)
+		return false;
+	uring->fd = -1;
+
+	uring->recv_buf = tds_new(unsigned char, URING_RECV_SIZE);
+	if (!uring->recv_buf)
+		goto failure;
+
+	memset(&params, 0, sizeof(params));
+	uring->fd = (int) syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+	if (uring->fd < 0) {
+		tdsdump_log(TDS_DBG_NETWORK, "io_uring_setup failed, errno %d\n", errno);
+		goto failure;
+	}
+
+	/* we need to pass timeouts and to receive from non-blocking sockets */
+	if ((params.features & (IORING_FEAT_EXT_ARG|IORING_FEAT_FAST_POLL)) != (IORING_FEAT_EXT_ARG|IORING_FEAT_FAST_POLL)) {
+		tdsdump_log(TDS_DBG_NETWORK, "io_uring features %#x not supported\n", params.features);
+		goto failure;
+	}
+
+	uring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	uring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (uring->cq_ring_size > uring->sq_ring_size)
+			uring->sq_ring_size = uring->cq_ring_size;
+		uring->cq_ring_size = uring->sq_ring_size;
+	}
+
+	uring->sq_ring = tds_uring_mmap(uring->fd, uring->sq_ring_size, IORING_OFF_SQ_RING);
+	if (!uring->sq_ring)
+		goto failure;
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		uring->cq_ring = uring->sq_ring;
+	else
+		uring->cq_ring = tds_uring_mmap(uring->fd, uring->cq_ring_size, IORING_OFF_CQ_RING);
+	if (!uring->cq_ring)
+		goto failure;
+	uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	uring->sqes = (struct io_uring_sqe *) tds_uring_mmap(uring->fd, uring->sqes_size, IORING_OFF_SQES);
+	if (!uring->sqes)
+		goto failure;
+
+	ring = (unsigned char *) uring->sq_ring;
+	uring->sq_head = (unsigned *) (ring + params.sq_off.head);
+	uring->sq_tail = (unsigned *) (ring + params.sq_off.tail);
+	uring->sq_mask = (unsigned *) (ring + params.sq_off.ring_mask);
+	uring->sq_array = (unsigned *) (ring + params.sq_off.array);
+	uring->sq_entries = params.sq_entries;
+
+	ring = (unsigned char *) uring->cq_ring;
+	uring->cq_head = (unsigned *) (ring + params.cq_off.head);
+	uring->cq_tail = (unsigned *) (ring + params.cq_off.tail);
+	uring->cq_mask = (unsigned *) (ring + params.cq_off.ring_mask);
+	uring->cqes = (struct io_uring_cqe *) (ring + params.cq_off.cqes);
+
+	tdsdump_log(TDS_DBG_NETWORK, "using io_uring for network I/O\n");
+	conn->uring = uring;
+	return true;
+
+failure:
+	tds_uring_destroy(uring);
+	return false;
+}
+
+/* queue a new request, it will be submitted by next tds_uring_enter */
+static struct io_uring_sqe *
+tds_uring_get_sqe(struct tds_uring *uring, unsigned char opcode, int op)
+{
+	struct io_uring_sqe *sqe;
+	unsigned tail = *uring->sq_tail, idx;
+
+	if (tail - __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE) >= uring->sq_entries)
+		return NULL;
+
+	idx = tail & *uring->sq_mask;
+	sqe = &uring->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->user_data = op;
+	uring->sq_array[idx] = idx;
+	__atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	if (op != URING_CANCEL)
+		uring->pending |= URING_PENDING(op);
+	return sqe;
+}
+
+/*
+ * Submit queued requests and wait for at least min_complete completions.
+ * timeout_ms < 0 means no timeout.
+ * Returns <0 on error (errno set).
+ */
+static int
+tds_uring_enter(struct tds_uring *uring, unsigned min_complete, int timeout_ms)
+{
+	unsigned to_submit, flags = 0;
+	uring_getevents_arg arg, *parg = NULL;
+	uring_timespec ts;
+	size_t arg_size = 0;
+
+	to_submit = *uring->sq_tail - __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE);
+	if (min_complete) {
+		flags |= IORING_ENTER_GETEVENTS;
+		if (timeout_ms >= 0) {
+			ts.tv_sec = timeout_ms / 1000;
+			ts.tv_nsec = (timeout_ms % 1000) * 1000000ll;
+			memset(&arg, 0, sizeof(arg));
+			arg.sigmask_sz = _NSIG / 8;
+			arg.ts = (uint64_t) (uintptr_t) &ts;
+			parg = &arg;
+			arg_size = sizeof(arg);
+			flags |= IORING_ENTER_EXT_ARG;
+		}
+	}
+	return (int) syscall(__NR_io_uring_enter, uring->fd, to_submit, min_complete, flags, parg, arg_size);
+}
+
+/* process completed requests, returns number of completions */
+static unsigned
+tds_uring_reap(struct tds_uring *uring)
+{
+	unsigned head = *uring->cq_head;
+	unsigned tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+	unsigned count = 0;
+
+	for (; head != tail; ++head, ++count) {
+		const struct io_uring_cqe *cqe = &uring->cqes[head & *uring->cq_mask];
+		int res = cqe->res;
+
+		switch (cqe->user_data) {
+		case URING_RECV:
+			uring->pending &= ~URING_PENDING(URING_RECV);
+			if (res > 0) {
+				uring->recv_pos = 0;
+				uring->recv_len = res;
+			} else if (res != -EAGAIN && res != -EINTR && res != -ECANCELED) {
+				uring->recv_done = true;
+				uring->recv_res = res;
+			}
+			break;
+		case URING_WAKEUP:
+			uring->pending &= ~URING_PENDING(URING_WAKEUP);
+			if (res != -ECANCELED)
+				uring->wakeup = true;
+			break;
+		case URING_SEND:
+			uring->pending &= ~URING_PENDING(URING_SEND);
+			uring->send_done = true;
+			uring->send_res = res;
+			break;
+		}
+	}
+	__atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+	return count;
+}
+
+/* queue receive and wakeup requests if not already in flight */
+static void
+tds_uring_post(TDSCONNECTION *conn)
+{
+	struct tds_uring *uring = conn->uring;
+	struct io_uring_sqe *sqe;
+
+	/* read ahead */
+	if (!(uring->pending & URING_PENDING(URING_RECV)) && uring->recv_pos >= uring->recv_len && !uring->recv_done) {
+		sqe = tds_uring_get_sqe(uring, IORING_OP_RECV, URING_RECV);
+		if (sqe) {
+			sqe->fd = conn->s;
+			sqe->addr = (uint64_t) (uintptr_t) uring->recv_buf;
+			sqe->len = URING_RECV_SIZE;
+		}
+	}
+
+	if (!(uring->pending & URING_PENDING(URING_WAKEUP)) && !uring->wakeup) {
+		sqe = tds_uring_get_sqe(uring, IORING_OP_POLL_ADD, URING_WAKEUP);
+		if (sqe) {
+			sqe->fd = tds_wakeup_get_fd(&conn->wakeup);
+			sqe->poll_events = POLLIN;
+		}
+	}
+}
+
+/* compute events available for the caller */
+static int
+tds_uring_ready(struct tds_uring *uring, unsigned tds_sel, bool *wakeup)
+{
+	int events = 0;
+
+	if ((tds_sel & POLLIN) && (uring->recv_pos < uring->recv_len || uring->recv_done))
+		events |= POLLIN;
+	if ((tds_sel & POLLOUT) && uring->send_done)
+		events |= POLLOUT;
+	if (uring->wakeup) {
+		uring->wakeup = false;
+		*wakeup = true;
+	}
+	return events;
+}
+
+/**
+ * Wait for the connection to be ready, similar to poll(2).
+ * Waiting for POLLIN means waiting for received data, waiting for
+ * POLLOUT means waiting for completion of the send posted by
+ * tds_uring_post_send().
+ * \param tds_sel    events to wait, POLLIN and/or POLLOUT
+ * \param timeout_ms timeout in milliseconds, <0 to wait forever
+ * \param wakeup     set to true if the wakeup descriptor was signaled
+ * \return events available, 0 on timeout, <0 on error (errno set)
+ */
+int
+tds_uring_poll(TDSCONNECTION *conn, unsigned tds_sel, int timeout_ms, bool *wakeup)
+{
+	struct tds_uring *uring = conn->uring;
+	int events, rc;
+
+	*wakeup = false;
+	for (;;) {
+		events = tds_uring_ready(uring, tds_sel, wakeup);
+		if (events || *wakeup)
+			return events;
+
+		tds_uring_post(conn);
+		rc = tds_uring_enter(uring, 1, timeout_ms);
+		if (!tds_uring_reap(uring)) {
+			if (rc < 0 && errno != ETIME)
+				return -1;
+			/* timeout */
+			return 0;
+		}
+		/* something completed, possibly not what we are waiting for, check again */
+	}
+}
+
+/**
+ * Get data received.
+ * \return bytes copied, 0 if no data is available, <0 on error (connection closed)
+ */
+ptrdiff_t
+tds_uring_recv(TDSSOCKET *tds, unsigned char *buf, size_t buflen)
+{
+	TDSCONNECTION *conn = tds->conn;
+	struct tds_uring *uring = conn->uring;
+	int res;
+
+	if (uring->recv_pos < uring->recv_len) {
+		size_t len = uring->recv_len - uring->recv_pos;
+
+		if (len > buflen)
+			len = buflen;
+		memcpy(buf, uring->recv_buf + uring->recv_pos, len);
+		uring->recv_pos += (unsigned) len;
+		return len;
+	}
+
+	if (!uring->recv_done)
+		return 0;
+
+	/* detect connection close */
+	res = uring->recv_res;
+	tds_connection_close(conn);
+	tdserror(conn->tds_ctx, tds, res == 0 ? TDSESEOF : TDSEREAD, res == 0 ? 0 : -res);
+	return -1;
+}
+
+/**
+ * Queue a send of given buffers.
+ * Only a single send can be in flight, the caller should wait for
+ * completion using tds_uring_poll() with POLLOUT and get the result
+ * with tds_uring_send_result().
+ * Buffers must be kept valid till the send completes.
+ */
+bool
+tds_uring_post_send(TDSCONNECTION *conn, const struct iovec *iov, int iovcnt)
+{
+	struct tds_uring *uring = conn->uring;
+	struct io_uring_sqe *sqe;
+
+	if (uring->pending & URING_PENDING(URING_SEND))
+		return false;
+
+	sqe = tds_uring_get_sqe(uring, IORING_OP_SENDMSG, URING_SEND);
+	if (!sqe)
+		return false;
+
+	if (iovcnt > URING_MAX_IOVEC)
+		iovcnt = URING_MAX_IOVEC;
+	memcpy(uring->send_iov, iov, iovcnt * sizeof(*iov));
+	memset(&uring->send_msg, 0, sizeof(uring->send_msg));
+	uring->send_msg.msg_iov = uring->send_iov;
+	uring->send_msg.msg_iovlen = iovcnt;
+	uring->send_done = false;
+
+	sqe->fd = conn->s;
+	sqe->addr = (uint64_t) (uintptr_t) &uring->send_msg;
+	sqe->len = 1;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	return true;
+}
+
+/**
+ * Get result of a completed send.
+ * \return bytes sent, 0 if the send should be retried, <0 on error (connection closed)
+ */
+ptrdiff_t
+tds_uring_send_result(TDSSOCKET *tds)
+{
+	TDSCONNECTION *conn = tds->conn;
+	struct tds_uring *uring = conn->uring;
+	int res;
+	char *errstr;
+
+	if (!uring->send_done)
+		return 0;
+
+	uring->send_done = false;
+	res = uring->send_res;
+	if (res >= 0 || res == -EAGAIN || res == -EINTR)
+		return res > 0 ? res : 0;
+
+	/* detect connection close */
+	errstr = sock_strerror(-res);
+	tdsdump_log(TDS_DBG_NETWORK, "send(2) failed: %d (%s)\n", -res, errstr);
+	sock_strerror_free(errstr);
+	tds_connection_close(conn);
+	tdserror(conn->tds_ctx, tds, TDSEWRIT, -res);
+	return -1;
+}
+
+/**
+ * Stop using io_uring for the connection.
+ * Requests in flight are canceled and waited for, the kernel could still
+ * access our buffers otherwise.
+ */
+void
+tds_uring_free(TDSCONNECTION *conn)
+{
+	struct tds_uring *uring = conn->uring;
+	int op;
+
+	if (!uring)
+		return;
+	conn->uring = NULL;
+
+	for (op = URING_RECV; op < URING_CANCEL; ++op) {
+		struct io_uring_sqe *sqe;
+
+		if (!(uring->pending & URING_PENDING(op)))
+			continue;
+		sqe = tds_uring_get_sqe(uring, IORING_OP_ASYNC_CANCEL, URING_CANCEL);
+		if (sqe)
+			sqe->addr = op;
+	}
+
+	while (uring->pending) {
+		if (tds_uring_enter(uring, 1, -1) < 0 && errno != EINTR)
+			break;
+		tds_uring_reap(uring);
+	}
+
+	tds_uring_destroy(uring);
+}
+
+#endif /* TDS_HAVE_IO_URING */
@@ -0,0 +1,651 @@
+/* FreeTDS - Library of routines accessing Sybase and Microsoft databases
+ * Copyright (C) 2026
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * \file
+ * \brief Built-in converters between UTF-16, UTF-8 and ISO-8859-1
+ *
+ * Every Unicode column or parameter needs one of these conversions and
+ * the system iconv is quite slow for them.
+ * Converters follow iconv(3) semantic (including errors and pointers
+ * update) so tds_iconv() can use them in place of the system ones.
+ * Runs of characters needing no transformation are handled with
+ * SSE2 or AVX2 instructions if the compiler targets them.
+ */
+
+#include <config.h>
+
+#if HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+#if HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#include <freetds/tds.h>
+#include <freetds/iconv.h>
+#include <freetds/bytes.h>
+#include <freetds/encodings.h>
+#include <freetds/utils/bjoern-utf8.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TDS_SIMD_AVX2 1
+#define TDS_SIMD_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TDS_SIMD_SSE2 1
+#endif
+
+/* like iconv silently drop language tags not representable in output */
+#define TDS_UNICODE_TAG(uc) (((uc) >> 7) == (0xe0000 >> 7))
+
+/**
+ * \addtogroup conv
+ * @{
+ */
+
+/**
+ * Narrow UTF-16LE code units to bytes while no unit has a bit of \a mask set.
+ * \param in     input code units
+ * \param units  maximum number of units to convert
+ * \param out    output bytes
+ * \param mask   0xff80 to stop at non-ASCII units, 0xff00 at non-Latin1 ones
+ * \return number of units converted
+ */
+static size_t
+tds_narrow_run(const unsigned char *in, size_t units, unsigned char *out, unsigned mask)
+{
+	size_t n = 0;
+
+#if TDS_SIMD_AVX2
+	{
+		const __m256i vmask = _mm256_set1_epi16((short) mask);
+
+		for (; n + 32 <= units; n += 32) {
+			__m256i a = _mm256_loadu_si256((const __m256i *) (in + n * 2));
+			__m256i b = _mm256_loadu_si256((const __m256i *) (in + n * 2 + 32));
+
+			if (!_mm256_testz_si256(_mm256_or_si256(a, b), vmask))
+				break;
+			/* packing works on 128-bit lanes, restore order */
+			_mm256_storeu_si256((__m256i *) (out + n),
+					    _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8));
+		}
+	}
+#endif
+#if TDS_SIMD_SSE2
+	{
+		const __m128i vmask = _mm_set1_epi16((short) mask);
+		const __m128i zero = _mm_setzero_si128();
+
+		for (; n + 16 <= units; n += 16) {
+			__m128i a = _mm_loadu_si128((const __m128i *) (in + n * 2));
+			__m128i b = _mm_loadu_si128((const __m128i *) (in + n * 2 + 16));
+			__m128i t = _mm_and_si128(_mm_or_si128(a, b), vmask);
+
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(t, zero)) != 0xffff)
+				break;
+			_mm_storeu_si128((__m128i *) (out + n), _mm_packus_epi16(a, b));
+		}
+	}
+#endif
+	for (; n < units; ++n) {
+		unsigned u = TDS_GET_UA2LE(in + n * 2);
+
+		if (u & mask)
+			break;
+		out[n] = (unsigned char) u;
+	}
+	return n;
+}
+
+/**
+ * Widen bytes to UTF-16LE code units.
+ * \param in     input bytes
+ * \param len    maximum number of bytes to convert
+ * \param out    output code units
+ * \param ascii  stop at first non-ASCII byte
+ * \return number of bytes converted
+ */
+static size_t
+tds_widen_run(const unsigned char *in, size_t len, unsigned char *out, bool ascii)
+{
+	size_t n = 0;
+
+#if TDS_SIMD_AVX2
+	for (; n + 32 <= len; n += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) (in + n));
+
+		if (ascii && _mm256_movemask_epi8(v) != 0)
+			break;
+		_mm256_storeu_si256((__m256i *) (out + n * 2), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+		_mm256_storeu_si256((__m256i *) (out + n * 2 + 32), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+	}
+#endif
+#if TDS_SIMD_SSE2
+	{
+		const __m128i zero = _mm_setzero_si128();
+
+		for (; n + 16 <= len; n += 16) {
+			__m128i v = _mm_loadu_si128((const __m128i *) (in + n));
+
+			if (ascii && _mm_movemask_epi8(v) != 0)
+				break;
+			_mm_storeu_si128((__m128i *) (out + n * 2), _mm_unpacklo_epi8(v, zero));
+			_mm_storeu_si128((__m128i *) (out + n * 2 + 16), _mm_unpackhi_epi8(v, zero));
+		}
+	}
+#endif
+	for (; n < len; ++n) {
+		if (ascii && in[n] >= 0x80)
+			break;
+		out[n * 2] = in[n];
+		out[n * 2 + 1] = 0;
+	}
+	return n;
+}
+
+/**
+ * Count leading ASCII bytes.
+ * \param in   input bytes
+ * \param len  maximum number of bytes to check
+ * \return number of ASCII bytes
+ */
+static size_t
+tds_ascii_bytes(const unsigned char *in, size_t len)
+{
+	size_t n = 0;
+
+#if TDS_SIMD_AVX2
+	for (; n + 32 <= len; n += 32)
+		if (_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *) (in + n))) != 0)
+			break;
+#endif
+#if TDS_SIMD_SSE2
+	for (; n + 16 <= len; n += 16)
+		if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *) (in + n))) != 0)
+			break;
+#endif
+	while (n < len && in[n] < 0x80)
+		++n;
+	return n;
+}
+
+/**
+ * Count leading ASCII UTF-16LE code units.
+ * \param in     input code units
+ * \param units  maximum number of units to check
+ * \return number of ASCII units
+ */
+static size_t
+tds_ascii_units(const unsigned char *in, size_t units)
+{
+	size_t n = 0;
+
+#if TDS_SIMD_SSE2
+	{
+		const __m128i vmask = _mm_set1_epi16((short) 0xff80);
+		const __m128i zero = _mm_setzero_si128();
+
+		for (; n + 8 <= units; n += 8) {
+			__m128i t = _mm_and_si128(_mm_loadu_si128((const __m128i *) (in + n * 2)), vmask);
+
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(t, zero)) != 0xffff)
+				break;
+		}
+	}
+#endif
+	while (n < units && TDS_GET_UA2LE(in + n * 2) < 0x80)
+		++n;
+	return n;
+}
+
+/* state of a conversion, pointers are updated at the end */
+typedef struct
+{
+	const unsigned char *in;
+	size_t il;
+	unsigned char *out;
+	size_t ol;
+} TDS_UTF_CONV;
+
+static size_t
+tds_utf_conv_end(TDS_UTF_CONV *c, const char **inbuf, size_t *inbytesleft, char **outbuf, size_t *outbytesleft,
+		 int err)
+{
+	*inbuf = (const char *) c->in;
+	*inbytesleft = c->il;
+	*outbuf = (char *) c->out;
+	*outbytesleft = c->ol;
+	if (!err)
+		return 0;
+	errno = err;
+	return (size_t) -1;
+}
+
+/**
+ * Read a character from UTF-16LE (or UCS-2LE) input.
+ * \return bytes read or negative errno value
+ */
+static int
+tds_get_utf16(const unsigned char *in, size_t il, bool surrogates, uint32_t *out)
+{
+	unsigned u, u2;
+
+	if (il < 2)
+		return -EINVAL;
+	u = TDS_GET_UA2LE(in);
+	if (u < 0xd800 || u >= 0xe000) {
+		*out = u;
+		return 2;
+	}
+	if (!surrogates || u >= 0xdc00)
+		return -EILSEQ;
+	if (il < 4)
+		return -EINVAL;
+	u2 = TDS_GET_UA2LE(in + 2);
+	if (u2 < 0xdc00 || u2 >= 0xe000)
+		return -EILSEQ;
+	*out = 0x10000 + ((u - 0xd800) << 10) + (u2 - 0xdc00);
+	return 4;
+}
+
+static size_t
+tds_utf16_to_utf8(const char **inbuf, size_t *inbytesleft, char **outbuf, size_t *outbytesleft, bool surrogates)
+{
+	TDS_UTF_CONV c = { (const unsigned char *) *inbuf, *inbytesleft, (unsigned char *) *outbuf, *outbytesleft };
+	int err = 0;
+
+	while (c.il) {
+		size_t n;
+		int len;
+		uint32_t uc;
+
+		n = tds_narrow_run(c.in, TDS_MIN(c.il / 2, c.ol), c.out, 0xff80);
+		c.in += n * 2;
+		c.il -= n * 2;
+		c.out += n;
+		c.ol -= n;
+		if (!c.il)
+			break;
+
+		len = tds_get_utf16(c.in, c.il, surrogates, &uc);
+		if (len < 0) {
+			err = -len;
+			break;
+		}
+		n = uc < 0x80 ? 1 : uc < 0x800 ? 2 : uc < 0x10000 ? 3 : 4;
+		if (c.ol < n) {
+			err = E2BIG;
+			break;
+		}
+		switch (n) {
+		case 1:
+			c.out[0] = (unsigned char) uc;
+			break;
+		case 2:
+			c.out[0] = 0xc0 | (uc >> 6);
+			c.out[1] = 0x80 | (uc & 0x3f);
+			break;
+		case 3:
+			c.out[0] = 0xe0 | (uc >> 12);
+			c.out[1] = 0x80 | ((uc >> 6) & 0x3f);
+			c.out[2] = 0x80 | (uc & 0x3f);
+			break;
+		default:
+			c.out[0] = 0xf0 | (uc >> 18);
+			c.out[1] = 0x80 | ((uc >> 12) & 0x3f);
+			c.out[2] = 0x80 | ((uc >> 6) & 0x3f);
+			c.out[3] = 0x80 | (uc & 0x3f);
+			break;
+		}
+		c.in += len;
+		c.il -= len;
+		c.out += n;
+		c.ol -= n;
+	}
+	return tds_utf_conv_end(&c, inbuf, inbytesleft, outbuf, outbytesleft, err);
+}
+
+/**
+ * Check if input ends in the middle of a sequence.
+ * Like iconv report truncated sequences even if invalid.
+ */
+static bool
+tds_utf8_truncated(const unsigned char *in, size_t len)
+{
+	unsigned char c = in[0];
+	size_t i, needed;
+
+	if (c < 0xc2 || c > 0xfd)
+		return false;
+	needed = c < 0xe0 ? 2 : c < 0xf0 ? 3 : c < 0xf8 ? 4 : c < 0xfc ? 5 : 6;
+	if (len >= needed)
+		return false;
+	for (i = 1; i < len; ++i)
+		if ((in[i] & 0xc0) != 0x80)
+			return false;
+	return true;
+}
+
+/**
+ * Check for a well formed sequence encoding a value above U+10FFFF.
+ * iconv decode these as characters so report E2BIG if output is full.
+ */
+static bool
+tds_utf8_out_of_range(const unsigned char *in, size_t len)
+{
+	if (len < 4 || in[0] < 0xf4 || in[0] > 0xf7 || (in[0] == 0xf4 && in[1] < 0x90))
+		return false;
+	return (in[1] & 0xc0) == 0x80 && (in[2] & 0xc0) == 0x80 && (in[3] & 0xc0) == 0x80;
+}
+
+static size_t
+tds_utf8_to_utf16(const char **inbuf, size_t *inbytesleft, char **outbuf, size_t *outbytesleft, bool surrogates)
+{
+	TDS_UTF_CONV c = { (const unsigned char *) *inbuf, *inbytesleft, (unsigned char *) *outbuf, *outbytesleft };
+	int err = 0;
+
+	while (c.il) {
+		size_t n, len;
+		uint32_t state, uc = 0;
+
+		n = tds_widen_run(c.in, TDS_MIN(c.il, c.ol / 2), c.out, true);
+		c.in += n;
+		c.il -= n;
+		c.out += n * 2;
+		c.ol -= n * 2;
+		if (!c.il)
+			break;
+
+		state = UTF8_ACCEPT;
+		len = 0;
+		do {
+			if (len >= c.il) {
+				err = EINVAL;
+				break;
+			}
+			decode_utf8(&state, &uc, c.in[len++]);
+		} while (state != UTF8_ACCEPT && state != UTF8_REJECT);
+		if (err)
+			break;
+		if (state == UTF8_REJECT) {
+			err = EILSEQ;
+			if (tds_utf8_truncated(c.in, c.il))
+				err = EINVAL;
+			else if (c.ol < 2 && tds_utf8_out_of_range(c.in, c.il))
+				err = E2BIG;
+			break;
+		}
+
+		/* like iconv check output space before representability */
+		n = uc < 0x10000 || !surrogates ? 2 : 4;
+		if (c.ol < n) {
+			err = E2BIG;
+			break;
+		}
+		if (uc >= 0x10000 && !surrogates) {
+			if (!TDS_UNICODE_TAG(uc)) {
+				err = EILSEQ;
+				break;
+			}
+			n = 0;
+		} else if (n == 2) {
+			TDS_PUT_UA2LE(c.out, uc);
+		} else {
+			uc -= 0x10000;
+			TDS_PUT_UA2LE(c.out, 0xd800 + (uc >> 10));
+			TDS_PUT_UA2LE(c.out + 2, 0xdc00 + (uc & 0x3ff));
+		}
+		c.in += len;
+		c.il -= len;
+		c.out += n;
+		c.ol -= n;
+	}
+	return tds_utf_conv_end(&c, inbuf, inbytesleft, outbuf, outbytesleft, err);
+}
+
+static size_t
+tds_utf16_to_latin1(const char **inbuf, size_t *inbytesleft, char **outbuf, size_t *outbytesleft, bool surrogates)
+{
+	TDS_UTF_CONV c = { (const unsigned char *) *inbuf, *inbytesleft, (unsigned char *) *outbuf, *outbytesleft };
+	int err = 0, len;
+	size_t n;
+	uint32_t uc;
+
+	while (c.il) {
+		n = tds_narrow_run(c.in, TDS_MIN(c.il / 2, c.ol), c.out, 0xff00);
+		c.in += n * 2;
+		c.il -= n * 2;
+		c.out += n;
+		c.ol -= n;
+		if (!c.il)
+			break;
+
+		/* find out why we stopped */
+		len = tds_get_utf16(c.in, c.il, surrogates, &uc);
+		if (len < 0) {
+			err = -len;
+			break;
+		}
+		if (!c.ol) {
+			err = E2BIG;
+			break;
+		}
+		if (!TDS_UNICODE_TAG(uc)) {
+			err = EILSEQ;
+			break;
+		}
+		c.in += len;
+		c.il -= len;
+	}
+	return tds_utf_conv_end(&c, inbuf, inbytesleft, outbuf, outbytesleft, err);
+}
+
+static size_t
+tds_latin1_to_utf16(const char **inbuf, size_t *inbytesleft, char **outbuf, size_t *outbytesleft)
+{
+	TDS_UTF_CONV c = { (const unsigned char *) *inbuf, *inbytesleft, (unsigned char *) *outbuf, *outbytesleft };
+	size_t n;
+
+	n = tds_widen_run(c.in, TDS_MIN(c.il, c.ol / 2), c.out, false);
+	c.in += n;
+	c.il -= n;
+	c.out += n * 2;
+	c.ol -= n * 2;
+	return tds_utf_conv_end(&c, inbuf, inbytesleft, outbuf, outbytesleft, c.il ? E2BIG : 0);
+}
+
+#define FAST_ICONV(name, call) \
+static size_t \
+name(const char **inbuf, size_t *inbytesleft, char **outbuf, size_t *outbytesleft) \
+{ \
+	/* no shift state to reset */ \
+	if (!inbuf || !*inbuf) \
+		return 0; \
+	return call; \
+}
+
+FAST_ICONV(tds_ucs2le_to_utf8, tds_utf16_to_utf8(inbuf, inbytesleft, outbuf, outbytesleft, false))
+FAST_ICONV(tds_utf16le_to_utf8, tds_utf16_to_utf8(inbuf, inbytesleft, outbuf, outbytesleft, true))
+FAST_ICONV(tds_utf8_to_ucs2le, tds_utf8_to_utf16(inbuf, inbytesleft, outbuf, outbytesleft, false))
+FAST_ICONV(tds_utf8_to_utf16le, tds_utf8_to_utf16(inbuf, inbytesleft, outbuf, outbytesleft, true))
+FAST_ICONV(tds_ucs2le_to_latin1, tds_utf16_to_latin1(inbuf, inbytesleft, outbuf, outbytesleft, false))
+FAST_ICONV(tds_utf16le_to_latin1, tds_utf16_to_latin1(inbuf, inbytesleft, outbuf, outbytesleft, true))
+FAST_ICONV(tds_latin1_to_utf16le, tds_latin1_to_utf16(inbuf, inbytesleft, outbuf, outbytesleft))
+
+/**
+ * Get a built-in converter between two charsets.
+ * \param from_canonic  canonic charset of input
+ * \param to_canonic    canonic charset of output
+ * \return converter or NULL if system iconv must be used
+ */
+TDS_FAST_ICONV
+tds_fast_iconv_get(int from_canonic, int to_canonic)
+{
+	switch (from_canonic) {
+	case TDS_CHARSET_UCS_2LE:
+		if (to_canonic == TDS_CHARSET_UTF_8)
+			return tds_ucs2le_to_utf8;
+		if (to_canonic == TDS_CHARSET_ISO_8859_1)
+			return tds_ucs2le_to_latin1;
+		break;
+	case TDS_CHARSET_UTF_16LE:
+		if (to_canonic == TDS_CHARSET_UTF_8)
+			return tds_utf16le_to_utf8;
+		if (to_canonic == TDS_CHARSET_ISO_8859_1)
+			return tds_utf16le_to_latin1;
+		break;
+	case TDS_CHARSET_UTF_8:
+		if (to_canonic == TDS_CHARSET_UCS_2LE)
+			return tds_utf8_to_ucs2le;
+		if (to_canonic == TDS_CHARSET_UTF_16LE)
+			return tds_utf8_to_utf16le;
+		break;
+	case TDS_CHARSET_ISO_8859_1:
+		/* every Latin1 character is in the BMP */
+		if (to_canonic == TDS_CHARSET_UCS_2LE || to_canonic == TDS_CHARSET_UTF_16LE)
+			return tds_latin1_to_utf16le;
+		break;
+	}
+	return NULL;
+}
+
+/**
+ * Return size of ASCII characters in a charset.
+ * \return 1 or 2 (UTF-16LE), 0 if ASCII characters are not always encoded
+ *         as a single code unit of the same value
+ */
+static int
+tds_ascii_width(int canonic)
+{
+	switch (canonic) {
+	case TDS_CHARSET_UCS_2LE:
+	case TDS_CHARSET_UTF_16LE:
+		return 2;
+	case TDS_CHARSET_ISO_8859_1:
+	case TDS_CHARSET_ISO_8859_2:
+	case TDS_CHARSET_ISO_8859_3:
+	case TDS_CHARSET_ISO_8859_4:
+	case TDS_CHARSET_ISO_8859_5:
+	case TDS_CHARSET_ISO_8859_6:
+	case TDS_CHARSET_ISO_8859_7:
+	case TDS_CHARSET_ISO_8859_8:
+	case TDS_CHARSET_ISO_8859_9:
+	case TDS_CHARSET_ISO_8859_10:
+	case TDS_CHARSET_ISO_8859_13:
+	case TDS_CHARSET_ISO_8859_14:
+	case TDS_CHARSET_ISO_8859_15:
+	case TDS_CHARSET_ISO_8859_16:
+	case TDS_CHARSET_UTF_8:
+	case TDS_CHARSET_US_ASCII:
+	/* CP1255 and CP1258 are excluded, iconv compose characters */
+	case TDS_CHARSET_CP1250:
+	case TDS_CHARSET_CP1251:
+	case TDS_CHARSET_CP1252:
+	case TDS_CHARSET_CP1253:
+	case TDS_CHARSET_CP1254:
+	case TDS_CHARSET_CP1256:
+	case TDS_CHARSET_CP1257:
+	case TDS_CHARSET_CP437:
+	case TDS_CHARSET_CP850:
+	case TDS_CHARSET_CP862:
+	case TDS_CHARSET_CP866:
+	case TDS_CHARSET_CP874:
+	case TDS_CHARSET_KOI8_R:
+	case TDS_CHARSET_KOI8_RU:
+	case TDS_CHARSET_KOI8_T:
+	case TDS_CHARSET_KOI8_U:
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Check if ASCII characters can be converted without iconv.
+ * This is possible if both charsets encode ASCII characters
+ * as single code units and an ASCII code unit is never part of
+ * another character.
+ * \param from_canonic  canonic charset of input
+ * \param to_canonic    canonic charset of output
+ */
+TDS_ASCII_MODE
+tds_ascii_mode(int from_canonic, int to_canonic)
+{
+	switch (tds_ascii_width(from_canonic) * 4 + tds_ascii_width(to_canonic)) {
+	case 1 * 4 + 1:
+		return TDS_ASCII_COPY;
+	case 1 * 4 + 2:
+		return TDS_ASCII_WIDEN;
+	case 2 * 4 + 1:
+		return TDS_ASCII_NARROW;
+	case 2 * 4 + 2:
+		return TDS_ASCII_COPY2;
+	}
+	return TDS_ASCII_NONE;
+}
+
+/**
+ * Convert leading ASCII characters.
+ * Pointers are updated like iconv(3) does, conversion stops at
+ * first non-ASCII character or when output is full.
+ * \param mode  how to convert, see tds_ascii_mode()
+ * \return number of bytes consumed
+ */
+size_t
+tds_ascii_convert(TDS_ASCII_MODE mode, const char **inbuf, size_t *inbytesleft, char **outbuf, size_t *outbytesleft)
+{
+	const unsigned char *in = (const unsigned char *) *inbuf;
+	unsigned char *out = (unsigned char *) *outbuf;
+	size_t n, in_bytes, out_bytes;
+
+	switch (mode) {
+	case TDS_ASCII_COPY:
+		n = tds_ascii_bytes(in, TDS_MIN(*inbytesleft, *outbytesleft));
+		memcpy(out, in, n);
+		in_bytes = out_bytes = n;
+		break;
+	case TDS_ASCII_WIDEN:
+		n = tds_widen_run(in, TDS_MIN(*inbytesleft, *outbytesleft / 2), out, true);
+		in_bytes = n;
+		out_bytes = n * 2;
+		break;
+	case TDS_ASCII_NARROW:
+		n = tds_narrow_run(in, TDS_MIN(*inbytesleft / 2, *outbytesleft), out, 0xff80);
+		in_bytes = n * 2;
+		out_bytes = n;
+		break;
+	case TDS_ASCII_COPY2:
+		n = tds_ascii_units(in, TDS_MIN(*inbytesleft, *outbytesleft) / 2);
+		memcpy(out, in, n * 2);
+		in_bytes = out_bytes = n * 2;
+		break;
+	default:
+		return 0;
+	}
+	*inbuf += in_bytes;
+	*inbytesleft -= in_bytes;
+	*outbuf += out_bytes;
+	*outbytesleft -= out_bytes;
+	return in_bytes;
+}
+
+/** @} */